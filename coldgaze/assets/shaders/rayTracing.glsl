@@ -0,0 +1,24 @@
+// Ray tracing shaders are written against GL_EXT_ray_tracing for the KHR backend,
+// with RAY_TRACING_NV defined they are compiled for VK_NV_ray_tracing instead
+#ifdef RAY_TRACING_NV
+#extension GL_NV_ray_tracing : require
+
+#define accelerationStructureEXT accelerationStructureNV
+#define rayPayloadEXT rayPayloadNV
+#define rayPayloadInEXT rayPayloadInNV
+#define hitAttributeEXT hitAttributeNV
+#define traceRayEXT traceNV
+
+#define gl_LaunchIDEXT gl_LaunchIDNV
+#define gl_LaunchSizeEXT gl_LaunchSizeNV
+#define gl_RayFlagsOpaqueEXT gl_RayFlagsOpaqueNV
+#define gl_RayFlagsTerminateOnFirstHitEXT gl_RayFlagsTerminateOnFirstHitNV
+#define gl_RayFlagsSkipClosestHitShaderEXT gl_RayFlagsSkipClosestHitShaderNV
+#define gl_ObjectToWorldEXT gl_ObjectToWorldNV
+#define gl_InstanceCustomIndexEXT gl_InstanceCustomIndexNV
+#define gl_WorldRayOriginEXT gl_WorldRayOriginNV
+#define gl_WorldRayDirectionEXT gl_WorldRayDirectionNV
+#define gl_HitTEXT gl_HitTNV
+#else
+#extension GL_EXT_ray_tracing : require
+#endif
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "glm/mat4x4.hpp"
+
+namespace CG {
+class ThreadPool;
+
+namespace Vk {
+    class GLTFModel;
+}
+
+namespace Benchmarks {
+    // Builds CPU BVH over the loaded model and reports build time, SAH cost and throughput of single ray and packet traversal
+    // for coherent camera rays and incoherent random rays.
+    // Started for every loaded scene with -bvhbenchmark command line argument, the model has to keep its geometry data.
+    void RunBVHBenchmark(const Vk::GLTFModel& model, const glm::mat4& modelMatrix, ThreadPool* threadPool);
+}
+}
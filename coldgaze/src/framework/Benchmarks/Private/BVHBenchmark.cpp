@@ -0,0 +1,165 @@
+#include "Benchmarks/BVHBenchmark.hpp"
+#include "Core/ThreadPool.hpp"
+#include "Render/CPU/BVH.hpp"
+#include "Render/CPU/SceneGeometry.hpp"
+#include "Render/Vulkan/Model.hpp"
+#include "glm/common.hpp"
+#include "glm/geometric.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace SBVHBenchmark {
+constexpr uint32_t kImageSize = 1024;
+constexpr uint32_t kRandomRaysCount = kImageSize * kImageSize;
+constexpr uint32_t kIterations = 5;
+
+template <typename Func>
+double MeasureMs(Func&& func)
+{
+    double bestMs = std::numeric_limits<double>::max();
+    for (uint32_t i = 0; i < kIterations; ++i) {
+        const auto start = std::chrono::high_resolution_clock::now();
+        func();
+        const auto end = std::chrono::high_resolution_clock::now();
+        bestMs = std::min(bestMs, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return bestMs;
+}
+
+double GetMraysPerSecond(size_t raysCount, double milliseconds)
+{
+    return static_cast<double>(raysCount) / (milliseconds * 1000.0);
+}
+
+// Pinhole camera looking at the scene bounds along -z, rows are stored one after another
+std::vector<CG::CPU::Ray> GenerateCameraRays(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+    const glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    const float radius = std::max(glm::length(boundsMax - boundsMin) * 0.5f, std::numeric_limits<float>::min());
+    const glm::vec3 origin = center + glm::vec3(0.0f, 0.0f, radius * 2.0f);
+
+    std::vector<CG::CPU::Ray> rays(kImageSize * kImageSize);
+    for (uint32_t y = 0; y < kImageSize; ++y) {
+        for (uint32_t x = 0; x < kImageSize; ++x) {
+            const float u = (static_cast<float>(x) + 0.5f) / kImageSize * 2.0f - 1.0f;
+            const float v = (static_cast<float>(y) + 0.5f) / kImageSize * 2.0f - 1.0f;
+            const glm::vec3 target = center + glm::vec3(u * radius, -v * radius, 0.0f);
+
+            CG::CPU::Ray& ray = rays[y * kImageSize + x];
+            ray.origin = origin;
+            ray.direction = glm::normalize(target - origin);
+        }
+    }
+    return rays;
+}
+
+// Rays between random points inside of the scene bounds, close to secondary bounces of a path tracer
+std::vector<CG::CPU::Ray> GenerateRandomRays(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+    const auto randomPoint = [&]() {
+        return glm::mix(boundsMin, boundsMax, glm::vec3(distribution(generator), distribution(generator), distribution(generator)));
+    };
+
+    std::vector<CG::CPU::Ray> rays(kRandomRaysCount);
+    for (CG::CPU::Ray& ray : rays) {
+        ray.origin = randomPoint();
+        glm::vec3 direction = randomPoint() - ray.origin;
+        if (glm::length(direction) == 0.0f) {
+            direction = glm::vec3(0.0f, 0.0f, 1.0f);
+        }
+        ray.direction = glm::normalize(direction);
+    }
+    return rays;
+}
+
+// Rays are traced in rows of kImageSize, returns number of hits
+uint32_t TraceRays(const CG::CPU::BVH& bvh, const std::vector<CG::CPU::Ray>& rays, bool packets, CG::ThreadPool* threadPool)
+{
+    using namespace CG::CPU;
+
+    std::atomic<uint32_t> hitsCount = { 0 };
+
+    const auto traceRow = [&](size_t row) {
+        const Ray* rowRays = rays.data() + row * kImageSize;
+        uint32_t rowHits = 0;
+
+        if (packets) {
+            Hit hits[BVH::kPacketSize];
+            for (uint32_t i = 0; i < kImageSize; i += BVH::kPacketSize) {
+                bvh.IntersectPacket(rowRays + i, hits);
+                for (const Hit& hit : hits) {
+                    rowHits += hit.IsValid() ? 1 : 0;
+                }
+            }
+        } else {
+            for (uint32_t i = 0; i < kImageSize; ++i) {
+                Hit hit;
+                rowHits += bvh.Intersect(rowRays[i], hit) ? 1 : 0;
+            }
+        }
+
+        hitsCount += rowHits;
+    };
+
+    const size_t rowsCount = rays.size() / kImageSize;
+    if (threadPool) {
+        threadPool->ParallelFor(rowsCount, traceRow);
+    } else {
+        for (size_t row = 0; row < rowsCount; ++row) {
+            traceRow(row);
+        }
+    }
+
+    return hitsCount;
+}
+
+void BenchmarkRays(const char* name, const CG::CPU::BVH& bvh, const std::vector<CG::CPU::Ray>& rays, CG::ThreadPool* threadPool)
+{
+    uint32_t singleHits = 0;
+    const double singleMs = MeasureMs([&]() { singleHits = TraceRays(bvh, rays, false, threadPool); });
+
+    uint32_t packetHits = 0;
+    const double packetMs = MeasureMs([&]() { packetHits = TraceRays(bvh, rays, true, threadPool); });
+
+    std::cout << "  " << name << " rays: single " << GetMraysPerSecond(rays.size(), singleMs) << " Mrays/s, packets of "
+              << CG::CPU::BVH::kPacketSize << " " << GetMraysPerSecond(rays.size(), packetMs) << " Mrays/s (x" << singleMs / packetMs
+              << "), " << singleHits << " hits" << std::endl;
+
+    if (singleHits != packetHits) {
+        std::cerr << "  " << name << " rays: packet traversal found " << packetHits << " hits instead of " << singleHits << std::endl;
+    }
+}
+}
+
+void CG::Benchmarks::RunBVHBenchmark(const Vk::GLTFModel& model, const glm::mat4& modelMatrix, ThreadPool* threadPool)
+{
+    using namespace SBVHBenchmark;
+
+    CPU::SceneGeometry geometry;
+    geometry.LoadFromModel(model, modelMatrix);
+
+    if (geometry.GetTrianglesCount() == 0) {
+        std::cout << "BVH benchmark: the scene has no triangles" << std::endl;
+        return;
+    }
+
+    CPU::BVH bvh;
+    const double serialBuildMs = MeasureMs([&]() { bvh.Build(geometry.positions.data(), geometry.GetTrianglesCount(), nullptr); });
+    const double buildMs = MeasureMs([&]() { bvh.Build(geometry.positions.data(), geometry.GetTrianglesCount(), threadPool); });
+
+    std::cout << "BVH benchmark: " << geometry.GetTrianglesCount() << " triangles, " << bvh.GetNodes().size() << " nodes, SAH cost "
+              << bvh.GetSAHCost() << ", best of " << kIterations << " runs" << std::endl;
+    std::cout << "  build: serial " << serialBuildMs << " ms, " << (threadPool ? threadPool->GetThreadsCount() : 1) << " threads " << buildMs << " ms (x"
+              << serialBuildMs / buildMs << ")" << std::endl;
+
+    const CPU::BVH::Node& root = bvh.GetNodes().front();
+    BenchmarkRays("camera", bvh, GenerateCameraRays(root.boundsMin, root.boundsMax), threadPool);
+    BenchmarkRays("random", bvh, GenerateRandomRays(root.boundsMin, root.boundsMax), threadPool);
+}
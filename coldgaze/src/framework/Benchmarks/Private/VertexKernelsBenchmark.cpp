@@ -0,0 +1,173 @@
+#include "Benchmarks/VertexKernelsBenchmark.hpp"
+#include "Render/Vulkan/Model.hpp"
+#include "Render/Vulkan/VertexKernels.hpp"
+#include "glm/common.hpp"
+#include "glm/geometric.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+#pragma warning(push, 0)
+#include <glm/gtc/type_ptr.hpp>
+#pragma warning(pop)
+
+namespace SVertexKernelsBenchmark {
+using Vertex = CG::Vk::GLTFModel::Vertex;
+
+constexpr size_t kVerticesCount = 4 * 1024 * 1024;
+constexpr size_t kIndicesCount = 3 * kVerticesCount;
+constexpr uint32_t kIterations = 10;
+
+// Typical interleaved glTF layout: float3 position, float3 normal, float2 uv
+struct SourceVertex {
+    float pos[3];
+    float normal[3];
+    float uv[2];
+};
+
+template <typename Func>
+double MeasureMs(Func&& func)
+{
+    double bestMs = std::numeric_limits<double>::max();
+    for (uint32_t i = 0; i < kIterations; ++i) {
+        const auto start = std::chrono::high_resolution_clock::now();
+        func();
+        const auto end = std::chrono::high_resolution_clock::now();
+        bestMs = std::min(bestMs, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return bestMs;
+}
+
+// Loop that GLTFModel::LoadNode used before the kernels were introduced
+void ConvertVerticesGlm(const std::vector<SourceVertex>& source, std::vector<Vertex>& vertexBuffer)
+{
+    vertexBuffer.clear();
+    const float* bufferPos = source.front().pos;
+    const float* bufferNormals = source.front().normal;
+    const float* bufferTexCoordSet0 = source.front().uv;
+    const size_t stride = sizeof(SourceVertex) / sizeof(float);
+
+    for (size_t v = 0; v < source.size(); ++v) {
+        Vertex vert = {};
+        vert.pos = glm::vec4(glm::make_vec3(&bufferPos[v * stride]), 1.0f);
+        vert.normal = glm::vec4(glm::normalize(glm::make_vec3(&bufferNormals[v * stride])), 1.0f);
+        glm::vec2 uv0 = glm::make_vec2(&bufferTexCoordSet0[v * stride]);
+        glm::vec2 uv1 = glm::vec2(0.0f);
+        vert.uv = glm::vec4(uv0.x, uv0.y, uv1.x, uv1.y);
+        vertexBuffer.push_back(vert);
+    }
+}
+
+void ConvertVerticesKernels(const std::vector<SourceVertex>& source, std::vector<Vertex>& vertexBuffer)
+{
+    using namespace CG::Vk;
+
+    vertexBuffer.resize(source.size());
+    const size_t stride = sizeof(SourceVertex);
+
+    VertexKernels::ConvertPositions(source.front().pos, stride, source.size(), &vertexBuffer.front().pos, sizeof(Vertex));
+    VertexKernels::ConvertNormals(source.front().normal, stride, source.size(), &vertexBuffer.front().normal, sizeof(Vertex));
+    VertexKernels::ConvertTexCoords(source.front().uv, stride, nullptr, 0, source.size(), &vertexBuffer.front().uv, sizeof(Vertex));
+}
+
+void WidenIndicesLoop(const std::vector<uint16_t>& source, std::vector<uint32_t>& indexBuffer)
+{
+    indexBuffer.clear();
+    for (size_t index = 0; index < source.size(); index++) {
+        indexBuffer.push_back(source[index]);
+    }
+}
+
+float MaxDifference(const std::vector<Vertex>& lhs, const std::vector<Vertex>& rhs)
+{
+    float maxDiff = 0.0f;
+    for (size_t i = 0; i < lhs.size(); ++i) {
+        const glm::vec4 posDiff = glm::abs(lhs[i].pos - rhs[i].pos);
+        const glm::vec4 normalDiff = glm::abs(lhs[i].normal - rhs[i].normal);
+        const glm::vec4 uvDiff = glm::abs(lhs[i].uv - rhs[i].uv);
+        maxDiff = std::max({ maxDiff, posDiff.x, posDiff.y, posDiff.z, posDiff.w, normalDiff.x, normalDiff.y, normalDiff.z,
+            normalDiff.w, uvDiff.x, uvDiff.y, uvDiff.z, uvDiff.w });
+    }
+    return maxDiff;
+}
+}
+
+int CG::Benchmarks::RunVertexKernelsBenchmark()
+{
+    using namespace SVertexKernelsBenchmark;
+    using namespace CG::Vk;
+    using eInstructionSet = VertexKernels::eInstructionSet;
+
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+
+    std::vector<SourceVertex> sourceVertices(kVerticesCount);
+    for (SourceVertex& vertex : sourceVertices) {
+        for (float& value : vertex.pos) {
+            value = distribution(generator) * 100.0f;
+        }
+        for (float& value : vertex.normal) {
+            value = distribution(generator);
+        }
+        for (float& value : vertex.uv) {
+            value = distribution(generator);
+        }
+    }
+
+    std::uniform_int_distribution<uint32_t> indexDistribution(0, 0xFFFF);
+    std::vector<uint16_t> sourceIndices(kIndicesCount);
+    for (uint16_t& index : sourceIndices) {
+        index = static_cast<uint16_t>(indexDistribution(generator));
+    }
+
+    const eInstructionSet defaultInstructionSet = VertexKernels::GetInstructionSet();
+
+    std::cout << "Vertex kernels benchmark: " << kVerticesCount << " vertices, " << kIndicesCount << " uint16 indices, best of "
+              << kIterations << " runs" << std::endl;
+
+    std::vector<Vertex> referenceVertices;
+    referenceVertices.reserve(kVerticesCount);
+    const double glmMs = MeasureMs([&]() { ConvertVerticesGlm(sourceVertices, referenceVertices); });
+    std::cout << "  vertices, per vertex glm loop: " << glmMs << " ms" << std::endl;
+
+    std::vector<uint32_t> referenceIndices;
+    referenceIndices.reserve(kIndicesCount);
+    const double indicesLoopMs = MeasureMs([&]() { WidenIndicesLoop(sourceIndices, referenceIndices); });
+    std::cout << "  indices, push_back loop: " << indicesLoopMs << " ms" << std::endl;
+
+    int result = EXIT_SUCCESS;
+
+    const eInstructionSet instructionSets[] = { eInstructionSet::kScalar, eInstructionSet::kSSE2, eInstructionSet::kAVX2 };
+    for (eInstructionSet instructionSet : instructionSets) {
+        if (instructionSet > VertexKernels::GetSupportedInstructionSet()) {
+            break;
+        }
+        VertexKernels::SetInstructionSet(instructionSet);
+        const char* name = VertexKernels::GetInstructionSetName(instructionSet);
+
+        std::vector<Vertex> vertices;
+        const double verticesMs = MeasureMs([&]() { ConvertVerticesKernels(sourceVertices, vertices); });
+
+        std::vector<uint32_t> indices(kIndicesCount);
+        const double indicesMs = MeasureMs([&]() { VertexKernels::WidenIndices(sourceIndices.data(), sourceIndices.size(), indices.data()); });
+
+        const float maxDiff = MaxDifference(referenceVertices, vertices);
+        const bool indicesMatch = indices == referenceIndices;
+
+        std::cout << "  " << name << " kernels: vertices " << verticesMs << " ms (x" << glmMs / verticesMs << "), indices "
+                  << indicesMs << " ms (x" << indicesLoopMs / indicesMs << "), max difference " << maxDiff << std::endl;
+
+        if (maxDiff > 1e-5f || !indicesMatch) {
+            std::cerr << "  " << name << " kernels output doesn't match reference!" << std::endl;
+            result = EXIT_FAILURE;
+        }
+    }
+
+    VertexKernels::SetInstructionSet(defaultInstructionSet);
+
+    return result;
+}
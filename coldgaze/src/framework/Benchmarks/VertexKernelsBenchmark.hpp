@@ -0,0 +1,9 @@
+#pragma once
+
+namespace CG {
+namespace Benchmarks {
+    // Compares per vertex glm conversion, that was used by glTF loader before, with VertexKernels on every supported instruction set.
+    // Started with -benchmark-vertex-kernels command line argument, returns process exit code.
+    int RunVertexKernelsBenchmark();
+}
+}
@@ -6,6 +6,7 @@
 #include "SDL2/SDL_events.h"
 #include "vulkan/vulkan.hpp"
 #include "vulkan/vulkan_core.h"
+#include <array>
 #include <chrono>
 #include <entt/entt.hpp>
 #include <memory>
@@ -28,10 +29,15 @@ namespace Vk {
 }
 struct EngineConfig;
 class InputHandler;
+class ThreadPool;
 class Window;
 
 class Engine {
 public:
+    // Frames recorded by the CPU while the GPU still executes the previous ones, every frame has its own
+    // command buffer, fence, semaphores and per frame buffers
+    static constexpr uint32_t kMaxFramesInFlight = 2;
+
     Engine(CG::EngineConfig& engineConfig);
     virtual ~Engine();
 
@@ -42,6 +48,7 @@ public:
 
     const InputHandler* GetInputHandler() const;
     const Window* GetCurrentWindow() const;
+    ThreadPool* GetThreadPool() const;
     const uint32_t GetSampleCount() const;
 
     // TODO: move to some shader manager
@@ -49,6 +56,8 @@ public:
     const std::string GetAssetPath() const;
 
 protected:
+    // Called once the physical device is picked, before the logical device is created
+    virtual void SelectDeviceExtensions() {};
     virtual VkPhysicalDeviceFeatures2 GetEnabledDeviceFeatures() const;
     virtual void RenderFrame(float deltaTime);
     virtual void Prepare();
@@ -56,6 +65,9 @@ protected:
 
     virtual void OnWindowResize() {};
 
+    // Replaces the main loop with -headless, called once after Prepare
+    virtual void RenderHeadless() {};
+
     virtual void BuildCommandBuffers();
 
     virtual void CaptureEvent(const SDL_Event&) {};
@@ -64,12 +76,17 @@ protected:
     void PrepareFrame();
     void SubmitFrame();
 
+    // Format of swapchain images, or of offscreen images which take their place without a window
+    VkFormat GetColorFormat() const;
+
     CG::EngineConfig& engineConfig;
 
     SDL_Window* window = nullptr;
     Vk::Device* vkDevice = nullptr;
     Vk::SwapChain* vkSwapChain = nullptr;
     VkQueue queue = {};
+    // Queue of background loading, the same as queue if the graphics family has only one
+    VkQueue loadingQueue = {};
 
     VkPhysicalDevice vkPhysicalDevice = {};
     VkInstance vkInstance = {};
@@ -80,16 +97,19 @@ protected:
     VkRenderPass renderPass = {};
     VkPipelineCache pipelineCache = {};
     std::vector<VkFramebuffer> frameBuffers;
-    VkSubmitInfo submitInfo = {};
 
     VkSampleCountFlagBits sampleCount = VK_SAMPLE_COUNT_1_BIT;
 
-    struct {
+    // Set by -headless, there is no SDL window, swapchain, render pass or UI then
+    bool headless = false;
+
+    struct Semaphores {
         // Swap chain image presentation
         VkSemaphore presentComplete;
         // Command buffer submission and execution
         VkSemaphore renderComplete;
-    } semaphores = {};
+    };
+    std::array<Semaphores, kMaxFramesInFlight> semaphores = {};
 
     struct
     {
@@ -104,14 +124,14 @@ protected:
 
     // active frame buffer index
     uint32_t currentBuffer = 0;
+    // Frame in flight being recorded, indexes drawCmdBuffers, waitFences, semaphores and per frame buffers
+    uint32_t currentFrame = 0;
 
     std::unique_ptr<Vk::ImGuiImpl> imGui;
 
     std::unique_ptr<InputHandler> inputHandler;
     std::unique_ptr<Window> currentWindow;
-
-    void InitRayTracing();
-    VkPhysicalDeviceRayTracingPropertiesNV rayTracingProperties;
+    std::unique_ptr<ThreadPool> threadPool;
 
     CameraComponent* cameraComponent = nullptr;
 
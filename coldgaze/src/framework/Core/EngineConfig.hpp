@@ -15,7 +15,7 @@ struct EngineConfig {
 
     bool vsync = false;
 
-    uint32_t vk_api_version = VK_API_VERSION_1_0;
+    uint32_t vk_api_version = VK_API_VERSION_1_1;
 
     std::string engine_name = "Coldgaze";
 
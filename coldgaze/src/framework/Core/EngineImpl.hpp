@@ -1,13 +1,18 @@
 #pragma once
+#include "Render/Vulkan/AccelerationStructureManager.hpp"
 #include "Render/Vulkan/Buffer.hpp"
+#include "Render/Vulkan/EnvironmentMap.hpp"
 #include "Render/Vulkan/Model.hpp"
+#include "Render/Vulkan/RayTracingBackend.hpp"
 #include "Render/Vulkan/Texture.hpp"
 #include "engine.hpp"
 #include "glm/ext/vector_float4.hpp"
 #include "vulkan/vulkan_core.h"
 #include <array>
+#include <atomic>
 #include <glm/glm.hpp>
 #include <mutex>
+#include <string>
 #include <thread>
 
 struct CameraComponent;
@@ -32,23 +37,23 @@ protected:
     void Prepare() override;
     void Cleanup() override;
 
+    void SelectDeviceExtensions() override;
     VkPhysicalDeviceFeatures2 GetEnabledDeviceFeatures() const override;
     void CaptureEvent(const SDL_Event& event) override;
 
     void OnWindowResize() override;
+    void RenderHeadless() override;
 
 private:
-    struct AccelerationStructure {
-        VkDeviceMemory memory;
-        VkAccelerationStructureNV accelerationStructure;
+    // TLAS instance per primitive of every node, its index is the instance custom index seen by closest hit shaders
+    struct BLASInstance {
         glm::mat4 transform;
-        uint64_t handle;
+        uint32_t blasIndex;
+        // Node of the primitive, the transform follows its world matrix when the model is animated
+        Vk::GLTFModel::Node* node;
     };
 
-    AccelerationStructure topLevelAS;
-
-    std::vector<AccelerationStructure> blasData;
-
+    // Layout of both VkGeometryInstanceNV and VkAccelerationStructureInstanceKHR
     struct GeometryInstance {
         glm::mat3x4 transform;
         uint32_t instanceId : 24;
@@ -58,6 +63,19 @@ private:
         uint64_t accelerationStructureHandle;
     };
 
+    // Per instance geometry lookup, mirrors PrimitiveInfo in closest hit shaders
+    struct PrimitiveShaderInfo {
+        // Geometry buffer stores GLTFModel::CompactVertex instead of GLTFModel::Vertex
+        static constexpr uint32_t kFlagCompactVertex = 1 << 0;
+        // Index buffer range holds uint16 indices, firstIndex is counted in them
+        static constexpr uint32_t kFlagIndex16 = 1 << 1;
+
+        uint32_t firstIndex;
+        uint32_t firstVertex;
+        uint32_t geometryBufferIndex;
+        uint32_t flags;
+    };
+
     struct CameraUboData {
         int bouncesCount = 2;
         int numberOfSamples = 1;
@@ -68,7 +86,8 @@ private:
         int randomSeed;
     } cameraUboData = {};
 
-    Vk::Buffer cameraUbo;
+    // Per frame in flight, the GPU may still read the one of the previous frame
+    std::array<Vk::Buffer, kMaxFramesInFlight> cameraUbos;
 
     struct UISettings {
         std::vector<float> frameTimes = {};
@@ -78,6 +97,7 @@ private:
         bool useSampleShading = false;
         bool enablePreviewQuality = false;
         bool enablePBRMaterials = true;
+        bool playAnimation = true;
         CameraUboData cameraUboData = {};
     } uiData = {};
 
@@ -94,7 +114,7 @@ private:
         glm::vec4 globalLightColor;
     } sceneUboData = {};
 
-    Vk::Buffer sceneUbo;
+    std::array<Vk::Buffer, kMaxFramesInFlight> sceneUbos;
 
     struct DescriptorSetLayout {
         bool created = false;
@@ -103,15 +123,11 @@ private:
 
 
     struct DescriptorSetLayouts {
-        DescriptorSetLayout rtxRaygenLayout;
-        DescriptorSetLayout rtxRayhitLayout;
         DescriptorSetLayout rtxRaymissLayout;
     } descriptorSetLayouts = {};
 
     struct DescriptorSets {
         VkDescriptorSet scene;
-        VkDescriptorSet rtxRaygen;
-        VkDescriptorSet rtxRayhit;
         VkDescriptorSet rtxRaymiss;
     } descriptorSets = {};
 
@@ -119,7 +135,61 @@ private:
         VkPipeline RTX;
         VkPipeline RTX_PBR;
         VkPipeline previewRTX;
-    } pipelines = {};
+    };
+
+    struct ShaderBindingTables {
+        Vk::Buffer RTX;
+        Vk::Buffer RTX_PBR;
+        Vk::Buffer previewRTX;
+    };
+
+    // Everything built for the loaded model. The loading thread prepares a complete set for the next model
+    // while the current one keeps rendering, see LoadModelAsync and UpdateLoadedScene
+    struct SceneData {
+        std::unique_ptr<Vk::GLTFModel> model;
+        std::string modelFilePath;
+        // Fits the model into the unit cube, instance transforms include it
+        glm::mat4 modelMatrix = glm::mat4(1.0f);
+
+        // One BLAS per unique geometry range, primitives of repeated meshes share it
+        std::unique_ptr<Vk::AccelerationStructureManager> accelerationStructures;
+        std::vector<BLASInstance> blasInstances;
+        // GeometryInstance of every BLASInstance per frame in flight, stay mapped so animated transforms are written in place
+        std::array<Vk::Buffer, kMaxFramesInFlight> instanceBuffers;
+        Vk::Buffer primitiveInfosBuffer;
+        // Bound in place of missing vertex and index buffers, storage buffer descriptors can't be null
+        Vk::Buffer emptyGeometryBuffer;
+
+        // Time of the first animation of the model, the TLAS is refitted in the next frame if any instance moved
+        float animationTime = 0.0f;
+        bool topLevelChanged = false;
+
+        // Sizes of hit shader descriptor arrays depend on the model, so every scene has its own pool, layouts and pipelines
+        VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+        DescriptorSetLayout rtxRaygenLayout = {};
+        DescriptorSetLayout rtxRayhitLayout = {};
+        // Per frame in flight, they differ in uniform buffers only
+        std::array<VkDescriptorSet, kMaxFramesInFlight> rtxRaygen = {};
+        VkDescriptorSet rtxRayhit = VK_NULL_HANDLE;
+
+        VkPipelineLayout rtxPipelineLayout = VK_NULL_HANDLE;
+        RenderPipelines pipelines = {};
+        ShaderBindingTables shaderBindingTables;
+    };
+
+    // Scene being rendered, null until the first model is loaded
+    std::unique_ptr<SceneData> scene;
+
+    // State of the model loading thread, the render thread reads result and error only after finished is set
+    struct SceneLoader {
+        std::thread thread;
+        std::atomic<bool> finished { false };
+        // Current loading step as a string literal and its progress in [0, 1], shown by the overlay
+        std::atomic<const char*> stage { nullptr };
+        std::atomic<float> progress { 0.0f };
+        std::unique_ptr<SceneData> result;
+        std::string error;
+    } sceneLoader;
 
     void FlushCommandBuffer(VkCommandBuffer commandBuffer);
 
@@ -127,6 +197,9 @@ private:
 
     void BuildUiCommandBuffers();
     void BuildCommandBuffers() override;
+    // Records traceCmdBuffers again once no frame in flight executes them
+    void BuildTraceCommandBuffers();
+    void DestroyTraceCommandBuffers();
 
     void SetupDescriptorsPool();
     void BindModelMaterials();
@@ -137,82 +210,93 @@ private:
 
     void SetupSystems();
 
-    void LoadModel(const std::string& modelFilePath);
+    Vk::GLTFModel::LoadingParams GetModelLoadingParams() const;
+    // Starts loading of the model on a background thread, the current scene is rendered until the new one is ready
     void LoadModelAsync(const std::string& modelFilePath);
+    // Body of the loading thread, builds the model, its acceleration structures, descriptor sets and pipelines
+    void LoadScene(const std::string& modelFilePath, const Vk::GLTFModel::LoadingParams& loadingParams);
+    // Swaps the loaded scene in between frames, reports loading errors
+    void UpdateLoadedScene();
+    void WaitForSceneLoading();
+    void DestroyScene(SceneData& sceneData);
+    // Traces the scene with the CPU path tracer from the current camera on cpuReferenceThread and saves the images
+    // next to the model, see -cpureference. Skipped while the previous reference is still tracing
+    void RenderCPUReference(const SceneData& sceneData);
+    void WaitForCPUReference();
 
     void LoadSkybox(const std::string& cubeMapFilePath);
 
-    void CreateBottomLevelAccelerationStructure(const VkGeometryNV* geometries, uint32_t blasIndex, size_t geomCount);
-    void CreateTopLevelAccelerationStructure();
-
-    void LoadNVRayTracingProcs();
+    void ShowAssetLoadingError(const char* message);
 
-    void CreateNVRayTracingGeometry();
-    void DestroyNVRayTracingGeometry();
+    void CreateTopLevelAccelerationStructure(SceneData& sceneData);
+    // Plays the first animation of the scene and writes instance transforms into the instance buffer of the current frame
+    void UpdateSceneAnimation(float deltaTime);
 
-    void CreateNVRayTracingStoreImage();
-    void DestroyNVRayTracingStoreImage();
+    void CreateRayTracingGeometry(SceneData& sceneData);
+    void DestroyRayTracingGeometry(SceneData& sceneData);
 
-    void CreateNVRayTracingAccumulationImage();
-    void DestroyNVRayTracingAccumulationImage();
+    void CreateRayTracingStoreImage();
+    void DestroyRayTracingStoreImage();
 
-    void CreateShaderBindingTable(Vk::Buffer& shaderBindingTable, VkPipeline pipeline);
-    VkDeviceSize CopyShaderIdentifier(uint8_t* data, const uint8_t* shaderHandleStorage, uint32_t groupIndex);
+    void CreateRayTracingAccumulationImage();
+    void DestroyRayTracingAccumulationImage();
 
-    void CreateRTXPipeline();
-    void DestroyRTXPipeline();
+    void CreateRTXPipeline(SceneData& sceneData);
+    void DestroyRTXPipeline(SceneData& sceneData);
 
     void CreateRTXPipelineLayout();
     void DestroyRTXPipelineLayout();
 
-    void SetupRTXModelDescriptorSets();
+    void SetupRTXModelDescriptorSets(SceneData& sceneData);
+    // Storage and accumulation images are recreated on resize, so they are written by the render thread
+    void UpdateRTXStorageImageDescriptors(SceneData& sceneData);
     void SetupRTXEnviromentDescriptorSet();
-    void DrawRayTracingData(uint32_t swapChainImageIndex);
+    // Refits the TLAS if the animation moved any instance, it is the only part of tracing recorded every frame
+    void UpdateTopLevel(VkCommandBuffer commandBuffer);
+    // Binds the pipeline picked in the overlay and traces the scene into the storage image
+    void TraceScene(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+    void DrawRayTracingData(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t swapChainImageIndex);
+    // Reads the storage image back after the last headless frame and writes it as PNG
+    void SaveStorageImage(const std::string& fileName);
 
     void UpdateFrameData(float deltaTime);
 
     CG::Vk::UniformBufferVS* uniformBufferVS = nullptr;
 
-    struct
-    {
-        VkPipelineLayout rtxPipelineLayout = {};
-    } pipelineLayouts = {};
-
     VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
 
     Vk::Texture2D emptyTexture;
-    Vk::Texture2D cubemapTexture;
+    Vk::EnvironmentMap enviromentMap;
 
-    std::unique_ptr<Vk::GLTFModel> testScene;
+    // KHR unless the device lacks it or -rtnv asks for VK_NV_ray_tracing
+    Vk::eRayTracingApi rayTracingApi = Vk::eRayTracingApi::kKHR;
+    std::unique_ptr<Vk::RayTracingBackend> rayTracing;
 
-    struct ShaderBindingTables {
-        Vk::Buffer RTX;
-        Vk::Buffer RTX_PBR;
-        Vk::Buffer previewRTX;
-    } shaderBindingTables;
-
-    PFN_vkCreateAccelerationStructureNV vkCreateAccelerationStructureNV;
-    PFN_vkDestroyAccelerationStructureNV vkDestroyAccelerationStructureNV;
-    PFN_vkBindAccelerationStructureMemoryNV vkBindAccelerationStructureMemoryNV;
-    PFN_vkGetAccelerationStructureHandleNV vkGetAccelerationStructureHandleNV;
-    PFN_vkGetAccelerationStructureMemoryRequirementsNV vkGetAccelerationStructureMemoryRequirementsNV;
-    PFN_vkCmdBuildAccelerationStructureNV vkCmdBuildAccelerationStructureNV;
-    PFN_vkCreateRayTracingPipelinesNV vkCreateRayTracingPipelinesNV;
-    PFN_vkGetRayTracingShaderGroupHandlesNV vkGetRayTracingShaderGroupHandlesNV;
-    PFN_vkCmdTraceRaysNV vkCmdTraceRaysNV;
+    // -cpureference with -headless renders the CPU reference only. Ray tracing extensions aren't required then,
+    // rayTracing stays null and scenes have no acceleration structures, pipelines or descriptor sets
+    bool cpuReferenceOnly = false;
+    std::thread cpuReferenceThread;
+    // Set by cpuReferenceThread when it's done, the render thread joins it only then
+    std::atomic<bool> cpuReferenceFinished { false };
 
     struct StorageImage {
         VkDeviceMemory memory;
         VkImage image;
         VkImageView view;
         VkFormat format;
-    } storageImage;
+    } storageImage = {};
 
     struct AccumulationImage {
         VkDeviceMemory memory;
         VkImage image;
         VkImageView view;
         VkFormat format;
-    } accumulationImage;
+    } accumulationImage = {};
+
+    // Secondary buffers tracing the scene and copying it into a swapchain image, indexed by frame * imageCount + image.
+    // Descriptor sets and pipelines they bind are fixed, so they are recorded again only when the scene, the pipeline
+    // picked in the overlay, the skybox or the swapchain change
+    std::vector<VkCommandBuffer> traceCmdBuffers;
+    bool traceCmdBuffersDirty = true;
 };
 }
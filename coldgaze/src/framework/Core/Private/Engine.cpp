@@ -1,11 +1,13 @@
 #include "Core/Engine.hpp"
 #include "Core/EngineConfig.hpp"
 #include "Core/InputHandler.hpp"
+#include "Core/ThreadPool.hpp"
 #include "Core/Window.hpp"
 #include "ECS/Components/CameraComponent.hpp"
 #include "ECS/ICGSystem.hpp"
 #include "Render/Vulkan/Debug.hpp"
 #include "Render/Vulkan/Device.hpp"
+#include "Render/Vulkan/Exceptions.hpp"
 #include "Render/Vulkan/ImGuiImpl.hpp"
 #include "Render/Vulkan/Initializers.hpp"
 #include "Render/Vulkan/SwapChain.hpp"
@@ -31,6 +33,8 @@ namespace SEngine
         "VK_LAYER_KHRONOS_validation",
     };
     const std::string kFaviconPath = "textures/Vulkan.png";
+    // Storage image format every implementation supports, used when there is no swapchain to match
+    constexpr VkFormat kHeadlessColorFormat = VK_FORMAT_R8G8B8A8_UNORM;
 
 }
 
@@ -38,9 +42,16 @@ CG::Engine::Engine(CG::EngineConfig& aEngineConfig)
     : engineConfig(aEngineConfig)
     , inputHandler(std::make_unique<InputHandler>())
     , currentWindow(std::make_unique<Window>())
+    , threadPool(std::make_unique<ThreadPool>())
 {
     currentWindow->windowResolution.height = static_cast<float>(aEngineConfig.height);
     currentWindow->windowResolution.width = static_cast<float>(aEngineConfig.width);
+
+    for (const char* arg : aEngineConfig.args) {
+        if (arg == std::string("-headless")) {
+            headless = true;
+        }
+    }
 }
 
 CG::Engine::~Engine() = default;
@@ -64,6 +75,13 @@ void CG::Engine::Run()
         Prepare();
     }
 
+    // Headless runs have no events to wait for, the frames are rendered in one go
+    if (isRunning && headless) {
+        UpdateSystems(0.0f);
+        RenderHeadless();
+        isRunning = false;
+    }
+
     auto previousTime = std::chrono::steady_clock::now();
     std::this_thread::sleep_for(std::chrono::microseconds(static_cast<size_t>(minSecPerFrame * 1000.0f)));
 
@@ -103,6 +121,11 @@ const CG::Window* CG::Engine::GetCurrentWindow() const
     return currentWindow.get();
 }
 
+CG::ThreadPool* CG::Engine::GetThreadPool() const
+{
+    return threadPool.get();
+}
+
 const uint32_t CG::Engine::GetSampleCount() const
 {
     return sampleCount;
@@ -110,11 +133,23 @@ const uint32_t CG::Engine::GetSampleCount() const
 
 bool CG::Engine::Init()
 {
+    if (headless) {
+        return SetupDependencies() && InitGraphicsAPI();
+    }
+
     return SetupDependencies() && InitSDL() && InitWindow() && InitGraphicsAPI();
 }
 
 void CG::Engine::Prepare()
 {
+    if (headless) {
+        CreateCommandPool();
+        CreateCommandBuffers();
+        CreateFences();
+        CreatePipelineCache();
+        return;
+    }
+
     InitSwapChain();
     CreateCommandPool();
     SetupSwapChain();
@@ -170,7 +205,10 @@ VkPipelineShaderStageCreateInfo CG::Engine::LoadShader(const std::string& filena
     shaderStage.stage = stage;
     shaderStage.module = LoadSPIRVShader(filename);
     shaderStage.pName = "main";
-    assert(shaderStage.module != VK_NULL_HANDLE);
+    // Ray tracing shaders of the KHR backend are .khr.spv files, which only exist once the shaders are compiled
+    if (shaderStage.module == VK_NULL_HANDLE) {
+        throw Vk::AssetLoadingException(("Could not load shader " + filename + ", compile the shaders with glslangValidator").c_str());
+    }
     shaderModules.push_back(shaderStage.module);
     return shaderStage;
 }
@@ -210,14 +248,19 @@ void CG::Engine::Cleanup()
         vkDestroyFence(vkDevice->logicalDevice, fence, nullptr);
     }
 
-    vkDestroySemaphore(vkDevice->logicalDevice, semaphores.presentComplete, nullptr);
-    vkDestroySemaphore(vkDevice->logicalDevice, semaphores.renderComplete, nullptr);
+    for (Semaphores& frameSemaphores : semaphores) {
+        vkDestroySemaphore(vkDevice->logicalDevice, frameSemaphores.presentComplete, nullptr);
+        vkDestroySemaphore(vkDevice->logicalDevice, frameSemaphores.renderComplete, nullptr);
+    }
 
     delete vkSwapChain;
     delete vkDevice;
 
     vkDestroyInstance(vkInstance, nullptr);
-    CleanupSDL();
+
+    if (!headless) {
+        CleanupSDL();
+    }
 }
 
 void CG::Engine::BuildCommandBuffers() { }
@@ -286,6 +329,10 @@ bool CG::Engine::InitWindow()
 
 bool CG::Engine::InitGraphicsAPI()
 {
+    if (headless) {
+        return CreateVkInstance() && SetupDebugging() && CreateDevices() && SetupSemaphores();
+    }
+
     return CreateVkInstance() && SetupDebugging() && CreateDevices() && CreateSwapChain() && SetupSemaphores();
 }
 
@@ -348,13 +395,16 @@ bool CG::Engine::CreateDevices()
 
     vkDevice = new CG::Vk::Device(vkPhysicalDevice);
 
+    SelectDeviceExtensions();
+
     VkPhysicalDeviceFeatures2 enabledFeatures = GetEnabledDeviceFeatures();
 
-    VK_CHECK_RESULT(vkDevice->CreateLogicalDevice(enabledFeatures, enabledDeviceExtensions));
+    VK_CHECK_RESULT(vkDevice->CreateLogicalDevice(enabledFeatures, enabledDeviceExtensions, !headless));
 
     VkDevice device = vkDevice->logicalDevice;
 
     vkGetDeviceQueue(device, vkDevice->queueFamilyIndices.graphics, 0, &queue);
+    vkGetDeviceQueue(device, vkDevice->queueFamilyIndices.graphics, vkDevice->loadingQueueIndex, &loadingQueue);
 
     VkFormat depthFormat;
     VkBool32 validDepthFormat = vkDevice->GetSupportedDepthFormat(vkPhysicalDevice, &depthFormat);
@@ -379,21 +429,15 @@ bool CG::Engine::SetupSemaphores()
     VkSemaphoreCreateInfo semaphoreCreateInfo {};
     semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-    // Create a semaphore used to synchronize image presentation
-    // Ensures that the image is displayed before we start submitting new commands to the queu
-    VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphores.presentComplete));
-    // Create a semaphore used to synchronize command submission
-    // Ensures that the image is not presented until all commands have been sumbitted and executed
-    VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphores.renderComplete));
-
-    VkPipelineStageFlags submitPipelineStages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    submitInfo = {};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.pWaitDstStageMask = &submitPipelineStages;
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = &semaphores.presentComplete;
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = &semaphores.renderComplete;
+    // Frames in flight wait for their own semaphores, a semaphore is reused once the fence of its frame is signaled
+    for (Semaphores& frameSemaphores : semaphores) {
+        // Create a semaphore used to synchronize image presentation
+        // Ensures that the image is displayed before we start submitting new commands to the queu
+        VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &frameSemaphores.presentComplete));
+        // Create a semaphore used to synchronize command submission
+        // Ensures that the image is not presented until all commands have been sumbitted and executed
+        VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &frameSemaphores.renderComplete));
+    }
 
     return true;
 }
@@ -408,7 +452,7 @@ void CG::Engine::CreateCommandPool()
     VkDevice device = vkDevice->logicalDevice;
     VkCommandPoolCreateInfo cmdPoolInfo = {};
     cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-    cmdPoolInfo.queueFamilyIndex = vkSwapChain->queueNodeIndex;
+    cmdPoolInfo.queueFamilyIndex = headless ? vkDevice->queueFamilyIndices.graphics : vkSwapChain->queueNodeIndex;
     cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
     VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &vkCmdPool));
 }
@@ -422,7 +466,8 @@ void CG::Engine::CreateCommandBuffers()
 {
     VkDevice device = vkDevice->logicalDevice;
 
-    drawCmdBuffers.resize(vkSwapChain->imageCount);
+    // Frames are recorded into the buffer of their frame in flight, independently of swapchain images
+    drawCmdBuffers.resize(kMaxFramesInFlight);
 
     VkCommandBufferAllocateInfo commandBufferAllocateInfo {};
     commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -594,7 +639,10 @@ void CG::Engine::SetupFrameBuffer()
 
 void CG::Engine::PrepareFrame()
 {
-    VkResult result = vkSwapChain->AcquireNextImage(semaphores.presentComplete, &currentBuffer);
+    // Command buffer and per frame buffers of this slot are free once the GPU finishes the frame submitted with them
+    VK_CHECK_RESULT(vkWaitForFences(vkDevice->logicalDevice, 1, &waitFences[currentFrame], VK_TRUE, UINT64_MAX));
+
+    VkResult result = vkSwapChain->AcquireNextImage(semaphores[currentFrame].presentComplete, &currentBuffer);
 
     if ((result == VK_ERROR_OUT_OF_DATE_KHR) || (result == VK_SUBOPTIMAL_KHR)) {
         WindowResize();
@@ -605,7 +653,14 @@ void CG::Engine::PrepareFrame()
 
 void CG::Engine::SubmitFrame()
 {
-    VkResult result = vkSwapChain->QueuePresent(queue, currentBuffer, semaphores.renderComplete);
+    VkResult result = VK_SUCCESS;
+    {
+        std::lock_guard<std::mutex> lock(vkDevice->deviceQueueMutex);
+        result = vkSwapChain->QueuePresent(queue, currentBuffer, semaphores[currentFrame].renderComplete);
+    }
+
+    // The next frame is recorded while the GPU still executes this one, PrepareFrame waits for its slot
+    currentFrame = (currentFrame + 1) % kMaxFramesInFlight;
 
     if (!((result == VK_SUCCESS) || (result == VK_SUBOPTIMAL_KHR))) {
         if (result == VK_ERROR_OUT_OF_DATE_KHR) {
@@ -617,21 +672,11 @@ void CG::Engine::SubmitFrame()
             VK_CHECK_RESULT(result);
         }
     }
-
-
-    VK_CHECK_RESULT(vkQueueWaitIdle(queue));
 }
 
-void CG::Engine::InitRayTracing()
+VkFormat CG::Engine::GetColorFormat() const
 {
-    VkPhysicalDeviceRayTracingPropertiesNV rtProperties = Vk::Initializers::PhysicalDeviceRayTracingPropertiesNV();
-
-    VkPhysicalDeviceProperties2 physicalDeviceProperties;
-    physicalDeviceProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
-    physicalDeviceProperties.pNext = &rtProperties;
-    vkGetPhysicalDeviceProperties2(vkDevice->physicalDevice, &physicalDeviceProperties);
-
-    rayTracingProperties = rtProperties;
+    return headless ? SEngine::kHeadlessColorFormat : vkSwapChain->colorFormat;
 }
 
 bool CG::Engine::CreateVkInstance()
@@ -641,13 +686,18 @@ bool CG::Engine::CreateVkInstance()
         std::cerr << "Validation enabled but not all requested layers are available" << std::endl;
     }
 #endif
-    uint32_t extensionCount = 0;
-    if (!SDL_Vulkan_GetInstanceExtensions(window, &extensionCount, nullptr)) {
-        return false;
-    }
+    std::vector<const char*> extensionNames;
 
-    std::vector<const char*> extensionNames(extensionCount);
-    SDL_Vulkan_GetInstanceExtensions(window, &extensionCount, extensionNames.data());
+    // Surface extensions are only needed to present to the window
+    if (!headless) {
+        uint32_t extensionCount = 0;
+        if (!SDL_Vulkan_GetInstanceExtensions(window, &extensionCount, nullptr)) {
+            return false;
+        }
+
+        extensionNames.resize(extensionCount);
+        SDL_Vulkan_GetInstanceExtensions(window, &extensionCount, extensionNames.data());
+    }
 
     VkApplicationInfo appInfo {};
     appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
@@ -753,7 +803,11 @@ void CG::Engine::PrepareImgui()
 
 void CG::Engine::WindowResize()
 {
-    vkDeviceWaitIdle(vkDevice->logicalDevice);
+    // Waiting for the device touches every queue, including the one of background loading
+    {
+        std::lock_guard<std::mutex> lock(vkDevice->deviceQueueMutex);
+        vkDeviceWaitIdle(vkDevice->logicalDevice);
+    }
 
     SetupSwapChain();
 
@@ -766,12 +820,8 @@ void CG::Engine::WindowResize()
     }
     SetupFrameBuffer();
 
-    DestroyCommandBuffers();
-    CreateCommandBuffers();
-    BuildCommandBuffers();
-
-    vkDeviceWaitIdle(vkDevice->logicalDevice);
-
+    // Nothing is recorded here, the next frame records its command buffer against the new swapchain right before
+    // submitting it, and OnWindowResize marks the prerecorded ones as outdated
     if ((engineConfig.width > 0.0f) && (engineConfig.height > 0.0f)) {
         imGui->Resize(static_cast<float>(engineConfig.width), static_cast<float>(engineConfig.height));
         cameraComponent->UpdateViewport(engineConfig.width, engineConfig.height);
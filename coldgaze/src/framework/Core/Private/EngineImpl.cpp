@@ -5,13 +5,24 @@
 
 #include <algorithm>
 #include <array>
+#include <chrono>
+#include <cmath>
+#include <fstream>
 #include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+#include <map>
 #include <memory>
+#include <tuple>
 
+#include "Benchmarks\BVHBenchmark.hpp"
 #include "Core\EngineConfig.hpp"
+#include "Core\ThreadPool.hpp"
 #include "ECS\Components\CameraComponent.hpp"
 #include "ECS\Systems\CameraSystem.hpp"
 #include "ECS\Systems\LightSystem.hpp"
+#include "Render\CPU\ImageWriter.hpp"
+#include "Render\CPU\PathTracer.hpp"
+#include "Render\CPU\Scene.hpp"
 #include "Render\Vulkan\Debug.hpp"
 #include "Render\Vulkan\Device.hpp"
 #include "Render\Vulkan\Exceptions.hpp"
@@ -38,6 +49,26 @@ constexpr uint32_t kIndexClosestHit = 2;
 // TODO: remove hard coded recursion depth for GTX 1070
 constexpr uint32_t kMaxRecursionDepth = 9;
 
+namespace SEngineImpl {
+// Accumulated frames of -cpureference renders, the GPU image converges in about as many
+constexpr uint32_t kCPUReferenceFramesCount = 64;
+// Accumulated frames of -headless renders unless -frames is given
+constexpr uint32_t kHeadlessFramesCount = 64;
+
+// Scales the model down into the unit cube
+glm::mat4 GetModelMatrix(const Vk::GLTFModel& model)
+{
+    const glm::vec3& size = model.GetSize();
+    const float scale = (1.0f / std::max(size.x, std::max(size.y, size.z))) * 0.5f;
+
+    glm::mat4 modelMatrix = glm::mat4(1.0f);
+    modelMatrix[0][0] = scale;
+    modelMatrix[1][1] = scale;
+    modelMatrix[2][2] = scale;
+    return modelMatrix;
+}
+}
+
 CG::EngineImpl::EngineImpl(CG::EngineConfig& engineConfig)
     : CG::Engine(engineConfig)
 {
@@ -45,9 +76,20 @@ CG::EngineImpl::EngineImpl(CG::EngineConfig& engineConfig)
         VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
     enabledDeviceExtensions.push_back(
         VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME);
-    enabledDeviceExtensions.push_back(VK_NV_RAY_TRACING_EXTENSION_NAME);
     enabledDeviceExtensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
-    enabledDeviceExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+
+    bool cpuReference = false;
+    for (const char* arg : engineConfig.args) {
+        if (arg == std::string("-cpureference")) {
+            cpuReference = true;
+        }
+    }
+    cpuReferenceOnly = cpuReference && headless;
+
+    // Descriptor indexing is used by hit shaders only
+    if (!cpuReferenceOnly) {
+        enabledDeviceExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+    }
 
     const size_t kFrameTimesCount = 100;
     uiData.frameTimes.resize(kFrameTimesCount, 0.0f);
@@ -57,9 +99,12 @@ CG::EngineImpl::~EngineImpl() = default;
 
 void CG::EngineImpl::RenderFrame(float deltaTime)
 {
+    UpdateLoadedScene();
+
     PrepareFrame();
 
     UpdateFrameData(deltaTime);
+    UpdateSceneAnimation(deltaTime);
     imGui->UpdateUI(deltaTime);
 
     BuildCommandBuffers();
@@ -71,14 +116,20 @@ void CG::EngineImpl::RenderFrame(float deltaTime)
     VkSubmitInfo localSubmitInfo = {};
     localSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
     localSubmitInfo.pWaitDstStageMask = &waitStageMask;
-    localSubmitInfo.pWaitSemaphores = &semaphores.presentComplete;
+    localSubmitInfo.pWaitSemaphores = &semaphores[currentFrame].presentComplete;
     localSubmitInfo.waitSemaphoreCount = 1;
-    localSubmitInfo.pSignalSemaphores = &semaphores.renderComplete;
+    localSubmitInfo.pSignalSemaphores = &semaphores[currentFrame].renderComplete;
     localSubmitInfo.signalSemaphoreCount = 1;
-    localSubmitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
+    localSubmitInfo.pCommandBuffers = &drawCmdBuffers[currentFrame];
     localSubmitInfo.commandBufferCount = 1;
 
-    VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &localSubmitInfo, VK_NULL_HANDLE));
+    // Signaled fence was waited for by PrepareFrame, the next wait on it is kMaxFramesInFlight frames later
+    VK_CHECK_RESULT(vkResetFences(vkDevice->logicalDevice, 1, &waitFences[currentFrame]));
+
+    {
+        std::lock_guard<std::mutex> lock(vkDevice->deviceQueueMutex);
+        VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &localSubmitInfo, waitFences[currentFrame]));
+    }
 
     SubmitFrame();
 }
@@ -87,47 +138,102 @@ void CG::EngineImpl::Prepare()
 {
     Engine::Prepare();
 
-    InitRayTracing();
-    LoadNVRayTracingProcs();
-    CreateNVRayTracingStoreImage();
-    CreateNVRayTracingAccumulationImage();
+    if (!cpuReferenceOnly) {
+        rayTracing = Vk::RayTracingBackend::Create(rayTracingApi, vkDevice, threadPool.get());
+        CreateRayTracingStoreImage();
+        CreateRayTracingAccumulationImage();
+    }
 
     SetupSystems();
 
     PrepareUniformBuffers();
 
-    SetupDescriptorsPool();
+    if (!cpuReferenceOnly) {
+        SetupDescriptorsPool();
+    }
 
     emptyTexture.LoadFromFile(GetAssetPath() + "textures/FFFFFF-1.png", vkDevice,
         queue);
+    for (const char* arg : engineConfig.args) {
+        if (arg == std::string("-cpureference")) {
+            // CPU path tracer samples the map and its distribution
+            enviromentMap.keepData = true;
+        }
+    }
     LoadSkybox(GetAssetPath() + "textures/hdr/anniversary_lounge_4k_blur.hdr");
-    LoadModelAsync(GetAssetPath() + "models/MaterialBall/scene.gltf");
 
-    CreateShaderBindingTable(shaderBindingTables.RTX, pipelines.RTX);
-    CreateShaderBindingTable(shaderBindingTables.previewRTX, pipelines.previewRTX);
-    CreateShaderBindingTable(shaderBindingTables.RTX_PBR, pipelines.RTX_PBR);
+    std::string modelFilePath = GetAssetPath() + "models/MaterialBall/scene.gltf";
+    for (size_t i = 0; i + 1 < engineConfig.args.size(); ++i) {
+        if (engineConfig.args[i] == std::string("-model")) {
+            modelFilePath = engineConfig.args[i + 1];
+        }
+    }
+    // Overlay shows the loading progress until the scene appears
+    LoadModelAsync(modelFilePath);
 
-    BuildCommandBuffers();
+    // Headless frames are recorded by RenderHeadless
+    if (!headless) {
+        BuildCommandBuffers();
+    }
 
     UpdateUniformBuffers();
 }
 
 void CG::EngineImpl::Cleanup()
 {
-    DestroyRTXPipeline();
-    DestroyNVRayTracingGeometry();
-    DestroyNVRayTracingStoreImage();
-    DestroyNVRayTracingAccumulationImage();
+    WaitForSceneLoading();
+    WaitForCPUReference();
+
+    // Frames in flight may still read the scene and the images
+    {
+        std::lock_guard<std::mutex> lock(vkDevice->deviceQueueMutex);
+        VK_CHECK_RESULT(vkDeviceWaitIdle(vkDevice->logicalDevice));
+    }
+
+    if (scene) {
+        DestroyScene(*scene);
+        scene = nullptr;
+    }
+
+    DestroyTraceCommandBuffers();
+    DestroyRayTracingStoreImage();
+    DestroyRayTracingAccumulationImage();
 
     emptyTexture.Destroy();
-    cubemapTexture.Destroy();
+    enviromentMap.Destroy();
 
-    testScene = nullptr;
+    rayTracing = nullptr;
     imGui = nullptr;
 
     Engine::Cleanup();
 }
 
+void CG::EngineImpl::SelectDeviceExtensions()
+{
+    if (cpuReferenceOnly) {
+        return;
+    }
+
+    bool preferNV = false;
+    for (const char* arg : engineConfig.args) {
+        if (arg == std::string("-rtnv")) {
+            preferNV = true;
+        }
+    }
+
+    // .khr.spv binaries exist only after the shader build, assets without them can still run on VK_NV_ray_tracing
+    if (!std::ifstream(GetAssetPath() + "shaders/compiled/raygenPBR.rgen.khr.spv")) {
+        std::cout << "KHR ray tracing shaders are not compiled, VK_NV_ray_tracing is preferred" << std::endl;
+        preferNV = true;
+    }
+
+    rayTracingApi = Vk::RayTracingBackend::SelectApi(*vkDevice, preferNV);
+
+    for (const char* extension : Vk::RayTracingBackend::GetRequiredExtensions(rayTracingApi)) {
+        enabledDeviceExtensions.push_back(extension);
+    }
+}
+
 VkPhysicalDeviceFeatures2 CG::EngineImpl::GetEnabledDeviceFeatures() const
 {
     VkPhysicalDeviceFeatures availableFeatures = vkDevice->features;
@@ -141,6 +247,17 @@ VkPhysicalDeviceFeatures2 CG::EngineImpl::GetEnabledDeviceFeatures() const
         enabledFeatures.sampleRateShading = VK_TRUE;
     }
 
+    if (availableFeatures.textureCompressionBC) {
+        enabledFeatures.textureCompressionBC = VK_TRUE;
+    }
+
+    if (cpuReferenceOnly) {
+        VkPhysicalDeviceFeatures2 enabledFeatures2 = {};
+        enabledFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        enabledFeatures2.features = enabledFeatures;
+        return enabledFeatures2;
+    }
+
     // TODO: remove hardcode descr indexing features
     static VkPhysicalDeviceDescriptorIndexingFeaturesEXT
         physicalDeviceDescriptorIndexingFeatures;
@@ -157,6 +274,28 @@ VkPhysicalDeviceFeatures2 CG::EngineImpl::GetEnabledDeviceFeatures() const
         .shaderSampledImageArrayNonUniformIndexing
         = true;
 
+    // Extensions of the KHR backend have their features disabled unless requested
+    static VkPhysicalDeviceBufferDeviceAddressFeaturesKHR bufferDeviceAddressFeatures;
+    bufferDeviceAddressFeatures = {};
+    bufferDeviceAddressFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES_KHR;
+    bufferDeviceAddressFeatures.bufferDeviceAddress = VK_TRUE;
+
+    static VkPhysicalDeviceAccelerationStructureFeaturesKHR accelerationStructureFeatures;
+    accelerationStructureFeatures = {};
+    accelerationStructureFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR;
+    accelerationStructureFeatures.pNext = &bufferDeviceAddressFeatures;
+    accelerationStructureFeatures.accelerationStructure = VK_TRUE;
+
+    static VkPhysicalDeviceRayTracingPipelineFeaturesKHR rayTracingPipelineFeatures;
+    rayTracingPipelineFeatures = {};
+    rayTracingPipelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_FEATURES_KHR;
+    rayTracingPipelineFeatures.pNext = &accelerationStructureFeatures;
+    rayTracingPipelineFeatures.rayTracingPipeline = VK_TRUE;
+
+    if (rayTracingApi == Vk::eRayTracingApi::kKHR) {
+        physicalDeviceDescriptorIndexingFeatures.pNext = &rayTracingPipelineFeatures;
+    }
+
     VkPhysicalDeviceFeatures2 enabledFeatures2;
 
     enabledFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
@@ -180,10 +319,16 @@ void CG::EngineImpl::CaptureEvent(const SDL_Event& event)
 
 void CG::EngineImpl::OnWindowResize()
 {
-    DestroyNVRayTracingAccumulationImage();
-    DestroyNVRayTracingStoreImage();
-    CreateNVRayTracingStoreImage();
-    CreateNVRayTracingAccumulationImage();
+    DestroyRayTracingAccumulationImage();
+    DestroyRayTracingStoreImage();
+    CreateRayTracingStoreImage();
+    CreateRayTracingAccumulationImage();
+
+    if (scene) {
+        UpdateRTXStorageImageDescriptors(*scene);
+    }
+
+    traceCmdBuffersDirty = true;
 }
 
 void CG::EngineImpl::FlushCommandBuffer(VkCommandBuffer commandBuffer)
@@ -217,6 +362,11 @@ void CG::EngineImpl::BuildCommandBuffers()
     BuildUiCommandBuffers();
     UpdateUniformBuffers();
 
+    // Swapchain recreation may change the number of images
+    if (traceCmdBuffersDirty || traceCmdBuffers.size() != kMaxFramesInFlight * vkSwapChain->imageCount) {
+        BuildTraceCommandBuffers();
+    }
+
     VkViewport viewport = {};
     viewport.height = static_cast<float>(engineConfig.height);
     viewport.width = static_cast<float>(engineConfig.width);
@@ -229,23 +379,70 @@ void CG::EngineImpl::BuildCommandBuffers()
     scissor.offset.x = 0;
     scissor.offset.y = 0;
 
-    for (int32_t i = 0; i < drawCmdBuffers.size(); ++i) {
-        renderPassBeginInfo.framebuffer = frameBuffers[i];
-        VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+    // Only the command buffer of the current frame is free, it draws into the acquired swapchain image.
+    // Tracing is recorded in advance, the refit and the UI are the only commands recorded every frame
+    VkCommandBuffer commandBuffer = drawCmdBuffers[currentFrame];
+    renderPassBeginInfo.framebuffer = frameBuffers[currentBuffer];
+    VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+
+    UpdateTopLevel(commandBuffer);
+
+    vkCmdExecuteCommands(commandBuffer, 1, &traceCmdBuffers[currentFrame * vkSwapChain->imageCount + currentBuffer]);
+
+    vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo,
+        VK_SUBPASS_CONTENTS_INLINE);
+
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    imGui->DrawFrame(commandBuffer, currentFrame);
+
+    vkCmdEndRenderPass(commandBuffer);
+
+    VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+}
+
+void CG::EngineImpl::BuildTraceCommandBuffers()
+{
+    VkDevice device = vkDevice->logicalDevice;
+
+    // Primary buffers of other frames in flight may still execute them
+    VK_CHECK_RESULT(vkWaitForFences(device, static_cast<uint32_t>(waitFences.size()), waitFences.data(), VK_TRUE, UINT64_MAX));
 
-        DrawRayTracingData(i);
+    const uint32_t imageCount = vkSwapChain->imageCount;
+    if (traceCmdBuffers.size() != kMaxFramesInFlight * imageCount) {
+        DestroyTraceCommandBuffers();
+        traceCmdBuffers.resize(kMaxFramesInFlight * imageCount);
 
-        vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo,
-            VK_SUBPASS_CONTENTS_INLINE);
+        VkCommandBufferAllocateInfo commandBufferAllocateInfo = Vk::Initializers::CommandBufferAllocateInfo(
+            vkCmdPool, VK_COMMAND_BUFFER_LEVEL_SECONDARY, static_cast<uint32_t>(traceCmdBuffers.size()));
+        VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, traceCmdBuffers.data()));
+    }
+
+    // Executed outside of render passes, so nothing is inherited
+    VkCommandBufferInheritanceInfo inheritanceInfo = {};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
 
-        vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-        vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+    VkCommandBufferBeginInfo cmdBufInfo = Vk::Initializers::CommandBufferBeginInfo();
+    cmdBufInfo.pInheritanceInfo = &inheritanceInfo;
 
-        imGui->DrawFrame(drawCmdBuffers[i]);
+    for (uint32_t frame = 0; frame < kMaxFramesInFlight; ++frame) {
+        for (uint32_t image = 0; image < imageCount; ++image) {
+            VkCommandBuffer commandBuffer = traceCmdBuffers[frame * imageCount + image];
+            VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+            DrawRayTracingData(commandBuffer, frame, image);
+            VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+        }
+    }
 
-        vkCmdEndRenderPass(drawCmdBuffers[i]);
+    traceCmdBuffersDirty = false;
+}
 
-        VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
+void CG::EngineImpl::DestroyTraceCommandBuffers()
+{
+    if (!traceCmdBuffers.empty()) {
+        vkFreeCommandBuffers(vkDevice->logicalDevice, vkCmdPool, static_cast<uint32_t>(traceCmdBuffers.size()), traceCmdBuffers.data());
+        traceCmdBuffers.clear();
     }
 }
 
@@ -266,7 +463,7 @@ void CG::EngineImpl::SetupDescriptorsPool()
         { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, typePoolSize },
         { VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, typePoolSize },
         { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, typePoolSize },
-        { VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_NV, typePoolSize },
+        { rayTracing->GetAccelerationStructureDescriptorType(), typePoolSize },
     };
 
     VkDescriptorPoolCreateInfo descriptorPoolCI = Vk::Initializers::DescriptorPoolCreateInfo(
@@ -291,21 +488,23 @@ void CG::EngineImpl::PrepareUniformBuffers()
 
     cameraComponent = &component;
 
-    VK_CHECK_RESULT(
-        vkDevice->CreateBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            &sceneUbo, sizeof(sceneUboData)));
+    for (uint32_t i = 0; i < kMaxFramesInFlight; ++i) {
+        VK_CHECK_RESULT(
+            vkDevice->CreateBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                &sceneUbos[i], sizeof(sceneUboData)));
 
-    // Map persistent
-    VK_CHECK_RESULT(sceneUbo.Map());
+        // Map persistent
+        VK_CHECK_RESULT(sceneUbos[i].Map());
 
-    VK_CHECK_RESULT(
-        vkDevice->CreateBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            &cameraUbo, sizeof(cameraUboData)));
+        VK_CHECK_RESULT(
+            vkDevice->CreateBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                &cameraUbos[i], sizeof(cameraUboData)));
 
-    // Map persistent
-    VK_CHECK_RESULT(cameraUbo.Map());
+        // Map persistent
+        VK_CHECK_RESULT(cameraUbos[i].Map());
+    }
 }
 
 void CG::EngineImpl::UpdateUniformBuffers()
@@ -324,15 +523,10 @@ void CG::EngineImpl::UpdateUniformBuffers()
     sceneUboData.invProjection = glm::inverse(sceneUboData.projection);
     sceneUboData.invView = glm::inverse(sceneUboData.view);
 
-    float scale = (1.0f / std::max(testScene->GetSize().x, std::max(testScene->GetSize().y, testScene->GetSize().z))) * 0.5f;
-
-    sceneUboData.model = glm::mat4(1.0f);
-    sceneUboData.model[0][0] = scale;
-    sceneUboData.model[1][1] = scale;
-    sceneUboData.model[2][2] = scale;
+    sceneUboData.model = scene ? scene->modelMatrix : glm::mat4(1.0f);
 
     sceneUboData.cameraPos = glm::vec4(cameraComponent->position, 1.0f);
-    sceneUbo.CopyTo(&sceneUboData, sizeof(sceneUboData));
+    sceneUbos[currentFrame].CopyTo(&sceneUboData, sizeof(sceneUboData));
 
     std::random_device dev;
     std::mt19937 rng(dev());
@@ -340,7 +534,7 @@ void CG::EngineImpl::UpdateUniformBuffers()
 
     cameraUboData.randomSeed = dist(rng);
     cameraUboData.accumulationIndex = cameraComponent->accumulationIndex;
-    cameraUbo.CopyTo(&cameraUboData, sizeof(cameraUboData));
+    cameraUbos[currentFrame].CopyTo(&cameraUboData, sizeof(cameraUboData));
 
     if (!cameraUboData.pauseRendering && !cameraComponent->input.IsMoving()) {
         cameraComponent->accumulationIndex = std::min(cameraComponent->accumulationIndex + 1, std::numeric_limits<int>::max());
@@ -393,6 +587,9 @@ void CG::EngineImpl::DrawUI()
             ImGui::Checkbox("Enable preview quality", &uiData.enablePreviewQuality);
             ImGui::Checkbox("Enable PBR materials", &uiData.enablePBRMaterials);
             ImGui::Checkbox("Pause rendering", &pauseRendering);
+            if (scene && !scene->model->GetAnimations().empty()) {
+                ImGui::Checkbox("Play animation", &uiData.playAnimation);
+            }
             ImGui::SliderInt("Bounces count", &cameraUboData.bouncesCount, 1, kMaxRecursionDepth);
             ImGui::SliderInt("Number of samples", &cameraUboData.numberOfSamples, 1, 64);
 
@@ -400,6 +597,7 @@ void CG::EngineImpl::DrawUI()
             if (oldPipelineParams != newPipelineParams)
             {
                 cameraComponent->ResetSamples();
+                traceCmdBuffersDirty = true;
             }
 
             cameraUboData.pauseRendering = static_cast<int>(pauseRendering);
@@ -421,6 +619,14 @@ void CG::EngineImpl::DrawUI()
             cameraComponent->ResetSamples();
         }
 
+        if (sceneLoader.thread.joinable()) {
+            ImGui::Separator();
+
+            const char* stage = sceneLoader.stage;
+            ImGui::Text("Loading scene: %s", stage ? stage : "");
+            ImGui::ProgressBar(sceneLoader.progress);
+        }
+
         ImGui::End();
     }
 
@@ -430,7 +636,8 @@ void CG::EngineImpl::DrawUI()
                 ImGui::MenuItem("File menu", nullptr, false, false);
                 {
 
-                    if (ImGui::MenuItem("Open scene", "*.gltf")) {
+                    // One model is loaded at a time
+                    if (ImGui::MenuItem("Open scene", "*.gltf, *.glb", false, !sceneLoader.thread.joinable())) {
                         nfdchar_t* outPath = nullptr;
 #pragma warning(push)
 #pragma warning(disable : 26812)
@@ -481,395 +688,524 @@ void CG::EngineImpl::BuildUiCommandBuffers()
 {
     DrawUI();
 
-    imGui->UpdateBuffers();
+    imGui->UpdateBuffers(currentFrame);
 }
 
-void CG::EngineImpl::LoadModel(const std::string& modelFilePath)
+CG::Vk::GLTFModel::LoadingParams CG::EngineImpl::GetModelLoadingParams() const
 {
-    {
-        if (testScene) {
-            UnbindModelMaterials();
+    Vk::GLTFModel::LoadingParams loadingParams;
+    bool cpuReference = false;
+
+    for (const char* arg : engineConfig.args) {
+        if (arg == std::string("-compactvertices")) {
+            loadingParams.vertexFormat = Vk::GLTFModel::eVertexFormat::kCompact;
+        }
+        if (arg == std::string("-noscenecache")) {
+            loadingParams.useSceneCache = false;
+        }
+        if (arg == std::string("-nomips")) {
+            loadingParams.mipGeneration = Vk::GLTFModel::eMipGeneration::kNone;
+        }
+        if (arg == std::string("-boxmips")) {
+            loadingParams.mipGeneration = Vk::GLTFModel::eMipGeneration::kBox;
+        }
+        if (arg == std::string("-kaisermips")) {
+            loadingParams.mipGeneration = Vk::GLTFModel::eMipGeneration::kKaiser;
+        }
+        if (arg == std::string("-compresstextures")) {
+            loadingParams.compressTextures = true;
         }
+        if (arg == std::string("-bvhbenchmark")) {
+            // CPU BVH is built from the geometry after the upload
+            loadingParams.keepGeometryData = true;
+        }
+        if (arg == std::string("-cpureference")) {
+            cpuReference = true;
+        }
+    }
 
-        testScene = std::make_unique<Vk::GLTFModel>();
+    if (cpuReference) {
+        // CPU path tracer reads uncompressed base levels of the textures, see RenderCPUReference
+        loadingParams.keepGeometryData = true;
+        loadingParams.keepTextureData = true;
+        loadingParams.compressTextures = false;
+    }
 
-        testScene->vkDevice = vkDevice;
-        testScene->queue = queue;
+    // Geometry is read by acceleration structure builds
+    if (rayTracing) {
+        loadingParams.geometryBufferUsage = rayTracing->GetBuildInputBufferUsage();
     }
 
-    testScene->LoadFromFile(modelFilePath);
+    return loadingParams;
 }
 
 void CG::EngineImpl::LoadModelAsync(const std::string& modelFilePath)
 {
+    if (sceneLoader.thread.joinable()) {
+        std::cout << "Another scene is being loaded, " << modelFilePath << " is skipped" << std::endl;
+        return;
+    }
+
+    sceneLoader.finished = false;
+    sceneLoader.stage = "reading the model";
+    sceneLoader.progress = 0.0f;
+    sceneLoader.result = nullptr;
+    sceneLoader.error.clear();
+
+    sceneLoader.thread = std::thread(&EngineImpl::LoadScene, this, modelFilePath, GetModelLoadingParams());
+}
+
+void CG::EngineImpl::LoadScene(const std::string& modelFilePath, const Vk::GLTFModel::LoadingParams& loadingParams)
+{
+    const auto loadingStart = std::chrono::high_resolution_clock::now();
+
+    // Pools are externally synchronized, the render thread keeps using the default one
+    VkCommandPool commandPool = vkDevice->CreateCommandPool(vkDevice->queueFamilyIndices.graphics);
+    Vk::Device::SetThreadCommandPool(commandPool);
+
+    std::unique_ptr<SceneData> sceneData = std::make_unique<SceneData>();
+
     try {
-        if (testScene) {
-            cameraComponent->ResetSamples();
-            DestroyNVRayTracingGeometry();
-            DestroyRTXPipeline();
-            // SetupRTXEnviromentDescriptorSet();
+        sceneData->model = std::make_unique<Vk::GLTFModel>();
+        sceneData->modelFilePath = modelFilePath;
+        Vk::GLTFModel& model = *sceneData->model;
+        model.vkDevice = vkDevice;
+        model.queue = loadingQueue;
+        model.threadPool = threadPool.get();
+        model.loadingParams = loadingParams;
+        model.progressCallback = [this](float progress) { sceneLoader.progress = progress; };
+
+        model.LoadFromFile(modelFilePath);
+        model.SetLoaded(true);
+
+        sceneData->modelMatrix = SEngineImpl::GetModelMatrix(model);
+
+        bool benchmarkBVH = false;
+        for (const char* arg : engineConfig.args) {
+            if (arg == std::string("-bvhbenchmark")) {
+                benchmarkBVH = true;
+            }
+        }
+
+        if (benchmarkBVH) {
+            sceneLoader.stage = "benchmarking CPU BVH";
+            Benchmarks::RunBVHBenchmark(model, sceneData->modelMatrix, threadPool.get());
         }
 
-        LoadModel(modelFilePath);
+        // The CPU path tracer reads the geometry and textures kept by the model
+        if (!cpuReferenceOnly) {
+            sceneLoader.stage = "building acceleration structures";
+            sceneLoader.progress = 0.0f;
+            CreateRayTracingGeometry(*sceneData);
 
-        testScene->SetLoaded(true);
+            sceneLoader.stage = "creating pipelines";
+            sceneLoader.progress = 0.0f;
+            SetupRTXModelDescriptorSets(*sceneData);
+            CreateRTXPipeline(*sceneData);
 
-        UpdateUniformBuffers();
-        CreateNVRayTracingGeometry();
-        SetupRTXModelDescriptorSets();
+            rayTracing->CreateShaderBindingTable(sceneData->pipelines.RTX, sceneData->shaderBindingTables.RTX);
+            rayTracing->CreateShaderBindingTable(sceneData->pipelines.previewRTX, sceneData->shaderBindingTables.previewRTX);
+            rayTracing->CreateShaderBindingTable(sceneData->pipelines.RTX_PBR, sceneData->shaderBindingTables.RTX_PBR);
+        }
+        sceneLoader.progress = 1.0f;
 
-        CreateRTXPipeline();
-    } catch (const Vk::AssetLoadingException& e) {
+        sceneLoader.result = std::move(sceneData);
+
+        const float milliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - loadingStart).count();
+        std::cout << "Loaded scene " << modelFilePath << " in " << milliseconds << " ms in background" << std::endl;
+    } catch (const std::exception& e) {
+        // Asset errors as well as failed allocations, anything escaping the thread would terminate the application
         std::cerr << e.what() << std::endl;
+        sceneLoader.error = e.what();
+        // Nothing of the scene was submitted for rendering yet, so whatever was created can go right away
+        DestroyScene(*sceneData);
+    } catch (...) {
+        sceneLoader.error = "Unknown error while loading " + modelFilePath;
+        std::cerr << sceneLoader.error << std::endl;
+        DestroyScene(*sceneData);
+    }
 
-        const SDL_MessageBoxButtonData buttons[] = {
-            { /* .flags, .buttonid, .text */ 0, 0, "ok" },
-        };
-        const SDL_MessageBoxData messageboxdata = {
-            SDL_MESSAGEBOX_INFORMATION,
-            NULL,
-            "Asset loading error",
-            e.what(),
-            SDL_arraysize(buttons),
-            buttons,
-        };
-        if (SDL_ShowMessageBox(&messageboxdata, nullptr) < 0) {
-            throw std::runtime_error(
-                "Error while trying to display SDL message box:" + std::string(SDL_GetError()));
+    Vk::Device::SetThreadCommandPool(VK_NULL_HANDLE);
+    vkDestroyCommandPool(vkDevice->logicalDevice, commandPool, nullptr);
+
+    sceneLoader.finished = true;
+}
+
+void CG::EngineImpl::UpdateLoadedScene()
+{
+    if (!sceneLoader.finished) {
+        return;
+    }
+
+    sceneLoader.thread.join();
+    sceneLoader.finished = false;
+
+    if (!sceneLoader.result) {
+        ShowAssetLoadingError(sceneLoader.error.c_str());
+        return;
+    }
+
+    // Frames are recorded from scratch, so the swap only has to wait for the ones which are still using the old scene
+    {
+        std::lock_guard<std::mutex> lock(vkDevice->deviceQueueMutex);
+        VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+    }
+
+    std::unique_ptr<SceneData> oldScene = std::move(scene);
+    scene = std::move(sceneLoader.result);
+    if (!cpuReferenceOnly) {
+        UpdateRTXStorageImageDescriptors(*scene);
+    }
+    traceCmdBuffersDirty = true;
+
+    if (oldScene) {
+        DestroyScene(*oldScene);
+    }
+
+    cameraComponent->ResetSamples();
+
+    // Headless references are rendered by RenderHeadless once the camera is set up
+    if (scene->model->loadingParams.keepTextureData && !headless) {
+        RenderCPUReference(*scene);
+    }
+}
+
+void CG::EngineImpl::WaitForSceneLoading()
+{
+    if (sceneLoader.thread.joinable()) {
+        sceneLoader.thread.join();
+    }
+
+    if (sceneLoader.result) {
+        DestroyScene(*sceneLoader.result);
+        sceneLoader.result = nullptr;
+    }
+}
+
+void CG::EngineImpl::DestroyScene(SceneData& sceneData)
+{
+    DestroyRTXPipeline(sceneData);
+    DestroyRayTracingGeometry(sceneData);
+
+    sceneData.shaderBindingTables.RTX.Destroy();
+    sceneData.shaderBindingTables.RTX_PBR.Destroy();
+    sceneData.shaderBindingTables.previewRTX.Destroy();
+
+    vkDestroyDescriptorPool(vkDevice->logicalDevice, sceneData.descriptorPool, nullptr);
+    sceneData.descriptorPool = VK_NULL_HANDLE;
+    sceneData.emptyGeometryBuffer.Destroy();
+
+    sceneData.model = nullptr;
+}
+
+void CG::EngineImpl::RenderCPUReference(const SceneData& sceneData)
+{
+    // Only one reference is traced at a time, both use the whole thread pool. Joining a running one would freeze the window
+    if (cpuReferenceThread.joinable()) {
+        if (!cpuReferenceFinished) {
+            std::cout << "CPU reference is still tracing, skipped the one of " << sceneData.modelFilePath << std::endl;
+            return;
         }
+        cpuReferenceThread.join();
+    }
+
+    // Copies the model as it is posed now, animation, skybox and scene swaps don't touch the traced one.
+    // Its BVH is built on cpuReferenceThread
+    auto cpuScene = std::make_unique<CPU::Scene>();
+    cpuScene->LoadModel(*sceneData.model, sceneData.modelMatrix);
+    cpuScene->LoadEnvironment(enviromentMap);
+
+    CPU::PathTracer::Settings settings;
+    settings.bouncesCount = cameraUboData.bouncesCount;
+    settings.samplesCount = cameraUboData.numberOfSamples;
+    settings.aperture = cameraUboData.aperture;
+    settings.focusDistance = cameraUboData.focusDistance;
+    settings.framesCount = SEngineImpl::kCPUReferenceFramesCount;
+    settings.randomSeed = cameraUboData.randomSeed;
+
+    // Current camera, the same view the GPU path starts accumulating from
+    CPU::PathTracer::View view;
+    view.invView = sceneUboData.invView;
+    view.invProjection = sceneUboData.invProjection;
+    view.lightDirection = glm::vec3(sceneUboData.globalLightDir);
+    view.lightColor = glm::vec3(sceneUboData.globalLightColor);
+
+    CPU::PathTracer::Image image;
+    image.width = engineConfig.width;
+    image.height = engineConfig.height;
+
+    const std::string exrFileName = sceneData.modelFilePath + ".reference.exr";
+    const std::string pngFileName = sceneData.modelFilePath + ".reference.png";
+
+    // Tracing takes from seconds to minutes, the render thread keeps drawing the scene meanwhile
+    cpuReferenceFinished = false;
+    cpuReferenceThread = std::thread([this, cpuScene = std::move(cpuScene), settings, view, image, exrFileName, pngFileName]() mutable {
+        try {
+            cpuScene->BuildBVH(threadPool.get());
+            CPU::PathTracer(*cpuScene, settings, view).Render(image, threadPool.get());
+
+            if (!CPU::ImageWriter::WriteEXR(exrFileName, image.width, image.height, image.radiance.data())) {
+                std::cerr << "Failed to write " << exrFileName << std::endl;
+            }
+            if (!CPU::ImageWriter::WritePNG(pngFileName, image.width, image.height, image.toneMapped.data())) {
+                std::cerr << "Failed to write " << pngFileName << std::endl;
+            }
+
+            std::cout << "CPU reference saved to " << exrFileName << " and " << pngFileName << std::endl;
+        } catch (const std::exception& e) {
+            std::cerr << "CPU reference " << exrFileName << " failed: " << e.what() << std::endl;
+        }
+
+        cpuReferenceFinished = true;
+    });
+}
+
+void CG::EngineImpl::WaitForCPUReference()
+{
+    if (cpuReferenceThread.joinable()) {
+        cpuReferenceThread.join();
     }
 }
 
 void CG::EngineImpl::LoadSkybox(const std::string& cubeMapFilePath)
 {
+    Vk::Texture2D::eHDRFormat hdrFormat = Vk::Texture2D::eHDRFormat::kSharedExponent;
+    for (const char* arg : engineConfig.args) {
+        if (arg == std::string("-halfenvmap")) {
+            hdrFormat = Vk::Texture2D::eHDRFormat::kHalf;
+        }
+    }
+
+    // The current map stays bound until the new one is fully loaded, so a broken file leaves the skybox as it was
+    Vk::EnvironmentMap loadedMap;
+    loadedMap.keepData = enviromentMap.keepData;
+
     try {
-        cubemapTexture.LoadFromFile(cubeMapFilePath, vkDevice, queue, true);
-        SetupRTXEnviromentDescriptorSet();
-    } catch (const Vk::AssetLoadingException& e) {
+        loadedMap.LoadFromFile(cubeMapFilePath, vkDevice, queue, threadPool.get(), hdrFormat);
+    } catch (const std::exception& e) {
+        loadedMap.Destroy();
         std::cerr << e.what() << std::endl;
+        ShowAssetLoadingError(e.what());
+        return;
+    }
 
-        const SDL_MessageBoxButtonData buttons[] = {
-            { /* .flags, .buttonid, .text */ 0, 0, "ok" },
-        };
-        const SDL_MessageBoxData messageboxdata = {
-            SDL_MESSAGEBOX_INFORMATION,
-            NULL,
-            "Asset loading error",
-            e.what(),
-            SDL_arraysize(buttons),
-            buttons,
-        };
-        if (SDL_ShowMessageBox(&messageboxdata, nullptr) < 0) {
-            throw std::runtime_error(
-                "Error while trying to display SDL message box:" + std::string(SDL_GetError()));
-        }
+    // Frames in flight may still sample the old map
+    {
+        std::lock_guard<std::mutex> lock(vkDevice->deviceQueueMutex);
+        VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+    }
+
+    enviromentMap.Destroy();
+    enviromentMap = std::move(loadedMap);
+
+    if (!cpuReferenceOnly) {
+        SetupRTXEnviromentDescriptorSet();
     }
+    traceCmdBuffersDirty = true;
 }
 
-void CG::EngineImpl::CreateBottomLevelAccelerationStructure(
-    const VkGeometryNV* geometries,
-    uint32_t blasIndex,
-    size_t geomCount)
+void CG::EngineImpl::ShowAssetLoadingError(const char* message)
 {
-    AccelerationStructure& bottomLevelAS = blasData[blasIndex];
+    if (headless) {
+        std::cerr << "Asset loading error: " << message << std::endl;
+        return;
+    }
 
-    // Prepare handle
-    {
-        VkAccelerationStructureInfoNV accelerationStructureInfo = {};
-        accelerationStructureInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_INFO_NV;
-        accelerationStructureInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_NV;
-        accelerationStructureInfo.instanceCount = 0;
-        accelerationStructureInfo.geometryCount = static_cast<uint32_t>(geomCount);
-        accelerationStructureInfo.pGeometries = geometries;
-        accelerationStructureInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_NV;
-
-        VkAccelerationStructureCreateInfoNV accelerationStructureCI = {};
-        accelerationStructureCI.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_NV;
-        accelerationStructureCI.info = accelerationStructureInfo;
-        VK_CHECK_RESULT(vkCreateAccelerationStructureNV(
-            vkDevice->logicalDevice, &accelerationStructureCI, nullptr,
-            &bottomLevelAS.accelerationStructure));
-
-        VkAccelerationStructureMemoryRequirementsInfoNV memoryRequirementsInfo {};
-        memoryRequirementsInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_MEMORY_REQUIREMENTS_INFO_NV;
-        memoryRequirementsInfo.accelerationStructure = bottomLevelAS.accelerationStructure;
-
-        VkMemoryRequirements2 memoryRequirements2 = {};
-        vkGetAccelerationStructureMemoryRequirementsNV(
-            vkDevice->logicalDevice, &memoryRequirementsInfo, &memoryRequirements2);
-
-        VkMemoryAllocateInfo memoryAllocateInfo = Vk::Initializers::MemoryAllocateInfo();
-        memoryAllocateInfo.allocationSize = memoryRequirements2.memoryRequirements.size;
-        memoryAllocateInfo.memoryTypeIndex = vkDevice->GetMemoryTypeIndex(
-            memoryRequirements2.memoryRequirements.memoryTypeBits,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-        VK_CHECK_RESULT(vkAllocateMemory(vkDevice->logicalDevice,
-            &memoryAllocateInfo, nullptr,
-            &bottomLevelAS.memory));
-
-        VkBindAccelerationStructureMemoryInfoNV accelerationStructureMemoryInfo = {};
-        accelerationStructureMemoryInfo.sType = VK_STRUCTURE_TYPE_BIND_ACCELERATION_STRUCTURE_MEMORY_INFO_NV;
-        accelerationStructureMemoryInfo.accelerationStructure = bottomLevelAS.accelerationStructure;
-        accelerationStructureMemoryInfo.memory = bottomLevelAS.memory;
-        VK_CHECK_RESULT(vkBindAccelerationStructureMemoryNV(
-            vkDevice->logicalDevice, 1, &accelerationStructureMemoryInfo));
-
-        VK_CHECK_RESULT(vkGetAccelerationStructureHandleNV(
-            vkDevice->logicalDevice, bottomLevelAS.accelerationStructure,
-            sizeof(uint64_t), &bottomLevelAS.handle));
-    }
-
-    // Build step
-    {
-        // Acceleration structure build requires some scratch space to store
-        // temporary information
-        VkAccelerationStructureMemoryRequirementsInfoNV memoryRequirementsInfo {};
-        memoryRequirementsInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_MEMORY_REQUIREMENTS_INFO_NV;
-        memoryRequirementsInfo.type = VK_ACCELERATION_STRUCTURE_MEMORY_REQUIREMENTS_TYPE_OBJECT_NV;
-
-        VkMemoryRequirements2 memReqBottomLevelAS;
-        memoryRequirementsInfo.accelerationStructure = bottomLevelAS.accelerationStructure;
-        vkGetAccelerationStructureMemoryRequirementsNV(
-            vkDevice->logicalDevice, &memoryRequirementsInfo, &memReqBottomLevelAS);
-
-        const VkDeviceSize scratchBufferSize = memReqBottomLevelAS.memoryRequirements.size;
-
-        Vk::Buffer scratchBuffer;
-        VK_CHECK_RESULT(vkDevice->CreateBuffer(VK_BUFFER_USAGE_RAY_TRACING_BIT_NV,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-            &scratchBuffer, scratchBufferSize));
-
-        VkCommandBuffer cmdBuffer = vkDevice->CreateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-        VkAccelerationStructureInfoNV buildInfo {};
-        buildInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_INFO_NV;
-        buildInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_NV;
-        buildInfo.geometryCount = static_cast<uint32_t>(geomCount);
-        buildInfo.pGeometries = geometries;
-        buildInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_NV;
-
-        vkCmdBuildAccelerationStructureNV(cmdBuffer, &buildInfo, VK_NULL_HANDLE, 0,
-            VK_FALSE,
-            bottomLevelAS.accelerationStructure,
-            VK_NULL_HANDLE, scratchBuffer.buffer, 0);
-
-        VkMemoryBarrier memoryBarrier = Vk::Initializers::CreateMemoryBarrier();
-        memoryBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_NV | VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_NV;
-        memoryBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_NV | VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_NV;
-        vkCmdPipelineBarrier(cmdBuffer,
-            VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_NV,
-            VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_NV,
-            0, 1, &memoryBarrier, 0, 0, 0, 0);
-
-        vkDevice->FlushCommandBuffer(cmdBuffer, queue);
+    const SDL_MessageBoxButtonData buttons[] = {
+        { /* .flags, .buttonid, .text */ 0, 0, "ok" },
+    };
+    const SDL_MessageBoxData messageboxdata = {
+        SDL_MESSAGEBOX_INFORMATION,
+        NULL,
+        "Asset loading error",
+        message,
+        SDL_arraysize(buttons),
+        buttons,
+    };
+    if (SDL_ShowMessageBox(&messageboxdata, nullptr) < 0) {
+        throw std::runtime_error(
+            "Error while trying to display SDL message box:" + std::string(SDL_GetError()));
     }
 }
 
-void CG::EngineImpl::CreateTopLevelAccelerationStructure()
+void CG::EngineImpl::CreateTopLevelAccelerationStructure(SceneData& sceneData)
 {
-    {
-        VkAccelerationStructureInfoNV accelerationStructureInfo = {};
-        accelerationStructureInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_INFO_NV;
-        accelerationStructureInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_NV;
-        accelerationStructureInfo.instanceCount = static_cast<uint32_t>(blasData.size());
-        accelerationStructureInfo.geometryCount = 0;
-
-        VkAccelerationStructureCreateInfoNV accelerationStructureCI = {};
-        accelerationStructureCI.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_NV;
-        accelerationStructureCI.info = accelerationStructureInfo;
-        VK_CHECK_RESULT(vkCreateAccelerationStructureNV(
-            vkDevice->logicalDevice, &accelerationStructureCI, nullptr,
-            &topLevelAS.accelerationStructure));
-
-        VkAccelerationStructureMemoryRequirementsInfoNV memoryRequirementsInfo {};
-        memoryRequirementsInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_MEMORY_REQUIREMENTS_INFO_NV;
-        memoryRequirementsInfo.accelerationStructure = topLevelAS.accelerationStructure;
-
-        VkMemoryRequirements2 memoryRequirements2 = {};
-        vkGetAccelerationStructureMemoryRequirementsNV(
-            vkDevice->logicalDevice, &memoryRequirementsInfo, &memoryRequirements2);
-
-        VkMemoryAllocateInfo memoryAllocateInfo = Vk::Initializers::MemoryAllocateInfo();
-        memoryAllocateInfo.allocationSize = memoryRequirements2.memoryRequirements.size;
-        memoryAllocateInfo.memoryTypeIndex = vkDevice->GetMemoryTypeIndex(
-            memoryRequirements2.memoryRequirements.memoryTypeBits,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-        VK_CHECK_RESULT(vkAllocateMemory(vkDevice->logicalDevice,
-            &memoryAllocateInfo, nullptr,
-            &topLevelAS.memory));
-
-        VkBindAccelerationStructureMemoryInfoNV accelerationStructureMemoryInfo = {};
-        accelerationStructureMemoryInfo.sType = VK_STRUCTURE_TYPE_BIND_ACCELERATION_STRUCTURE_MEMORY_INFO_NV;
-        accelerationStructureMemoryInfo.accelerationStructure = topLevelAS.accelerationStructure;
-        accelerationStructureMemoryInfo.memory = topLevelAS.memory;
-        VK_CHECK_RESULT(vkBindAccelerationStructureMemoryNV(
-            vkDevice->logicalDevice, 1, &accelerationStructureMemoryInfo));
-
-
-        VK_CHECK_RESULT(vkGetAccelerationStructureHandleNV(
-            vkDevice->logicalDevice, topLevelAS.accelerationStructure,
-            sizeof(uint64_t), &topLevelAS.handle));
-    }
+    const std::vector<BLASInstance>& blasInstances = sceneData.blasInstances;
 
+    bool benchmarkTopLevel = false;
+    for (const char* arg : engineConfig.args) {
+        if (arg == std::string("-tlasbenchmark")) {
+            benchmarkTopLevel = true;
+        }
+    }
+    // Only animated scenes pay for a TLAS which can be refitted
+    const bool allowUpdate = !sceneData.model->GetAnimations().empty() || benchmarkTopLevel;
 
-    {
-        // Single instance with a 3x4 transform matrix for the ray traced triangle
-        Vk::Buffer instanceBuffer;
+    // Refits of consecutive frames read different buffers, so animation never writes one the GPU may still read
+    for (Vk::Buffer& instanceBuffer : sceneData.instanceBuffers) {
+        VK_CHECK_RESULT(vkDevice->CreateBuffer(
+            rayTracing->GetBuildInputBufferUsage(),
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            &instanceBuffer, sizeof(GeometryInstance) * blasInstances.size()));
+        VK_CHECK_RESULT(instanceBuffer.Map());
 
-        std::vector<GeometryInstance> geometryInstances(blasData.size());
-        for (size_t i = 0; i < geometryInstances.size(); ++i) {
+        GeometryInstance* geometryInstances = static_cast<GeometryInstance*>(instanceBuffer.mapped);
+        for (size_t i = 0; i < blasInstances.size(); ++i) {
             GeometryInstance& geometryInstance = geometryInstances[i];
+            const BLASInstance& blasInstance = blasInstances[i];
 
-            geometryInstance.transform = glm::transpose(blasData[i].transform);
+            geometryInstance.transform = glm::transpose(blasInstance.transform);
             geometryInstance.instanceId = i;
             geometryInstance.mask = 0xff;
             geometryInstance.instanceOffset = 0;
-            geometryInstance.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_CULL_DISABLE_BIT_NV;
-            geometryInstance.accelerationStructureHandle = blasData[i].handle;
+            geometryInstance.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
+            geometryInstance.accelerationStructureHandle = sceneData.accelerationStructures->GetBottomLevel(blasInstance.blasIndex).handle;
         }
+    }
 
-        VK_CHECK_RESULT(vkDevice->CreateBuffer(
-            VK_BUFFER_USAGE_RAY_TRACING_BIT_NV,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            &instanceBuffer, sizeof(GeometryInstance) * geometryInstances.size(),
-            geometryInstances.data()));
-
-        // Acceleration structure build requires some scratch space to store
-        // temporary information
-        VkAccelerationStructureMemoryRequirementsInfoNV memoryRequirementsInfo {};
-        memoryRequirementsInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_MEMORY_REQUIREMENTS_INFO_NV;
-        memoryRequirementsInfo.type = VK_ACCELERATION_STRUCTURE_MEMORY_REQUIREMENTS_TYPE_OBJECT_NV;
-
-        VkMemoryRequirements2 memReqTopLevelAS;
-        memoryRequirementsInfo.accelerationStructure = topLevelAS.accelerationStructure;
-        vkGetAccelerationStructureMemoryRequirementsNV(
-            vkDevice->logicalDevice, &memoryRequirementsInfo, &memReqTopLevelAS);
-
-        const VkDeviceSize scratchBufferSize = memReqTopLevelAS.memoryRequirements.size;
-
-        Vk::Buffer scratchBuffer;
-        VK_CHECK_RESULT(vkDevice->CreateBuffer(VK_BUFFER_USAGE_RAY_TRACING_BIT_NV,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-            &scratchBuffer, scratchBufferSize));
-
-        VkCommandBuffer cmdBuffer = vkDevice->CreateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-        VkAccelerationStructureInfoNV buildInfo {};
-        buildInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_INFO_NV;
-        buildInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_NV;
-        buildInfo.pGeometries = 0;
-        buildInfo.geometryCount = 0;
-        buildInfo.instanceCount = static_cast<uint32_t>(blasData.size());
-
-        vkCmdBuildAccelerationStructureNV(cmdBuffer, &buildInfo,
-            instanceBuffer.buffer, 0, VK_FALSE,
-            topLevelAS.accelerationStructure,
-            VK_NULL_HANDLE, scratchBuffer.buffer, 0);
-
-        VkMemoryBarrier memoryBarrier = Vk::Initializers::CreateMemoryBarrier();
-        memoryBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_NV | VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_NV;
-        memoryBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_NV | VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_NV;
-        vkCmdPipelineBarrier(cmdBuffer,
-            VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_NV,
-            VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_NV,
-            0, 1, &memoryBarrier, 0, 0, 0, 0);
-
-        vkDevice->FlushCommandBuffer(cmdBuffer, queue);
+    sceneData.accelerationStructures->BuildTopLevel(
+        sceneData.instanceBuffers[0].buffer, static_cast<uint32_t>(blasInstances.size()), allowUpdate);
 
-        instanceBuffer.Destroy();
+    if (benchmarkTopLevel) {
+        constexpr uint32_t kBenchmarkIterationsCount = 100;
+        sceneData.accelerationStructures->BenchmarkTopLevel(sceneData.instanceBuffers[0].buffer, kBenchmarkIterationsCount);
     }
 }
 
-void CG::EngineImpl::LoadNVRayTracingProcs()
+void CG::EngineImpl::UpdateSceneAnimation(float deltaTime)
 {
-    VkDevice device = vkDevice->logicalDevice;
+    if (!scene || !uiData.playAnimation || scene->model->GetAnimations().empty()) {
+        return;
+    }
+
+    const Vk::GLTFModel::Animation& animation = scene->model->GetAnimations().front();
+    const float duration = animation.end - animation.start;
+    scene->animationTime = duration > 0.0f ? std::fmod(scene->animationTime + deltaTime, duration) : 0.0f;
+
+    if (!scene->model->UpdateAnimation(0, animation.start + scene->animationTime)) {
+        return;
+    }
+
+    // Primitives of a node are consecutive instances, so its world matrix is computed once
+    Vk::GLTFModel::Node* node = nullptr;
+    glm::mat4 transform = glm::mat4(1.0f);
+    for (size_t i = 0; i < scene->blasInstances.size(); ++i) {
+        BLASInstance& blasInstance = scene->blasInstances[i];
+        if (blasInstance.node != node) {
+            node = blasInstance.node;
+            transform = scene->modelMatrix * node->GetWorldMatrix();
+        }
+
+        if (blasInstance.transform != transform) {
+            blasInstance.transform = transform;
+            scene->topLevelChanged = true;
+        }
+    }
+
+    if (scene->topLevelChanged) {
+        // Buffer of this frame was last written kMaxFramesInFlight frames ago, so every transform is rewritten
+        GeometryInstance* geometryInstances = static_cast<GeometryInstance*>(scene->instanceBuffers[currentFrame].mapped);
+        for (size_t i = 0; i < scene->blasInstances.size(); ++i) {
+            geometryInstances[i].transform = glm::transpose(scene->blasInstances[i].transform);
+        }
 
-    // Get VK_NV_ray_tracing related function pointers
-    vkCreateAccelerationStructureNV = reinterpret_cast<PFN_vkCreateAccelerationStructureNV>(
-        vkGetDeviceProcAddr(device, "vkCreateAccelerationStructureNV"));
-    vkDestroyAccelerationStructureNV = reinterpret_cast<PFN_vkDestroyAccelerationStructureNV>(
-        vkGetDeviceProcAddr(device, "vkDestroyAccelerationStructureNV"));
-    vkBindAccelerationStructureMemoryNV = reinterpret_cast<PFN_vkBindAccelerationStructureMemoryNV>(
-        vkGetDeviceProcAddr(device, "vkBindAccelerationStructureMemoryNV"));
-    vkGetAccelerationStructureHandleNV = reinterpret_cast<PFN_vkGetAccelerationStructureHandleNV>(
-        vkGetDeviceProcAddr(device, "vkGetAccelerationStructureHandleNV"));
-    vkGetAccelerationStructureMemoryRequirementsNV = reinterpret_cast<PFN_vkGetAccelerationStructureMemoryRequirementsNV>(
-        vkGetDeviceProcAddr(
-            device, "vkGetAccelerationStructureMemoryRequirementsNV"));
-    vkCmdBuildAccelerationStructureNV = reinterpret_cast<PFN_vkCmdBuildAccelerationStructureNV>(
-        vkGetDeviceProcAddr(device, "vkCmdBuildAccelerationStructureNV"));
-    vkCreateRayTracingPipelinesNV = reinterpret_cast<PFN_vkCreateRayTracingPipelinesNV>(
-        vkGetDeviceProcAddr(device, "vkCreateRayTracingPipelinesNV"));
-    vkGetRayTracingShaderGroupHandlesNV = reinterpret_cast<PFN_vkGetRayTracingShaderGroupHandlesNV>(
-        vkGetDeviceProcAddr(device, "vkGetRayTracingShaderGroupHandlesNV"));
-    vkCmdTraceRaysNV = reinterpret_cast<PFN_vkCmdTraceRaysNV>(
-        vkGetDeviceProcAddr(device, "vkCmdTraceRaysNV"));
+        cameraComponent->ResetSamples();
+    }
 }
 
-void CG::EngineImpl::CreateNVRayTracingGeometry()
+void CG::EngineImpl::CreateRayTracingGeometry(SceneData& sceneData)
 {
-    assert(testScene);
+    Vk::GLTFModel& model = *sceneData.model;
+    std::vector<BLASInstance>& blasInstances = sceneData.blasInstances;
+
+    sceneData.accelerationStructures = std::make_unique<Vk::AccelerationStructureManager>(vkDevice, rayTracing.get(), loadingQueue);
+    Vk::AccelerationStructureManager& accelerationStructures = *sceneData.accelerationStructures;
+    accelerationStructures.progressCallback = [this](float progress) { sceneLoader.progress = progress; };
 
-    blasData.resize(testScene->GetPrimitivesCount());
-    std::vector<VkGeometryNV> geometries(testScene->GetPrimitivesCount());
+    const std::vector<Vk::GLTFModel::GeometryBuffer>& geometryBuffers = model.GetGeometryBuffers();
+    const uint32_t vertexStride = model.GetVertexStride();
+    const bool compactVertices = model.loadingParams.vertexFormat == Vk::GLTFModel::eVertexFormat::kCompact;
+
+    blasInstances.resize(model.GetPrimitivesCount());
+    std::vector<PrimitiveShaderInfo> primitiveInfos(model.GetPrimitivesCount());
     uint32_t currentGeomIndex = 0;
 
-    for (const auto& node : testScene->GetFlatNodes()) {
+    // Repeated meshes and duplicated mesh data point to the same geometry range, see GLTFModel::ReserveGeometry
+    std::map<std::tuple<uint32_t, uint32_t, uint32_t>, uint32_t> rangeBlasIndices;
+
+    for (const auto& node : model.GetFlatNodes()) {
         if (node->mesh) {
             for (const auto& primitive : node->mesh->primitives) {
-                VkGeometryNV& geometry = geometries[currentGeomIndex];
-                geometry.sType = VK_STRUCTURE_TYPE_GEOMETRY_NV;
-                geometry.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_NV;
-                geometry.geometry.triangles.sType = VK_STRUCTURE_TYPE_GEOMETRY_TRIANGLES_NV;
-                geometry.geometry.triangles.vertexData = primitive->vertices.buffer;
-                geometry.geometry.triangles.vertexOffset = 0;
-                geometry.geometry.triangles.vertexCount = primitive->vertexCount;
-                geometry.geometry.triangles.vertexStride = sizeof(Vk::GLTFModel::Vertex);
-                geometry.geometry.triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;
-                geometry.geometry.triangles.indexData = primitive->indices.buffer;
-                geometry.geometry.triangles.indexOffset = 0;
-                geometry.geometry.triangles.indexCount = primitive->indexCount;
-                geometry.geometry.triangles.indexType = VK_INDEX_TYPE_UINT32;
-                geometry.geometry.triangles.transformData = VK_NULL_HANDLE;
-                geometry.geometry.triangles.transformOffset = 0;
-                geometry.geometry.aabbs = {};
-                geometry.geometry.aabbs.sType = VK_STRUCTURE_TYPE_GEOMETRY_AABB_NV;
-                geometry.flags = VK_GEOMETRY_OPAQUE_BIT_NV;
-
-
-                blasData[currentGeomIndex].transform = sceneUboData.model * node->GetWorldMatrix();
-                CreateBottomLevelAccelerationStructure(&geometry, currentGeomIndex, 1);
-
+                const Vk::GLTFModel::GeometryBuffer& geometryBuffer = geometryBuffers[primitive->geometryBufferIndex];
+                const bool index16 = primitive->indexType == VK_INDEX_TYPE_UINT16;
+
+                PrimitiveShaderInfo& primitiveInfo = primitiveInfos[currentGeomIndex];
+                primitiveInfo.firstIndex = primitive->firstIndex;
+                primitiveInfo.firstVertex = primitive->firstVertex;
+                primitiveInfo.geometryBufferIndex = primitive->geometryBufferIndex;
+                primitiveInfo.flags = compactVertices ? PrimitiveShaderInfo::kFlagCompactVertex : 0;
+                primitiveInfo.flags |= index16 ? PrimitiveShaderInfo::kFlagIndex16 : 0;
+
+                BLASInstance& blasInstance = blasInstances[currentGeomIndex];
+                blasInstance.transform = sceneData.modelMatrix * node->GetWorldMatrix();
+                blasInstance.node = node;
                 ++currentGeomIndex;
+
+                const auto range = std::make_tuple(primitive->geometryBufferIndex, primitive->firstVertex, primitive->firstIndex);
+                const auto rangeBlas = rangeBlasIndices.find(range);
+                if (rangeBlas != rangeBlasIndices.end()) {
+                    blasInstance.blasIndex = rangeBlas->second;
+                    continue;
+                }
+
+                Vk::RayTracingGeometry geometry;
+                geometry.vertexBuffer = geometryBuffer.vertices.buffer;
+                geometry.vertexOffset = static_cast<VkDeviceSize>(primitive->firstVertex) * vertexStride;
+                geometry.vertexCount = primitive->vertexCount;
+                // Both vertex formats start with float3 position
+                geometry.vertexStride = vertexStride;
+                geometry.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;
+                geometry.indexBuffer = geometryBuffer.indices.buffer;
+                geometry.indexOffset = static_cast<VkDeviceSize>(primitive->firstIndex) * (index16 ? sizeof(uint16_t) : sizeof(uint32_t));
+                geometry.indexCount = primitive->indexCount;
+                geometry.indexType = primitive->indexType;
+
+                blasInstance.blasIndex = accelerationStructures.AddBottomLevel(&geometry, 1);
+                rangeBlasIndices.emplace(range, blasInstance.blasIndex);
             }
         }
     }
 
-    CreateTopLevelAccelerationStructure();
+    accelerationStructures.BuildBottomLevels();
+
+    VK_CHECK_RESULT(vkDevice->CreateBuffer(
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        &sceneData.primitiveInfosBuffer, sizeof(PrimitiveShaderInfo) * primitiveInfos.size(),
+        primitiveInfos.data()));
+
+    CreateTopLevelAccelerationStructure(sceneData);
+    accelerationStructures.ReleaseScratch();
 }
 
-void CG::EngineImpl::DestroyNVRayTracingGeometry()
+void CG::EngineImpl::DestroyRayTracingGeometry(SceneData& sceneData)
 {
-    for (const auto& blas : blasData) {
-        vkFreeMemory(vkDevice->logicalDevice, blas.memory, nullptr);
-    }
-
-    vkFreeMemory(vkDevice->logicalDevice, topLevelAS.memory, nullptr);
+    sceneData.accelerationStructures = nullptr;
 
-    for (const auto& blas : blasData) {
-        vkDestroyAccelerationStructureNV(vkDevice->logicalDevice,
-            blas.accelerationStructure, nullptr);
+    for (Vk::Buffer& instanceBuffer : sceneData.instanceBuffers) {
+        instanceBuffer.Unmap();
+        instanceBuffer.Destroy();
     }
+    sceneData.blasInstances.clear();
 
-    vkDestroyAccelerationStructureNV(vkDevice->logicalDevice,
-        topLevelAS.accelerationStructure, nullptr);
+    sceneData.primitiveInfosBuffer.Destroy();
 }
 
-void CG::EngineImpl::CreateNVRayTracingStoreImage()
+void CG::EngineImpl::CreateRayTracingStoreImage()
 {
     VkImageCreateInfo image = Vk::Initializers::ImageCreateInfo();
     image.imageType = VK_IMAGE_TYPE_2D;
-    image.format = vkSwapChain->colorFormat;
+    image.format = GetColorFormat();
     image.extent.width = engineConfig.width;
     image.extent.height = engineConfig.height;
     image.extent.depth = 1;
@@ -896,7 +1232,7 @@ void CG::EngineImpl::CreateNVRayTracingStoreImage()
 
     VkImageViewCreateInfo colorImageView = Vk::Initializers::ImageViewCreateInfo();
     colorImageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    colorImageView.format = vkSwapChain->colorFormat;
+    colorImageView.format = GetColorFormat();
     colorImageView.subresourceRange = {};
     colorImageView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     colorImageView.subresourceRange.baseMipLevel = 0;
@@ -914,18 +1250,18 @@ void CG::EngineImpl::CreateNVRayTracingStoreImage()
     vkDevice->FlushCommandBuffer(cmdBuffer, queue);
 }
 
-void CG::EngineImpl::DestroyNVRayTracingStoreImage()
+void CG::EngineImpl::DestroyRayTracingStoreImage()
 {
     vkDestroyImageView(vkDevice->logicalDevice, storageImage.view, nullptr);
     vkDestroyImage(vkDevice->logicalDevice, storageImage.image, nullptr);
     vkFreeMemory(vkDevice->logicalDevice, storageImage.memory, nullptr);
 }
 
-void CG::EngineImpl::CreateNVRayTracingAccumulationImage()
+void CG::EngineImpl::CreateRayTracingAccumulationImage()
 {
     VkImageCreateInfo image = Vk::Initializers::ImageCreateInfo();
     image.imageType = VK_IMAGE_TYPE_2D;
-    image.format = vkSwapChain->colorFormat;
+    image.format = GetColorFormat();
     image.extent.width = engineConfig.width;
     image.extent.height = engineConfig.height;
     image.extent.depth = 1;
@@ -952,7 +1288,7 @@ void CG::EngineImpl::CreateNVRayTracingAccumulationImage()
 
     VkImageViewCreateInfo colorImageView = Vk::Initializers::ImageViewCreateInfo();
     colorImageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    colorImageView.format = vkSwapChain->colorFormat;
+    colorImageView.format = GetColorFormat();
     colorImageView.subresourceRange = {};
     colorImageView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     colorImageView.subresourceRange.baseMipLevel = 0;
@@ -970,51 +1306,18 @@ void CG::EngineImpl::CreateNVRayTracingAccumulationImage()
     vkDevice->FlushCommandBuffer(cmdBuffer, queue);
 }
 
-void CG::EngineImpl::DestroyNVRayTracingAccumulationImage()
+void CG::EngineImpl::DestroyRayTracingAccumulationImage()
 {
     vkDestroyImageView(vkDevice->logicalDevice, accumulationImage.view, nullptr);
     vkDestroyImage(vkDevice->logicalDevice, accumulationImage.image, nullptr);
     vkFreeMemory(vkDevice->logicalDevice, accumulationImage.memory, nullptr);
 }
 
-void CG::EngineImpl::CreateShaderBindingTable(Vk::Buffer& shaderBindingTable, VkPipeline pipeline)
-{
-    const uint32_t sbtSize = rayTracingProperties.shaderGroupHandleSize * 3;
-    VK_CHECK_RESULT(vkDevice->CreateBuffer(VK_BUFFER_USAGE_RAY_TRACING_BIT_NV,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-        &shaderBindingTable, sbtSize));
-    shaderBindingTable.Map();
-
-    auto shaderHandleStorage = new uint8_t[sbtSize];
-    // Get shader identifiers
-    VK_CHECK_RESULT(vkGetRayTracingShaderGroupHandlesNV(
-        vkDevice->logicalDevice, pipeline, 0, 3, sbtSize,
-        shaderHandleStorage));
-    auto* data = static_cast<uint8_t*>(shaderBindingTable.mapped);
-
-    // Copy the shader identifiers to the shader binding table
-    data += CopyShaderIdentifier(data, shaderHandleStorage, kIndexRaygen);
-    data += CopyShaderIdentifier(data, shaderHandleStorage, kIndexMiss);
-    data += CopyShaderIdentifier(data, shaderHandleStorage, kIndexClosestHit);
-    shaderBindingTable.Unmap();
-}
-
-VkDeviceSize CG::EngineImpl::CopyShaderIdentifier(
-    uint8_t* data,
-    const uint8_t* shaderHandleStorage,
-    uint32_t groupIndex)
-{
-    const uint32_t shaderGroupHandleSize = rayTracingProperties.shaderGroupHandleSize;
-    memcpy(data, shaderHandleStorage + groupIndex * shaderGroupHandleSize,
-        shaderGroupHandleSize);
-    return shaderGroupHandleSize;
-}
-
-void CG::EngineImpl::CreateRTXPipeline()
+void CG::EngineImpl::CreateRTXPipeline(SceneData& sceneData)
 {
     const std::vector<VkDescriptorSetLayout> setLayouts = {
-        descriptorSetLayouts.rtxRaygenLayout.layout,
-        descriptorSetLayouts.rtxRayhitLayout.layout,
+        sceneData.rtxRaygenLayout.layout,
+        sceneData.rtxRayhitLayout.layout,
         descriptorSetLayouts.rtxRaymissLayout.layout,
     };
 
@@ -1022,96 +1325,57 @@ void CG::EngineImpl::CreateRTXPipeline()
 
     VK_CHECK_RESULT(vkCreatePipelineLayout(vkDevice->logicalDevice,
         &pipelineLayoutCreateInfo, nullptr,
-        &pipelineLayouts.rtxPipelineLayout));
-
-    const uint32_t shaderIndexRaygen = 0;
-    const uint32_t shaderIndexMiss = 1;
-    const uint32_t shaderIndexClosestHit = 2;
-
-    std::array<VkPipelineShaderStageCreateInfo, 3> rtxShaderStages;
-    rtxShaderStages[shaderIndexRaygen] = LoadShader(GetAssetPath() + "shaders/compiled/raygen.rgen.spv",
-        VK_SHADER_STAGE_RAYGEN_BIT_NV);
-    rtxShaderStages[shaderIndexMiss] = LoadShader(GetAssetPath() + "shaders/compiled/miss.rmiss.spv",
-        VK_SHADER_STAGE_MISS_BIT_NV);
-    rtxShaderStages[shaderIndexClosestHit] = LoadShader(GetAssetPath() + "shaders/compiled/closesthit.rchit.spv",
-        VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV);
-
-    std::array<VkRayTracingShaderGroupCreateInfoNV, 3> groups {};
-    for (auto& group : groups) {
-        // Init all groups with some default values
-        group.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_NV;
-        group.generalShader = VK_SHADER_UNUSED_NV;
-        group.closestHitShader = VK_SHADER_UNUSED_NV;
-        group.anyHitShader = VK_SHADER_UNUSED_NV;
-        group.intersectionShader = VK_SHADER_UNUSED_NV;
-    }
-
-    // Links shaders and types to ray tracing shader groups
-    groups[kIndexRaygen].type = VK_RAY_TRACING_SHADER_GROUP_TYPE_GENERAL_NV;
-    groups[kIndexRaygen].generalShader = shaderIndexRaygen;
-    groups[kIndexMiss].type = VK_RAY_TRACING_SHADER_GROUP_TYPE_GENERAL_NV;
-    groups[kIndexMiss].generalShader = shaderIndexMiss;
-    groups[kIndexClosestHit].type = VK_RAY_TRACING_SHADER_GROUP_TYPE_TRIANGLES_HIT_GROUP_NV;
-    groups[kIndexClosestHit].generalShader = VK_SHADER_UNUSED_NV;
-    groups[kIndexClosestHit].closestHitShader = shaderIndexClosestHit;
-
-
-    VkRayTracingPipelineCreateInfoNV rayPipelineInfo {};
-    rayPipelineInfo.sType = VK_STRUCTURE_TYPE_RAY_TRACING_PIPELINE_CREATE_INFO_NV;
-    rayPipelineInfo.stageCount = static_cast<uint32_t>(rtxShaderStages.size());
-    rayPipelineInfo.pStages = rtxShaderStages.data();
-    rayPipelineInfo.groupCount = static_cast<uint32_t>(groups.size());
-    rayPipelineInfo.pGroups = groups.data();
-    rayPipelineInfo.maxRecursionDepth = kMaxRecursionDepth;
-    rayPipelineInfo.layout = pipelineLayouts.rtxPipelineLayout;
-
-    VK_CHECK_RESULT(
-        vkCreateRayTracingPipelinesNV(vkDevice->logicalDevice, VK_NULL_HANDLE, 1,
-            &rayPipelineInfo, nullptr, &pipelines.RTX));
-
-    std::array<VkPipelineShaderStageCreateInfo, 3> previewShaderStages;
-    previewShaderStages[shaderIndexRaygen] = LoadShader(GetAssetPath() + "shaders/compiled/raygenPreview.rgen.spv",
-        VK_SHADER_STAGE_RAYGEN_BIT_NV);
-    previewShaderStages[shaderIndexMiss] = LoadShader(GetAssetPath() + "shaders/compiled/missPreview.rmiss.spv",
-        VK_SHADER_STAGE_MISS_BIT_NV);
-    previewShaderStages[shaderIndexClosestHit] = LoadShader(GetAssetPath() + "shaders/compiled/closesthitPreview.rchit.spv",
-        VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV);
-
-    rayPipelineInfo.stageCount = static_cast<uint32_t>(previewShaderStages.size());
-    rayPipelineInfo.pStages = previewShaderStages.data();
-
-    VK_CHECK_RESULT(
-        vkCreateRayTracingPipelinesNV(vkDevice->logicalDevice, VK_NULL_HANDLE, 1,
-            &rayPipelineInfo, nullptr, &pipelines.previewRTX));
-
-    std::array<VkPipelineShaderStageCreateInfo, 3> pbrShaderStages;
-    pbrShaderStages[shaderIndexRaygen] = LoadShader(GetAssetPath() + "shaders/compiled/raygenPBR.rgen.spv",
-        VK_SHADER_STAGE_RAYGEN_BIT_NV);
-    pbrShaderStages[shaderIndexMiss] = LoadShader(GetAssetPath() + "shaders/compiled/missPBR.rmiss.spv",
-        VK_SHADER_STAGE_MISS_BIT_NV);
-    pbrShaderStages[shaderIndexClosestHit] = LoadShader(GetAssetPath() + "shaders/compiled/closesthitPBR.rchit.spv",
-        VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV);
-
-    rayPipelineInfo.stageCount = static_cast<uint32_t>(pbrShaderStages.size());
-    rayPipelineInfo.pStages = pbrShaderStages.data();
-
-    VK_CHECK_RESULT(
-        vkCreateRayTracingPipelinesNV(vkDevice->logicalDevice, VK_NULL_HANDLE, 1,
-            &rayPipelineInfo, nullptr, &pipelines.RTX_PBR));
+        &sceneData.rtxPipelineLayout));
+
+    const auto loadStages = [this](const std::string& raygen, const std::string& miss, const std::string& closestHit) {
+        const std::string shadersPath = GetAssetPath() + "shaders/compiled/";
+
+        // Stages in the order of shader binding table records
+        std::array<VkPipelineShaderStageCreateInfo, 3> stages;
+        stages[kIndexRaygen] = LoadShader(rayTracing->GetShaderPath(shadersPath + raygen), VK_SHADER_STAGE_RAYGEN_BIT_KHR);
+        stages[kIndexMiss] = LoadShader(rayTracing->GetShaderPath(shadersPath + miss), VK_SHADER_STAGE_MISS_BIT_KHR);
+        stages[kIndexClosestHit] = LoadShader(rayTracing->GetShaderPath(shadersPath + closestHit), VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR);
+        return stages;
+    };
+
+    const std::array<VkPipelineShaderStageCreateInfo, 3> rtxShaderStages
+        = loadStages("raygen.rgen", "miss.rmiss", "closesthit.rchit");
+    const std::array<VkPipelineShaderStageCreateInfo, 3> previewShaderStages
+        = loadStages("raygenPreview.rgen", "missPreview.rmiss", "closesthitPreview.rchit");
+    const std::array<VkPipelineShaderStageCreateInfo, 3> pbrShaderStages
+        = loadStages("raygenPBR.rgen", "missPBR.rmiss", "closesthitPBR.rchit");
+
+    std::array<Vk::RayTracingPipelineInfo, 3> pipelineInfos;
+    pipelineInfos[0].stages = rtxShaderStages.data();
+    pipelineInfos[1].stages = previewShaderStages.data();
+    pipelineInfos[2].stages = pbrShaderStages.data();
+    for (Vk::RayTracingPipelineInfo& pipelineInfo : pipelineInfos) {
+        pipelineInfo.stageCount = 3;
+        pipelineInfo.layout = sceneData.rtxPipelineLayout;
+        pipelineInfo.maxRecursionDepth = std::min(kMaxRecursionDepth, rayTracing->GetMaxRecursionDepth());
+    }
+
+    // All pipelines are compiled at once, so the KHR backend spreads them over the thread pool
+    std::array<VkPipeline, 3> pipelines;
+    rayTracing->CreatePipelines(pipelineInfos.data(), static_cast<uint32_t>(pipelineInfos.size()), pipelines.data());
+
+    sceneData.pipelines.RTX = pipelines[0];
+    sceneData.pipelines.previewRTX = pipelines[1];
+    sceneData.pipelines.RTX_PBR = pipelines[2];
 }
 
-void CG::EngineImpl::DestroyRTXPipeline()
+void CG::EngineImpl::DestroyRTXPipeline(SceneData& sceneData)
 {
-    vkDestroyPipeline(vkDevice->logicalDevice, pipelines.previewRTX, nullptr);
-    vkDestroyPipeline(vkDevice->logicalDevice, pipelines.RTX_PBR, nullptr);
-    vkDestroyPipeline(vkDevice->logicalDevice, pipelines.RTX, nullptr);
+    vkDestroyPipeline(vkDevice->logicalDevice, sceneData.pipelines.previewRTX, nullptr);
+    vkDestroyPipeline(vkDevice->logicalDevice, sceneData.pipelines.RTX_PBR, nullptr);
+    vkDestroyPipeline(vkDevice->logicalDevice, sceneData.pipelines.RTX, nullptr);
     vkDestroyPipelineLayout(vkDevice->logicalDevice,
-        pipelineLayouts.rtxPipelineLayout, nullptr);
+        sceneData.rtxPipelineLayout, nullptr);
     vkDestroyDescriptorSetLayout(vkDevice->logicalDevice,
-        descriptorSetLayouts.rtxRaygenLayout.layout,
+        sceneData.rtxRaygenLayout.layout,
         nullptr);
     vkDestroyDescriptorSetLayout(vkDevice->logicalDevice,
-        descriptorSetLayouts.rtxRayhitLayout.layout,
+        sceneData.rtxRayhitLayout.layout,
         nullptr);
     // vkDestroyDescriptorSetLayout(vkDevice->logicalDevice,
     // descriptorSetLayouts.rtxRaymissLayout.layout, nullptr);
@@ -1121,18 +1385,40 @@ void CG::EngineImpl::CreateRTXPipelineLayout() { }
 
 void CG::EngineImpl::DestroyRTXPipelineLayout() { }
 
-void CG::EngineImpl::SetupRTXModelDescriptorSets()
+void CG::EngineImpl::SetupRTXModelDescriptorSets(SceneData& sceneData)
 {
+    Vk::GLTFModel& model = *sceneData.model;
+    const uint32_t primCount = static_cast<uint32_t>(model.GetPrimitivesCount());
+    // A model without geometry still gets one element in the buffer arrays, see emptyGeometryBuffer
+    const uint32_t geometryBuffersCount = std::max(static_cast<uint32_t>(model.GetGeometryBuffers().size()), 1u);
+
+    {
+        constexpr uint32_t kMaterialTexturesCount = 5;
+
+        // Raygen set per frame in flight and a single hit set
+        const std::vector<VkDescriptorPoolSize> poolSizes = {
+            { rayTracing->GetAccelerationStructureDescriptorType(), kMaxFramesInFlight },
+            { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2 * kMaxFramesInFlight },
+            { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2 * kMaxFramesInFlight + primCount },
+            { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 * geometryBuffersCount + 1 },
+            { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, std::max(kMaterialTexturesCount * primCount, 1u) },
+        };
+
+        VkDescriptorPoolCreateInfo descriptorPoolCI = Vk::Initializers::DescriptorPoolCreateInfo(poolSizes, kMaxFramesInFlight + 1);
+        VK_CHECK_RESULT(vkCreateDescriptorPool(
+            vkDevice->logicalDevice, &descriptorPoolCI, nullptr, &sceneData.descriptorPool));
+    }
+
     {
         std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings({
-            { 0, VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_NV, 1,
-                VK_SHADER_STAGE_RAYGEN_BIT_NV | VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV},
-            { 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_RAYGEN_BIT_NV },
+            { 0, rayTracing->GetAccelerationStructureDescriptorType(), 1,
+                VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR},
+            { 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_RAYGEN_BIT_KHR },
             { 2, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1,
-                VK_SHADER_STAGE_RAYGEN_BIT_NV | VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV },
-            { 3, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_RAYGEN_BIT_NV },
+                VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR },
+            { 3, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_RAYGEN_BIT_KHR },
             { 4, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1,
-                VK_SHADER_STAGE_RAYGEN_BIT_NV | VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV },
+                VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR },
         });
 
 
@@ -1142,81 +1428,60 @@ void CG::EngineImpl::SetupRTXModelDescriptorSets()
         layoutInfo.pBindings = setLayoutBindings.data();
         VK_CHECK_RESULT(vkCreateDescriptorSetLayout(
             vkDevice->logicalDevice, &layoutInfo, nullptr,
-            &descriptorSetLayouts.rtxRaygenLayout.layout));
+            &sceneData.rtxRaygenLayout.layout));
 
+        std::array<VkDescriptorSetLayout, kMaxFramesInFlight> setLayouts;
+        setLayouts.fill(sceneData.rtxRaygenLayout.layout);
         VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = Vk::Initializers::DescriptorSetAllocateInfo(
-            descriptorPool, &descriptorSetLayouts.rtxRaygenLayout.layout, 1);
+            sceneData.descriptorPool, setLayouts.data(), kMaxFramesInFlight);
         VK_CHECK_RESULT(vkAllocateDescriptorSets(vkDevice->logicalDevice,
             &descriptorSetAllocateInfo,
-            &descriptorSets.rtxRaygen));
-
-        descriptorSetLayouts.rtxRaygenLayout.created = true;
-
-        VkWriteDescriptorSetAccelerationStructureNV
-            descriptorAccelerationStructureInfo {};
-        descriptorAccelerationStructureInfo.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_NV;
-        descriptorAccelerationStructureInfo.accelerationStructureCount = 1;
-        descriptorAccelerationStructureInfo.pAccelerationStructures = &topLevelAS.accelerationStructure;
-
-        VkWriteDescriptorSet accelerationStructureWrite {};
-        accelerationStructureWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        // The specialized acceleration structure descriptor has to be chained
-        accelerationStructureWrite.pNext = &descriptorAccelerationStructureInfo;
-        accelerationStructureWrite.dstSet = descriptorSets.rtxRaygen;
-        accelerationStructureWrite.dstBinding = 0;
-        accelerationStructureWrite.descriptorCount = 1;
-        accelerationStructureWrite.descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_NV;
-
-        VkDescriptorImageInfo storageImageDescriptor {};
-        storageImageDescriptor.imageView = storageImage.view;
-        storageImageDescriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-
-        VkDescriptorImageInfo accumulationImageDescriptor {};
-        accumulationImageDescriptor.imageView = accumulationImage.view;
-        accumulationImageDescriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-
-        std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
-            accelerationStructureWrite,
-            Vk::Initializers::WriteDescriptorSet(descriptorSets.rtxRaygen,
-                VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
-                1, &storageImageDescriptor),
-            Vk::Initializers::WriteDescriptorSet(descriptorSets.rtxRaygen,
-                VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                2, &sceneUbo.descriptor),
-            Vk::Initializers::WriteDescriptorSet(descriptorSets.rtxRaygen,
-                VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
-                3, &accumulationImageDescriptor),
-            Vk::Initializers::WriteDescriptorSet(descriptorSets.rtxRaygen,
-                VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                4, &cameraUbo.descriptor),
-        };
-        vkUpdateDescriptorSets(vkDevice->logicalDevice,
-            static_cast<uint32_t>(writeDescriptorSets.size()),
-            writeDescriptorSets.data(), 0, VK_NULL_HANDLE);
+            sceneData.rtxRaygen.data()));
+
+        sceneData.rtxRaygenLayout.created = true;
+
+        for (uint32_t i = 0; i < kMaxFramesInFlight; ++i) {
+            rayTracing->WriteAccelerationStructureDescriptor(sceneData.rtxRaygen[i], 0, sceneData.accelerationStructures->GetTopLevel());
+
+            // Images of bindings 1 and 3 are written by UpdateRTXStorageImageDescriptors
+            std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+                Vk::Initializers::WriteDescriptorSet(sceneData.rtxRaygen[i],
+                    VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                    2, &sceneUbos[i].descriptor),
+                Vk::Initializers::WriteDescriptorSet(sceneData.rtxRaygen[i],
+                    VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                    4, &cameraUbos[i].descriptor),
+            };
+            vkUpdateDescriptorSets(vkDevice->logicalDevice,
+                static_cast<uint32_t>(writeDescriptorSets.size()),
+                writeDescriptorSets.data(), 0, VK_NULL_HANDLE);
+        }
     }
 
     {
-        uint32_t primCount = static_cast<uint32_t>(testScene->GetPrimitivesCount());
+        const std::vector<Vk::GLTFModel::GeometryBuffer>& geometryBuffers = model.GetGeometryBuffers();
 
         std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
-            { 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, primCount,
-                VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV, nullptr }, // vertexBuffers[]
-            { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, primCount,
-                VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV, nullptr }, // indexBuffers[]
+            { 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, geometryBuffersCount,
+                VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, nullptr }, // vertexBuffers[]
+            { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, geometryBuffersCount,
+                VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, nullptr }, // indexBuffers[]
             { 2, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, primCount,
-                VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV, nullptr }, // materials[]
+                VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, nullptr }, // materials[]
             { 3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, primCount,
-                VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV, nullptr }, // baseColorTextures[]
+                VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, nullptr }, // baseColorTextures[]
             { 4, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, primCount,
-                VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV,
+                VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR,
                 nullptr }, // physicalDescriptorTextures[]
             { 5, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, primCount,
-                VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV, nullptr }, // normalTextures[]
+                VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, nullptr }, // normalTextures[]
             { 6, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, primCount,
-                VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV,
+                VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR,
                 nullptr }, // ambientOcclusionTextures[]
             { 7, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, primCount,
-                VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV, nullptr }, // emissiveTextures[]
+                VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, nullptr }, // emissiveTextures[]
+            { 8, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
+                VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, nullptr }, // primitiveInfos
         };
         VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI {};
         descriptorSetLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -1224,15 +1489,15 @@ void CG::EngineImpl::SetupRTXModelDescriptorSets()
         descriptorSetLayoutCI.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
         VK_CHECK_RESULT(vkCreateDescriptorSetLayout(
             vkDevice->logicalDevice, &descriptorSetLayoutCI, nullptr,
-            &descriptorSetLayouts.rtxRayhitLayout.layout));
+            &sceneData.rtxRayhitLayout.layout));
 
         VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = Vk::Initializers::DescriptorSetAllocateInfo(
-            descriptorPool, &descriptorSetLayouts.rtxRayhitLayout.layout, 1);
+            sceneData.descriptorPool, &sceneData.rtxRayhitLayout.layout, 1);
         VK_CHECK_RESULT(vkAllocateDescriptorSets(vkDevice->logicalDevice,
             &descriptorSetAllocateInfo,
-            &descriptorSets.rtxRayhit));
+            &sceneData.rtxRayhit));
 
-        descriptorSetLayouts.rtxRayhitLayout.created = true;
+        sceneData.rtxRayhitLayout.created = true;
 
         std::vector<VkDescriptorBufferInfo> dbiVert;
         std::vector<VkDescriptorBufferInfo> dbiIdx;
@@ -1243,11 +1508,28 @@ void CG::EngineImpl::SetupRTXModelDescriptorSets()
         std::vector<VkDescriptorImageInfo> diiOcclusion;
         std::vector<VkDescriptorImageInfo> diiEmissive;
 
-        for (const auto& node : testScene->GetFlatNodes()) {
+        VK_CHECK_RESULT(vkDevice->CreateBuffer(
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            &sceneData.emptyGeometryBuffer, sizeof(uint32_t)));
+
+        // Ranges without vertices or indices have no buffers, nothing hits them so the dummy is never read
+        for (const auto& geometryBuffer : geometryBuffers) {
+            dbiVert.push_back(geometryBuffer.vertices.buffer != VK_NULL_HANDLE
+                    ? geometryBuffer.vertices.descriptor
+                    : sceneData.emptyGeometryBuffer.descriptor);
+            dbiIdx.push_back(geometryBuffer.indices.buffer != VK_NULL_HANDLE
+                    ? geometryBuffer.indices.descriptor
+                    : sceneData.emptyGeometryBuffer.descriptor);
+        }
+        if (geometryBuffers.empty()) {
+            dbiVert.push_back(sceneData.emptyGeometryBuffer.descriptor);
+            dbiIdx.push_back(sceneData.emptyGeometryBuffer.descriptor);
+        }
+
+        for (const auto& node : model.GetFlatNodes()) {
             if (node->mesh) {
                 for (const auto& primitive : node->mesh->primitives) {
-                    dbiVert.push_back(primitive->vertices.descriptor);
-                    dbiIdx.push_back(primitive->indices.descriptor);
                     dbiMaterial.push_back(primitive->material.materialParams.descriptor);
                     diiBaseCol.push_back(
                         primitive->material.baseColorTexture
@@ -1276,129 +1558,203 @@ void CG::EngineImpl::SetupRTXModelDescriptorSets()
 
         std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
             Vk::Initializers::WriteDescriptorSet(
-                descriptorSets.rtxRayhit, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0,
+                sceneData.rtxRayhit, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0,
                 dbiVert.data(), static_cast<uint32_t>(dbiVert.size())),
             Vk::Initializers::WriteDescriptorSet(
-                descriptorSets.rtxRayhit, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
+                sceneData.rtxRayhit, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
                 dbiIdx.data(), static_cast<uint32_t>(dbiIdx.size())),
             Vk::Initializers::WriteDescriptorSet(
-                descriptorSets.rtxRayhit, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2,
+                sceneData.rtxRayhit, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2,
                 dbiMaterial.data(), static_cast<uint32_t>(dbiMaterial.size())),
             Vk::Initializers::WriteDescriptorSet(
-                descriptorSets.rtxRayhit, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                sceneData.rtxRayhit, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
                 3, diiBaseCol.data(), static_cast<uint32_t>(diiBaseCol.size())),
             Vk::Initializers::WriteDescriptorSet(
-                descriptorSets.rtxRayhit, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                sceneData.rtxRayhit, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
                 4, diiPhysicalDescr.data(),
                 static_cast<uint32_t>(diiPhysicalDescr.size())),
             Vk::Initializers::WriteDescriptorSet(
-                descriptorSets.rtxRayhit, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                sceneData.rtxRayhit, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
                 5, diiNormal.data(), static_cast<uint32_t>(diiNormal.size())),
             Vk::Initializers::WriteDescriptorSet(
-                descriptorSets.rtxRayhit, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                sceneData.rtxRayhit, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
                 6, diiOcclusion.data(), static_cast<uint32_t>(diiOcclusion.size())),
             Vk::Initializers::WriteDescriptorSet(
-                descriptorSets.rtxRayhit, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                sceneData.rtxRayhit, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
                 7, diiEmissive.data(), static_cast<uint32_t>(diiEmissive.size())),
+            Vk::Initializers::WriteDescriptorSet(
+                sceneData.rtxRayhit, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 8,
+                &sceneData.primitiveInfosBuffer.descriptor),
         };
+        // Material arrays of a model without primitives are empty, writes of zero descriptors aren't allowed
+        writeDescriptorSets.erase(std::remove_if(writeDescriptorSets.begin(), writeDescriptorSets.end(),
+                                      [](const VkWriteDescriptorSet& write) { return write.descriptorCount == 0; }),
+            writeDescriptorSets.end());
         vkUpdateDescriptorSets(vkDevice->logicalDevice,
             static_cast<uint32_t>(writeDescriptorSets.size()),
             writeDescriptorSets.data(), 0, VK_NULL_HANDLE);
     }
 }
 
+void CG::EngineImpl::UpdateRTXStorageImageDescriptors(SceneData& sceneData)
+{
+    VkDescriptorImageInfo storageImageDescriptor {};
+    storageImageDescriptor.imageView = storageImage.view;
+    storageImageDescriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+    VkDescriptorImageInfo accumulationImageDescriptor {};
+    accumulationImageDescriptor.imageView = accumulationImage.view;
+    accumulationImageDescriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+    // Frames in flight share the images
+    std::vector<VkWriteDescriptorSet> writeDescriptorSets;
+    for (VkDescriptorSet descriptorSet : sceneData.rtxRaygen) {
+        writeDescriptorSets.push_back(Vk::Initializers::WriteDescriptorSet(descriptorSet,
+            VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            1, &storageImageDescriptor));
+        writeDescriptorSets.push_back(Vk::Initializers::WriteDescriptorSet(descriptorSet,
+            VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            3, &accumulationImageDescriptor));
+    }
+    vkUpdateDescriptorSets(vkDevice->logicalDevice,
+        static_cast<uint32_t>(writeDescriptorSets.size()),
+        writeDescriptorSets.data(), 0, VK_NULL_HANDLE);
+}
+
 void CG::EngineImpl::SetupRTXEnviromentDescriptorSet()
 {
-    std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
-        { 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1,
-            VK_SHADER_STAGE_MISS_BIT_NV | VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV,
-            nullptr }, // equirectangularMap
-    };
-    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI {};
-    descriptorSetLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    descriptorSetLayoutCI.pBindings = setLayoutBindings.data();
-    descriptorSetLayoutCI.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
-    VK_CHECK_RESULT(vkCreateDescriptorSetLayout(
-        vkDevice->logicalDevice, &descriptorSetLayoutCI, nullptr,
-        &descriptorSetLayouts.rtxRaymissLayout.layout));
-
-    VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = Vk::Initializers::DescriptorSetAllocateInfo(
-        descriptorPool, &descriptorSetLayouts.rtxRaymissLayout.layout, 1);
-    VK_CHECK_RESULT(vkAllocateDescriptorSets(vkDevice->logicalDevice,
-        &descriptorSetAllocateInfo,
-        &descriptorSets.rtxRaymiss));
-
-    descriptorSetLayouts.rtxRaymissLayout.created = true;
+    // Skybox can be reloaded, the set is kept and only its bindings are rewritten then
+    if (!descriptorSetLayouts.rtxRaymissLayout.created) {
+        std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+            { 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1,
+                VK_SHADER_STAGE_MISS_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR,
+                nullptr }, // equirectangularMap
+            { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
+                VK_SHADER_STAGE_MISS_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR,
+                nullptr }, // enviromentDistribution
+        };
+        VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCI {};
+        descriptorSetLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        descriptorSetLayoutCI.pBindings = setLayoutBindings.data();
+        descriptorSetLayoutCI.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
+        VK_CHECK_RESULT(vkCreateDescriptorSetLayout(
+            vkDevice->logicalDevice, &descriptorSetLayoutCI, nullptr,
+            &descriptorSetLayouts.rtxRaymissLayout.layout));
+
+        VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = Vk::Initializers::DescriptorSetAllocateInfo(
+            descriptorPool, &descriptorSetLayouts.rtxRaymissLayout.layout, 1);
+        VK_CHECK_RESULT(vkAllocateDescriptorSets(vkDevice->logicalDevice,
+            &descriptorSetAllocateInfo,
+            &descriptorSets.rtxRaymiss));
+
+        descriptorSetLayouts.rtxRaymissLayout.created = true;
+    }
 
     std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
         Vk::Initializers::WriteDescriptorSet(
             descriptorSets.rtxRaymiss, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-            0, &cubemapTexture.descriptor, 1),
+            0, &enviromentMap.texture.descriptor, 1),
+        Vk::Initializers::WriteDescriptorSet(
+            descriptorSets.rtxRaymiss, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            1, &enviromentMap.distribution.descriptor, 1),
     };
     vkUpdateDescriptorSets(vkDevice->logicalDevice,
         static_cast<uint32_t>(writeDescriptorSets.size()),
         writeDescriptorSets.data(), 0, VK_NULL_HANDLE);
 }
 
-void CG::EngineImpl::DrawRayTracingData(uint32_t swapChainImageIndex)
+void CG::EngineImpl::UpdateTopLevel(VkCommandBuffer commandBuffer)
 {
-    const VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT,
-        0, 1, 0, 1 };
+    if (scene && scene->topLevelChanged) {
+        scene->accelerationStructures->RecordTopLevelUpdate(commandBuffer, scene->instanceBuffers[currentFrame].buffer);
+        scene->topLevelChanged = false;
+    }
+}
 
+void CG::EngineImpl::TraceScene(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+{
     const std::vector<VkDescriptorSet> descriptorsets = {
-        descriptorSets.rtxRaygen,
-        descriptorSets.rtxRayhit,
+        scene->rtxRaygen[frameIndex],
+        scene->rtxRayhit,
         descriptorSets.rtxRaymiss,
     };
 
     VkPipeline pipeline;
     Vk::Buffer* shaderBindingTable = nullptr;
-    
+
     if (uiData.enablePreviewQuality)
     {
-        pipeline = pipelines.previewRTX;
-        shaderBindingTable = &shaderBindingTables.previewRTX;
+        pipeline = scene->pipelines.previewRTX;
+        shaderBindingTable = &scene->shaderBindingTables.previewRTX;
     } 
     else if (uiData.enablePBRMaterials)
     {
-        pipeline = pipelines.RTX_PBR;
-        shaderBindingTable = &shaderBindingTables.RTX_PBR;
+        pipeline = scene->pipelines.RTX_PBR;
+        shaderBindingTable = &scene->shaderBindingTables.RTX_PBR;
     }
     else
     {
-        pipeline = pipelines.RTX;
-        shaderBindingTable = &shaderBindingTables.RTX;
+        pipeline = scene->pipelines.RTX;
+        shaderBindingTable = &scene->shaderBindingTables.RTX;
     }
 
-    vkCmdBindPipeline(drawCmdBuffers[swapChainImageIndex],
-        VK_PIPELINE_BIND_POINT_RAY_TRACING_NV, pipeline);
-
-    vkCmdBindDescriptorSets(drawCmdBuffers[swapChainImageIndex],
-        VK_PIPELINE_BIND_POINT_RAY_TRACING_NV,
-        pipelineLayouts.rtxPipelineLayout, 0,
+    // Storage and accumulation images are shared by frames in flight, the previous frame may still trace into them
+    // or copy the storage image out
+    VkMemoryBarrier imagesBarrier = Vk::Initializers::CreateMemoryBarrier();
+    imagesBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+    imagesBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer,
+        VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR,
+        0, 1, &imagesBarrier, 0, nullptr, 0, nullptr);
+
+    vkCmdBindPipeline(commandBuffer,
+        VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, pipeline);
+
+    vkCmdBindDescriptorSets(commandBuffer,
+        VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR,
+        scene->rtxPipelineLayout, 0,
         static_cast<uint32_t>(descriptorsets.size()),
         descriptorsets.data(), 0, 0);
 
-    VkDeviceSize bindingOffsetRayGenShader = rayTracingProperties.shaderGroupHandleSize * kIndexRaygen;
-    VkDeviceSize bindingOffsetMissShader = rayTracingProperties.shaderGroupHandleSize * kIndexMiss;
-    VkDeviceSize bindingOffsetHitShader = rayTracingProperties.shaderGroupHandleSize * kIndexClosestHit;
-    VkDeviceSize bindingStride = rayTracingProperties.shaderGroupHandleSize;
+    rayTracing->RecordTraceRays(commandBuffer, *shaderBindingTable, engineConfig.width, engineConfig.height);
+}
 
-    vkCmdTraceRaysNV(drawCmdBuffers[swapChainImageIndex],
-        shaderBindingTable->buffer, bindingOffsetRayGenShader,
-        shaderBindingTable->buffer, bindingOffsetMissShader,
-        bindingStride, shaderBindingTable->buffer,
-        bindingOffsetHitShader, bindingStride, VK_NULL_HANDLE, 0, 0,
-        engineConfig.width, engineConfig.height, 1);
+void CG::EngineImpl::DrawRayTracingData(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t swapChainImageIndex)
+{
+    const VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT,
+        0, 1, 0, 1 };
+
+    // Nothing to trace until the first scene is loaded, the swapchain image is cleared instead
+    if (!scene) {
+        Vk::Utils::SetImageLayout(
+            commandBuffer,
+            vkSwapChain->images[swapChainImageIndex], VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
+
+        const VkClearColorValue clearColor = { { 1.0f, 1.0f, 1.0f, 1.0f } };
+        vkCmdClearColorImage(commandBuffer,
+            vkSwapChain->images[swapChainImageIndex],
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearColor, 1, &subresourceRange);
+
+        Vk::Utils::SetImageLayout(commandBuffer,
+            vkSwapChain->images[swapChainImageIndex],
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            subresourceRange);
+        return;
+    }
+
+    TraceScene(commandBuffer, frameIndex);
 
     // Prepare current swapchain image as transfer destination
     Vk::Utils::SetImageLayout(
-        drawCmdBuffers[swapChainImageIndex],
+        commandBuffer,
         vkSwapChain->images[swapChainImageIndex], VK_IMAGE_LAYOUT_UNDEFINED,
         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
 
     // Prepare ray tracing output image as transfer source
-    Vk::Utils::SetImageLayout(drawCmdBuffers[swapChainImageIndex],
+    Vk::Utils::SetImageLayout(commandBuffer,
         storageImage.image, VK_IMAGE_LAYOUT_GENERAL,
         VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
         subresourceRange);
@@ -1409,25 +1765,181 @@ void CG::EngineImpl::DrawRayTracingData(uint32_t swapChainImageIndex)
     copyRegion.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
     copyRegion.dstOffset = { 0, 0, 0 };
     copyRegion.extent = { engineConfig.width, engineConfig.height, 1 };
-    vkCmdCopyImage(drawCmdBuffers[swapChainImageIndex], storageImage.image,
+    vkCmdCopyImage(commandBuffer, storageImage.image,
         VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
         vkSwapChain->images[swapChainImageIndex],
         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
 
     // Transition swap chain image back for presentation
-    Vk::Utils::SetImageLayout(drawCmdBuffers[swapChainImageIndex],
+    Vk::Utils::SetImageLayout(commandBuffer,
         vkSwapChain->images[swapChainImageIndex],
         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
         VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
         subresourceRange);
 
     // Transition ray tracing output image back to general layout
-    Vk::Utils::SetImageLayout(drawCmdBuffers[swapChainImageIndex],
+    Vk::Utils::SetImageLayout(commandBuffer,
         storageImage.image,
         VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
         VK_IMAGE_LAYOUT_GENERAL, subresourceRange);
 }
 
+void CG::EngineImpl::RenderHeadless()
+{
+    uint32_t framesCount = SEngineImpl::kHeadlessFramesCount;
+    std::string outputFilePath = "headless.png";
+    for (size_t i = 0; i + 1 < engineConfig.args.size(); ++i) {
+        if (engineConfig.args[i] == std::string("-frames")) {
+            char* endptr;
+            const uint32_t count = strtoul(engineConfig.args[i + 1], &endptr, 10);
+            if (endptr != engineConfig.args[i + 1] && count > 0) {
+                framesCount = count;
+            }
+        }
+        if (engineConfig.args[i] == std::string("-output")) {
+            outputFilePath = engineConfig.args[i + 1];
+        }
+    }
+
+    // The model is still loaded on its thread, there is nothing to render meanwhile
+    while (!sceneLoader.finished) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    UpdateLoadedScene();
+
+    if (!scene) {
+        return;
+    }
+
+    if (cpuReferenceOnly) {
+        // View matrices of the initial camera
+        UpdateUniformBuffers();
+        RenderCPUReference(*scene);
+        WaitForCPUReference();
+        return;
+    }
+
+    VkCommandBufferBeginInfo cmdBufInfo = Vk::Initializers::CommandBufferBeginInfo();
+
+    // Start and end of every frame, the wall time also includes recording and waiting for the fences
+    VkQueryPoolCreateInfo queryPoolCI = {};
+    queryPoolCI.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolCI.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolCI.queryCount = 2 * framesCount;
+
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    VK_CHECK_RESULT(vkCreateQueryPool(vkDevice->logicalDevice, &queryPoolCI, nullptr, &queryPool));
+
+    const auto renderStart = std::chrono::high_resolution_clock::now();
+
+    // Every frame reads the accumulation image of the previous one, TraceScene orders them on the GPU,
+    // so the next frame is recorded while the previous one is traced
+    for (uint32_t frame = 0; frame < framesCount; ++frame) {
+        currentFrame = frame % kMaxFramesInFlight;
+        VkCommandBuffer commandBuffer = drawCmdBuffers[currentFrame];
+        VkFence fence = waitFences[currentFrame];
+
+        VK_CHECK_RESULT(vkWaitForFences(vkDevice->logicalDevice, 1, &fence, VK_TRUE, UINT64_MAX));
+        VK_CHECK_RESULT(vkResetFences(vkDevice->logicalDevice, 1, &fence));
+
+        UpdateUniformBuffers();
+
+        VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+        vkCmdResetQueryPool(commandBuffer, queryPool, 2 * frame, 2);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 2 * frame);
+        UpdateTopLevel(commandBuffer);
+        TraceScene(commandBuffer, currentFrame);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 2 * frame + 1);
+        VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+
+        VkSubmitInfo frameSubmitInfo = Vk::Initializers::SubmitInfo();
+        frameSubmitInfo.commandBufferCount = 1;
+        frameSubmitInfo.pCommandBuffers = &commandBuffer;
+
+        {
+            std::lock_guard<std::mutex> lock(vkDevice->deviceQueueMutex);
+            VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &frameSubmitInfo, fence));
+        }
+    }
+
+    VK_CHECK_RESULT(vkWaitForFences(vkDevice->logicalDevice, static_cast<uint32_t>(waitFences.size()), waitFences.data(), VK_TRUE, UINT64_MAX));
+
+    const float wallMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - renderStart).count();
+
+    std::vector<uint64_t> timestamps(2 * framesCount);
+    VK_CHECK_RESULT(vkGetQueryPoolResults(vkDevice->logicalDevice, queryPool, 0, 2 * framesCount,
+        timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+
+    vkDestroyQueryPool(vkDevice->logicalDevice, queryPool, nullptr);
+
+    uint64_t gpuTicks = 0;
+    for (uint32_t frame = 0; frame < framesCount; ++frame) {
+        gpuTicks += timestamps[2 * frame + 1] - timestamps[2 * frame];
+    }
+    const double nanosecondsPerTick = vkDevice->properties.limits.timestampPeriod;
+    const double gpuMilliseconds = gpuTicks * nanosecondsPerTick * 1e-6;
+
+    std::cout << "Headless render of " << framesCount << " frames at " << engineConfig.width << "x" << engineConfig.height << ": GPU time "
+              << gpuMilliseconds << " ms, " << gpuMilliseconds / framesCount << " ms per frame, wall time " << wallMilliseconds << " ms"
+              << std::endl;
+
+    SaveStorageImage(outputFilePath);
+}
+
+void CG::EngineImpl::SaveStorageImage(const std::string& fileName)
+{
+    const VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    const size_t pixelsCount = static_cast<size_t>(engineConfig.width) * engineConfig.height;
+
+    Vk::Buffer readbackBuffer;
+    VK_CHECK_RESULT(vkDevice->CreateBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        &readbackBuffer, pixelsCount * 4));
+
+    VkCommandBuffer cmdBuffer = vkDevice->CreateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+
+    Vk::Utils::SetImageLayout(cmdBuffer, storageImage.image,
+        VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, subresourceRange);
+
+    VkBufferImageCopy copyRegion = {};
+    copyRegion.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    copyRegion.imageExtent = { engineConfig.width, engineConfig.height, 1 };
+    vkCmdCopyImageToBuffer(cmdBuffer, storageImage.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        readbackBuffer.buffer, 1, &copyRegion);
+
+    // Copied texels have to be visible to the host once the fence of the flush is signaled
+    VkMemoryBarrier hostReadBarrier = {};
+    hostReadBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    hostReadBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    hostReadBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+        0, 1, &hostReadBarrier, 0, nullptr, 0, nullptr);
+
+    Vk::Utils::SetImageLayout(cmdBuffer, storageImage.image,
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL, subresourceRange);
+
+    vkDevice->FlushCommandBuffer(cmdBuffer, queue);
+
+    VK_CHECK_RESULT(readbackBuffer.Map());
+
+    // Headless storage image is R8G8B8A8, its rows are already stored from the top by raygen shaders
+    const uint8_t* texels = static_cast<const uint8_t*>(readbackBuffer.mapped);
+    std::vector<glm::vec3> pixels(pixelsCount);
+    for (size_t i = 0; i < pixelsCount; ++i) {
+        pixels[i] = glm::vec3(texels[i * 4], texels[i * 4 + 1], texels[i * 4 + 2]) / 255.0f;
+    }
+
+    readbackBuffer.Unmap();
+    readbackBuffer.Destroy();
+
+    if (CPU::ImageWriter::WritePNG(fileName, engineConfig.width, engineConfig.height, pixels.data())) {
+        std::cout << "Headless render saved to " << fileName << std::endl;
+    } else {
+        std::cerr << "Failed to write " << fileName << std::endl;
+    }
+}
+
 void CG::EngineImpl::UpdateFrameData(float deltaTime)
 {
     uiData.fps = 1.0f / deltaTime;
@@ -0,0 +1,127 @@
+#include "Core/ThreadPool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+namespace SThreadPool {
+// Shared state of a single ParallelFor call
+struct ParallelForBatch {
+    std::atomic<size_t> nextIndex { 0 };
+    size_t count = 0;
+    const std::function<void(size_t)>* job = nullptr;
+
+    std::mutex mutex;
+    std::condition_variable finishedCondition;
+    uint32_t activeHelpers = 0;
+    std::exception_ptr exception = nullptr;
+
+    void Run()
+    {
+        for (size_t i = nextIndex++; i < count; i = nextIndex++) {
+            try {
+                (*job)(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!exception) {
+                    exception = std::current_exception();
+                }
+                // Skip the rest of iterations, result is going to be thrown away anyway
+                nextIndex = count;
+            }
+        }
+    }
+};
+}
+
+CG::ThreadPool::ThreadPool(uint32_t threadsCount /*= 0*/)
+{
+    if (threadsCount == 0) {
+        threadsCount = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    // Calling thread works too, so one thread less is enough to load all cores
+    const uint32_t workersCount = threadsCount - 1;
+    workers.reserve(workersCount);
+    for (uint32_t i = 0; i < workersCount; ++i) {
+        workers.emplace_back(&ThreadPool::WorkerLoop, this);
+    }
+}
+
+CG::ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(tasksMutex);
+        stopping = true;
+    }
+    tasksCondition.notify_all();
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void CG::ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& job)
+{
+    if (count == 0) {
+        return;
+    }
+
+    auto batch = std::make_shared<SThreadPool::ParallelForBatch>();
+    batch->count = count;
+    batch->job = &job;
+
+    const uint32_t helpersCount = static_cast<uint32_t>(std::min(workers.size(), count - 1));
+    if (helpersCount > 0) {
+        batch->activeHelpers = helpersCount;
+        {
+            std::lock_guard<std::mutex> lock(tasksMutex);
+            for (uint32_t i = 0; i < helpersCount; ++i) {
+                tasks.push([batch]() {
+                    batch->Run();
+
+                    std::lock_guard<std::mutex> batchLock(batch->mutex);
+                    if (--batch->activeHelpers == 0) {
+                        batch->finishedCondition.notify_one();
+                    }
+                });
+            }
+        }
+        tasksCondition.notify_all();
+    }
+
+    batch->Run();
+
+    // Job reference is owned by the caller, so helpers must leave it before we return
+    std::unique_lock<std::mutex> lock(batch->mutex);
+    batch->finishedCondition.wait(lock, [&batch]() { return batch->activeHelpers == 0; });
+
+    if (batch->exception) {
+        std::rethrow_exception(batch->exception);
+    }
+}
+
+uint32_t CG::ThreadPool::GetThreadsCount() const
+{
+    return static_cast<uint32_t>(workers.size()) + 1;
+}
+
+void CG::ThreadPool::WorkerLoop()
+{
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(tasksMutex);
+            tasksCondition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+
+            if (stopping && tasks.empty()) {
+                return;
+            }
+
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+
+        task();
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace CG {
+// Fixed set of worker threads, used for CPU heavy loading work (geometry decoding, image processing, etc.)
+class ThreadPool {
+public:
+    // 0 means one worker per hardware thread
+    explicit ThreadPool(uint32_t threadsCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Calls job(i) for every i in [0, count), the calling thread takes part in the work too.
+    // Blocks until all iterations are done, the first exception thrown by a job is rethrown here.
+    // Must not be called from inside of a job, workers would wait for each other.
+    void ParallelFor(size_t count, const std::function<void(size_t)>& job);
+
+    uint32_t GetThreadsCount() const;
+
+private:
+    void WorkerLoop();
+
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+
+    std::mutex tasksMutex;
+    std::condition_variable tasksCondition;
+    bool stopping = false;
+};
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "glm/vec3.hpp"
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace CG {
+class ThreadPool;
+
+namespace CPU {
+    struct Ray {
+        glm::vec3 origin = {};
+        float tMin = 0.0f;
+        glm::vec3 direction = { 0.0f, 0.0f, 1.0f };
+        float tMax = std::numeric_limits<float>::max();
+    };
+
+    struct Hit {
+        static constexpr uint32_t kInvalidTriangle = std::numeric_limits<uint32_t>::max();
+
+        float t = std::numeric_limits<float>::max();
+        // Barycentrics of the second and the third vertex
+        float u = 0.0f;
+        float v = 0.0f;
+        // Index of the triangle in the array passed to BVH::Build
+        uint32_t triangleIndex = kInvalidTriangle;
+
+        bool IsValid() const { return triangleIndex != kInvalidTriangle; }
+    };
+
+    // Bounding volume hierarchy over a triangle soup, built with binned surface area heuristic.
+    // Traversal is read only, so any number of threads can trace rays at the same time
+    class BVH {
+    public:
+        // Rays traced together by IntersectPacket, SSE lanes when the CPU has them
+        static constexpr uint32_t kPacketSize = 4;
+
+        struct Node {
+            glm::vec3 boundsMin;
+            // Left child of inner nodes, the right one follows it. First triangle of leaves
+            uint32_t leftOrFirst;
+            glm::vec3 boundsMax;
+            // Zero for inner nodes
+            uint32_t trianglesCount;
+
+            bool IsLeaf() const { return trianglesCount > 0; }
+        };
+
+        // positions holds three vertices per triangle. Large nodes are binned and subtrees are built on threadPool if it is set
+        void Build(const glm::vec3* positions, uint32_t trianglesCount, ThreadPool* threadPool);
+
+        // Closest hit in (tMin, tMax)
+        bool Intersect(const Ray& ray, Hit& hit) const;
+        // Any hit in (tMin, tMax), for shadow rays
+        bool Occluded(const Ray& ray) const;
+        // Closest hits of kPacketSize rays, coherent rays (camera rays, tiles) share most of the visited nodes
+        void IntersectPacket(const Ray* rays, Hit* hits) const;
+
+        const std::vector<Node>& GetNodes() const;
+        uint32_t GetTrianglesCount() const;
+        // Expected cost of a random ray by the surface area heuristic, with traversal and intersection costs of 1
+        float GetSAHCost() const;
+
+    private:
+        // Vertex and edges for Moller-Trumbore test, stored in leaf order
+        struct PreparedTriangle {
+            glm::vec3 v0;
+            glm::vec3 edge1;
+            glm::vec3 edge2;
+        };
+
+        // Shared by Intersect and Occluded, any hit stops the traversal right away
+        template <bool anyHit>
+        bool Traverse(const Ray& ray, Hit& hit) const;
+
+        std::vector<Node> nodes;
+        std::vector<PreparedTriangle> triangles;
+        // Original index of every triangle in leaf order
+        std::vector<uint32_t> triangleIndices;
+    };
+}
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "glm/vec3.hpp"
+#include <cstdint>
+#include <string>
+
+namespace CG {
+namespace CPU {
+    // Output of batch renders, pixels are float RGB rows from the top of the image
+    namespace ImageWriter {
+        // Uncompressed scanline OpenEXR with 32 bit float channels, returns false if the file can't be written
+        bool WriteEXR(const std::string& fileName, uint32_t width, uint32_t height, const glm::vec3* pixels);
+
+        // 8 bit RGB PNG, values are clamped to [0, 1] and stored as they are, like in the UNORM storage image of the GPU path
+        bool WritePNG(const std::string& fileName, uint32_t width, uint32_t height, const glm::vec3* pixels);
+    }
+}
+}
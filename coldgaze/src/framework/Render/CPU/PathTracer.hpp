@@ -0,0 +1,108 @@
+#pragma once
+
+#include "glm/mat4x4.hpp"
+#include "glm/vec2.hpp"
+#include "glm/vec3.hpp"
+#include "glm/vec4.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace CG {
+class ThreadPool;
+
+namespace CPU {
+    struct Hit;
+    struct Scene;
+    struct Material;
+
+    // Reference implementation of raygenPBR, closesthitPBR and missPBR. The shaders are followed line by line, including
+    // their approximations and random number streams, so images rendered here can be compared against the GPU ones.
+    // Textures are sampled at the base level, GPU hit shaders pick mips by ray cones.
+    class PathTracer {
+    public:
+        // Pixels of a tile are traced by one worker, idle workers steal tiles from the others
+        static constexpr uint32_t kTileSize = 16;
+
+        // Mirrors the Camera uniform block of the shaders, framesCount is the number of accumulated frames
+        struct Settings {
+            uint32_t bouncesCount = 2;
+            uint32_t samplesCount = 1;
+            float aperture = 0.0f;
+            float focusDistance = 13.0f;
+            uint32_t framesCount = 1;
+            uint32_t randomSeed = 0;
+        };
+
+        // Part of the UBOScene uniform block the shaders read
+        struct View {
+            glm::mat4 invView = glm::mat4(1.0f);
+            glm::mat4 invProjection = glm::mat4(1.0f);
+            glm::vec3 lightDirection = { 0.0f, 1.0f, 0.0f };
+            glm::vec3 lightColor = glm::vec3(1.0f);
+        };
+
+        // Rows from the top of the image
+        struct Image {
+            uint32_t width = 0;
+            uint32_t height = 0;
+            // Linear radiance averaged over all samples
+            std::vector<glm::vec3> radiance;
+            // Tone mapped frames averaged the same way as the accumulation image of the GPU path
+            std::vector<glm::vec3> toneMapped;
+        };
+
+        // PBRParams of closesthitPBR, defined next to the shading functions
+        struct PBRParams;
+
+        PathTracer(const Scene& aScene, const Settings& aSettings, const View& aView);
+
+        // Image width and height have to be set, tiles are traced on threadPool if it is given
+        void Render(Image& image, ThreadPool* threadPool) const;
+
+    private:
+        // Mirrors RayPayload of the shaders, ray cone fields are left out with the mip selection
+        struct Payload {
+            glm::vec3 color = glm::vec3(0.0f);
+            glm::vec3 throughput = glm::vec3(0.0f);
+            uint32_t bouncesCount = 0;
+            uint32_t randomSeed = 0;
+            uint32_t sampleEnviroment = 0;
+            float bsdfPdf = 0.0f;
+        };
+
+        // Vertex attributes interpolated at the hit point
+        struct VertexData {
+            glm::vec3 normal;
+            glm::vec4 texCoords;
+        };
+
+        void RenderTile(uint32_t tile, const std::vector<uint32_t>& frameSeeds, Image& image) const;
+
+        // traceRayEXT with the closest hit and miss shaders of the PBR pipeline
+        void TraceRay(const glm::vec3& origin, const glm::vec3& direction, Payload& payload) const;
+        // traceRayEXT with gl_RayFlagsTerminateOnFirstHitEXT and gl_RayFlagsSkipClosestHitShaderEXT, true if the miss shader was called
+        bool TraceShadowRay(const glm::vec3& origin, const glm::vec3& direction) const;
+
+        void Miss(const glm::vec3& direction, Payload& payload) const;
+        void ClosestHit(const glm::vec3& origin, const glm::vec3& direction, const Hit& hit, Payload& payload) const;
+
+        glm::vec4 SampleTexture(const VertexData& vertexData, int32_t texCoordSet, int32_t texture) const;
+        glm::vec3 PerturbNormal(const VertexData& vertexData, const Material& material, const glm::mat4& transform,
+            const glm::vec3& worldPos) const;
+        PBRParams GetPBRParams(const VertexData& vertexData, const Material& material, const glm::mat4& transform,
+            const glm::vec3& origin, const glm::vec3& direction, float t) const;
+
+        glm::vec3 GetDirectLighting(const PBRParams& pbrParams, Payload& payload) const;
+        glm::vec3 GetEnviromentLighting(PBRParams pbrParams, Payload& payload) const;
+        glm::vec3 GetIndirectLighting(PBRParams pbrParams, uint32_t minDepth, Payload& payload, Payload& indirect) const;
+
+        glm::vec2 SampleEnviroment(const glm::vec2& u, float& pdf) const;
+        float PdfEnviroment(const glm::vec2& uv) const;
+        uint32_t FindCDFInterval(uint32_t offset, uint32_t count, float u) const;
+
+        const Scene& scene;
+        Settings settings;
+        View view;
+    };
+}
+}
@@ -0,0 +1,777 @@
+#include "Render/CPU/BVH.hpp"
+#include "Core/ThreadPool.hpp"
+#include "glm/common.hpp"
+#include "glm/geometric.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define CG_BVH_SSE2 1
+#include <immintrin.h>
+#endif
+
+namespace SBVH {
+constexpr uint32_t kBinsCount = 16;
+// Larger leaves are split even if the heuristic says otherwise
+constexpr uint32_t kMaxLeafSize = 16;
+constexpr float kTraversalCost = 1.0f;
+constexpr float kIntersectionCost = 1.0f;
+// Nodes with more triangles are binned on the thread pool in chunks
+constexpr uint32_t kParallelBinningThreshold = 64 * 1024;
+constexpr uint32_t kBinningChunkSize = 16 * 1024;
+// Top of the tree is split on the calling thread until there are a few subtrees per thread, the subtrees are built in parallel
+constexpr uint32_t kSubtreesPerThread = 4;
+constexpr uint32_t kMinSubtreeSize = 1024;
+// Binned SAH can peel off a few triangles per level on clustered or exponentially spaced geometry,
+// deeper nodes are split at the object median, so no leaf is deeper than kMaxSAHDepth + 32
+constexpr uint32_t kMaxSAHDepth = 32;
+// Traversal pushes at most one node per level
+constexpr uint32_t kStackSize = kMaxSAHDepth + 32;
+constexpr float kDeterminantEpsilon = 1e-12f;
+
+struct Bounds {
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+
+    void Grow(const glm::vec3& point)
+    {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    void Grow(const Bounds& bounds)
+    {
+        min = glm::min(min, bounds.min);
+        max = glm::max(max, bounds.max);
+    }
+
+    float Area() const
+    {
+        const glm::vec3 extent = max - min;
+        if (extent.x < 0.0f || extent.y < 0.0f || extent.z < 0.0f) {
+            return 0.0f;
+        }
+        return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+    }
+};
+
+struct Bin {
+    Bounds bounds;
+    uint32_t count = 0;
+};
+
+// Bins of every axis
+using Bins = std::array<std::array<Bin, kBinsCount>, 3>;
+
+struct BuildTask {
+    uint32_t nodeIndex;
+    uint32_t first;
+    uint32_t count;
+    // Root is at 0
+    uint32_t depth;
+};
+
+struct Split {
+    int axis = -1;
+    // Triangles of the bins below go to the left child
+    uint32_t bin = 0;
+    float cost = std::numeric_limits<float>::max();
+};
+
+float Area(const CG::CPU::BVH::Node& node)
+{
+    Bounds bounds;
+    bounds.min = node.boundsMin;
+    bounds.max = node.boundsMax;
+    return bounds.Area();
+}
+
+glm::vec3 GetInverseDirection(const glm::vec3& direction)
+{
+    // Zero components would give NaNs for rays starting on a slab plane
+    constexpr float kMinComponent = 1e-20f;
+    glm::vec3 inverseDirection;
+    for (int i = 0; i < 3; ++i) {
+        const float component = std::abs(direction[i]) > kMinComponent ? direction[i] : std::copysign(kMinComponent, direction[i]);
+        inverseDirection[i] = 1.0f / component;
+    }
+    return inverseDirection;
+}
+
+class Builder {
+public:
+    Builder(const std::vector<Bounds>& aTriangleBounds, const std::vector<glm::vec3>& aCentroids, std::vector<uint32_t>& aIndices,
+        CG::ThreadPool* aThreadPool)
+        : triangleBounds(aTriangleBounds)
+        , centroids(aCentroids)
+        , indices(aIndices)
+        , threadPool(aThreadPool)
+    {
+    }
+
+    // Splits nodes until they become leaves, nodes[task.nodeIndex] has to exist
+    void BuildSubtree(const BuildTask& root, std::vector<CG::CPU::BVH::Node>& nodes) const
+    {
+        std::vector<BuildTask> tasks = { root };
+        while (!tasks.empty()) {
+            const BuildTask task = tasks.back();
+            tasks.pop_back();
+
+            uint32_t leftCount = 0;
+            if (SplitNode(task, nodes, false, leftCount)) {
+                const uint32_t left = nodes[task.nodeIndex].leftOrFirst;
+                tasks.push_back({ left, task.first, leftCount, task.depth + 1 });
+                tasks.push_back({ left + 1, task.first + leftCount, task.count - leftCount, task.depth + 1 });
+            }
+        }
+    }
+
+    // Writes bounds of the node and either makes it a leaf or appends its two children and partitions its triangles.
+    // Returns false for leaves
+    bool SplitNode(const BuildTask& task, std::vector<CG::CPU::BVH::Node>& nodes, bool parallel, uint32_t& leftCount) const
+    {
+        Bounds bounds;
+        Bounds centroidBounds;
+        ComputeBounds(task, parallel, bounds, centroidBounds);
+
+        CG::CPU::BVH::Node& node = nodes[task.nodeIndex];
+        node.boundsMin = bounds.min;
+        node.boundsMax = bounds.max;
+        node.leftOrFirst = task.first;
+        node.trianglesCount = task.count;
+
+        if (task.count <= 1) {
+            return false;
+        }
+
+        Bins bins;
+        ComputeBins(task, centroidBounds, parallel, bins);
+        const Split split = FindSplit(bins);
+
+        uint32_t* first = indices.data() + task.first;
+        uint32_t* last = first + task.count;
+
+        if (split.axis >= 0) {
+            const float leafCost = kIntersectionCost * static_cast<float>(task.count);
+            const float splitCost = kTraversalCost + kIntersectionCost * split.cost / std::max(bounds.Area(), std::numeric_limits<float>::min());
+            if (splitCost >= leafCost && task.count <= kMaxLeafSize) {
+                return false;
+            }
+
+            if (task.depth >= kMaxSAHDepth) {
+                leftCount = SplitMedian(task, centroidBounds);
+            } else {
+                const int axis = split.axis;
+                const float minCentroid = centroidBounds.min[axis];
+                const float scale = GetBinScale(centroidBounds, axis);
+                uint32_t* middle = std::partition(first, last, [&](uint32_t index) {
+                    return GetBinIndex(centroids[index][axis], minCentroid, scale) < split.bin;
+                });
+                leftCount = static_cast<uint32_t>(middle - first);
+            }
+        } else if (task.count <= kMaxLeafSize) {
+            return false;
+        } else {
+            // Every centroid is the same point, any half is as good as the other
+            leftCount = task.count / 2;
+        }
+
+        const uint32_t left = static_cast<uint32_t>(nodes.size());
+        nodes[task.nodeIndex].leftOrFirst = left;
+        nodes[task.nodeIndex].trianglesCount = 0;
+        nodes.emplace_back();
+        nodes.emplace_back();
+
+        return true;
+    }
+
+private:
+    // Halves the triangles along the longest axis of the centroids, returns the left count
+    uint32_t SplitMedian(const BuildTask& task, const Bounds& centroidBounds) const
+    {
+        const glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+        const int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+        uint32_t* first = indices.data() + task.first;
+        const uint32_t leftCount = task.count / 2;
+        std::nth_element(first, first + leftCount, first + task.count,
+            [&](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+        return leftCount;
+    }
+
+    static float GetBinScale(const Bounds& centroidBounds, int axis)
+    {
+        const float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+        return extent > 0.0f ? static_cast<float>(kBinsCount) / extent : 0.0f;
+    }
+
+    static uint32_t GetBinIndex(float centroid, float minCentroid, float scale)
+    {
+        const float bin = (centroid - minCentroid) * scale;
+        return std::min(static_cast<uint32_t>(std::max(bin, 0.0f)), kBinsCount - 1);
+    }
+
+    template <typename ChunkJob>
+    void ForEachChunk(const BuildTask& task, bool parallel, const ChunkJob& chunkJob) const
+    {
+        const uint32_t chunksCount = parallel ? (task.count + kBinningChunkSize - 1) / kBinningChunkSize : 1;
+        const uint32_t chunkSize = parallel ? kBinningChunkSize : task.count;
+
+        const auto job = [&](size_t chunk) {
+            const uint32_t begin = task.first + static_cast<uint32_t>(chunk) * chunkSize;
+            const uint32_t end = std::min(begin + chunkSize, task.first + task.count);
+            chunkJob(chunk, begin, end);
+        };
+
+        if (parallel && threadPool) {
+            threadPool->ParallelFor(chunksCount, job);
+        } else {
+            for (uint32_t chunk = 0; chunk < chunksCount; ++chunk) {
+                job(chunk);
+            }
+        }
+    }
+
+    uint32_t GetChunksCount(const BuildTask& task, bool parallel) const
+    {
+        return parallel ? (task.count + kBinningChunkSize - 1) / kBinningChunkSize : 1;
+    }
+
+    void ComputeBounds(const BuildTask& task, bool parallel, Bounds& bounds, Bounds& centroidBounds) const
+    {
+        std::vector<std::pair<Bounds, Bounds>> chunkBounds(GetChunksCount(task, parallel));
+        ForEachChunk(task, parallel, [&](size_t chunk, uint32_t begin, uint32_t end) {
+            std::pair<Bounds, Bounds>& result = chunkBounds[chunk];
+            for (uint32_t i = begin; i < end; ++i) {
+                result.first.Grow(triangleBounds[indices[i]]);
+                result.second.Grow(centroids[indices[i]]);
+            }
+        });
+
+        for (const std::pair<Bounds, Bounds>& result : chunkBounds) {
+            bounds.Grow(result.first);
+            centroidBounds.Grow(result.second);
+        }
+    }
+
+    void ComputeBins(const BuildTask& task, const Bounds& centroidBounds, bool parallel, Bins& bins) const
+    {
+        std::vector<Bins> chunkBins(GetChunksCount(task, parallel));
+        ForEachChunk(task, parallel, [&](size_t chunk, uint32_t begin, uint32_t end) {
+            Bins& result = chunkBins[chunk];
+            for (int axis = 0; axis < 3; ++axis) {
+                const float scale = GetBinScale(centroidBounds, axis);
+                if (scale == 0.0f) {
+                    continue;
+                }
+                for (uint32_t i = begin; i < end; ++i) {
+                    const uint32_t index = indices[i];
+                    Bin& bin = result[axis][GetBinIndex(centroids[index][axis], centroidBounds.min[axis], scale)];
+                    bin.bounds.Grow(triangleBounds[index]);
+                    ++bin.count;
+                }
+            }
+        });
+
+        bins = {};
+        for (const Bins& result : chunkBins) {
+            for (int axis = 0; axis < 3; ++axis) {
+                for (uint32_t i = 0; i < kBinsCount; ++i) {
+                    bins[axis][i].bounds.Grow(result[axis][i].bounds);
+                    bins[axis][i].count += result[axis][i].count;
+                }
+            }
+        }
+    }
+
+    // Sweeps the bins of every axis from both sides, cost is the sum of child areas weighted by their triangle counts
+    static Split FindSplit(const Bins& bins)
+    {
+        Split split;
+
+        for (int axis = 0; axis < 3; ++axis) {
+            std::array<float, kBinsCount> leftAreas = {};
+            std::array<uint32_t, kBinsCount> leftCounts = {};
+
+            Bounds leftBounds;
+            uint32_t leftCount = 0;
+            for (uint32_t i = 0; i < kBinsCount - 1; ++i) {
+                leftBounds.Grow(bins[axis][i].bounds);
+                leftCount += bins[axis][i].count;
+                leftAreas[i] = leftBounds.Area();
+                leftCounts[i] = leftCount;
+            }
+
+            Bounds rightBounds;
+            uint32_t rightCount = 0;
+            for (uint32_t i = kBinsCount - 1; i > 0; --i) {
+                rightBounds.Grow(bins[axis][i].bounds);
+                rightCount += bins[axis][i].count;
+
+                if (leftCounts[i - 1] == 0 || rightCount == 0) {
+                    continue;
+                }
+
+                const float cost = static_cast<float>(leftCounts[i - 1]) * leftAreas[i - 1] + static_cast<float>(rightCount) * rightBounds.Area();
+                if (cost < split.cost) {
+                    split.axis = axis;
+                    split.bin = i;
+                    split.cost = cost;
+                }
+            }
+        }
+
+        return split;
+    }
+
+    const std::vector<Bounds>& triangleBounds;
+    const std::vector<glm::vec3>& centroids;
+    std::vector<uint32_t>& indices;
+    CG::ThreadPool* threadPool = nullptr;
+};
+
+bool IntersectBounds(const CG::CPU::BVH::Node& node, const glm::vec3& origin, const glm::vec3& inverseDirection, float tMin, float tMax,
+    float& tNear)
+{
+    const glm::vec3 t0 = (node.boundsMin - origin) * inverseDirection;
+    const glm::vec3 t1 = (node.boundsMax - origin) * inverseDirection;
+    const glm::vec3 tSlabMin = glm::min(t0, t1);
+    const glm::vec3 tSlabMax = glm::max(t0, t1);
+
+    tNear = std::max(std::max(tSlabMin.x, tSlabMin.y), std::max(tSlabMin.z, tMin));
+    const float tFar = std::min(std::min(tSlabMax.x, tSlabMax.y), std::min(tSlabMax.z, tMax));
+    return tNear <= tFar;
+}
+
+#if defined(CG_BVH_SSE2)
+// Rays of a packet in SoA layout, lanes are rays
+struct RayPacketSSE {
+    __m128 origin[3];
+    __m128 direction[3];
+    __m128 inverseDirection[3];
+    __m128 tMin;
+    __m128 tMax;
+};
+
+__m128 Select(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+float HorizontalMin(__m128 v)
+{
+    v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+    return _mm_cvtss_f32(v);
+}
+
+// Returns mask of the lanes which hit the node, tNear of the missed ones is +inf
+__m128 IntersectBoundsSSE(const CG::CPU::BVH::Node& node, const RayPacketSSE& packet, __m128& tNear)
+{
+    __m128 tEnter = packet.tMin;
+    __m128 tExit = packet.tMax;
+    for (int axis = 0; axis < 3; ++axis) {
+        const __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMin[axis]), packet.origin[axis]), packet.inverseDirection[axis]);
+        const __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMax[axis]), packet.origin[axis]), packet.inverseDirection[axis]);
+        tEnter = _mm_max_ps(tEnter, _mm_min_ps(t0, t1));
+        tExit = _mm_min_ps(tExit, _mm_max_ps(t0, t1));
+    }
+
+    const __m128 mask = _mm_cmple_ps(tEnter, tExit);
+    tNear = Select(mask, tEnter, _mm_set1_ps(std::numeric_limits<float>::infinity()));
+    return mask;
+}
+#endif
+}
+
+void CG::CPU::BVH::Build(const glm::vec3* positions, uint32_t trianglesCount, ThreadPool* threadPool)
+{
+    using namespace SBVH;
+
+    nodes.clear();
+    triangles.clear();
+    triangleIndices.clear();
+
+    if (trianglesCount == 0) {
+        return;
+    }
+
+    std::vector<Bounds> triangleBounds(trianglesCount);
+    std::vector<glm::vec3> centroids(trianglesCount);
+    std::vector<uint32_t> indices(trianglesCount);
+
+    const auto prepareTriangles = [&](size_t chunk) {
+        const uint32_t begin = static_cast<uint32_t>(chunk) * kBinningChunkSize;
+        const uint32_t end = std::min(begin + kBinningChunkSize, trianglesCount);
+        for (uint32_t i = begin; i < end; ++i) {
+            Bounds& bounds = triangleBounds[i];
+            bounds.Grow(positions[i * 3 + 0]);
+            bounds.Grow(positions[i * 3 + 1]);
+            bounds.Grow(positions[i * 3 + 2]);
+            centroids[i] = (bounds.min + bounds.max) * 0.5f;
+            indices[i] = i;
+        }
+    };
+
+    const uint32_t chunksCount = (trianglesCount + kBinningChunkSize - 1) / kBinningChunkSize;
+    if (threadPool) {
+        threadPool->ParallelFor(chunksCount, prepareTriangles);
+    } else {
+        for (uint32_t chunk = 0; chunk < chunksCount; ++chunk) {
+            prepareTriangles(chunk);
+        }
+    }
+
+    const Builder builder(triangleBounds, centroids, indices, threadPool);
+
+    nodes.reserve(trianglesCount * 2);
+    nodes.emplace_back();
+
+    if (threadPool) {
+        const uint32_t subtreeSize = std::max(kMinSubtreeSize, trianglesCount / (threadPool->GetThreadsCount() * kSubtreesPerThread));
+
+        std::vector<BuildTask> subtreeTasks;
+        std::vector<BuildTask> tasks = { { 0, 0, trianglesCount, 0 } };
+        while (!tasks.empty()) {
+            const BuildTask task = tasks.back();
+            tasks.pop_back();
+
+            if (task.count <= subtreeSize) {
+                subtreeTasks.push_back(task);
+                continue;
+            }
+
+            uint32_t leftCount = 0;
+            if (builder.SplitNode(task, nodes, task.count >= kParallelBinningThreshold, leftCount)) {
+                const uint32_t left = nodes[task.nodeIndex].leftOrFirst;
+                tasks.push_back({ left, task.first, leftCount, task.depth + 1 });
+                tasks.push_back({ left + 1, task.first + leftCount, task.count - leftCount, task.depth + 1 });
+            }
+        }
+
+        // Every subtree is built into its own array with the root at 0, then the arrays are appended
+        std::vector<std::vector<Node>> subtreeNodes(subtreeTasks.size());
+        threadPool->ParallelFor(subtreeTasks.size(), [&](size_t i) {
+            subtreeNodes[i].emplace_back();
+            builder.BuildSubtree({ 0, subtreeTasks[i].first, subtreeTasks[i].count, subtreeTasks[i].depth }, subtreeNodes[i]);
+        });
+
+        for (size_t i = 0; i < subtreeTasks.size(); ++i) {
+            // Children are never at 0, so the local index k lands at base + k - 1
+            const uint32_t base = static_cast<uint32_t>(nodes.size());
+            for (size_t k = 0; k < subtreeNodes[i].size(); ++k) {
+                Node node = subtreeNodes[i][k];
+                if (!node.IsLeaf()) {
+                    node.leftOrFirst = base + node.leftOrFirst - 1;
+                }
+
+                if (k == 0) {
+                    nodes[subtreeTasks[i].nodeIndex] = node;
+                } else {
+                    nodes.push_back(node);
+                }
+            }
+        }
+    } else {
+        builder.BuildSubtree({ 0, 0, trianglesCount, 0 }, nodes);
+    }
+
+    nodes.shrink_to_fit();
+
+    triangles.resize(trianglesCount);
+    triangleIndices = std::move(indices);
+    for (uint32_t i = 0; i < trianglesCount; ++i) {
+        const glm::vec3* vertices = positions + static_cast<size_t>(triangleIndices[i]) * 3;
+        triangles[i].v0 = vertices[0];
+        triangles[i].edge1 = vertices[1] - vertices[0];
+        triangles[i].edge2 = vertices[2] - vertices[0];
+    }
+}
+
+template <bool anyHit>
+bool CG::CPU::BVH::Traverse(const Ray& ray, Hit& hit) const
+{
+    using namespace SBVH;
+
+    if (nodes.empty()) {
+        return false;
+    }
+
+    const glm::vec3 inverseDirection = GetInverseDirection(ray.direction);
+    float tMax = ray.tMax;
+
+    float tNear = 0.0f;
+    if (!IntersectBounds(nodes[0], ray.origin, inverseDirection, ray.tMin, tMax, tNear)) {
+        return false;
+    }
+
+    uint32_t hitTriangle = Hit::kInvalidTriangle;
+
+    std::array<uint32_t, kStackSize> stack;
+    uint32_t stackSize = 0;
+    uint32_t nodeIndex = 0;
+
+    while (true) {
+        const Node& node = nodes[nodeIndex];
+
+        if (node.IsLeaf()) {
+            for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.trianglesCount; ++i) {
+                const PreparedTriangle& triangle = triangles[i];
+
+                const glm::vec3 pvec = glm::cross(ray.direction, triangle.edge2);
+                const float determinant = glm::dot(triangle.edge1, pvec);
+                if (std::abs(determinant) < kDeterminantEpsilon) {
+                    continue;
+                }
+
+                const float inverseDeterminant = 1.0f / determinant;
+                const glm::vec3 tvec = ray.origin - triangle.v0;
+                const float u = glm::dot(tvec, pvec) * inverseDeterminant;
+                if (u < 0.0f || u > 1.0f) {
+                    continue;
+                }
+
+                const glm::vec3 qvec = glm::cross(tvec, triangle.edge1);
+                const float v = glm::dot(ray.direction, qvec) * inverseDeterminant;
+                if (v < 0.0f || u + v > 1.0f) {
+                    continue;
+                }
+
+                const float t = glm::dot(triangle.edge2, qvec) * inverseDeterminant;
+                if (t <= ray.tMin || t >= tMax) {
+                    continue;
+                }
+
+                tMax = t;
+                hitTriangle = i;
+                hit.u = u;
+                hit.v = v;
+
+                if (anyHit) {
+                    break;
+                }
+            }
+
+            if (anyHit && hitTriangle != Hit::kInvalidTriangle) {
+                break;
+            }
+        } else {
+            const uint32_t left = node.leftOrFirst;
+            float tLeft = 0.0f;
+            float tRight = 0.0f;
+            const bool hitLeft = IntersectBounds(nodes[left], ray.origin, inverseDirection, ray.tMin, tMax, tLeft);
+            const bool hitRight = IntersectBounds(nodes[left + 1], ray.origin, inverseDirection, ray.tMin, tMax, tRight);
+
+            if (hitLeft && hitRight) {
+                // Nearer child first, so the farther one is often culled by the shortened tMax
+                const bool leftFirst = tLeft <= tRight;
+                stack[stackSize++] = leftFirst ? left + 1 : left;
+                nodeIndex = leftFirst ? left : left + 1;
+                continue;
+            }
+            if (hitLeft || hitRight) {
+                nodeIndex = hitLeft ? left : left + 1;
+                continue;
+            }
+        }
+
+        if (stackSize == 0) {
+            break;
+        }
+        nodeIndex = stack[--stackSize];
+    }
+
+    if (hitTriangle == Hit::kInvalidTriangle) {
+        return false;
+    }
+
+    hit.t = tMax;
+    hit.triangleIndex = triangleIndices[hitTriangle];
+    return true;
+}
+
+bool CG::CPU::BVH::Intersect(const Ray& ray, Hit& hit) const
+{
+    return Traverse<false>(ray, hit);
+}
+
+bool CG::CPU::BVH::Occluded(const Ray& ray) const
+{
+    Hit hit;
+    return Traverse<true>(ray, hit);
+}
+
+void CG::CPU::BVH::IntersectPacket(const Ray* rays, Hit* hits) const
+{
+    using namespace SBVH;
+
+    for (uint32_t i = 0; i < kPacketSize; ++i) {
+        hits[i] = Hit();
+    }
+
+#if defined(CG_BVH_SSE2)
+    if (nodes.empty()) {
+        return;
+    }
+
+    RayPacketSSE packet;
+    for (int axis = 0; axis < 3; ++axis) {
+        packet.origin[axis] = _mm_setr_ps(rays[0].origin[axis], rays[1].origin[axis], rays[2].origin[axis], rays[3].origin[axis]);
+        packet.direction[axis] = _mm_setr_ps(rays[0].direction[axis], rays[1].direction[axis], rays[2].direction[axis], rays[3].direction[axis]);
+    }
+    for (int axis = 0; axis < 3; ++axis) {
+        glm::vec3 inverseDirections[kPacketSize];
+        for (uint32_t i = 0; i < kPacketSize; ++i) {
+            inverseDirections[i] = GetInverseDirection(rays[i].direction);
+        }
+        packet.inverseDirection[axis] = _mm_setr_ps(inverseDirections[0][axis], inverseDirections[1][axis], inverseDirections[2][axis],
+            inverseDirections[3][axis]);
+    }
+    packet.tMin = _mm_setr_ps(rays[0].tMin, rays[1].tMin, rays[2].tMin, rays[3].tMin);
+    packet.tMax = _mm_setr_ps(rays[0].tMax, rays[1].tMax, rays[2].tMax, rays[3].tMax);
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 epsilon = _mm_set1_ps(kDeterminantEpsilon);
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+    __m128 hitU = zero;
+    __m128 hitV = zero;
+    __m128 hitTriangles = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+    __m128 tNear;
+    if (_mm_movemask_ps(IntersectBoundsSSE(nodes[0], packet, tNear)) == 0) {
+        return;
+    }
+
+    std::array<uint32_t, kStackSize> stack;
+    uint32_t stackSize = 0;
+    uint32_t nodeIndex = 0;
+
+    while (true) {
+        const Node& node = nodes[nodeIndex];
+
+        if (node.IsLeaf()) {
+            for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.trianglesCount; ++i) {
+                const PreparedTriangle& triangle = triangles[i];
+                const __m128 e1x = _mm_set1_ps(triangle.edge1.x);
+                const __m128 e1y = _mm_set1_ps(triangle.edge1.y);
+                const __m128 e1z = _mm_set1_ps(triangle.edge1.z);
+                const __m128 e2x = _mm_set1_ps(triangle.edge2.x);
+                const __m128 e2y = _mm_set1_ps(triangle.edge2.y);
+                const __m128 e2z = _mm_set1_ps(triangle.edge2.z);
+                const __m128* d = packet.direction;
+
+                // pvec = cross(direction, edge2)
+                const __m128 px = _mm_sub_ps(_mm_mul_ps(d[1], e2z), _mm_mul_ps(d[2], e2y));
+                const __m128 py = _mm_sub_ps(_mm_mul_ps(d[2], e2x), _mm_mul_ps(d[0], e2z));
+                const __m128 pz = _mm_sub_ps(_mm_mul_ps(d[0], e2y), _mm_mul_ps(d[1], e2x));
+                const __m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+                const __m128 inverseDeterminant = _mm_div_ps(one, determinant);
+
+                // tvec = origin - v0
+                const __m128 tx = _mm_sub_ps(packet.origin[0], _mm_set1_ps(triangle.v0.x));
+                const __m128 ty = _mm_sub_ps(packet.origin[1], _mm_set1_ps(triangle.v0.y));
+                const __m128 tz = _mm_sub_ps(packet.origin[2], _mm_set1_ps(triangle.v0.z));
+                const __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)), _mm_mul_ps(tz, pz)), inverseDeterminant);
+
+                // qvec = cross(tvec, edge1)
+                const __m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+                const __m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+                const __m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+                const __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(d[0], qx), _mm_mul_ps(d[1], qy)), _mm_mul_ps(d[2], qz)), inverseDeterminant);
+                const __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inverseDeterminant);
+
+                __m128 mask = _mm_cmpge_ps(_mm_and_ps(determinant, absMask), epsilon);
+                mask = _mm_and_ps(mask, _mm_cmpge_ps(u, zero));
+                mask = _mm_and_ps(mask, _mm_cmpge_ps(v, zero));
+                mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u, v), one));
+                mask = _mm_and_ps(mask, _mm_cmpgt_ps(t, packet.tMin));
+                mask = _mm_and_ps(mask, _mm_cmplt_ps(t, packet.tMax));
+
+                if (_mm_movemask_ps(mask) == 0) {
+                    continue;
+                }
+
+                packet.tMax = Select(mask, t, packet.tMax);
+                hitU = Select(mask, u, hitU);
+                hitV = Select(mask, v, hitV);
+                hitTriangles = Select(mask, _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(i))), hitTriangles);
+            }
+        } else {
+            const uint32_t left = node.leftOrFirst;
+            __m128 tLeft;
+            __m128 tRight;
+            const bool hitLeft = _mm_movemask_ps(IntersectBoundsSSE(nodes[left], packet, tLeft)) != 0;
+            const bool hitRight = _mm_movemask_ps(IntersectBoundsSSE(nodes[left + 1], packet, tRight)) != 0;
+
+            if (hitLeft && hitRight) {
+                // The child any of the rays enters first goes first
+                const bool leftFirst = HorizontalMin(tLeft) <= HorizontalMin(tRight);
+                stack[stackSize++] = leftFirst ? left + 1 : left;
+                nodeIndex = leftFirst ? left : left + 1;
+                continue;
+            }
+            if (hitLeft || hitRight) {
+                nodeIndex = hitLeft ? left : left + 1;
+                continue;
+            }
+        }
+
+        if (stackSize == 0) {
+            break;
+        }
+        nodeIndex = stack[--stackSize];
+    }
+
+    alignas(16) float t[kPacketSize];
+    alignas(16) float u[kPacketSize];
+    alignas(16) float v[kPacketSize];
+    alignas(16) int32_t hitTriangleIndices[kPacketSize];
+    _mm_store_ps(t, packet.tMax);
+    _mm_store_ps(u, hitU);
+    _mm_store_ps(v, hitV);
+    _mm_store_si128(reinterpret_cast<__m128i*>(hitTriangleIndices), _mm_castps_si128(hitTriangles));
+
+    for (uint32_t i = 0; i < kPacketSize; ++i) {
+        if (hitTriangleIndices[i] >= 0) {
+            hits[i].t = t[i];
+            hits[i].u = u[i];
+            hits[i].v = v[i];
+            hits[i].triangleIndex = triangleIndices[hitTriangleIndices[i]];
+        }
+    }
+#else
+    for (uint32_t i = 0; i < kPacketSize; ++i) {
+        Intersect(rays[i], hits[i]);
+    }
+#endif
+}
+
+const std::vector<CG::CPU::BVH::Node>& CG::CPU::BVH::GetNodes() const
+{
+    return nodes;
+}
+
+uint32_t CG::CPU::BVH::GetTrianglesCount() const
+{
+    return static_cast<uint32_t>(triangles.size());
+}
+
+float CG::CPU::BVH::GetSAHCost() const
+{
+    using namespace SBVH;
+
+    if (nodes.empty()) {
+        return 0.0f;
+    }
+
+    float cost = 0.0f;
+    for (const Node& node : nodes) {
+        const float area = Area(node);
+        cost += node.IsLeaf() ? kIntersectionCost * static_cast<float>(node.trianglesCount) * area : kTraversalCost * area;
+    }
+
+    return cost / std::max(Area(nodes[0]), std::numeric_limits<float>::min());
+}
@@ -0,0 +1,139 @@
+#include "Render/CPU/ImageWriter.hpp"
+#include "stb_image_write.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace SImageWriter {
+// OpenEXR files are little endian, so values are copied as they are on x86 and ARM
+template <typename T>
+void Write(std::vector<uint8_t>& data, const T& value)
+{
+    const size_t offset = data.size();
+    data.resize(offset + sizeof(T));
+    memcpy(data.data() + offset, &value, sizeof(T));
+}
+
+void WriteString(std::vector<uint8_t>& data, const char* string)
+{
+    data.insert(data.end(), string, string + strlen(string) + 1);
+}
+
+template <typename T>
+void WriteAttribute(std::vector<uint8_t>& data, const char* name, const char* type, const T& value)
+{
+    WriteString(data, name);
+    WriteString(data, type);
+    Write(data, static_cast<int32_t>(sizeof(T)));
+    Write(data, value);
+}
+
+struct Box2i {
+    int32_t xMin;
+    int32_t yMin;
+    int32_t xMax;
+    int32_t yMax;
+};
+
+struct V2f {
+    float x;
+    float y;
+};
+
+constexpr uint32_t kMagicNumber = 20000630;
+// Single part scanline image
+constexpr uint32_t kVersion = 2;
+constexpr int32_t kPixelTypeFloat = 2;
+constexpr uint8_t kNoCompression = 0;
+constexpr uint8_t kIncreasingY = 0;
+
+// Channels are stored in alphabetical order, every scanline has all B values, then all G values and then all R values
+constexpr int kChannels[] = { 2, 1, 0 };
+constexpr const char* kChannelNames[] = { "B", "G", "R" };
+}
+
+bool CG::CPU::ImageWriter::WriteEXR(const std::string& fileName, uint32_t width, uint32_t height, const glm::vec3* pixels)
+{
+    using namespace SImageWriter;
+
+    std::vector<uint8_t> header;
+    Write(header, kMagicNumber);
+    Write(header, kVersion);
+
+    std::vector<uint8_t> channels;
+    for (const char* channelName : kChannelNames) {
+        WriteString(channels, channelName);
+        Write(channels, kPixelTypeFloat);
+        // pLinear and reserved bytes
+        Write(channels, static_cast<uint32_t>(0));
+        // x and y sampling
+        Write(channels, static_cast<int32_t>(1));
+        Write(channels, static_cast<int32_t>(1));
+    }
+    channels.push_back(0);
+
+    WriteString(header, "channels");
+    WriteString(header, "chlist");
+    Write(header, static_cast<int32_t>(channels.size()));
+    header.insert(header.end(), channels.begin(), channels.end());
+
+    const Box2i window = { 0, 0, static_cast<int32_t>(width) - 1, static_cast<int32_t>(height) - 1 };
+    WriteAttribute(header, "compression", "compression", kNoCompression);
+    WriteAttribute(header, "dataWindow", "box2i", window);
+    WriteAttribute(header, "displayWindow", "box2i", window);
+    WriteAttribute(header, "lineOrder", "lineOrder", kIncreasingY);
+    WriteAttribute(header, "pixelAspectRatio", "float", 1.0f);
+    WriteAttribute(header, "screenWindowCenter", "v2f", V2f { 0.0f, 0.0f });
+    WriteAttribute(header, "screenWindowWidth", "float", 1.0f);
+    header.push_back(0);
+
+    // Offset table of scanlines follows the header, every scanline is prefixed with its y and size
+    const uint32_t scanlineSize = width * static_cast<uint32_t>(sizeof(float)) * 3;
+    const uint64_t firstScanline = header.size() + sizeof(uint64_t) * height;
+    for (uint32_t y = 0; y < height; ++y) {
+        Write(header, firstScanline + static_cast<uint64_t>(y) * (sizeof(int32_t) * 2 + scanlineSize));
+    }
+
+    std::ofstream file(fileName, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(header.data()), header.size());
+
+    std::vector<uint8_t> scanline;
+    scanline.reserve(sizeof(int32_t) * 2 + scanlineSize);
+    for (uint32_t y = 0; y < height; ++y) {
+        scanline.clear();
+        Write(scanline, static_cast<int32_t>(y));
+        Write(scanline, static_cast<int32_t>(scanlineSize));
+
+        const glm::vec3* row = pixels + static_cast<size_t>(y) * width;
+        for (int channel : kChannels) {
+            for (uint32_t x = 0; x < width; ++x) {
+                Write(scanline, row[x][channel]);
+            }
+        }
+
+        file.write(reinterpret_cast<const char*>(scanline.data()), scanline.size());
+    }
+
+    return static_cast<bool>(file);
+}
+
+bool CG::CPU::ImageWriter::WritePNG(const std::string& fileName, uint32_t width, uint32_t height, const glm::vec3* pixels)
+{
+    std::vector<uint8_t> rgb(static_cast<size_t>(width) * height * 3);
+    for (size_t i = 0; i < static_cast<size_t>(width) * height; ++i) {
+        for (int channel = 0; channel < 3; ++channel) {
+            // NaN is written as black
+            const float value = std::isnan(pixels[i][channel]) ? 0.0f : std::min(std::max(pixels[i][channel], 0.0f), 1.0f);
+            rgb[i * 3 + channel] = static_cast<uint8_t>(std::lround(value * 255.0f));
+        }
+    }
+
+    return stbi_write_png(fileName.c_str(), static_cast<int>(width), static_cast<int>(height), 3, rgb.data(),
+               static_cast<int>(width) * 3)
+        != 0;
+}
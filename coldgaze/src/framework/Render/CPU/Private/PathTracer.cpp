@@ -0,0 +1,834 @@
+#include "Render/CPU/PathTracer.hpp"
+#include "Core/ThreadPool.hpp"
+#include "Render/CPU/Scene.hpp"
+#include "glm/common.hpp"
+#include "glm/geometric.hpp"
+#include "glm/mat3x3.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+
+namespace SPathTracer {
+constexpr float kEpsilon = 0.001f;
+constexpr float kPi = 3.14159265359f;
+
+constexpr float kWorkflowMetallicRoughness = 0.0f;
+constexpr float kMinRoughness = 0.04f;
+constexpr float kDielectricReflectionApproximation = 0.04f;
+constexpr float kMinTerminationThreshold = 0.05f;
+
+constexpr float kRayMin = 0.001f;
+constexpr float kRayMax = 10000.0f;
+
+// Spread of the direct light rays in closesthitPBR
+constexpr float kDispersionFactor = 0.08f;
+constexpr float kEnviromentFactor = 1.0f;
+// Russian roulette starts after this bounce
+constexpr uint32_t kMinDepth = 1;
+
+// GLSL min, max and clamp compile to GPU instructions which return the other operand for NaN, unlike std::min and std::max
+float Min(float a, float b)
+{
+    return std::fmin(a, b);
+}
+
+float Max(float a, float b)
+{
+    return std::fmax(a, b);
+}
+
+float Clamp(float x, float minValue, float maxValue)
+{
+    return Min(Max(x, minValue), maxValue);
+}
+
+glm::vec2 Clamp(const glm::vec2& x, float minValue, float maxValue)
+{
+    return glm::vec2(Clamp(x.x, minValue, maxValue), Clamp(x.y, minValue, maxValue));
+}
+
+uint32_t InitRandomSeed(uint32_t val0, uint32_t val1)
+{
+    uint32_t v0 = val0;
+    uint32_t v1 = val1;
+    uint32_t s0 = 0;
+
+    for (uint32_t n = 0; n < 16; n++) {
+        s0 += 0x9e3779b9;
+        v0 += ((v1 << 4) + 0xa341316c) ^ (v1 + s0) ^ ((v1 >> 5) + 0xc8013ea4);
+        v1 += ((v0 << 4) + 0xad90777d) ^ (v0 + s0) ^ ((v0 >> 5) + 0x7e95761e);
+    }
+
+    return v0;
+}
+
+uint32_t RandomInt(uint32_t& seed)
+{
+    // LCG values from Numerical Recipes
+    return (seed = 1664525 * seed + 1013904223);
+}
+
+float RandomFloat(uint32_t& seed)
+{
+    // Float version using bitmask from Numerical Recipes
+    const uint32_t one = 0x3f800000;
+    const uint32_t msk = 0x007fffff;
+    const uint32_t bits = one | (msk & (RandomInt(seed) >> 9));
+
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value - 1.0f;
+}
+
+// Arguments of GLSL constructors are evaluated from left to right, so are the ones of these helpers
+glm::vec2 RandomFloat2(uint32_t& seed)
+{
+    const float x = RandomFloat(seed);
+    const float y = RandomFloat(seed);
+    return glm::vec2(x, y);
+}
+
+glm::vec3 RandomFloat3(uint32_t& seed)
+{
+    const float x = RandomFloat(seed);
+    const float y = RandomFloat(seed);
+    const float z = RandomFloat(seed);
+    return glm::vec3(x, y, z);
+}
+
+glm::vec2 RandomInUnitDisk(uint32_t& seed)
+{
+    for (;;) {
+        const glm::vec2 p = 2.0f * RandomFloat2(seed) - 1.0f;
+        if (glm::dot(p, p) < 1.0f) {
+            return p;
+        }
+    }
+}
+
+glm::vec3 RandomInUnitSphere(uint32_t& seed)
+{
+    for (;;) {
+        const glm::vec3 p = 2.0f * RandomFloat3(seed) - 1.0f;
+        if (glm::dot(p, p) < 1.0f) {
+            return p;
+        }
+    }
+}
+
+glm::vec3 ToneMapping(glm::vec3 linear)
+{
+    linear = glm::vec3(Max(0.0f, linear.x - 0.004f), Max(0.0f, linear.y - 0.004f), Max(0.0f, linear.z - 0.004f));
+    return (linear * (6.2f * linear + 0.5f)) / (linear * (6.2f * linear + 1.7f) + 0.06f);
+}
+
+float Luminance(const glm::vec3& color)
+{
+    return glm::dot(color, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+}
+
+float GetSpecularWeight(const glm::vec3& baseColor, const glm::vec3& F0, float metallic)
+{
+    const float diffuseLum = glm::mix(Luminance(baseColor), 0.0f, metallic);
+    const float specularLum = Luminance(F0);
+    return Min(1.0f, specularLum / (specularLum + diffuseLum));
+}
+
+bool IsBlack(const glm::vec3& color)
+{
+    return glm::dot(color, color) < kEpsilon;
+}
+
+glm::vec2 SampleDisk(const glm::vec2& u)
+{
+    const float r = std::sqrt(u.x);
+    const float theta = 2.0f * kPi * u.y;
+    return r * glm::vec2(std::cos(theta), std::sin(theta));
+}
+
+glm::vec3 SampleHemisphereCosine(const glm::vec2& u)
+{
+    const glm::vec2 d = SampleDisk(u);
+    return glm::vec3(d.x, d.y, std::sqrt(1.0f - d.x * d.x - d.y * d.y));
+}
+
+float PdfHemisphereCosine(float cosTheta)
+{
+    return cosTheta / kPi;
+}
+
+float G_SchlickGGX(float cosTheta, float roughness)
+{
+    const float r = roughness + 1.0f;
+    const float k = (r * r) / 8.0f;
+    return cosTheta / (cosTheta * (1.0f - k) + k);
+}
+
+glm::vec3 SampleD_GGX(const glm::vec2& u, float alpha2)
+{
+    const float phi = 2.0f * kPi * u.x;
+    const float cosWh = std::sqrt((1.0f - u.y) / (1.0f + (alpha2 - 1.0f) * u.y));
+    const float sinWh = std::sqrt(1.0f - cosWh * cosWh);
+    return glm::vec3(sinWh * std::cos(phi), sinWh * std::sin(phi), cosWh);
+}
+
+float PDF_D_GGX(float roughness, float cosTheta)
+{
+    return G_SchlickGGX(cosTheta, roughness) * cosTheta;
+}
+
+float PowerHeuristic(float pdf, float otherPdf)
+{
+    const float sum = pdf * pdf + otherPdf * otherPdf;
+    return sum > 0.0f ? (pdf * pdf) / sum : 0.0f;
+}
+
+float Maxcomp(const glm::vec3& comps)
+{
+    return Max(comps.x, Max(comps.y, comps.z));
+}
+
+// Inverse of SampleSphericalMap
+glm::vec3 EquirectangularToDirection(const glm::vec2& uv)
+{
+    const float phi = (uv.x - 0.5f) * 2.0f * kPi;
+    const float elevation = (uv.y - 0.5f) * kPi;
+    return glm::vec3(std::cos(elevation) * std::cos(phi), std::sin(elevation), std::cos(elevation) * std::sin(phi));
+}
+
+glm::vec2 SampleSphericalMap(const glm::vec3& v)
+{
+    const glm::vec2 invAtan = glm::vec2(0.1591f, 0.3183f);
+    return glm::vec2(std::atan2(v.z, v.x), std::asin(v.y)) * invAtan + 0.5f;
+}
+
+// Tiles are split into a contiguous range per worker, so neighbouring tiles share cache lines of the scene.
+// A worker which runs out of its own tiles takes the last ones of the others, far from where their owners are working
+class TileScheduler {
+public:
+    TileScheduler(uint32_t tilesCount, uint32_t workersCount)
+        : queues(workersCount)
+    {
+        for (uint32_t worker = 0; worker < workersCount; ++worker) {
+            const uint32_t first = static_cast<uint32_t>(static_cast<uint64_t>(tilesCount) * worker / workersCount);
+            const uint32_t last = static_cast<uint32_t>(static_cast<uint64_t>(tilesCount) * (worker + 1) / workersCount);
+            for (uint32_t tile = first; tile < last; ++tile) {
+                queues[worker].tiles.push_back(tile);
+            }
+        }
+    }
+
+    bool Pop(uint32_t worker, uint32_t& tile)
+    {
+        {
+            Queue& queue = queues[worker];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (!queue.tiles.empty()) {
+                tile = queue.tiles.front();
+                queue.tiles.pop_front();
+                return true;
+            }
+        }
+
+        const uint32_t workersCount = static_cast<uint32_t>(queues.size());
+        for (uint32_t i = 1; i < workersCount; ++i) {
+            Queue& victim = queues[(worker + i) % workersCount];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tiles.empty()) {
+                tile = victim.tiles.back();
+                victim.tiles.pop_back();
+                ++stolenTilesCount;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    uint32_t GetStolenTilesCount() const
+    {
+        return stolenTilesCount;
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<uint32_t> tiles;
+    };
+
+    std::vector<Queue> queues;
+    std::atomic<uint32_t> stolenTilesCount = { 0 };
+};
+}
+
+struct CG::CPU::PathTracer::PBRParams {
+    float NdotL; // cos angle between normal and light direction
+    float NdotV; // cos angle between normal and view direction
+    float NdotH; // cos angle between normal and half vector
+    float LdotH; // cos angle between light direction and half vector
+    float VdotH; // cos angle between view direction and half vector
+    float occlusion; // pre calculated occlusion value on the surface
+    float roughness; // roughness value at the surface
+    float metallic; // metallic value at the surface
+    float alphaRoughness; // roughness * roughness
+    glm::vec4 albedo; // base albedo color value
+    glm::vec3 emissive; // emissive color value
+    glm::vec3 worldPos; // point on surface world position
+    glm::vec3 F0; // F0 param for Fresnel function
+    glm::vec3 V; // View vector
+    glm::vec3 N; // Normal vector
+    glm::vec3 H; // Half vector
+    glm::vec3 L; // Light vector
+    float sw; // Specular weight determine, how we are going to launch ray
+};
+
+namespace SPathTracer {
+using PBRParams = CG::CPU::PathTracer::PBRParams;
+
+// Approximation of microfacets towards half-vector using Normal Distribution
+float NDF_GGXTR(const PBRParams& pbrParams)
+{
+    const float a = pbrParams.alphaRoughness;
+    const float a2 = a * a;
+    const float NdotH2 = pbrParams.NdotH * pbrParams.NdotH;
+
+    float denom = (NdotH2 * (a2 - 1.0f) + 1.0f);
+    denom = kPi * denom * denom;
+
+    return a2 / denom;
+}
+
+// This method covers geometry obstruction and shadowing cases
+float G_Smith(const PBRParams& pbrParams)
+{
+    return G_SchlickGGX(pbrParams.NdotV, pbrParams.roughness) * G_SchlickGGX(pbrParams.NdotL, pbrParams.roughness);
+}
+
+glm::vec3 F_Schlick(const PBRParams& pbrParams)
+{
+    return pbrParams.F0 + (1.0f - pbrParams.F0) * std::pow(1.0f - pbrParams.VdotH, 5.0f);
+}
+
+float PDF_BSDF(const PBRParams& pbrParams)
+{
+    const float pdfDiffuse = PdfHemisphereCosine(pbrParams.NdotL);
+    const float pdfSpecular = PDF_D_GGX(pbrParams.roughness, pbrParams.NdotH) / Max(kEpsilon, 4.0f * pbrParams.LdotH);
+    return glm::mix(pdfDiffuse, pdfSpecular, pbrParams.sw);
+}
+
+void InitPBRParams(PBRParams& pbrParams, const glm::vec3& N, const glm::vec3& V, const glm::vec3& L, const glm::vec3& H)
+{
+    pbrParams.NdotL = Clamp(glm::dot(N, L), 0.001f, 1.0f);
+    pbrParams.NdotV = Clamp(std::abs(glm::dot(N, V)), 0.001f, 1.0f);
+    pbrParams.NdotH = Clamp(glm::dot(N, H), 0.001f, 1.0f);
+    pbrParams.LdotH = Clamp(glm::dot(L, H), 0.001f, 1.0f);
+    pbrParams.VdotH = Clamp(glm::dot(V, H), 0.001f, 1.0f);
+}
+
+glm::vec3 EvaluateBSDF(const PBRParams& pbrParams)
+{
+    // Cook-Torrance BRDF
+    const float NDF = NDF_GGXTR(pbrParams);
+    const float G = G_Smith(pbrParams);
+    const glm::vec3 F = F_Schlick(pbrParams);
+
+    const glm::vec3 kS = F;
+    glm::vec3 kD = glm::vec3(1.0f) - kS;
+    kD *= 1.0f - pbrParams.metallic;
+
+    const glm::vec3 specular = NDF * G * F;
+    const glm::vec3 diffuse = kD * glm::vec3(pbrParams.albedo) / kPi;
+
+    return specular + diffuse;
+}
+
+// L and H stay in the frame of the sampling functions, as in closesthitPBR
+glm::vec3 SampleBSDF(PBRParams& pbrParams, uint32_t& randomSeed, float& pdf)
+{
+    const glm::vec3 unit = RandomInUnitSphere(randomSeed);
+
+    if (unit.z < pbrParams.sw) {
+        pbrParams.H = SampleD_GGX(glm::vec2(unit), pbrParams.alphaRoughness * pbrParams.alphaRoughness);
+        pbrParams.L = -glm::reflect(pbrParams.V, pbrParams.H);
+    } else {
+        pbrParams.L = SampleHemisphereCosine(glm::vec2(unit));
+        pbrParams.H = glm::normalize(pbrParams.L + pbrParams.V);
+    }
+
+    InitPBRParams(pbrParams, pbrParams.N, pbrParams.V, pbrParams.L, pbrParams.H);
+
+    pdf = PDF_BSDF(pbrParams);
+    return EvaluateBSDF(pbrParams);
+}
+
+// Screen space derivatives are replaced by fixed offsets in closesthitPBR
+glm::vec2 dFdx(const glm::vec2& p)
+{
+    return glm::vec2(p.x + 0.01f, p.y) - p;
+}
+
+glm::vec3 dFdx(const glm::vec3& p)
+{
+    return glm::vec3(p.x + 0.01f, p.y, p.z) - p;
+}
+
+glm::vec2 dFdy(const glm::vec2& p)
+{
+    return glm::vec2(p.x, p.y + 0.01f) - p;
+}
+
+glm::vec3 dFdy(const glm::vec3& p)
+{
+    return glm::vec3(p.x, p.y + 0.01f, p.z) - p;
+}
+}
+
+CG::CPU::PathTracer::PathTracer(const Scene& aScene, const Settings& aSettings, const View& aView)
+    : scene(aScene)
+    , settings(aSettings)
+    , view(aView)
+{
+}
+
+void CG::CPU::PathTracer::Render(Image& image, ThreadPool* threadPool) const
+{
+    using namespace SPathTracer;
+
+    const auto renderStart = std::chrono::high_resolution_clock::now();
+
+    image.radiance.assign(static_cast<size_t>(image.width) * image.height, glm::vec3(0.0f));
+    image.toneMapped.assign(static_cast<size_t>(image.width) * image.height, glm::vec3(0.0f));
+
+    // The GPU path gets a new seed for every frame from the engine
+    std::vector<uint32_t> frameSeeds(settings.framesCount);
+    uint32_t seed = settings.randomSeed;
+    for (uint32_t& frameSeed : frameSeeds) {
+        frameSeed = RandomInt(seed);
+    }
+
+    const uint32_t tilesX = (image.width + kTileSize - 1) / kTileSize;
+    const uint32_t tilesY = (image.height + kTileSize - 1) / kTileSize;
+    const uint32_t workersCount = threadPool ? threadPool->GetThreadsCount() : 1;
+
+    TileScheduler scheduler(tilesX * tilesY, workersCount);
+    const auto worker = [&](size_t workerIndex) {
+        uint32_t tile = 0;
+        while (scheduler.Pop(static_cast<uint32_t>(workerIndex), tile)) {
+            RenderTile(tile, frameSeeds, image);
+        }
+    };
+
+    if (threadPool) {
+        threadPool->ParallelFor(workersCount, worker);
+    } else {
+        worker(0);
+    }
+
+    const float milliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - renderStart).count();
+    std::cout << "CPU path tracer rendered " << image.width << "x" << image.height << " with " << settings.framesCount * settings.samplesCount
+              << " samples per pixel in " << milliseconds << " ms on " << workersCount << " thread(s), " << scheduler.GetStolenTilesCount()
+              << " of " << tilesX * tilesY << " tiles stolen" << std::endl;
+}
+
+void CG::CPU::PathTracer::RenderTile(uint32_t tile, const std::vector<uint32_t>& frameSeeds, Image& image) const
+{
+    using namespace SPathTracer;
+
+    const uint32_t tilesX = (image.width + kTileSize - 1) / kTileSize;
+    const uint32_t beginX = (tile % tilesX) * kTileSize;
+    const uint32_t beginY = (tile / tilesX) * kTileSize;
+    const uint32_t endX = std::min(beginX + kTileSize, image.width);
+    const uint32_t endY = std::min(beginY + kTileSize, image.height);
+
+    const glm::vec2 launchSize = glm::vec2(image.width, image.height);
+
+    for (uint32_t y = beginY; y < endY; ++y) {
+        for (uint32_t x = beginX; x < endX; ++x) {
+            glm::vec3 radiance = glm::vec3(0.0f);
+            glm::vec3 accumulationColor = glm::vec3(0.0f);
+
+            for (uint32_t frame = 0; frame < settings.framesCount; ++frame) {
+                Payload rayPayload;
+                rayPayload.randomSeed = InitRandomSeed(InitRandomSeed(x, y), frameSeeds[frame]);
+
+                glm::vec3 resultColor = glm::vec3(0.0f);
+
+                for (uint32_t s = 0; s < settings.samplesCount; ++s) {
+                    rayPayload.throughput = glm::vec3(1.0f);
+
+                    const glm::vec2 pixelCenter = glm::vec2(x, y) + RandomFloat(rayPayload.randomSeed);
+                    const glm::vec2 inUV = pixelCenter / launchSize;
+                    const glm::vec2 d = inUV * 2.0f - 1.0f;
+
+                    const glm::vec2 offset = settings.aperture / 2.0f * RandomInUnitDisk(rayPayload.randomSeed);
+                    const glm::vec4 origin = view.invView * glm::vec4(offset, 0.0f, 1.0f);
+                    const glm::vec4 target = view.invProjection * glm::vec4(d.x, d.y, 1.0f, 1.0f);
+                    const glm::vec4 direction = view.invView
+                        * glm::vec4(glm::normalize(glm::vec3(target) * settings.focusDistance - glm::vec3(offset, 0.0f)), 0.0f);
+
+                    rayPayload.bouncesCount = 0;
+                    rayPayload.sampleEnviroment = 1;
+                    rayPayload.bsdfPdf = 0.0f;
+
+                    TraceRay(glm::vec3(origin), glm::vec3(direction), rayPayload);
+
+                    resultColor += rayPayload.color;
+                }
+
+                resultColor /= static_cast<float>(settings.samplesCount);
+                radiance += resultColor;
+
+                accumulationColor = (ToneMapping(resultColor) + static_cast<float>(frame) * accumulationColor) / static_cast<float>(frame + 1);
+            }
+
+            // raygenPBR stores launch rows bottom up
+            const size_t pixel = static_cast<size_t>(image.height - 1 - y) * image.width + x;
+            image.radiance[pixel] = radiance / static_cast<float>(settings.framesCount);
+            image.toneMapped[pixel] = accumulationColor;
+        }
+    }
+}
+
+void CG::CPU::PathTracer::TraceRay(const glm::vec3& origin, const glm::vec3& direction, Payload& payload) const
+{
+    Ray ray;
+    ray.origin = origin;
+    ray.tMin = SPathTracer::kRayMin;
+    ray.direction = direction;
+    ray.tMax = SPathTracer::kRayMax;
+
+    Hit hit;
+    if (scene.bvh.Intersect(ray, hit)) {
+        ClosestHit(origin, direction, hit, payload);
+    } else {
+        Miss(direction, payload);
+    }
+}
+
+bool CG::CPU::PathTracer::TraceShadowRay(const glm::vec3& origin, const glm::vec3& direction) const
+{
+    Ray ray;
+    ray.origin = origin;
+    ray.tMin = SPathTracer::kRayMin;
+    ray.direction = direction;
+    ray.tMax = SPathTracer::kRayMax;
+
+    return !scene.bvh.Occluded(ray);
+}
+
+void CG::CPU::PathTracer::Miss(const glm::vec3& direction, Payload& payload) const
+{
+    using namespace SPathTracer;
+
+    const glm::vec2 uv = SampleSphericalMap(glm::normalize(direction));
+
+    if (payload.sampleEnviroment > 0) {
+        payload.color = glm::vec3(scene.environment.texture.Sample(uv));
+
+        // BSDF sampled bounce, the same direction could have been picked by environment light sampling
+        if (payload.bsdfPdf > 0.0f) {
+            payload.color *= PowerHeuristic(payload.bsdfPdf, PdfEnviroment(Clamp(uv, 0.0f, 1.0f)));
+        }
+    } else {
+        payload.color = glm::vec3(0.0f);
+    }
+}
+
+void CG::CPU::PathTracer::ClosestHit(const glm::vec3& origin, const glm::vec3& direction, const Hit& hit, Payload& payload) const
+{
+    using namespace SPathTracer;
+
+    const SceneGeometry& geometry = scene.geometry;
+    const SceneGeometry::Primitive& primitive = geometry.primitives[geometry.primitiveIndices[hit.triangleIndex]];
+    const Material& material = scene.materials[primitive.materialIndex];
+
+    const glm::vec3 barycentrics = glm::vec3(1.0f - hit.u - hit.v, hit.u, hit.v);
+    const size_t firstVertex = static_cast<size_t>(hit.triangleIndex) * 3;
+
+    VertexData vertexData;
+    vertexData.normal = geometry.normals[firstVertex] * barycentrics.x + geometry.normals[firstVertex + 1] * barycentrics.y
+        + geometry.normals[firstVertex + 2] * barycentrics.z;
+    vertexData.texCoords = geometry.texCoords[firstVertex] * barycentrics.x + geometry.texCoords[firstVertex + 1] * barycentrics.y
+        + geometry.texCoords[firstVertex + 2] * barycentrics.z;
+
+    if (material.workflow != kWorkflowMetallicRoughness) {
+        payload.color = glm::vec3(1.0f, 0.0f, 0.0f);
+        return;
+    }
+
+    const PBRParams pbrParams = GetPBRParams(vertexData, material, primitive.transform, origin, direction, hit.t);
+
+    payload.color = (payload.bouncesCount == 0) ? pbrParams.emissive : glm::vec3(0.0f);
+    payload.color += GetDirectLighting(pbrParams, payload);
+    payload.color += GetEnviromentLighting(pbrParams, payload) * kEnviromentFactor;
+
+    if (payload.bouncesCount < settings.bouncesCount) {
+        Payload indirect;
+        payload.color += GetIndirectLighting(pbrParams, kMinDepth, payload, indirect);
+    }
+}
+
+glm::vec4 CG::CPU::PathTracer::SampleTexture(const VertexData& vertexData, int32_t texCoordSet, int32_t texture) const
+{
+    const glm::vec2 uv = texCoordSet == 0 ? glm::vec2(vertexData.texCoords.x, vertexData.texCoords.y)
+                                          : glm::vec2(vertexData.texCoords.z, vertexData.texCoords.w);
+    return scene.textures[texture].Sample(uv);
+}
+
+glm::vec3 CG::CPU::PathTracer::PerturbNormal(
+    const VertexData& vertexData, const Material& material, const glm::mat4& transform, const glm::vec3& worldPos) const
+{
+    using namespace SPathTracer;
+
+    // Normals are transformed with w = 1, as gl_ObjectToWorldEXT * inNormal does
+    const glm::vec3 worldNormal = glm::normalize(glm::vec3(transform * glm::vec4(vertexData.normal, 1.0f)));
+
+    if (material.normal.texCoordSet <= -1) {
+        return worldNormal;
+    }
+
+    const glm::vec2 inUV = material.normal.texCoordSet == 0 ? glm::vec2(vertexData.texCoords.x, vertexData.texCoords.y)
+                                                            : glm::vec2(vertexData.texCoords.z, vertexData.texCoords.w);
+    glm::vec3 tangentNormal;
+    const glm::vec4 normalSample = scene.textures[material.normal.texture].Sample(inUV);
+    tangentNormal.x = normalSample.x * 2.0f - 1.0f;
+    tangentNormal.y = normalSample.y * 2.0f - 1.0f;
+    // Z is reconstructed, BC5 normal maps only store x and y
+    tangentNormal.z = std::sqrt(Max(1.0f - (tangentNormal.x * tangentNormal.x + tangentNormal.y * tangentNormal.y), 0.0f));
+
+    const glm::vec3 q1 = dFdx(worldPos);
+    const glm::vec3 q2 = dFdy(worldPos);
+    const glm::vec2 st1 = dFdx(inUV);
+    const glm::vec2 st2 = dFdy(inUV);
+
+    const glm::vec3 T = glm::normalize(q1 * st2.t - q2 * st1.t);
+    const glm::vec3 N = glm::normalize(worldNormal);
+    const glm::vec3 B = -glm::normalize(glm::cross(N, T));
+    const glm::mat3 TBN = glm::mat3(T, B, N);
+
+    return glm::normalize(TBN * tangentNormal);
+}
+
+CG::CPU::PathTracer::PBRParams CG::CPU::PathTracer::GetPBRParams(const VertexData& vertexData, const Material& material,
+    const glm::mat4& transform, const glm::vec3& origin, const glm::vec3& direction, float t) const
+{
+    using namespace SPathTracer;
+
+    glm::vec4 albedo;
+    if (material.baseColor.texCoordSet > -1) {
+        albedo = SampleTexture(vertexData, material.baseColor.texCoordSet, material.baseColor.texture) * material.baseColorFactor;
+    } else {
+        albedo = material.baseColorFactor;
+    }
+
+    glm::vec3 emissive;
+    if (material.emissive.texCoordSet > -1) {
+        emissive = glm::vec3(SampleTexture(vertexData, material.emissive.texCoordSet, material.emissive.texture))
+            * glm::vec3(material.emissiveFactor);
+    } else {
+        emissive = glm::vec3(material.emissiveFactor);
+    }
+
+    const glm::vec3 worldPos = origin + t * direction;
+
+    const glm::vec3 N = PerturbNormal(vertexData, material, transform, worldPos);
+    const glm::vec3 V = glm::normalize(origin - worldPos);
+    const glm::vec3 L = glm::normalize(view.lightDirection);
+    const glm::vec3 H = glm::normalize(V + L);
+
+    float occlusion = 1.0f;
+    float roughness = material.roughnessFactor;
+    float metallic = material.metallicFactor;
+
+    if (material.physicalDescriptor.texCoordSet > -1) {
+        const glm::vec4 mrSample = SampleTexture(vertexData, material.physicalDescriptor.texCoordSet, material.physicalDescriptor.texture);
+        roughness = mrSample.g * roughness;
+        metallic = mrSample.b * metallic;
+    } else {
+        roughness = Clamp(roughness, kMinRoughness, 1.0f);
+        metallic = Clamp(metallic, 0.0f, 1.0f);
+    }
+
+    if (material.occlusion.texCoordSet > -1) {
+        occlusion = SampleTexture(vertexData, material.occlusion.texCoordSet, material.occlusion.texture).r;
+    }
+
+    const glm::vec3 F0 = glm::mix(glm::vec3(kDielectricReflectionApproximation), glm::vec3(albedo), metallic);
+
+    PBRParams pbrParams;
+    pbrParams.NdotL = Clamp(glm::dot(N, L), 0.001f, 1.0f);
+    pbrParams.NdotV = Clamp(std::abs(glm::dot(N, V)), 0.001f, 1.0f);
+    pbrParams.NdotH = Clamp(glm::dot(N, H), 0.0f, 1.0f);
+    pbrParams.LdotH = Clamp(glm::dot(L, H), 0.0f, 1.0f);
+    pbrParams.VdotH = Clamp(glm::dot(V, H), 0.0f, 1.0f);
+    pbrParams.occlusion = occlusion;
+    pbrParams.roughness = roughness;
+    pbrParams.metallic = metallic;
+    pbrParams.alphaRoughness = roughness * roughness;
+    pbrParams.albedo = albedo;
+    pbrParams.emissive = emissive;
+    pbrParams.worldPos = worldPos;
+    pbrParams.F0 = F0;
+    pbrParams.V = V;
+    pbrParams.N = N;
+    pbrParams.H = H;
+    pbrParams.L = L;
+    pbrParams.sw = GetSpecularWeight(glm::vec3(albedo), F0, metallic);
+
+    return pbrParams;
+}
+
+glm::vec3 CG::CPU::PathTracer::GetDirectLighting(const PBRParams& pbrParams, Payload& payload) const
+{
+    using namespace SPathTracer;
+
+    const glm::vec3 direction = view.lightDirection + kDispersionFactor * RandomInUnitSphere(payload.randomSeed);
+
+    if (TraceShadowRay(pbrParams.worldPos, direction)) {
+        return view.lightColor * EvaluateBSDF(pbrParams) * pbrParams.NdotL;
+    }
+
+    return glm::vec3(0.0f);
+}
+
+// Light sampling half of MIS, BSDF sampled rays get the other weight in Miss
+glm::vec3 CG::CPU::PathTracer::GetEnviromentLighting(PBRParams pbrParams, Payload& payload) const
+{
+    using namespace SPathTracer;
+
+    if (scene.environment.cdfs.empty()) {
+        return glm::vec3(0.0f);
+    }
+
+    float lightPdf;
+    const glm::vec2 uv = SampleEnviroment(RandomFloat2(payload.randomSeed), lightPdf);
+    const glm::vec3 L = EquirectangularToDirection(uv);
+
+    if (lightPdf < kEpsilon || glm::dot(pbrParams.N, L) <= 0.0f) {
+        return glm::vec3(0.0f);
+    }
+
+    if (!TraceShadowRay(pbrParams.worldPos, L)) {
+        return glm::vec3(0.0f);
+    }
+
+    pbrParams.L = L;
+    pbrParams.H = glm::normalize(L + pbrParams.V);
+    InitPBRParams(pbrParams, pbrParams.N, pbrParams.V, pbrParams.L, pbrParams.H);
+
+    const glm::vec3 bsdf = EvaluateBSDF(pbrParams);
+    const glm::vec3 radiance = glm::vec3(scene.environment.texture.Sample(uv));
+
+    return radiance * bsdf * pbrParams.NdotL * PowerHeuristic(lightPdf, PDF_BSDF(pbrParams)) / lightPdf;
+}
+
+glm::vec3 CG::CPU::PathTracer::GetIndirectLighting(PBRParams pbrParams, uint32_t minDepth, Payload& payload, Payload& indirect) const
+{
+    using namespace SPathTracer;
+
+    float pdf;
+    const glm::vec3 bsdf = SampleBSDF(pbrParams, payload.randomSeed, pdf);
+
+    if (IsBlack(bsdf) || pdf < kEpsilon) {
+        return glm::vec3(0.0f);
+    }
+
+    // Same f * cos / pdf estimator as the light sampled half in GetEnviromentLighting
+    glm::vec3 weight = (bsdf * pbrParams.NdotL) / pdf;
+    glm::vec3 pathThroughput = payload.throughput * weight;
+
+    if (payload.bouncesCount > minDepth) {
+        const float terminationThreshold = Max(kMinTerminationThreshold, 1.0f - Maxcomp(pathThroughput));
+        if (RandomFloat(payload.randomSeed) < terminationThreshold) {
+            return glm::vec3(0.0f);
+        }
+        pathThroughput /= 1.0f - terminationThreshold;
+        weight /= 1.0f - terminationThreshold;
+    }
+
+    indirect.throughput = pathThroughput;
+    indirect.randomSeed = payload.randomSeed;
+    indirect.bouncesCount = payload.bouncesCount + 1;
+    // Environment is light sampled as well, so the miss shader weights what this ray finds
+    indirect.sampleEnviroment = 1;
+    indirect.bsdfPdf = pdf;
+
+    TraceRay(pbrParams.worldPos, -pbrParams.L, indirect);
+
+    return indirect.color * weight;
+}
+
+// Picks a row by the marginal CDF and a texel inside of it by the row CDF, pdf is per solid angle
+glm::vec2 CG::CPU::PathTracer::SampleEnviroment(const glm::vec2& u, float& pdf) const
+{
+    using namespace SPathTracer;
+
+    const Environment& environment = scene.environment;
+    const uint32_t width = environment.distributionWidth;
+    const uint32_t height = environment.distributionHeight;
+    const float* cdfs = environment.cdfs.data();
+
+    const uint32_t row = FindCDFInterval(0, height, u.y);
+    const float rowStart = cdfs[row];
+    const float rowSize = cdfs[row + 1] - rowStart;
+
+    const uint32_t rowOffset = height + 1 + row * (width + 1);
+    const uint32_t column = FindCDFInterval(rowOffset, width, u.x);
+    const float columnStart = cdfs[rowOffset + column];
+    const float columnSize = cdfs[rowOffset + column + 1] - columnStart;
+
+    const glm::vec2 uv = glm::vec2((static_cast<float>(column) + Clamp((u.x - columnStart) / columnSize, 0.0f, 1.0f)) / width,
+        (static_cast<float>(row) + Clamp((u.y - rowStart) / rowSize, 0.0f, 1.0f)) / height);
+
+    // Equirectangular texel covers 2 * PI * PI * sin(theta) of solid angle per unit of uv area
+    pdf = columnSize * rowSize * static_cast<float>(width * height) / Max(2.0f * kPi * kPi * std::sin(uv.y * kPi), kEpsilon);
+    return uv;
+}
+
+// Solid angle pdf of GetEnviromentLighting picking this direction
+float CG::CPU::PathTracer::PdfEnviroment(const glm::vec2& uv) const
+{
+    using namespace SPathTracer;
+
+    const Environment& environment = scene.environment;
+    if (environment.cdfs.empty()) {
+        return 0.0f;
+    }
+
+    const uint32_t width = environment.distributionWidth;
+    const uint32_t height = environment.distributionHeight;
+    const float* cdfs = environment.cdfs.data();
+
+    const uint32_t row = std::min(static_cast<uint32_t>(uv.y * height), height - 1);
+    const uint32_t column = std::min(static_cast<uint32_t>(uv.x * width), width - 1);
+    const uint32_t rowOffset = height + 1 + row * (width + 1);
+
+    const float rowSize = cdfs[row + 1] - cdfs[row];
+    const float columnSize = cdfs[rowOffset + column + 1] - cdfs[rowOffset + column];
+
+    return columnSize * rowSize * static_cast<float>(width * height) / Max(2.0f * kPi * kPi * std::sin(uv.y * kPi), kEpsilon);
+}
+
+// Index of the last entry <= u among count + 1 CDF values starting at offset, the first one is 0.0 and the last one is 1.0
+uint32_t CG::CPU::PathTracer::FindCDFInterval(uint32_t offset, uint32_t count, float u) const
+{
+    const float* cdfs = scene.environment.cdfs.data();
+
+    uint32_t first = 0;
+    uint32_t last = count;
+    while (first + 1 < last) {
+        const uint32_t middle = (first + last) / 2;
+        if (cdfs[offset + middle] <= u) {
+            first = middle;
+        } else {
+            last = middle;
+        }
+    }
+    return first;
+}
@@ -0,0 +1,110 @@
+#include "Render/CPU/Scene.hpp"
+#include "Render/Vulkan/EnvironmentMap.hpp"
+#include "Render/Vulkan/Model.hpp"
+#include <chrono>
+#include <iostream>
+
+namespace SScene {
+CG::CPU::eWrapMode GetWrapMode(VkSamplerAddressMode addressMode)
+{
+    switch (addressMode) {
+    case VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT:
+        return CG::CPU::eWrapMode::kMirroredRepeat;
+    case VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE:
+    case VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER:
+        return CG::CPU::eWrapMode::kClampToEdge;
+    default:
+        return CG::CPU::eWrapMode::kRepeat;
+    }
+}
+
+CG::CPU::Material::TextureSlot GetTextureSlot(
+    int texCoordSet, const CG::Vk::GLTFModel::Texture* texture, const CG::Vk::GLTFModel& model, uint32_t& missingTexturesCount)
+{
+    CG::CPU::Material::TextureSlot slot;
+    if (texCoordSet < 0 || !texture) {
+        return slot;
+    }
+
+    if (texture->data.pixels.empty()) {
+        ++missingTexturesCount;
+        return slot;
+    }
+
+    slot.texCoordSet = texCoordSet;
+    slot.texture = static_cast<int32_t>(texture - model.GetTextures().data());
+    return slot;
+}
+}
+
+void CG::CPU::Scene::LoadModel(const Vk::GLTFModel& model, const glm::mat4& modelMatrix)
+{
+    using namespace SScene;
+
+    const auto loadingStart = std::chrono::high_resolution_clock::now();
+
+    geometry.LoadFromModel(model, modelMatrix);
+
+    textures.clear();
+    for (const Vk::GLTFModel::Texture& modelTexture : model.GetTextures()) {
+        const Vk::GLTFModel::Texture::TextureData& data = modelTexture.data;
+
+        Texture texture;
+        if (!data.pixels.empty()) {
+            texture.LoadRGBA8(data.width, data.height, data.pixels, GetWrapMode(data.sampler.addressModeU),
+                GetWrapMode(data.sampler.addressModeV));
+        }
+        textures.push_back(std::move(texture));
+    }
+
+    // Shaders read texture sets from the parameters, textures are bound per instance from the material
+    uint32_t missingTexturesCount = 0;
+    materials.clear();
+    for (const auto& modelMaterial : model.GetMaterials()) {
+        const Vk::GLTFModel::Material::MaterialParams& params = modelMaterial->materialParamsData;
+
+        Material material;
+        material.baseColorFactor = params.baseColorFactor;
+        material.emissiveFactor = params.emissiveFactor;
+        material.workflow = params.workflow;
+        material.metallicFactor = params.metallicFactor;
+        material.roughnessFactor = params.roughnessFactor;
+        material.baseColor = GetTextureSlot(params.colorTextureSet, modelMaterial->baseColorTexture, model, missingTexturesCount);
+        material.physicalDescriptor = GetTextureSlot(
+            params.physicalDescriptorTextureSet, modelMaterial->metallicRoughnessTexture, model, missingTexturesCount);
+        material.normal = GetTextureSlot(params.normalTextureSet, modelMaterial->normalTexture, model, missingTexturesCount);
+        material.occlusion = GetTextureSlot(params.occlusionTextureSet, modelMaterial->occlusionTexture, model, missingTexturesCount);
+        material.emissive = GetTextureSlot(params.emissiveTextureSet, modelMaterial->emissiveTexture, model, missingTexturesCount);
+        materials.push_back(material);
+    }
+
+    if (missingTexturesCount > 0) {
+        std::cout << missingTexturesCount << " material texture(s) have no CPU copy, their factors are used alone" << std::endl;
+    }
+
+    const float milliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - loadingStart).count();
+    std::cout << "CPU scene with " << geometry.GetTrianglesCount() << " triangles copied in " << milliseconds << " ms" << std::endl;
+}
+
+void CG::CPU::Scene::BuildBVH(ThreadPool* threadPool)
+{
+    const auto buildStart = std::chrono::high_resolution_clock::now();
+
+    bvh.Build(geometry.positions.data(), geometry.GetTrianglesCount(), threadPool);
+
+    const float milliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - buildStart).count();
+    std::cout << "CPU scene BVH built in " << milliseconds << " ms" << std::endl;
+}
+
+void CG::CPU::Scene::LoadEnvironment(const Vk::EnvironmentMap& environmentMap)
+{
+    const Vk::EnvironmentMap::Data& data = environmentMap.data;
+
+    environment = {};
+    if (!data.pixels.empty()) {
+        environment.texture.LoadRGB32F(data.width, data.height, data.pixels, eWrapMode::kRepeat, eWrapMode::kClampToEdge);
+    }
+    environment.distributionWidth = data.header.width;
+    environment.distributionHeight = data.header.height;
+    environment.cdfs = data.cdfs;
+}
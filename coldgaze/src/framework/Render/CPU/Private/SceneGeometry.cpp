@@ -0,0 +1,113 @@
+#include "Render/CPU/SceneGeometry.hpp"
+#include "Render/Vulkan/Model.hpp"
+#include "glm/geometric.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+#pragma warning(push, 0)
+#include <glm/gtc/packing.hpp>
+#pragma warning(pop)
+
+namespace SSceneGeometry {
+// Same as OctDecode in closest hit shaders
+glm::vec3 OctDecode(uint32_t encoded)
+{
+    const glm::vec2 e = glm::unpackSnorm2x16(encoded);
+    glm::vec3 n = glm::vec3(e, 1.0f - std::abs(e.x) - std::abs(e.y));
+    const float t = std::max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return glm::normalize(n);
+}
+
+void LoadVertex(const uint8_t* vertex, bool compactVertex, glm::vec3& position, glm::vec3& normal, glm::vec4& texCoords)
+{
+    if (compactVertex) {
+        CG::Vk::GLTFModel::CompactVertex compact;
+        std::memcpy(&compact, vertex, sizeof(compact));
+        position = compact.pos;
+        normal = OctDecode(compact.normal);
+        texCoords = glm::vec4(glm::unpackHalf2x16(compact.uv0), glm::unpackHalf2x16(compact.uv1));
+    } else {
+        CG::Vk::GLTFModel::Vertex full;
+        std::memcpy(&full, vertex, sizeof(full));
+        position = glm::vec3(full.pos);
+        normal = glm::vec3(full.normal);
+        texCoords = full.uv;
+    }
+}
+}
+
+uint32_t CG::CPU::SceneGeometry::GetTrianglesCount() const
+{
+    return static_cast<uint32_t>(positions.size() / 3);
+}
+
+void CG::CPU::SceneGeometry::LoadFromModel(const Vk::GLTFModel& model, const glm::mat4& modelMatrix)
+{
+    using namespace SSceneGeometry;
+
+    positions.clear();
+    normals.clear();
+    texCoords.clear();
+    primitiveIndices.clear();
+    primitives.clear();
+
+    const std::vector<Vk::GLTFModel::GeometryData>& geometryData = model.GetGeometryData();
+    assert(!geometryData.empty());
+
+    std::unordered_map<const Vk::GLTFModel::Material*, uint32_t> materialIndices;
+    for (size_t i = 0; i < model.GetMaterials().size(); ++i) {
+        materialIndices[model.GetMaterials()[i].get()] = static_cast<uint32_t>(i);
+    }
+
+    const uint32_t vertexStride = model.GetVertexStride();
+    const bool compactVertex = model.loadingParams.vertexFormat == Vk::GLTFModel::eVertexFormat::kCompact;
+
+    for (const auto& node : model.GetFlatNodes()) {
+        if (!node->mesh) {
+            continue;
+        }
+
+        const glm::mat4 transform = modelMatrix * node->GetWorldMatrix();
+
+        for (const auto& primitive : node->mesh->primitives) {
+            const Vk::GLTFModel::GeometryData& data = geometryData[primitive->geometryBufferIndex];
+            const uint8_t* vertices = data.vertices.data() + static_cast<size_t>(primitive->firstVertex) * vertexStride;
+            const bool index16 = primitive->indexType == VK_INDEX_TYPE_UINT16;
+            const size_t indexSize = index16 ? sizeof(uint16_t) : sizeof(uint32_t);
+            const uint8_t* indices = data.indices.data() + static_cast<size_t>(primitive->firstIndex) * indexSize;
+
+            const uint32_t verticesCount = primitive->hasIndices ? primitive->indexCount : primitive->vertexCount;
+            const uint32_t trianglesCount = verticesCount / 3;
+
+            for (uint32_t i = 0; i < trianglesCount * 3; ++i) {
+                uint32_t index = i;
+                if (primitive->hasIndices) {
+                    if (index16) {
+                        uint16_t index16Value;
+                        std::memcpy(&index16Value, indices + i * indexSize, sizeof(uint16_t));
+                        index = index16Value;
+                    } else {
+                        std::memcpy(&index, indices + i * indexSize, sizeof(uint32_t));
+                    }
+                }
+
+                glm::vec3 position;
+                glm::vec3 normal;
+                glm::vec4 vertexTexCoords;
+                LoadVertex(vertices + static_cast<size_t>(index) * vertexStride, compactVertex, position, normal, vertexTexCoords);
+
+                positions.push_back(glm::vec3(transform * glm::vec4(position, 1.0f)));
+                normals.push_back(normal);
+                texCoords.push_back(vertexTexCoords);
+            }
+
+            primitiveIndices.insert(primitiveIndices.end(), trianglesCount, static_cast<uint32_t>(primitives.size()));
+            primitives.push_back({ transform, materialIndices.at(&primitive->material) });
+        }
+    }
+}
@@ -0,0 +1,105 @@
+#include "Render/CPU/Texture.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace STexture {
+// Brings the coordinate into a range where texel indices fit into int, wrapping doesn't change the result
+float ReduceCoordinate(float coordinate, CG::CPU::eWrapMode wrapMode)
+{
+    switch (wrapMode) {
+    case CG::CPU::eWrapMode::kRepeat:
+        coordinate -= std::floor(coordinate);
+        break;
+    case CG::CPU::eWrapMode::kMirroredRepeat:
+        coordinate -= 2.0f * std::floor(coordinate * 0.5f);
+        break;
+    case CG::CPU::eWrapMode::kClampToEdge:
+        coordinate = std::min(std::max(coordinate, -1.0f), 2.0f);
+        break;
+    }
+
+    return std::isfinite(coordinate) ? coordinate : 0.0f;
+}
+
+uint32_t WrapTexel(int32_t texel, uint32_t size, CG::CPU::eWrapMode wrapMode)
+{
+    const int32_t count = static_cast<int32_t>(size);
+
+    switch (wrapMode) {
+    case CG::CPU::eWrapMode::kRepeat:
+        return static_cast<uint32_t>((texel % count + count) % count);
+    case CG::CPU::eWrapMode::kMirroredRepeat: {
+        int32_t period = texel % (2 * count);
+        period += period < 0 ? 2 * count : 0;
+        return static_cast<uint32_t>(period < count ? period : 2 * count - 1 - period);
+    }
+    case CG::CPU::eWrapMode::kClampToEdge:
+    default:
+        return static_cast<uint32_t>(std::min(std::max(texel, 0), count - 1));
+    }
+}
+}
+
+void CG::CPU::Texture::LoadRGBA8(uint32_t aWidth, uint32_t aHeight, std::vector<uint8_t> pixels, eWrapMode aWrapU, eWrapMode aWrapV)
+{
+    width = aWidth;
+    height = aHeight;
+    wrapU = aWrapU;
+    wrapV = aWrapV;
+    rgba8 = std::move(pixels);
+    rgb32f.clear();
+}
+
+void CG::CPU::Texture::LoadRGB32F(uint32_t aWidth, uint32_t aHeight, std::vector<float> pixels, eWrapMode aWrapU, eWrapMode aWrapV)
+{
+    width = aWidth;
+    height = aHeight;
+    wrapU = aWrapU;
+    wrapV = aWrapV;
+    rgb32f = std::move(pixels);
+    rgba8.clear();
+}
+
+glm::vec4 CG::CPU::Texture::Sample(const glm::vec2& uv) const
+{
+    using namespace STexture;
+
+    if (IsEmpty()) {
+        return glm::vec4(0.0f);
+    }
+
+    // Texel centers are at half integers
+    const float x = ReduceCoordinate(uv.x, wrapU) * width - 0.5f;
+    const float y = ReduceCoordinate(uv.y, wrapV) * height - 0.5f;
+    const float x0 = std::floor(x);
+    const float y0 = std::floor(y);
+    const float fx = x - x0;
+    const float fy = y - y0;
+
+    const uint32_t left = WrapTexel(static_cast<int32_t>(x0), width, wrapU);
+    const uint32_t right = WrapTexel(static_cast<int32_t>(x0) + 1, width, wrapU);
+    const uint32_t top = WrapTexel(static_cast<int32_t>(y0), height, wrapV);
+    const uint32_t bottom = WrapTexel(static_cast<int32_t>(y0) + 1, height, wrapV);
+
+    const glm::vec4 topRow = Fetch(left, top) * (1.0f - fx) + Fetch(right, top) * fx;
+    const glm::vec4 bottomRow = Fetch(left, bottom) * (1.0f - fx) + Fetch(right, bottom) * fx;
+    return topRow * (1.0f - fy) + bottomRow * fy;
+}
+
+bool CG::CPU::Texture::IsEmpty() const
+{
+    return width == 0 || height == 0;
+}
+
+glm::vec4 CG::CPU::Texture::Fetch(uint32_t x, uint32_t y) const
+{
+    const size_t texel = static_cast<size_t>(y) * width + x;
+
+    if (!rgba8.empty()) {
+        const uint8_t* pixel = rgba8.data() + texel * 4;
+        return glm::vec4(pixel[0], pixel[1], pixel[2], pixel[3]) * (1.0f / 255.0f);
+    }
+
+    const float* pixel = rgb32f.data() + texel * 3;
+    return glm::vec4(pixel[0], pixel[1], pixel[2], 1.0f);
+}
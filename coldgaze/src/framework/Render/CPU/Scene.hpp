@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Render/CPU/BVH.hpp"
+#include "Render/CPU/SceneGeometry.hpp"
+#include "Render/CPU/Texture.hpp"
+#include "glm/mat4x4.hpp"
+#include "glm/vec4.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace CG {
+class ThreadPool;
+
+namespace Vk {
+    class EnvironmentMap;
+    class GLTFModel;
+}
+
+namespace CPU {
+    // Mirrors Material of closest hit shaders
+    struct Material {
+        struct TextureSlot {
+            // -1 if the material has no texture or its texture has no CPU copy
+            int32_t texCoordSet = -1;
+            // Index in Scene::textures
+            int32_t texture = -1;
+        };
+
+        glm::vec4 baseColorFactor = glm::vec4(1.0f);
+        glm::vec4 emissiveFactor = glm::vec4(0.0f);
+        float workflow = 0.0f;
+        float metallicFactor = 0.0f;
+        float roughnessFactor = 0.0f;
+
+        TextureSlot baseColor;
+        TextureSlot physicalDescriptor;
+        TextureSlot normal;
+        TextureSlot occlusion;
+        TextureSlot emissive;
+    };
+
+    // HDR skybox and the distribution used to pick directions towards its bright parts, see Vk::EnvironmentMap
+    struct Environment {
+        Texture texture;
+        uint32_t distributionWidth = 0;
+        uint32_t distributionHeight = 0;
+        // Marginal CDF of rows (height + 1 values), then conditional CDF of every row (width + 1 values each)
+        std::vector<float> cdfs;
+    };
+
+    // Everything the CPU path tracer reads, copied out of a loaded model and environment map
+    struct Scene {
+        SceneGeometry geometry;
+        BVH bvh;
+        std::vector<Material> materials;
+        std::vector<Texture> textures;
+        Environment environment;
+
+        // The model has to be loaded with loadingParams.keepGeometryData and keepTextureData. Copies the posed
+        // geometry, textures and materials only, BuildBVH has to be called before tracing
+        void LoadModel(const Vk::GLTFModel& model, const glm::mat4& modelMatrix);
+        // Doesn't touch the model, so it can run off the render thread
+        void BuildBVH(ThreadPool* threadPool);
+        // The map has to be loaded with keepData
+        void LoadEnvironment(const Vk::EnvironmentMap& environmentMap);
+    };
+}
+}
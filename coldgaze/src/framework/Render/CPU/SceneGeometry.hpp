@@ -0,0 +1,40 @@
+#pragma once
+
+#include "glm/mat4x4.hpp"
+#include "glm/vec3.hpp"
+#include "glm/vec4.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace CG {
+namespace Vk {
+    class GLTFModel;
+}
+
+namespace CPU {
+    // Triangles of a loaded model for BVH::Build, with the vertex attributes closest hit shaders read
+    struct SceneGeometry {
+        struct Primitive {
+            // Object to world, the same as the transform of its TLAS instance
+            glm::mat4 transform;
+            // Index in GLTFModel::GetMaterials()
+            uint32_t materialIndex;
+        };
+
+        // World space positions, three vertices per triangle
+        std::vector<glm::vec3> positions;
+        // Object space normals and xy = UV0, zw = UV1 of every vertex of positions, decoded from either vertex format
+        std::vector<glm::vec3> normals;
+        std::vector<glm::vec4> texCoords;
+        // Index of the primitive every triangle comes from
+        std::vector<uint32_t> primitiveIndices;
+        // In GLTFModel::GetFlatNodes() order, the same as TLAS instances
+        std::vector<Primitive> primitives;
+
+        uint32_t GetTrianglesCount() const;
+
+        // The model has to be loaded with loadingParams.keepGeometryData
+        void LoadFromModel(const Vk::GLTFModel& model, const glm::mat4& modelMatrix);
+    };
+}
+}
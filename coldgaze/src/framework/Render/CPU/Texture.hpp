@@ -0,0 +1,41 @@
+#pragma once
+
+#include "glm/vec2.hpp"
+#include "glm/vec4.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace CG {
+namespace CPU {
+    enum class eWrapMode {
+        kRepeat,
+        kMirroredRepeat,
+        kClampToEdge,
+    };
+
+    // Single level RGBA8 UNORM or float RGB image with bilinear filtering, a stand-in for texture samplers of the shaders
+    class Texture {
+    public:
+        void LoadRGBA8(uint32_t aWidth, uint32_t aHeight, std::vector<uint8_t> pixels, eWrapMode aWrapU, eWrapMode aWrapV);
+        // Alpha of float RGB images is 1
+        void LoadRGB32F(uint32_t aWidth, uint32_t aHeight, std::vector<float> pixels, eWrapMode aWrapU, eWrapMode aWrapV);
+
+        // Empty texture returns zero. Non-finite coordinates read texel 0, as GPU samplers do in practice
+        glm::vec4 Sample(const glm::vec2& uv) const;
+
+        bool IsEmpty() const;
+
+    private:
+        glm::vec4 Fetch(uint32_t x, uint32_t y) const;
+
+        uint32_t width = 0;
+        uint32_t height = 0;
+        eWrapMode wrapU = eWrapMode::kRepeat;
+        eWrapMode wrapV = eWrapMode::kRepeat;
+
+        // Only one of them is filled
+        std::vector<uint8_t> rgba8;
+        std::vector<float> rgb32f;
+    };
+}
+}
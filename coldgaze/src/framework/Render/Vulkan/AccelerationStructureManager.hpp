@@ -0,0 +1,86 @@
+#pragma once
+
+#include "Render/Vulkan/Buffer.hpp"
+#include "Render/Vulkan/RayTracingBackend.hpp"
+#include "vulkan/vulkan_core.h"
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace CG {
+namespace Vk {
+    class Device;
+
+    // Owns acceleration structures of a scene. Bottom levels are built for fast tracing and then copied into
+    // allocations of their compacted size, every build takes its scratch memory from one arena,
+    // which is released as soon as the scene is built. Structures are created and built through the ray tracing backend.
+    class AccelerationStructureManager {
+    public:
+        AccelerationStructureManager(Device* vkDevice, RayTracingBackend* backend, VkQueue queue);
+        ~AccelerationStructureManager();
+
+        AccelerationStructureManager(const AccelerationStructureManager&) = delete;
+        AccelerationStructureManager& operator=(const AccelerationStructureManager&) = delete;
+
+        // Geometry descriptions are copied, buffers they point to have to stay alive until BuildBottomLevels.
+        // Returns index of the bottom level
+        uint32_t AddBottomLevel(const RayTracingGeometry* geometries, uint32_t geometryCount);
+
+        // Builds all added bottom levels with a few submits, compacts them and prints their memory before and after compaction.
+        // Handles of bottom levels are final only after this call
+        void BuildBottomLevels();
+
+        // instanceBuffer holds instanceCount instance records referencing bottom level handles.
+        // A top level which allows updates keeps its own scratch buffer for RecordTopLevelUpdate
+        void BuildTopLevel(VkBuffer instanceBuffer, uint32_t instanceCount, bool allowUpdate = false);
+
+        // Refits the top level to the new instance transforms, instanceBuffer has to hold the same instances in the same order.
+        // Barriers make the refit wait for previous traces and the next traces wait for the refit
+        void RecordTopLevelUpdate(VkCommandBuffer cmdBuffer, VkBuffer instanceBuffer) const;
+
+        // Measures GPU time of iterationsCount top level refits against as many full rebuilds and prints both.
+        // The top level has to allow updates
+        void BenchmarkTopLevel(VkBuffer instanceBuffer, uint32_t iterationsCount);
+
+        // Frees the scratch arena, the scene has to be built by then
+        void ReleaseScratch();
+
+        const AccelerationStructure& GetBottomLevel(uint32_t index) const;
+        uint32_t GetBottomLevelsCount() const;
+        const AccelerationStructure& GetTopLevel() const;
+
+        // Memory of all acceleration structures without scratch
+        VkDeviceSize GetMemorySize() const;
+
+        // Called with the share of built bottom levels in [0, 1]
+        std::function<void(float progress)> progressCallback;
+
+    private:
+        AccelerationStructureInputs GetBottomLevelInputs(uint32_t index) const;
+        AccelerationStructureInputs GetTopLevelInputs(VkBuffer instanceBuffer) const;
+
+        // Grows the arena if it's smaller than scratchSize, previous builds have to be finished
+        void ReserveScratch(VkDeviceSize scratchSize);
+
+        // Copies every bottom level into an allocation of its compacted size and destroys the original
+        void CompactBottomLevels();
+
+        void RecordBuildBarrier(VkCommandBuffer cmdBuffer) const;
+        void RecordTopLevelBuild(VkCommandBuffer cmdBuffer, VkBuffer instanceBuffer, bool update) const;
+
+        Device* vkDevice = nullptr;
+        RayTracingBackend* backend = nullptr;
+        VkQueue queue = VK_NULL_HANDLE;
+
+        std::vector<std::vector<RayTracingGeometry>> bottomLevelGeometries;
+        std::vector<AccelerationStructure> bottomLevels;
+        AccelerationStructure topLevel = {};
+        uint32_t topLevelInstanceCount = 0;
+        VkBuildAccelerationStructureFlagsKHR topLevelFlags = 0;
+
+        Buffer scratchBuffer = {};
+        // Fits both a rebuild and a refit of the top level, lives as long as the top level if it allows updates
+        Buffer topLevelScratchBuffer = {};
+    };
+}
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "vulkan/vulkan_core.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace CG {
+namespace Vk {
+    // CPU encoder of RGBA8 images into BC formats, blocks go to the GPU and into the scene cache as they are.
+    // Quality is traded for speed, every block is fitted along the principal axis of its texels without iterative refinement
+    namespace BlockCompressor {
+
+        // False if any texel of the level has alpha below 255
+        bool IsOpaque(const uint8_t* pixels, uint32_t width, uint32_t height);
+
+        // VK_FORMAT_BC1_RGB_UNORM_BLOCK, VK_FORMAT_BC5_UNORM_BLOCK (red and green only) or VK_FORMAT_BC7_UNORM_BLOCK
+        bool IsSupportedFormat(VkFormat format);
+
+        // Chain is tightly packed RGBA8 levels starting from the biggest one,
+        // dst gets the same levels in format and has to hold Texture2D::GetMipChainSize bytes
+        void CompressMipChain(const uint8_t* chain, uint32_t width, uint32_t height, uint16_t levelsCount, VkFormat format, uint8_t* dst);
+    }
+}
+}
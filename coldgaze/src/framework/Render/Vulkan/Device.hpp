@@ -41,7 +41,10 @@ namespace Vk {
         bool enableDebugMarkers = false;
 
         /** @brief Lock it when using device queue */
-        std::mutex deviceQueueMutex;
+        mutable std::mutex deviceQueueMutex;
+
+        /** @brief Index of the graphics family queue used by background loading, 0 shares the rendering queue if the family has only one */
+        uint32_t loadingQueueIndex = 0;
 
         /** @brief Contains queue family indices */
         struct
@@ -164,6 +167,21 @@ namespace Vk {
 			*/
         VkCommandBuffer CreateCommandBuffer(VkCommandBufferLevel level, bool begin = false) const;
 
+        /**
+			* Command pool used by CreateCommandBuffer and FlushCommandBuffer on the calling thread
+			*
+			* @return Pool set by SetThreadCommandPool, the default commandPool if there is none
+			*/
+        VkCommandPool GetCommandPool() const;
+
+        /**
+			* Replace the default command pool for the calling thread, pools are externally synchronized,
+			* so every thread recording commands besides the main one needs its own
+			*
+			* @param threadCommandPool Pool of the graphics family, VK_NULL_HANDLE restores the default one
+			*/
+        static void SetThreadCommandPool(VkCommandPool threadCommandPool);
+
         /**
 			* Check if an extension is supported by the (physical device)
 			*
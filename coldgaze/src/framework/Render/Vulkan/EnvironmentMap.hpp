@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Render/Vulkan/Buffer.hpp"
+#include "Render/Vulkan/Texture2D.hpp"
+#include "vulkan/vulkan_core.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace CG {
+class ThreadPool;
+
+namespace Vk {
+    class Device;
+
+    // Equirectangular HDR skybox together with a piecewise constant 2D distribution of its luminance,
+    // so hit shaders can pick directions towards bright parts of the sky instead of waiting for BSDF rays to find them.
+    class EnvironmentMap {
+    public:
+        // Distribution is built on a downsampled grid, an 8K map would need hundreds of megabytes of CDFs otherwise
+        static constexpr uint32_t kMaxDistributionWidth = 1024;
+        static constexpr uint32_t kMaxDistributionHeight = 512;
+
+        // Header of the distribution buffer, followed by the marginal CDF of rows (height + 1 floats)
+        // and by a conditional CDF of every row (width + 1 floats each)
+        struct DistributionHeader {
+            uint32_t width = 0;
+            uint32_t height = 0;
+            // Average of luminance * sin(theta) over the map, zero for a black sky
+            float integral = 0.0f;
+            uint32_t padding = 0;
+        };
+
+        // Luminance is gathered from the rows while the texture is decoded, CDFs of the rows are built on threadPool if it's given.
+        // Expects an empty map, a skybox is replaced by loading into a new one (see EngineImpl::LoadSkybox)
+        void LoadFromFile(const std::string& fileName, Device* device, VkQueue copyQueue, ThreadPool* threadPool,
+            Texture2D::eHDRFormat hdrFormat = Texture2D::eHDRFormat::kSharedExponent);
+
+        void Destroy();
+
+        Texture2D texture;
+        Buffer distribution;
+
+        // Keep CPU copies of the texels and the distribution, has to be set before LoadFromFile
+        bool keepData = false;
+
+        // CPU side copy of the map, empty unless keepData is set or if the file has no HDR rows (.ktx2)
+        struct Data {
+            uint32_t width = 0;
+            uint32_t height = 0;
+            // Float RGB rows from the top of the image, before they are packed into the texture format
+            std::vector<float> pixels;
+            DistributionHeader header;
+            std::vector<float> cdfs;
+        } data;
+    };
+}
+}
@@ -2,6 +2,7 @@
 #include "glm/ext/vector_float2.hpp"
 #include "vulkan/vulkan_core.h"
 #include <memory>
+#include <vector>
 
 namespace CG {
 class Engine;
@@ -23,8 +24,9 @@ namespace Vk {
         void Init(float width, float height);
         void InitResources(VkRenderPass renderPass, VkQueue queue);
 
-        void UpdateBuffers();
-        void DrawFrame(VkCommandBuffer commandBuffer);
+        // frameIndex picks the buffers of the frame in flight, the others may still be read by the GPU
+        void UpdateBuffers(uint32_t frameIndex);
+        void DrawFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex);
 
         void UpdateUI(float deltaTime);
 
@@ -45,10 +47,15 @@ namespace Vk {
         VkPipelineLayout pipelineLayout;
         VkPipeline pipeline;
 
-        std::unique_ptr<Buffer> vertexBuffer;
-        std::unique_ptr<Buffer> indexBuffer;
-        int32_t vertexCount = 0;
-        int32_t indexCount = 0;
+        struct FrameBuffers {
+            std::unique_ptr<Buffer> vertexBuffer;
+            std::unique_ptr<Buffer> indexBuffer;
+            int32_t vertexCount = 0;
+            int32_t indexCount = 0;
+        };
+
+        // One set per frame in flight
+        std::vector<FrameBuffers> frameBuffers;
     };
 }
 }
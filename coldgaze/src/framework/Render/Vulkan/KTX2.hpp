@@ -0,0 +1,40 @@
+#pragma once
+
+#include "vulkan/vulkan_core.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace CG {
+namespace Vk {
+    // Reader of KTX2 containers which can be uploaded as they are: a single 2D image without supercompression
+    // in one of the formats Texture2D::GetLevelSize knows. Basis Universal payloads would need a transcoder and are rejected.
+    namespace KTX2 {
+
+        struct Level {
+            const uint8_t* data = nullptr;
+            uint64_t size = 0;
+        };
+
+        struct Image {
+            VkFormat format = VK_FORMAT_UNDEFINED;
+            uint32_t width = 0;
+            uint32_t height = 0;
+            // Levels inside of the container memory, starting from the biggest one
+            std::vector<Level> levels;
+            // Container asks for the chain to be generated after loading, only the first level is stored then
+            bool generateMips = false;
+        };
+
+        bool IsKTX2(const uint8_t* data, size_t size);
+
+        // Returns false and describes the reason in error if the container can't be uploaded as is.
+        // Levels point into data, so it has to outlive the image
+        bool Parse(const uint8_t* data, size_t size, Image& image, std::string& error);
+
+        // Levels copied into a tightly packed chain, as Texture2D::FromBuffer expects them
+        std::vector<uint8_t> GetMipChain(const Image& image);
+    }
+}
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace CG {
+namespace Vk {
+    // CPU mip chain generation, used when better filtered levels are baked into the scene cache instead of GPU blits.
+    // Chains are tightly packed levels starting from the biggest one, the layout Texture2D::FromBuffer expects.
+    namespace MipGenerator {
+
+        enum class eFilter {
+            // 2x2 average, same as a linear blit
+            kBox,
+            // Kaiser windowed sinc, sharper distant surfaces at the cost of a slower bake
+            kKaiser,
+        };
+
+        // Full chain down to 1x1
+        uint16_t GetMipLevelsCount(uint32_t width, uint32_t height);
+
+        size_t GetMipChainSize(uint32_t width, uint32_t height, uint16_t levelsCount, size_t texelSize);
+
+        // Level 0 has to be in the chain already, levels 1 .. levelsCount - 1 are filled from it.
+        // RGBA8 unorm texels, values are filtered as stored
+        void GenerateMipChain(uint8_t* chain, uint32_t width, uint32_t height, uint16_t levelsCount, eFilter filter);
+
+        // Box filters the next level of a float image with channelsCount interleaved channels, rows are fed one by one in any order.
+        // A destination row is handed out as soon as all of its source rows arrived, so HDR images are filtered while they
+        // are decoded and only a few rows of every level are alive at once instead of whole float levels
+        class RowDownsampler {
+        public:
+            using RowCallback = std::function<void(uint32_t dstY, const float* dstRow)>;
+
+            // Destination gets max(size / 2, 1)
+            RowDownsampler(uint32_t srcWidth, uint32_t srcHeight, uint32_t channelsCount);
+
+            uint32_t GetDstWidth() const;
+            uint32_t GetDstHeight() const;
+
+            // Every source row has to be added exactly once
+            void AddRow(uint32_t srcY, const float* srcRow, const RowCallback& onRowReady);
+
+        private:
+            uint32_t srcHeight = 0;
+            uint32_t dstWidth = 0;
+            uint32_t dstHeight = 0;
+            uint32_t channelsCount = 0;
+
+            // tapsCount source indices and weights per destination texel, as in GenerateMipChain
+            uint32_t horizontalTapsCount = 0;
+            std::vector<uint32_t> horizontalIndices;
+            std::vector<float> horizontalWeights;
+            uint32_t verticalTapsCount = 0;
+            std::vector<uint32_t> verticalIndices;
+            std::vector<float> verticalWeights;
+
+            // Source rows every destination row still waits for, and its partial sums
+            std::vector<uint32_t> pendingRowsCounts;
+            std::vector<std::vector<float>> dstRows;
+
+            std::vector<float> filteredRow;
+        };
+    }
+}
+}
@@ -4,14 +4,17 @@
 
 #include "Buffer.hpp"
 #include "Debug.hpp"
+#include "SceneCache.hpp"
 #include "Texture2D.hpp"
 #include "glm/mat4x4.hpp"
 #include "glm/vec2.hpp"
 #include "glm/vec3.hpp"
 #include "glm/vec4.hpp"
 #include "vulkan/vulkan_core.h"
+#include <functional>
 #include <memory>
 #include <string>
+#include <unordered_map>
 
 #pragma warning(push, 0)
 #include "glm/ext/quaternion_float.hpp"
@@ -25,15 +28,21 @@ namespace tinygltf {
 class Node;
 class Model;
 struct Image;
+struct Primitive;
+struct Texture;
 }
 
 // This value also hard coded inside mesh.vert/frag
 uint32_t constexpr kMaxJointsCount = 128;
 
 namespace CG {
+class MappedFile;
+class ThreadPool;
+
 namespace Vk {
     class Device;
     class Texture2D;
+    class UploadBatcher;
 
     // The most of the classes code was took from https://github.com/SaschaWillems/Vulkan-glTF-PBR/blob/master/base/VulkanglTFModel.hpp
     class GLTFModel {
@@ -52,7 +61,7 @@ namespace Vk {
         };
 
         // TODO: animations
-        // The vertex layout for the model
+        // The vertex layout for the model. JOINTS_0 and WEIGHTS_0 aren't decoded, skinned meshes are traced in their bind pose
         struct Vertex {
             glm::vec4 pos;
             glm::vec4 normal;
@@ -61,13 +70,91 @@ namespace Vk {
             // glm::vec4 weight0;
         };
 
+        // Quantized alternative of Vertex, decoded by closest hit shaders
+        struct CompactVertex {
+            glm::vec3 pos;
+            uint32_t normal; // octahedral encoded, snorm16 x2
+            uint32_t uv0; // half x2
+            uint32_t uv1; // half x2
+        };
+
         Device* vkDevice = nullptr;
         VkQueue queue;
+        // Vertex attributes and images are decoded on the pool workers, serially if it is not set
+        ThreadPool* threadPool = nullptr;
+        // Called by LoadFromFile with the share of loading done so far, in [0, 1], from the thread which loads the model
+        std::function<void(float progress)> progressCallback;
+
+        enum class eGeometryLayout {
+            // Every primitive owns its vertex and index buffers
+            kPerPrimitive,
+            // All primitives of the model share one vertex and one index buffer
+            kMerged,
+        };
 
-        struct Texture {
-            void FromGLTFImage(const tinygltf::Image& gltfimage, TextureSampler textureSampler, Device* device, VkQueue copyQueue);
+        enum class eVertexFormat {
+            // Vertex, 48 bytes
+            kFull,
+            // CompactVertex, 24 bytes
+            kCompact,
+        };
+
+        enum class eMipGeneration {
+            // Textures have a single level
+            kNone,
+            // Linear blits right after the upload
+            kGPU,
+            // Chains are filtered on the CPU, see MipGenerator::eFilter, and baked into the scene cache
+            kBox,
+            kKaiser,
+        };
+
+        struct LoadingParams {
+            eGeometryLayout geometryLayout = eGeometryLayout::kMerged;
+            eVertexFormat vertexFormat = eVertexFormat::kFull;
+            eMipGeneration mipGeneration = eMipGeneration::kGPU;
+            // Encode images into BC1, BC5 or BC7 on the CPU, mips are filtered on the CPU then as BC formats can't be blitted.
+            // KTX2 images are uploaded in their own format either way
+            bool compressTextures = false;
+            // Reuse the .cgscene cache written next to the model after the first load
+            bool useSceneCache = true;
+            // Added to the usage of vertex and index buffers, e.g. for acceleration structure builds
+            VkBufferUsageFlags geometryBufferUsage = 0;
+            // Keep CPU copies of geometry buffers after the upload, see GetGeometryData
+            bool keepGeometryData = false;
+            // Keep CPU copies of the base level of R8G8B8A8 textures, see Texture::data
+            bool keepTextureData = false;
+        } loadingParams = {};
+
+        // Vertex and index buffers referenced by primitives through geometryBufferIndex
+        struct GeometryBuffer {
+            Buffer vertices = {};
+            Buffer indices = {};
+        };
 
+        // CPU side copy of a GeometryBuffer
+        struct GeometryData {
+            // Vertex or CompactVertex array, see GetVertexStride()
+            std::vector<uint8_t> vertices;
+            // Mix of uint16 and uint32 primitive ranges, every range starts 4 bytes aligned
+            std::vector<uint8_t> indices;
+
+            // Ranges reserved by LoadNode, vectors are allocated once all nodes are traversed
+            uint32_t vertexCount = 0;
+            size_t indicesSize = 0;
+        };
+
+        struct Texture {
             Texture2D texture;
+
+            // CPU side copy of the base level, empty unless the model was loaded with loadingParams.keepTextureData.
+            // Block compressed and other non R8G8B8A8 images are not kept
+            struct TextureData {
+                uint32_t width = 0;
+                uint32_t height = 0;
+                std::vector<uint8_t> pixels;
+                TextureSampler sampler = {};
+            } data;
         };
 
         struct Material {
@@ -122,21 +209,23 @@ namespace Vk {
             } pbrWorkflows;
             VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
 
-            void BuildBuffers(CG::Vk::Device* vkDevice, VkQueue queue);
+            void BuildBuffers(CG::Vk::Device* vkDevice, UploadBatcher& uploadBatcher);
         };
 
         // A primitive contains the data for a single draw call
         struct Primitive {
+            // Offsets inside of the geometry buffer, indices are relative to firstVertex.
+            // firstIndex is counted in elements of indexType
             uint32_t firstIndex = 0;
             uint32_t firstVertex = 0;
             uint32_t indexCount = 0;
             uint32_t vertexCount = 0;
 
-            // Single vertex buffer for all primitives
-            Buffer vertices = {};
+            // Single vertex and index buffer for all primitives in merged layout
+            uint32_t geometryBufferIndex = 0;
 
-            // Single index buffer for all primitives
-            Buffer indices = {};
+            // 16 bit indices are used by primitives with less than 65536 vertices
+            VkIndexType indexType = VK_INDEX_TYPE_UINT32;
 
             Material& material;
             bool hasIndices;
@@ -243,12 +332,20 @@ namespace Vk {
         GLTFModel();
         ~GLTFModel();
 
+        // Supports both .gltf and .glb, binary buffers are memory mapped.
+        // Loads the scene cache instead if it is up to date, writes it otherwise
         void LoadFromFile(const std::string& filename, float scale = 1.0f);
 
         std::vector<std::unique_ptr<Material>>& GetMaterials();
+        const std::vector<std::unique_ptr<Material>>& GetMaterials() const;
         const std::vector<Texture>& GetTextures() const;
         const std::vector<std::unique_ptr<Node>>& GetNodes() const;
         const std::vector<Node*>& GetFlatNodes() const;
+        const std::vector<GeometryBuffer>& GetGeometryBuffers() const;
+        // Empty unless the model was loaded with loadingParams.keepGeometryData
+        const std::vector<GeometryData>& GetGeometryData() const;
+        // Size of a single vertex inside of geometry buffers, depends on loadingParams.vertexFormat
+        uint32_t GetVertexStride() const;
 
         bool IsLoaded() const;
         void SetLoaded(bool loaded);
@@ -256,23 +353,62 @@ namespace Vk {
         const glm::vec3& GetSize() const;
         const uint32_t GetPrimitivesCount();
 
+        const std::vector<Animation>& GetAnimations() const;
+        // Sets translation, rotation and scale of the animated nodes at time in seconds, returns false if nothing was animated.
+        // World matrices of the nodes have to be queried again afterwards
+        bool UpdateAnimation(uint32_t index, float time);
+
     private:
+        // Parses the file with tinygltf, but keeps binary buffers (glb chunk, external .bin files) memory mapped
+        // instead of copying them into tinygltf::Buffer::data. Fills buffersData.
+        bool ParseFile(const std::string& filename, tinygltf::Model& input, std::string& error, std::string& warning);
+
+        // tinygltf image loader, userData is the model. Only reads image dimensions and keeps encoded bytes in encodedImages
+        static bool LoadEncodedImage(tinygltf::Image* image, const int imageIndex, std::string* error, std::string* warning,
+            int reqWidth, int reqHeight, const unsigned char* bytes, int size, void* userData);
+
+        // Returns false if there is no cache for the file or it is outdated, nothing is created in that case
+        bool LoadFromCache(const std::string& filename, float scale);
+        // Starts cacheWriter, models with animations and skins are not cached
+        void OpenCache(const std::string& filename, const tinygltf::Model& input);
+        // Has to be called while geometryData is still alive, texture payloads are already written by LoadTextures
+        void WriteCache(const std::string& filename, const tinygltf::Model& input, float scale);
+
         static VkSamplerAddressMode GetVkWrapMode(int32_t wrapMode);
         static VkFilter GetVkFilterMode(int32_t filterMode);
 
         void LoadTextureSamplers(const tinygltf::Model& input);
-        void LoadTextures(const tinygltf::Model& input);
-        void LoadMaterials(const tinygltf::Model& input);
+        // Copies the base level into texture.data if loadingParams.keepTextureData is set and the format is R8G8B8A8
+        void KeepTextureData(Texture& texture, const void* pixels, VkFormat format, uint32_t width, uint32_t height,
+            const TextureSampler& sampler) const;
+        TextureSampler GetTextureSampler(int32_t samplerIndex) const;
+        // LoadingParams::compressTextures, if the device can sample BC formats
+        bool IsTextureCompressionEnabled() const;
+        // Decodes images on the thread pool in batches limited by kDecodedImagesBudget, pixels go to the GPU through uploadBatcher
+        void LoadTextures(const tinygltf::Model& input, UploadBatcher& uploadBatcher);
+        // Image of the texture, KHR_texture_basisu one is preferred if it can be uploaded
+        size_t GetTextureSource(const tinygltf::Texture& texture) const;
+        void LoadMaterials(const tinygltf::Model& input, UploadBatcher& uploadBatcher);
         void LoadAnimations(const tinygltf::Model& input);
         void LoadSkins(const tinygltf::Model& input);
 
         void CalculateSize();
 
-        void CreatePrimitiveBuffers(Primitive* newPrimitive, std::vector<Vertex>& vertexBuffer,
-            std::vector<uint32_t>& indexBuffer);
+        void ReportProgress(float progress) const;
+
+        void CreateGeometryBuffers(UploadBatcher& uploadBatcher);
+        void CreateGeometryBuffer(GeometryBuffer& geometryBuffer, const void* vertices, VkDeviceSize verticesSize, const void* indices,
+            VkDeviceSize indicesSize, UploadBatcher& uploadBatcher);
 
         void LoadNode(Node* parent, const tinygltf::Node& node, uint32_t nodeIndex, const tinygltf::Model& input,
             float globalscale);
+        // Returns index of the decode job for the primitive. Repeated glTF meshes and primitives with identical source data
+        // share the job, so their Primitive objects point to the same geometry range
+        size_t ReserveGeometry(const tinygltf::Primitive& primitive, uint64_t meshPrimitiveKey, const tinygltf::Model& input,
+            uint32_t vertexCount, uint32_t indexCount);
+
+        // Fills geometryData with the primitives collected by LoadNode
+        void DecodePrimitives(const tinygltf::Model& input);
 
         /*
 				Model data
@@ -282,6 +418,49 @@ namespace Vk {
 
         std::vector<std::unique_ptr<Skin>> skins;
 
+        std::vector<GeometryBuffer> geometryBuffers;
+
+        // CPU side geometry, lives only until it is uploaded into geometryBuffers unless loadingParams.keepGeometryData is set
+        std::vector<GeometryData> geometryData;
+
+        // Node traversal only reserves geometry ranges, attributes are decoded afterwards in parallel
+        struct PrimitiveDecodeJob {
+            const tinygltf::Primitive* primitive = nullptr;
+            uint32_t geometryBufferIndex = 0;
+            uint32_t firstVertex = 0;
+            uint32_t firstIndex = 0;
+            uint32_t vertexCount = 0;
+            uint32_t indexCount = 0;
+            VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+        };
+        std::vector<PrimitiveDecodeJob> primitiveDecodeJobs;
+        // Keys are glTF mesh index in the high half and primitive index in the low one
+        std::unordered_map<uint64_t, size_t> meshPrimitiveDecodeJobs;
+        std::unordered_multimap<size_t, size_t> geometryHashDecodeJobs;
+
+        // Source data of every glTF buffer, valid only while the model is being loaded
+        std::vector<std::unique_ptr<MappedFile>> mappedFiles;
+        std::vector<const uint8_t*> buffersData;
+        // Model file and its external buffers relative to the model directory, scene cache depends on them
+        std::vector<std::string> sourceFiles;
+
+        // tinygltf only collects encoded images, LoadTextures decodes them in parallel
+        struct EncodedImage {
+            const uint8_t* data = nullptr;
+            size_t size = 0;
+            // Data URIs and external files are read by tinygltf into temporary storage, so their bytes are copied
+            std::vector<uint8_t> ownedData;
+            // KTX2 containers are uploaded as they are instead of being decoded
+            bool isKTX2 = false;
+            // False for KTX2 files the engine can't upload, textures fall back to their png or jpeg source then
+            bool isLoadable = true;
+        };
+        std::vector<EncodedImage> encodedImages;
+
+        // Scene cache is written along with the loading, blobs are streamed into it as soon as they are ready
+        std::unique_ptr<SceneCache::Writer> cacheWriter;
+        std::vector<SceneCache::TextureRecord> cacheTextureRecords;
+
         std::vector<Texture> textures;
         std::vector<TextureSampler> textureSamplers;
         std::vector<std::unique_ptr<Material>> materials;
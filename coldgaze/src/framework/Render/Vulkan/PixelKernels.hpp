@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace CG {
+namespace Vk {
+    // Packing of float RGB pixels of HDR images into formats, which are sampled with optimal tiling.
+    // Kernels follow VertexKernels::GetInstructionSet(), so both can be switched to a lower instruction set for comparison.
+    namespace PixelKernels {
+
+        // Round to nearest even, values above the half range become infinity
+        uint16_t FloatToHalf(float value);
+
+        // RGB -> VK_FORMAT_R16G16B16A16_SFLOAT texels with alpha 1.0
+        void ConvertRGBToHalfRGBA(const float* src, size_t texelsCount, uint16_t* dst);
+
+        // RGB -> VK_FORMAT_E5B9G9R9_UFLOAT_PACK32 texels, negative values are clamped to zero
+        void ConvertRGBToE5B9G9R9(const float* src, size_t texelsCount, uint32_t* dst);
+    }
+}
+}
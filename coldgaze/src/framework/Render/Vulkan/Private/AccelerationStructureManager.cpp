@@ -0,0 +1,370 @@
+#include "Render/Vulkan/AccelerationStructureManager.hpp"
+#include "Render/Vulkan/Debug.hpp"
+#include "Render/Vulkan/Device.hpp"
+#include "Render/Vulkan/Initializers.hpp"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+
+namespace SAccelerationStructureManager {
+constexpr VkBuildAccelerationStructureFlagsKHR kBottomLevelFlags
+    = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR;
+
+// Builds of one batch run concurrently in their own scratch ranges, the arena is limited to this size
+// unless a single build needs more
+constexpr VkDeviceSize kScratchArenaBudget = 128 * 1024 * 1024;
+// Keeps scratch ranges of concurrent builds apart by at least this, backends may need more
+constexpr VkDeviceSize kScratchAlignment = 256;
+// Submits are split, so the loading progress moves and a huge scene doesn't make one command buffer run for seconds
+constexpr uint32_t kMaxBuildsPerSubmit = 1024;
+
+VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+float ToMegabytes(VkDeviceSize size)
+{
+    return static_cast<float>(size) / (1024.0f * 1024.0f);
+}
+}
+
+CG::Vk::AccelerationStructureManager::AccelerationStructureManager(Device* aVkDevice, RayTracingBackend* aBackend, VkQueue aQueue)
+    : vkDevice(aVkDevice)
+    , backend(aBackend)
+    , queue(aQueue)
+{
+}
+
+CG::Vk::AccelerationStructureManager::~AccelerationStructureManager()
+{
+    for (AccelerationStructure& bottomLevel : bottomLevels) {
+        backend->DestroyAccelerationStructure(bottomLevel);
+    }
+    backend->DestroyAccelerationStructure(topLevel);
+
+    ReleaseScratch();
+    topLevelScratchBuffer.Destroy();
+}
+
+uint32_t CG::Vk::AccelerationStructureManager::AddBottomLevel(const RayTracingGeometry* geometries, uint32_t geometryCount)
+{
+    bottomLevelGeometries.emplace_back(geometries, geometries + geometryCount);
+    bottomLevels.emplace_back();
+    return static_cast<uint32_t>(bottomLevels.size() - 1);
+}
+
+void CG::Vk::AccelerationStructureManager::BuildBottomLevels()
+{
+    using namespace SAccelerationStructureManager;
+
+    if (bottomLevels.empty()) {
+        return;
+    }
+
+    const auto buildStart = std::chrono::high_resolution_clock::now();
+
+    const uint32_t bottomLevelsCount = static_cast<uint32_t>(bottomLevels.size());
+    const VkDeviceSize scratchAlignment = std::max(kScratchAlignment, backend->GetScratchAlignment());
+
+    std::vector<VkDeviceSize> scratchSizes(bottomLevelsCount);
+    VkDeviceSize maxScratchSize = 0;
+    VkDeviceSize totalScratchSize = 0;
+    for (uint32_t i = 0; i < bottomLevelsCount; ++i) {
+        backend->CreateAccelerationStructure(GetBottomLevelInputs(i), bottomLevels[i]);
+
+        scratchSizes[i] = AlignUp(bottomLevels[i].buildScratchSize, scratchAlignment);
+        maxScratchSize = std::max(maxScratchSize, scratchSizes[i]);
+        totalScratchSize += scratchSizes[i];
+    }
+
+    ReserveScratch(std::max(maxScratchSize, std::min(totalScratchSize, kScratchArenaBudget)));
+
+    // Builds are packed into batches which fit the arena together, a batch waits for the previous one
+    // only because it reuses its scratch ranges
+    uint32_t batchesCount = 0;
+    uint32_t submitsCount = 0;
+    uint32_t builtCount = 0;
+    while (builtCount < bottomLevelsCount) {
+        VkCommandBuffer cmdBuffer = vkDevice->CreateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+
+        const uint32_t submitEnd = std::min(bottomLevelsCount, builtCount + kMaxBuildsPerSubmit);
+        VkDeviceSize scratchOffset = 0;
+        for (uint32_t i = builtCount; i < submitEnd; ++i) {
+            if (scratchOffset + scratchSizes[i] > scratchBuffer.size) {
+                RecordBuildBarrier(cmdBuffer);
+                scratchOffset = 0;
+                ++batchesCount;
+            }
+
+            backend->RecordBuild(cmdBuffer, GetBottomLevelInputs(i), bottomLevels[i], false, scratchBuffer.buffer, scratchOffset);
+
+            scratchOffset += scratchSizes[i];
+        }
+
+        RecordBuildBarrier(cmdBuffer);
+        ++batchesCount;
+
+        vkDevice->FlushCommandBuffer(cmdBuffer, queue);
+        ++submitsCount;
+
+        builtCount = submitEnd;
+        if (progressCallback) {
+            progressCallback(static_cast<float>(builtCount) / static_cast<float>(bottomLevelsCount));
+        }
+    }
+
+    const auto buildEnd = std::chrono::high_resolution_clock::now();
+    std::cout << "Built " << bottomLevelsCount << " BLAS in " << batchesCount << " batch(es), " << submitsCount << " submit(s), "
+              << std::chrono::duration<float, std::milli>(buildEnd - buildStart).count() << " ms" << std::endl;
+
+    VkDeviceSize builtSize = 0;
+    for (const AccelerationStructure& bottomLevel : bottomLevels) {
+        builtSize += bottomLevel.memorySize;
+    }
+
+    CompactBottomLevels();
+
+    VkDeviceSize compactedSize = 0;
+    for (const AccelerationStructure& bottomLevel : bottomLevels) {
+        compactedSize += bottomLevel.memorySize;
+    }
+
+    std::cout << "Compacted " << bottomLevels.size() << " BLAS from " << ToMegabytes(builtSize) << " MB to "
+              << ToMegabytes(compactedSize) << " MB, scratch " << ToMegabytes(scratchBuffer.size) << " MB" << std::endl;
+
+    // Geometry descriptions aren't needed after the build
+    bottomLevelGeometries.clear();
+}
+
+void CG::Vk::AccelerationStructureManager::BuildTopLevel(VkBuffer instanceBuffer, uint32_t instanceCount, bool allowUpdate /*= false*/)
+{
+    using namespace SAccelerationStructureManager;
+
+    topLevelInstanceCount = instanceCount;
+    topLevelFlags = allowUpdate ? VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR : 0;
+
+    backend->CreateAccelerationStructure(GetTopLevelInputs(instanceBuffer), topLevel);
+
+    if (allowUpdate) {
+        VK_CHECK_RESULT(vkDevice->CreateBuffer(backend->GetScratchBufferUsage(),
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            &topLevelScratchBuffer, std::max(topLevel.buildScratchSize, topLevel.updateScratchSize)));
+    } else {
+        ReserveScratch(topLevel.buildScratchSize);
+    }
+
+    VkCommandBuffer cmdBuffer = vkDevice->CreateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+
+    RecordTopLevelBuild(cmdBuffer, instanceBuffer, false);
+    RecordBuildBarrier(cmdBuffer);
+
+    vkDevice->FlushCommandBuffer(cmdBuffer, queue);
+
+    std::cout << "Acceleration structures take " << ToMegabytes(GetMemorySize()) << " MB" << std::endl;
+}
+
+void CG::Vk::AccelerationStructureManager::RecordTopLevelUpdate(VkCommandBuffer cmdBuffer, VkBuffer instanceBuffer) const
+{
+    assert(topLevelFlags & VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR);
+
+    VkMemoryBarrier memoryBarrier = Initializers::CreateMemoryBarrier();
+    memoryBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+    memoryBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+    vkCmdPipelineBarrier(cmdBuffer,
+        VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+        VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+        0, 1, &memoryBarrier, 0, 0, 0, 0);
+
+    RecordTopLevelBuild(cmdBuffer, instanceBuffer, true);
+
+    memoryBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+    memoryBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+    vkCmdPipelineBarrier(cmdBuffer,
+        VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+        VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR,
+        0, 1, &memoryBarrier, 0, 0, 0, 0);
+}
+
+void CG::Vk::AccelerationStructureManager::BenchmarkTopLevel(VkBuffer instanceBuffer, uint32_t iterationsCount)
+{
+    assert(topLevelFlags & VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR);
+
+    // Before rebuilds, after rebuilds and after refits
+    constexpr uint32_t kTimestampsCount = 3;
+
+    VkQueryPoolCreateInfo queryPoolCI = {};
+    queryPoolCI.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolCI.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolCI.queryCount = kTimestampsCount;
+
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    VK_CHECK_RESULT(vkCreateQueryPool(vkDevice->logicalDevice, &queryPoolCI, nullptr, &queryPool));
+
+    VkCommandBuffer cmdBuffer = vkDevice->CreateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+
+    vkCmdResetQueryPool(cmdBuffer, queryPool, 0, kTimestampsCount);
+    RecordBuildBarrier(cmdBuffer);
+
+    // Every build has to finish before the next one, as it happens between frames
+    vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, queryPool, 0);
+    for (uint32_t i = 0; i < iterationsCount; ++i) {
+        RecordTopLevelBuild(cmdBuffer, instanceBuffer, false);
+        RecordBuildBarrier(cmdBuffer);
+    }
+    vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, queryPool, 1);
+    for (uint32_t i = 0; i < iterationsCount; ++i) {
+        RecordTopLevelBuild(cmdBuffer, instanceBuffer, true);
+        RecordBuildBarrier(cmdBuffer);
+    }
+    vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, queryPool, 2);
+
+    vkDevice->FlushCommandBuffer(cmdBuffer, queue);
+
+    uint64_t timestamps[kTimestampsCount] = {};
+    VK_CHECK_RESULT(vkGetQueryPoolResults(vkDevice->logicalDevice, queryPool, 0, kTimestampsCount,
+        sizeof(timestamps), timestamps, sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+
+    vkDestroyQueryPool(vkDevice->logicalDevice, queryPool, nullptr);
+
+    const double nanosecondsPerTick = vkDevice->properties.limits.timestampPeriod;
+    const double rebuildMilliseconds = (timestamps[1] - timestamps[0]) * nanosecondsPerTick * 1e-6 / iterationsCount;
+    const double refitMilliseconds = (timestamps[2] - timestamps[1]) * nanosecondsPerTick * 1e-6 / iterationsCount;
+
+    std::cout << "TLAS of " << topLevelInstanceCount << " instance(s) over " << iterationsCount << " iteration(s): rebuild "
+              << rebuildMilliseconds << " ms, refit " << refitMilliseconds << " ms" << std::endl;
+}
+
+void CG::Vk::AccelerationStructureManager::ReleaseScratch()
+{
+    scratchBuffer.Destroy();
+    scratchBuffer.size = 0;
+}
+
+const CG::Vk::AccelerationStructure& CG::Vk::AccelerationStructureManager::GetBottomLevel(uint32_t index) const
+{
+    return bottomLevels[index];
+}
+
+uint32_t CG::Vk::AccelerationStructureManager::GetBottomLevelsCount() const
+{
+    return static_cast<uint32_t>(bottomLevels.size());
+}
+
+const CG::Vk::AccelerationStructure& CG::Vk::AccelerationStructureManager::GetTopLevel() const
+{
+    return topLevel;
+}
+
+VkDeviceSize CG::Vk::AccelerationStructureManager::GetMemorySize() const
+{
+    VkDeviceSize memorySize = topLevel.memorySize;
+    for (const AccelerationStructure& bottomLevel : bottomLevels) {
+        memorySize += bottomLevel.memorySize;
+    }
+    return memorySize;
+}
+
+CG::Vk::AccelerationStructureInputs CG::Vk::AccelerationStructureManager::GetBottomLevelInputs(uint32_t index) const
+{
+    AccelerationStructureInputs inputs;
+    inputs.level = eAccelerationStructureLevel::kBottom;
+    inputs.flags = SAccelerationStructureManager::kBottomLevelFlags;
+    inputs.geometries = bottomLevelGeometries[index].data();
+    inputs.geometryCount = static_cast<uint32_t>(bottomLevelGeometries[index].size());
+    return inputs;
+}
+
+CG::Vk::AccelerationStructureInputs CG::Vk::AccelerationStructureManager::GetTopLevelInputs(VkBuffer instanceBuffer) const
+{
+    AccelerationStructureInputs inputs;
+    inputs.level = eAccelerationStructureLevel::kTop;
+    inputs.flags = topLevelFlags;
+    inputs.instanceBuffer = instanceBuffer;
+    inputs.instanceCount = topLevelInstanceCount;
+    return inputs;
+}
+
+void CG::Vk::AccelerationStructureManager::ReserveScratch(VkDeviceSize scratchSize)
+{
+    if (scratchBuffer.buffer != VK_NULL_HANDLE && scratchBuffer.size >= scratchSize) {
+        return;
+    }
+
+    ReleaseScratch();
+    VK_CHECK_RESULT(vkDevice->CreateBuffer(backend->GetScratchBufferUsage(),
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        &scratchBuffer, scratchSize));
+}
+
+void CG::Vk::AccelerationStructureManager::CompactBottomLevels()
+{
+    const uint32_t bottomLevelsCount = static_cast<uint32_t>(bottomLevels.size());
+
+    VkQueryPoolCreateInfo queryPoolCI = {};
+    queryPoolCI.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolCI.queryType = backend->GetCompactedSizeQueryType();
+    queryPoolCI.queryCount = bottomLevelsCount;
+
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    VK_CHECK_RESULT(vkCreateQueryPool(vkDevice->logicalDevice, &queryPoolCI, nullptr, &queryPool));
+
+    {
+        VkCommandBuffer cmdBuffer = vkDevice->CreateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+
+        vkCmdResetQueryPool(cmdBuffer, queryPool, 0, bottomLevelsCount);
+        RecordBuildBarrier(cmdBuffer);
+        backend->RecordCompactedSizesQuery(cmdBuffer, bottomLevels, queryPool, 0);
+
+        vkDevice->FlushCommandBuffer(cmdBuffer, queue);
+    }
+
+    std::vector<VkDeviceSize> compactedSizes(bottomLevelsCount);
+    VK_CHECK_RESULT(vkGetQueryPoolResults(vkDevice->logicalDevice, queryPool, 0, bottomLevelsCount,
+        compactedSizes.size() * sizeof(VkDeviceSize), compactedSizes.data(), sizeof(VkDeviceSize),
+        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+
+    vkDestroyQueryPool(vkDevice->logicalDevice, queryPool, nullptr);
+
+    std::vector<AccelerationStructure> compactedLevels(bottomLevelsCount);
+    for (uint32_t i = 0; i < bottomLevelsCount; ++i) {
+        backend->CreateCompactedBottomLevel(SAccelerationStructureManager::kBottomLevelFlags, compactedSizes[i], compactedLevels[i]);
+    }
+
+    {
+        VkCommandBuffer cmdBuffer = vkDevice->CreateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+
+        for (uint32_t i = 0; i < bottomLevelsCount; ++i) {
+            backend->RecordCompactingCopy(cmdBuffer, bottomLevels[i], compactedLevels[i]);
+        }
+        RecordBuildBarrier(cmdBuffer);
+
+        vkDevice->FlushCommandBuffer(cmdBuffer, queue);
+    }
+
+    for (uint32_t i = 0; i < bottomLevelsCount; ++i) {
+        backend->DestroyAccelerationStructure(bottomLevels[i]);
+        bottomLevels[i] = compactedLevels[i];
+    }
+}
+
+void CG::Vk::AccelerationStructureManager::RecordBuildBarrier(VkCommandBuffer cmdBuffer) const
+{
+    VkMemoryBarrier memoryBarrier = Initializers::CreateMemoryBarrier();
+    memoryBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+    memoryBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+    vkCmdPipelineBarrier(cmdBuffer,
+        VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+        VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+        0, 1, &memoryBarrier, 0, 0, 0, 0);
+}
+
+void CG::Vk::AccelerationStructureManager::RecordTopLevelBuild(VkCommandBuffer cmdBuffer, VkBuffer instanceBuffer, bool update) const
+{
+    // Top levels which allow updates have their own scratch, the others are built only once from the arena
+    const VkBuffer scratch = topLevelScratchBuffer.buffer != VK_NULL_HANDLE ? topLevelScratchBuffer.buffer : scratchBuffer.buffer;
+
+    backend->RecordBuild(cmdBuffer, GetTopLevelInputs(instanceBuffer), topLevel, update, scratch, 0);
+}
@@ -0,0 +1,391 @@
+#include "Render/Vulkan/BlockCompressor.hpp"
+#include "Render/Vulkan/Texture2D.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace SBlockCompressor {
+constexpr uint32_t kBlockSize = 4;
+constexpr uint32_t kBlockTexelsCount = kBlockSize * kBlockSize;
+
+// BC7 interpolation weights of 4 bit indices
+constexpr int32_t kWeights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// RGBA8 texels of a 4x4 block
+using Block = uint8_t[kBlockTexelsCount][4];
+
+// Levels which are not a multiple of 4 repeat their edge texels, decoders ignore texels outside of the level anyway
+void LoadBlock(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, Block& block)
+{
+    for (uint32_t y = 0; y < kBlockSize; ++y) {
+        const uint32_t srcY = std::min(blockY * kBlockSize + y, height - 1);
+        for (uint32_t x = 0; x < kBlockSize; ++x) {
+            const uint32_t srcX = std::min(blockX * kBlockSize + x, width - 1);
+            memcpy(block[y * kBlockSize + x], pixels + (static_cast<size_t>(srcY) * width + srcX) * 4, 4);
+        }
+    }
+}
+
+// Direction of the biggest variance of the first channelsCount channels, found with power iterations on the covariance matrix
+void GetPrincipalAxis(const Block& block, uint32_t channelsCount, float (&mean)[4], float (&axis)[4])
+{
+    for (uint32_t c = 0; c < 4; ++c) {
+        mean[c] = 0.0f;
+        axis[c] = 0.0f;
+    }
+
+    for (uint32_t i = 0; i < kBlockTexelsCount; ++i) {
+        for (uint32_t c = 0; c < channelsCount; ++c) {
+            mean[c] += static_cast<float>(block[i][c]) / kBlockTexelsCount;
+        }
+    }
+
+    float covariance[4][4] = {};
+    for (uint32_t i = 0; i < kBlockTexelsCount; ++i) {
+        for (uint32_t a = 0; a < channelsCount; ++a) {
+            for (uint32_t b = 0; b < channelsCount; ++b) {
+                covariance[a][b] += (block[i][a] - mean[a]) * (block[i][b] - mean[b]);
+            }
+        }
+    }
+
+    float trace = 0.0f;
+    uint32_t maxVarianceChannel = 0;
+    for (uint32_t c = 0; c < channelsCount; ++c) {
+        trace += covariance[c][c];
+        if (covariance[c][c] > covariance[maxVarianceChannel][maxVarianceChannel]) {
+            maxVarianceChannel = c;
+        }
+    }
+
+    // Flat block, any axis works
+    if (trace < 1e-6f) {
+        axis[0] = 1.0f;
+        return;
+    }
+
+    // Row of the channel with the biggest variance is never orthogonal to the principal axis,
+    // unlike a fixed seed such as (1, 1, 1) for red-green or anti-correlated normal map edges
+    for (uint32_t c = 0; c < channelsCount; ++c) {
+        axis[c] = covariance[maxVarianceChannel][c];
+    }
+
+    for (uint32_t iteration = 0; iteration < 8; ++iteration) {
+        float product[4] = {};
+        float maxComponent = 0.0f;
+        for (uint32_t a = 0; a < channelsCount; ++a) {
+            for (uint32_t b = 0; b < channelsCount; ++b) {
+                product[a] += covariance[a][b] * axis[b];
+            }
+            maxComponent = std::max(maxComponent, std::abs(product[a]));
+        }
+
+        for (uint32_t c = 0; c < channelsCount; ++c) {
+            axis[c] = product[c] / maxComponent;
+        }
+    }
+
+    float length = 0.0f;
+    for (uint32_t c = 0; c < channelsCount; ++c) {
+        length += axis[c] * axis[c];
+    }
+    length = std::sqrt(length);
+    for (uint32_t c = 0; c < channelsCount; ++c) {
+        axis[c] /= length;
+    }
+}
+
+// Block texels projected onto the axis span [0, 1] between the returned endpoints
+void GetAxisEndpoints(const Block& block, uint32_t channelsCount, float insetFraction, float (&endpoint0)[4], float (&endpoint1)[4])
+{
+    float mean[4], axis[4];
+    GetPrincipalAxis(block, channelsCount, mean, axis);
+
+    float minProjection = std::numeric_limits<float>::max();
+    float maxProjection = -std::numeric_limits<float>::max();
+    for (uint32_t i = 0; i < kBlockTexelsCount; ++i) {
+        float projection = 0.0f;
+        for (uint32_t c = 0; c < channelsCount; ++c) {
+            projection += (block[i][c] - mean[c]) * axis[c];
+        }
+        minProjection = std::min(minProjection, projection);
+        maxProjection = std::max(maxProjection, projection);
+    }
+
+    // Pulling endpoints inside keeps a few outliers from stretching the whole palette
+    const float inset = (maxProjection - minProjection) * insetFraction;
+    minProjection += inset;
+    maxProjection -= inset;
+
+    for (uint32_t c = 0; c < 4; ++c) {
+        endpoint0[c] = std::clamp(mean[c] + axis[c] * minProjection, 0.0f, 255.0f);
+        endpoint1[c] = std::clamp(mean[c] + axis[c] * maxProjection, 0.0f, 255.0f);
+    }
+}
+
+template <uint32_t paletteSize>
+uint32_t GetClosestIndex(const uint8_t* texel, const int32_t (&palette)[paletteSize][4], uint32_t channelsCount)
+{
+    uint32_t bestIndex = 0;
+    int32_t bestError = std::numeric_limits<int32_t>::max();
+    for (uint32_t p = 0; p < paletteSize; ++p) {
+        int32_t error = 0;
+        for (uint32_t c = 0; c < channelsCount; ++c) {
+            const int32_t delta = static_cast<int32_t>(texel[c]) - palette[p][c];
+            error += delta * delta;
+        }
+        if (error < bestError) {
+            bestError = error;
+            bestIndex = p;
+        }
+    }
+    return bestIndex;
+}
+
+uint16_t PackRGB565(const float (&color)[4])
+{
+    const uint32_t r = static_cast<uint32_t>(color[0] * 31.0f / 255.0f + 0.5f);
+    const uint32_t g = static_cast<uint32_t>(color[1] * 63.0f / 255.0f + 0.5f);
+    const uint32_t b = static_cast<uint32_t>(color[2] * 31.0f / 255.0f + 0.5f);
+    return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+void UnpackRGB565(uint16_t color, int32_t (&rgb)[4])
+{
+    const int32_t r = (color >> 11) & 31;
+    const int32_t g = (color >> 5) & 63;
+    const int32_t b = color & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+    rgb[3] = 255;
+}
+
+void CompressBC1Block(const Block& block, uint8_t* dst)
+{
+    float endpoint0[4], endpoint1[4];
+    GetAxisEndpoints(block, 3, 1.0f / 16.0f, endpoint0, endpoint1);
+
+    uint16_t color0 = PackRGB565(endpoint1);
+    uint16_t color1 = PackRGB565(endpoint0);
+    // color0 > color1 selects the 4 color mode without transparency
+    if (color0 < color1) {
+        std::swap(color0, color1);
+    }
+
+    uint32_t indices = 0;
+    // Equal colors decode in the 3 color mode, but index 0 is color0 there as well
+    if (color0 != color1) {
+        int32_t palette[4][4];
+        UnpackRGB565(color0, palette[0]);
+        UnpackRGB565(color1, palette[1]);
+        for (uint32_t c = 0; c < 4; ++c) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        for (uint32_t i = 0; i < kBlockTexelsCount; ++i) {
+            indices |= GetClosestIndex(block[i], palette, 3) << (i * 2);
+        }
+    }
+
+    dst[0] = static_cast<uint8_t>(color0 & 0xFF);
+    dst[1] = static_cast<uint8_t>(color0 >> 8);
+    dst[2] = static_cast<uint8_t>(color1 & 0xFF);
+    dst[3] = static_cast<uint8_t>(color1 >> 8);
+    for (uint32_t b = 0; b < 4; ++b) {
+        dst[4 + b] = static_cast<uint8_t>(indices >> (b * 8));
+    }
+}
+
+// Single channel block, two of them make a BC5 block
+void CompressBC4Block(const Block& block, uint32_t channel, uint8_t* dst)
+{
+    uint8_t minValue = 255;
+    uint8_t maxValue = 0;
+    for (uint32_t i = 0; i < kBlockTexelsCount; ++i) {
+        minValue = std::min(minValue, block[i][channel]);
+        maxValue = std::max(maxValue, block[i][channel]);
+    }
+
+    memset(dst, 0, 8);
+    // Red0 > red1 selects 8 interpolated values, for a flat block every index stays 0
+    dst[0] = maxValue;
+    dst[1] = minValue;
+    if (maxValue == minValue) {
+        return;
+    }
+
+    int32_t palette[8][4] = {};
+    palette[0][0] = maxValue;
+    palette[1][0] = minValue;
+    for (int32_t p = 2; p < 8; ++p) {
+        palette[p][0] = ((8 - p) * maxValue + (p - 1) * minValue) / 7;
+    }
+
+    uint64_t indices = 0;
+    for (uint32_t i = 0; i < kBlockTexelsCount; ++i) {
+        const uint8_t value = block[i][channel];
+        indices |= static_cast<uint64_t>(GetClosestIndex(&value, palette, 1)) << (i * 3);
+    }
+    for (uint32_t b = 0; b < 6; ++b) {
+        dst[2 + b] = static_cast<uint8_t>(indices >> (b * 8));
+    }
+}
+
+void CompressBC5Block(const Block& block, uint8_t* dst)
+{
+    CompressBC4Block(block, 0, dst);
+    CompressBC4Block(block, 1, dst + 8);
+}
+
+// Appends bits from the least significant one, dst has to be zeroed
+class BitWriter {
+public:
+    explicit BitWriter(uint8_t* aDst)
+        : dst(aDst)
+    {
+    }
+
+    void Write(uint32_t value, uint32_t bitsCount)
+    {
+        for (uint32_t b = 0; b < bitsCount; ++b, ++position) {
+            if ((value >> b) & 1) {
+                dst[position >> 3] |= static_cast<uint8_t>(1 << (position & 7));
+            }
+        }
+    }
+
+private:
+    uint8_t* dst = nullptr;
+    uint32_t position = 0;
+};
+
+// 7 bit channels of a BC7 mode 6 endpoint share the lowest bit, the p-bit with the smallest error wins
+void QuantizeEndpoint(const float (&color)[4], uint32_t (&quantized)[4], uint32_t& pBit)
+{
+    float bestError = std::numeric_limits<float>::max();
+    for (uint32_t p = 0; p < 2; ++p) {
+        uint32_t candidate[4];
+        float error = 0.0f;
+        for (uint32_t c = 0; c < 4; ++c) {
+            candidate[c] = static_cast<uint32_t>(std::clamp(std::round((color[c] - p) * 0.5f), 0.0f, 127.0f));
+            const float delta = static_cast<float>(candidate[c] * 2 + p) - color[c];
+            error += delta * delta;
+        }
+        if (error < bestError) {
+            bestError = error;
+            pBit = p;
+            memcpy(quantized, candidate, sizeof(candidate));
+        }
+    }
+}
+
+// Mode 6 only: one subset, RGBA endpoints and 4 bit indices. Other modes would handle blocks with several
+// distinct colors better, but mode 6 alone is already far ahead of BC1 and keeps the encoder simple
+void CompressBC7Block(const Block& block, uint8_t* dst)
+{
+    float endpoint0[4], endpoint1[4];
+    GetAxisEndpoints(block, 4, 0.0f, endpoint0, endpoint1);
+
+    uint32_t quantized0[4], quantized1[4];
+    uint32_t pBit0 = 0, pBit1 = 0;
+    QuantizeEndpoint(endpoint0, quantized0, pBit0);
+    QuantizeEndpoint(endpoint1, quantized1, pBit1);
+
+    int32_t palette[16][4];
+    for (uint32_t p = 0; p < 16; ++p) {
+        for (uint32_t c = 0; c < 4; ++c) {
+            const int32_t e0 = static_cast<int32_t>(quantized0[c] * 2 + pBit0);
+            const int32_t e1 = static_cast<int32_t>(quantized1[c] * 2 + pBit1);
+            palette[p][c] = ((64 - kWeights4[p]) * e0 + kWeights4[p] * e1 + 32) >> 6;
+        }
+    }
+
+    uint32_t indices[kBlockTexelsCount];
+    for (uint32_t i = 0; i < kBlockTexelsCount; ++i) {
+        indices[i] = GetClosestIndex(block[i], palette, 4);
+    }
+
+    // Highest bit of the first index is implicitly 0, so endpoints are swapped if it is set
+    if (indices[0] >= 8) {
+        std::swap(quantized0, quantized1);
+        std::swap(pBit0, pBit1);
+        for (uint32_t& index : indices) {
+            index = 15 - index;
+        }
+    }
+
+    memset(dst, 0, 16);
+    BitWriter writer(dst);
+    writer.Write(1 << 6, 7);
+    for (uint32_t c = 0; c < 4; ++c) {
+        writer.Write(quantized0[c], 7);
+        writer.Write(quantized1[c], 7);
+    }
+    writer.Write(pBit0, 1);
+    writer.Write(pBit1, 1);
+    writer.Write(indices[0], 3);
+    for (uint32_t i = 1; i < kBlockTexelsCount; ++i) {
+        writer.Write(indices[i], 4);
+    }
+}
+
+void CompressLevel(const uint8_t* pixels, uint32_t width, uint32_t height, VkFormat format, uint8_t* dst)
+{
+    const uint32_t blocksX = (width + kBlockSize - 1) / kBlockSize;
+    const uint32_t blocksY = (height + kBlockSize - 1) / kBlockSize;
+    const size_t blockBytes = format == VK_FORMAT_BC1_RGB_UNORM_BLOCK ? 8 : 16;
+
+    Block block;
+    for (uint32_t blockY = 0; blockY < blocksY; ++blockY) {
+        for (uint32_t blockX = 0; blockX < blocksX; ++blockX) {
+            LoadBlock(pixels, width, height, blockX, blockY, block);
+
+            switch (format) {
+            case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+                CompressBC1Block(block, dst);
+                break;
+            case VK_FORMAT_BC5_UNORM_BLOCK:
+                CompressBC5Block(block, dst);
+                break;
+            default:
+                CompressBC7Block(block, dst);
+                break;
+            }
+            dst += blockBytes;
+        }
+    }
+}
+}
+
+bool CG::Vk::BlockCompressor::IsOpaque(const uint8_t* pixels, uint32_t width, uint32_t height)
+{
+    const size_t pixelsCount = static_cast<size_t>(width) * height;
+    for (size_t i = 0; i < pixelsCount; ++i) {
+        if (pixels[i * 4 + 3] != 255) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CG::Vk::BlockCompressor::IsSupportedFormat(VkFormat format)
+{
+    return format == VK_FORMAT_BC1_RGB_UNORM_BLOCK || format == VK_FORMAT_BC5_UNORM_BLOCK || format == VK_FORMAT_BC7_UNORM_BLOCK;
+}
+
+void CG::Vk::BlockCompressor::CompressMipChain(const uint8_t* chain, uint32_t width, uint32_t height, uint16_t levelsCount, VkFormat format,
+    uint8_t* dst)
+{
+    for (uint16_t level = 0; level < levelsCount; ++level) {
+        const uint32_t levelWidth = std::max(width >> level, 1u);
+        const uint32_t levelHeight = std::max(height >> level, 1u);
+
+        SBlockCompressor::CompressLevel(chain, levelWidth, levelHeight, format, dst);
+
+        chain += static_cast<size_t>(levelWidth) * levelHeight * 4;
+        dst += Texture2D::GetLevelSize(format, levelWidth, levelHeight);
+    }
+}
@@ -6,6 +6,10 @@
 #include <assert.h>
 #include <stdexcept>
 
+namespace SDevice {
+thread_local VkCommandPool threadCommandPool = VK_NULL_HANDLE;
+}
+
 CG::Vk::Device::Device(VkPhysicalDevice physicalDevice)
 {
     assert(physicalDevice);
@@ -122,14 +126,17 @@ void CG::Vk::Device::FlushCommandBuffer(VkCommandBuffer commandBuffer, VkQueue q
     VK_CHECK_RESULT(vkCreateFence(logicalDevice, &fenceInfo, nullptr, &fence));
 
     // Submit to the queue
-    VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, fence));
+    {
+        std::lock_guard<std::mutex> lock(deviceQueueMutex);
+        VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, fence));
+    }
     // Wait for the fence to signal that command buffer has finished executing
     VK_CHECK_RESULT(vkWaitForFences(logicalDevice, 1, &fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
 
     vkDestroyFence(logicalDevice, fence, nullptr);
 
     if (free) {
-        vkFreeCommandBuffers(logicalDevice, commandPool, 1, &commandBuffer);
+        vkFreeCommandBuffers(logicalDevice, GetCommandPool(), 1, &commandBuffer);
     }
 }
 
@@ -171,15 +178,19 @@ VkResult CG::Vk::Device::CreateLogicalDevice(VkPhysicalDeviceFeatures2 aEnabledF
     // Note that the indices may overlap depending on the implementation
 
     const float defaultQueuePriority(0.0f);
+    const float graphicsQueuePriorities[] = { defaultQueuePriority, defaultQueuePriority };
 
     // Graphics queue
     if (requestedQueueTypes & VK_QUEUE_GRAPHICS_BIT) {
         queueFamilyIndices.graphics = GetQueueFamilyIndex(VK_QUEUE_GRAPHICS_BIT);
+        // Second queue of the family lets background loading submit uploads and acceleration structure builds
+        // without waiting for the rendering ones, resources stay owned by the same family
+        loadingQueueIndex = queueFamilyProperties[queueFamilyIndices.graphics].queueCount > 1 ? 1 : 0;
         VkDeviceQueueCreateInfo queueInfo {};
         queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
         queueInfo.queueFamilyIndex = queueFamilyIndices.graphics;
-        queueInfo.queueCount = 1;
-        queueInfo.pQueuePriorities = &defaultQueuePriority;
+        queueInfo.queueCount = loadingQueueIndex + 1;
+        queueInfo.pQueuePriorities = graphicsQueuePriorities;
         queueCreateInfos.push_back(queueInfo);
     } else {
         queueFamilyIndices.graphics = VK_NULL_HANDLE;
@@ -269,6 +280,15 @@ VkResult CG::Vk::Device::CreateBuffer(VkBufferUsageFlags usageFlags, VkMemoryPro
     memAlloc.allocationSize = memReqs.size;
 
     memAlloc.memoryTypeIndex = GetMemoryTypeIndex(memReqs.memoryTypeBits, memoryPropertyFlags);
+
+    // Ray tracing with VK_KHR_acceleration_structure reads buffers by their device address
+    VkMemoryAllocateFlagsInfo memAllocFlags = {};
+    if (usageFlags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT_KHR) {
+        memAllocFlags.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO;
+        memAllocFlags.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR;
+        memAlloc.pNext = &memAllocFlags;
+    }
+
     VK_CHECK_RESULT(vkAllocateMemory(logicalDevice, &memAlloc, nullptr, &buffer->memory));
 
     buffer->alignment = memReqs.alignment;
@@ -304,7 +324,7 @@ VkCommandPool CG::Vk::Device::CreateCommandPool(uint32_t queueFamilyIndex, VkCom
 
 VkCommandBuffer CG::Vk::Device::CreateCommandBuffer(VkCommandBufferLevel level, bool begin /*= false*/) const
 {
-    VkCommandBufferAllocateInfo cmdBufAllocateInfo = Initializers::CommandBufferAllocateInfo(commandPool, level, 1);
+    VkCommandBufferAllocateInfo cmdBufAllocateInfo = Initializers::CommandBufferAllocateInfo(GetCommandPool(), level, 1);
 
     VkCommandBuffer cmdBuffer;
     VK_CHECK_RESULT(vkAllocateCommandBuffers(logicalDevice, &cmdBufAllocateInfo, &cmdBuffer));
@@ -317,6 +337,16 @@ VkCommandBuffer CG::Vk::Device::CreateCommandBuffer(VkCommandBufferLevel level,
     return cmdBuffer;
 }
 
+VkCommandPool CG::Vk::Device::GetCommandPool() const
+{
+    return SDevice::threadCommandPool != VK_NULL_HANDLE ? SDevice::threadCommandPool : commandPool;
+}
+
+void CG::Vk::Device::SetThreadCommandPool(VkCommandPool threadCommandPool)
+{
+    SDevice::threadCommandPool = threadCommandPool;
+}
+
 bool CG::Vk::Device::ExtensionSupported(std::string extension)
 {
     return (std::find(supportedExtensions.begin(), supportedExtensions.end(), extension) != supportedExtensions.end());
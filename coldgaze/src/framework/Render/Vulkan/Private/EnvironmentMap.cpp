@@ -0,0 +1,197 @@
+#include "Render/Vulkan/EnvironmentMap.hpp"
+#include "Core/ThreadPool.hpp"
+#include "Render/Vulkan/Debug.hpp"
+#include "Render/Vulkan/Device.hpp"
+#include "Render/Vulkan/UploadBatcher.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+namespace SEnvironmentMap {
+constexpr double kPi = 3.14159265358979323846;
+
+float GetLuminance(const float* texel)
+{
+    const float luminance = 0.2126f * texel[0] + 0.7152f * texel[1] + 0.0722f * texel[2];
+    // NaN fails the comparison and is dropped as well
+    return luminance > 0.0f ? luminance : 0.0f;
+}
+
+// Turns accumulated function values into a CDF in [0, 1], returns the integral of the function.
+// A zero function gets a uniform CDF, its entries in the parent distribution have zero probability anyway
+double NormalizeCDF(float* cdf, const double* accumulated, uint32_t count)
+{
+    const double integral = accumulated[count] / count;
+
+    for (uint32_t i = 0; i <= count; ++i) {
+        cdf[i] = integral > 0.0 ? static_cast<float>(accumulated[i] / accumulated[count]) : static_cast<float>(i) / count;
+    }
+    // Sampling looks for the last entry <= u, so the end has to be exactly 1.0 whatever the rounding was
+    cdf[count] = 1.0f;
+
+    return integral;
+}
+
+// Luminance sums of the texels covered by every distribution cell, gathered row by row while the texture is decoded
+class LuminanceGrid {
+public:
+    void AddRow(uint32_t imageWidth, uint32_t imageHeight, uint32_t y, const float* row)
+    {
+        if (sums.empty()) {
+            Init(imageWidth, imageHeight);
+        }
+
+        // Cell y covers image rows [y * imageHeight / height, (y + 1) * imageHeight / height)
+        const uint32_t cellY = static_cast<uint32_t>((static_cast<uint64_t>(y + 1) * height + imageHeight - 1) / imageHeight - 1);
+        double* cellSums = sums.data() + static_cast<size_t>(cellY) * width;
+
+        for (uint32_t x = 0; x < imageWidth; ++x) {
+            cellSums[columnCells[x]] += GetLuminance(row + static_cast<size_t>(x) * 3);
+        }
+    }
+
+    // Rows of CDFs are independent until the marginal one, so they are built in parallel
+    std::vector<float> BuildCDFs(CG::ThreadPool* threadPool, CG::Vk::EnvironmentMap::DistributionHeader& header)
+    {
+        // Images without HDR rows (.ktx2) get a single black cell, which is sampled uniformly
+        if (sums.empty()) {
+            Init(1, 1);
+        }
+
+        header.width = width;
+        header.height = height;
+
+        const uint32_t rowSize = width + 1;
+        std::vector<float> cdfs(height + 1 + static_cast<size_t>(height) * rowSize);
+        float* marginalCdf = cdfs.data();
+        float* conditionalCdfs = cdfs.data() + height + 1;
+
+        std::vector<double> rowIntegrals(height);
+
+        const auto buildRow = [&](size_t row) {
+            const uint32_t y = static_cast<uint32_t>(row);
+            const uint32_t rowTexelsCount = GetCellBegin(y + 1, imageHeight, height) - GetCellBegin(y, imageHeight, height);
+
+            // Texels near the poles cover less of the sphere, the equirectangular mapping squeezes them by sin(theta)
+            const double sinTheta = std::sin(kPi * (y + 0.5) / height);
+
+            std::vector<double> accumulated(rowSize);
+            accumulated[0] = 0.0;
+            for (uint32_t x = 0; x < width; ++x) {
+                const uint32_t texelsCount = rowTexelsCount * (GetCellBegin(x + 1, imageWidth, width) - GetCellBegin(x, imageWidth, width));
+                const double luminance = sums[static_cast<size_t>(y) * width + x] / texelsCount;
+                accumulated[x + 1] = accumulated[x] + luminance * sinTheta;
+            }
+
+            rowIntegrals[y] = NormalizeCDF(conditionalCdfs + static_cast<size_t>(y) * rowSize, accumulated.data(), width);
+        };
+
+        if (threadPool) {
+            threadPool->ParallelFor(height, buildRow);
+        } else {
+            for (uint32_t y = 0; y < height; ++y) {
+                buildRow(y);
+            }
+        }
+
+        std::vector<double> accumulated(height + 1);
+        accumulated[0] = 0.0;
+        for (uint32_t y = 0; y < height; ++y) {
+            accumulated[y + 1] = accumulated[y] + rowIntegrals[y];
+        }
+        header.integral = static_cast<float>(NormalizeCDF(marginalCdf, accumulated.data(), height));
+
+        return cdfs;
+    }
+
+private:
+    void Init(uint32_t aImageWidth, uint32_t aImageHeight)
+    {
+        imageWidth = aImageWidth;
+        imageHeight = aImageHeight;
+        width = std::min(imageWidth, CG::Vk::EnvironmentMap::kMaxDistributionWidth);
+        height = std::min(imageHeight, CG::Vk::EnvironmentMap::kMaxDistributionHeight);
+
+        sums.assign(static_cast<size_t>(width) * height, 0.0);
+
+        columnCells.resize(imageWidth);
+        for (uint32_t x = 0; x < imageWidth; ++x) {
+            columnCells[x] = static_cast<uint32_t>((static_cast<uint64_t>(x + 1) * width + imageWidth - 1) / imageWidth - 1);
+        }
+    }
+
+    // First image texel covered by the cell
+    static uint32_t GetCellBegin(uint32_t cell, uint32_t imageSize, uint32_t cellsCount)
+    {
+        return static_cast<uint32_t>(static_cast<uint64_t>(cell) * imageSize / cellsCount);
+    }
+
+    uint32_t imageWidth = 0;
+    uint32_t imageHeight = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+
+    std::vector<double> sums;
+    // Distribution column of every image column
+    std::vector<uint32_t> columnCells;
+};
+}
+
+void CG::Vk::EnvironmentMap::LoadFromFile(
+    const std::string& fileName, Device* device, VkQueue copyQueue, ThreadPool* threadPool, Texture2D::eHDRFormat hdrFormat)
+{
+    data = {};
+
+    SEnvironmentMap::LuminanceGrid luminanceGrid;
+    texture.LoadFromFile(fileName, device, copyQueue, true, hdrFormat,
+        [this, &luminanceGrid](uint32_t imageWidth, uint32_t imageHeight, uint32_t y, const float* row) {
+            luminanceGrid.AddRow(imageWidth, imageHeight, y, row);
+
+            if (keepData) {
+                const size_t rowSize = static_cast<size_t>(imageWidth) * 3;
+                if (data.pixels.empty()) {
+                    data.width = imageWidth;
+                    data.height = imageHeight;
+                    data.pixels.resize(rowSize * imageHeight);
+                }
+                memcpy(data.pixels.data() + rowSize * y, row, rowSize * sizeof(float));
+            }
+        });
+
+    const auto buildStart = std::chrono::high_resolution_clock::now();
+
+    DistributionHeader header;
+    const std::vector<float> cdfs = luminanceGrid.BuildCDFs(threadPool, header);
+
+    const auto buildEnd = std::chrono::high_resolution_clock::now();
+    std::cout << "Environment distribution " << header.width << "x" << header.height << " built in "
+              << std::chrono::duration<float, std::milli>(buildEnd - buildStart).count() << " ms on "
+              << (threadPool ? threadPool->GetThreadsCount() : 1) << " thread(s)" << std::endl;
+
+    if (keepData) {
+        data.header = header;
+        data.cdfs = cdfs;
+    }
+
+    std::vector<uint8_t> distributionData(sizeof(DistributionHeader) + cdfs.size() * sizeof(float));
+    memcpy(distributionData.data(), &header, sizeof(header));
+    memcpy(distributionData.data() + sizeof(header), cdfs.data(), cdfs.size() * sizeof(float));
+
+    VK_CHECK_RESULT(device->CreateBuffer(
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        &distribution,
+        distributionData.size()));
+
+    UploadBatcher uploadBatcher(device, copyQueue, distributionData.size());
+    uploadBatcher.Upload(distribution, distributionData.data(), distributionData.size());
+    uploadBatcher.Flush();
+}
+
+void CG::Vk::EnvironmentMap::Destroy()
+{
+    texture.Destroy();
+    distribution.Destroy();
+}
@@ -14,9 +14,13 @@ using namespace CG;
 CG::Vk::ImGuiImpl::ImGuiImpl(Engine& aEngine)
     : engine(aEngine)
     , device(aEngine.GetDevice())
-    , vertexBuffer(std::make_unique<Buffer>())
-    , indexBuffer(std::make_unique<Buffer>())
+    , frameBuffers(Engine::kMaxFramesInFlight)
 {
+    for (FrameBuffers& buffers : frameBuffers) {
+        buffers.vertexBuffer = std::make_unique<Buffer>();
+        buffers.indexBuffer = std::make_unique<Buffer>();
+    }
+
     ImGui::CreateContext();
 }
 
@@ -241,9 +245,12 @@ void CG::Vk::ImGuiImpl::InitResources(VkRenderPass renderPass, VkQueue copyQueue
     VK_CHECK_RESULT(vkCreateGraphicsPipelines(device->logicalDevice, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline));
 }
 
-void CG::Vk::ImGuiImpl::UpdateBuffers()
+void CG::Vk::ImGuiImpl::UpdateBuffers(uint32_t frameIndex)
 {
     ImDrawData* imDrawData = ImGui::GetDrawData();
+    FrameBuffers& buffers = frameBuffers[frameIndex];
+    Buffer* vertexBuffer = buffers.vertexBuffer.get();
+    Buffer* indexBuffer = buffers.indexBuffer.get();
 
     VkDeviceSize vertexBufferSize = imDrawData->TotalVtxCount * sizeof(ImDrawVert);
     VkDeviceSize indexBufferSize = imDrawData->TotalIdxCount * sizeof(ImDrawIdx);
@@ -252,20 +259,20 @@ void CG::Vk::ImGuiImpl::UpdateBuffers()
         return;
     }
 
-    if ((vertexBuffer->buffer == VK_NULL_HANDLE) || (vertexCount != imDrawData->TotalVtxCount)) {
+    if ((vertexBuffer->buffer == VK_NULL_HANDLE) || (buffers.vertexCount != imDrawData->TotalVtxCount)) {
         vertexBuffer->Unmap();
         vertexBuffer->Destroy();
-        VK_CHECK_RESULT(device->CreateBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, vertexBuffer.get(), vertexBufferSize));
-        vertexCount = imDrawData->TotalVtxCount;
+        VK_CHECK_RESULT(device->CreateBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, vertexBuffer, vertexBufferSize));
+        buffers.vertexCount = imDrawData->TotalVtxCount;
         vertexBuffer->Unmap();
         vertexBuffer->Map();
     }
 
-    if ((indexBuffer->buffer == VK_NULL_HANDLE) || (indexCount < imDrawData->TotalIdxCount)) {
+    if ((indexBuffer->buffer == VK_NULL_HANDLE) || (buffers.indexCount < imDrawData->TotalIdxCount)) {
         indexBuffer->Unmap();
         indexBuffer->Destroy();
-        VK_CHECK_RESULT(device->CreateBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, indexBuffer.get(), indexBufferSize));
-        indexCount = imDrawData->TotalIdxCount;
+        VK_CHECK_RESULT(device->CreateBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, indexBuffer, indexBufferSize));
+        buffers.indexCount = imDrawData->TotalIdxCount;
         indexBuffer->Map();
     }
 
@@ -284,8 +291,10 @@ void CG::Vk::ImGuiImpl::UpdateBuffers()
     indexBuffer->Flush();
 }
 
-void CG::Vk::ImGuiImpl::DrawFrame(VkCommandBuffer commandBuffer)
+void CG::Vk::ImGuiImpl::DrawFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex)
 {
+    const FrameBuffers& buffers = frameBuffers[frameIndex];
+
     ImGuiIO& io = ImGui::GetIO();
 
     vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
@@ -307,8 +316,8 @@ void CG::Vk::ImGuiImpl::DrawFrame(VkCommandBuffer commandBuffer)
     if (imDrawData->CmdListsCount > 0) {
 
         VkDeviceSize offsets[1] = { 0 };
-        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer->buffer, offsets);
-        vkCmdBindIndexBuffer(commandBuffer, indexBuffer->buffer, 0, VK_INDEX_TYPE_UINT16);
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &buffers.vertexBuffer->buffer, offsets);
+        vkCmdBindIndexBuffer(commandBuffer, buffers.indexBuffer->buffer, 0, VK_INDEX_TYPE_UINT16);
 
         for (int32_t i = 0; i < imDrawData->CmdListsCount; i++) {
             const ImDrawList* cmd_list = imDrawData->CmdLists[i];
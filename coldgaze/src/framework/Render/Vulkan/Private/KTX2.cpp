@@ -0,0 +1,142 @@
+#include "Render/Vulkan/KTX2.hpp"
+#include "Render/Vulkan/MipGenerator.hpp"
+#include "Render/Vulkan/Texture2D.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace SKTX2 {
+constexpr uint8_t kIdentifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+struct Header {
+    uint8_t identifier[12];
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t layerCount;
+    uint32_t faceCount;
+    uint32_t levelCount;
+    uint32_t supercompressionScheme;
+
+    uint32_t dfdByteOffset;
+    uint32_t dfdByteLength;
+    uint32_t kvdByteOffset;
+    uint32_t kvdByteLength;
+    uint64_t sgdByteOffset;
+    uint64_t sgdByteLength;
+};
+static_assert(sizeof(Header) == 80, "KTX2 header has to match the file layout");
+
+struct LevelIndex {
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint64_t uncompressedByteLength;
+};
+
+// PNG and JPEG textures are uploaded as UNORM as well, so sRGB formats are read as their UNORM twins to look the same
+VkFormat GetEngineFormat(uint32_t vkFormat)
+{
+    switch (vkFormat) {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+        return VK_FORMAT_R8G8B8A8_UNORM;
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        return VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+        return VK_FORMAT_BC5_UNORM_BLOCK;
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+        return VK_FORMAT_BC7_UNORM_BLOCK;
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+        return VK_FORMAT_R16G16B16A16_SFLOAT;
+    case VK_FORMAT_R32G32B32A32_SFLOAT:
+        return VK_FORMAT_R32G32B32A32_SFLOAT;
+    default:
+        return VK_FORMAT_UNDEFINED;
+    }
+}
+}
+
+bool CG::Vk::KTX2::IsKTX2(const uint8_t* data, size_t size)
+{
+    return size >= sizeof(SKTX2::kIdentifier) && memcmp(data, SKTX2::kIdentifier, sizeof(SKTX2::kIdentifier)) == 0;
+}
+
+bool CG::Vk::KTX2::Parse(const uint8_t* data, size_t size, Image& image, std::string& error)
+{
+    if (!IsKTX2(data, size) || size < sizeof(SKTX2::Header)) {
+        error = "not a KTX2 file";
+        return false;
+    }
+
+    SKTX2::Header header;
+    memcpy(&header, data, sizeof(header));
+
+    if (header.supercompressionScheme != 0) {
+        error = "supercompressed KTX2 files are not supported";
+        return false;
+    }
+    if (header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1 || header.pixelHeight == 0 || header.pixelWidth == 0) {
+        error = "only 2D KTX2 images without layers and faces are supported";
+        return false;
+    }
+
+    image.format = SKTX2::GetEngineFormat(header.vkFormat);
+    if (image.format == VK_FORMAT_UNDEFINED) {
+        error = "unsupported KTX2 format " + std::to_string(header.vkFormat);
+        return false;
+    }
+
+    image.width = header.pixelWidth;
+    image.height = header.pixelHeight;
+    image.generateMips = header.levelCount == 0;
+
+    const uint32_t levelsCount = std::max(header.levelCount, 1u);
+    if (levelsCount > MipGenerator::GetMipLevelsCount(image.width, image.height)) {
+        error = "KTX2 file has more levels than its size allows";
+        return false;
+    }
+    if (size < sizeof(SKTX2::Header) + levelsCount * sizeof(SKTX2::LevelIndex)) {
+        error = "truncated KTX2 level index";
+        return false;
+    }
+
+    image.levels.resize(levelsCount);
+    for (uint32_t level = 0; level < levelsCount; ++level) {
+        SKTX2::LevelIndex levelIndex;
+        memcpy(&levelIndex, data + sizeof(SKTX2::Header) + level * sizeof(SKTX2::LevelIndex), sizeof(levelIndex));
+
+        const VkDeviceSize levelSize
+            = Texture2D::GetLevelSize(image.format, std::max(image.width >> level, 1u), std::max(image.height >> level, 1u));
+        if (levelIndex.byteOffset > size || levelIndex.byteLength > size - levelIndex.byteOffset || levelIndex.byteLength < levelSize) {
+            error = "KTX2 level " + std::to_string(level) + " is outside of the file";
+            return false;
+        }
+
+        image.levels[level].data = data + levelIndex.byteOffset;
+        image.levels[level].size = levelSize;
+    }
+
+    return true;
+}
+
+std::vector<uint8_t> CG::Vk::KTX2::GetMipChain(const Image& image)
+{
+    size_t chainSize = 0;
+    for (const Level& level : image.levels) {
+        chainSize += static_cast<size_t>(level.size);
+    }
+
+    std::vector<uint8_t> chain(chainSize);
+    uint8_t* dst = chain.data();
+    for (const Level& level : image.levels) {
+        memcpy(dst, level.data, static_cast<size_t>(level.size));
+        dst += level.size;
+    }
+    return chain;
+}
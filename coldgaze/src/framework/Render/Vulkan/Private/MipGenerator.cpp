@@ -0,0 +1,288 @@
+#include "Render/Vulkan/MipGenerator.hpp"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using eFilter = CG::Vk::MipGenerator::eFilter;
+
+namespace SMipGenerator {
+constexpr float kPi = 3.14159265358979f;
+
+// Half width of the Kaiser kernel in destination texels, alpha 4 keeps ringing low while staying sharper than a box
+constexpr float kKaiserRadius = 3.0f;
+constexpr float kKaiserAlpha = 4.0f;
+
+// Zeroth order modified Bessel function of the first kind, power series converges fast for the window arguments
+float BesselI0(float x)
+{
+    const float quarterX2 = x * x * 0.25f;
+    float sum = 1.0f;
+    float term = 1.0f;
+    for (int k = 1; k < 32 && term > sum * 1e-8f; ++k) {
+        term *= quarterX2 / static_cast<float>(k * k);
+        sum += term;
+    }
+    return sum;
+}
+
+float Sinc(float x)
+{
+    if (std::abs(x) < 1e-6f) {
+        return 1.0f;
+    }
+    x *= kPi;
+    return std::sin(x) / x;
+}
+
+float KaiserWindow(float x)
+{
+    const float t = x / kKaiserRadius;
+    if (t * t >= 1.0f) {
+        return 0.0f;
+    }
+    return BesselI0(kKaiserAlpha * std::sqrt(1.0f - t * t)) / BesselI0(kKaiserAlpha);
+}
+
+// Weights of the source texels contributing to every destination texel along one axis,
+// tapsCount weights per destination texel, source indices are already clamped to the edge
+struct AxisFilter {
+    uint32_t tapsCount = 0;
+    std::vector<uint32_t> indices;
+    std::vector<float> weights;
+};
+
+AxisFilter BuildAxisFilter(uint32_t srcSize, uint32_t dstSize, eFilter filter)
+{
+    const float scale = static_cast<float>(srcSize) / static_cast<float>(dstSize);
+    const float support = filter == eFilter::kBox ? 0.5f * scale : kKaiserRadius * scale;
+
+    AxisFilter axisFilter;
+    axisFilter.tapsCount = static_cast<uint32_t>(std::ceil(support * 2.0f)) + 1;
+    axisFilter.indices.resize(static_cast<size_t>(dstSize) * axisFilter.tapsCount);
+    axisFilter.weights.resize(static_cast<size_t>(dstSize) * axisFilter.tapsCount);
+
+    for (uint32_t d = 0; d < dstSize; ++d) {
+        const float center = (static_cast<float>(d) + 0.5f) * scale;
+        const int32_t first = static_cast<int32_t>(std::floor(center - support));
+
+        uint32_t* indices = axisFilter.indices.data() + static_cast<size_t>(d) * axisFilter.tapsCount;
+        float* weights = axisFilter.weights.data() + static_cast<size_t>(d) * axisFilter.tapsCount;
+        float weightsSum = 0.0f;
+
+        for (uint32_t t = 0; t < axisFilter.tapsCount; ++t) {
+            const int32_t i = first + static_cast<int32_t>(t);
+
+            float weight = 0.0f;
+            if (filter == eFilter::kBox) {
+                // Overlap of the source texel with the destination footprint
+                const float begin = std::max(static_cast<float>(i), center - support);
+                const float end = std::min(static_cast<float>(i + 1), center + support);
+                weight = std::max(end - begin, 0.0f);
+            } else {
+                const float x = (static_cast<float>(i) + 0.5f - center) / scale;
+                weight = Sinc(x) * KaiserWindow(x);
+            }
+
+            indices[t] = static_cast<uint32_t>(std::clamp(i, 0, static_cast<int32_t>(srcSize) - 1));
+            weights[t] = weight;
+            weightsSum += weight;
+        }
+
+        for (uint32_t t = 0; t < axisFilter.tapsCount; ++t) {
+            weights[t] /= weightsSum;
+        }
+    }
+
+    return axisFilter;
+}
+
+float LoadTexel(uint8_t value)
+{
+    return static_cast<float>(value) * (1.0f / 255.0f);
+}
+
+void StoreTexel(float value, uint8_t& texel)
+{
+    texel = static_cast<uint8_t>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+// Separable resampling, rows are filtered into a float scratch first, then its columns go into dst
+template <typename Texel>
+void Downsample(const Texel* src, uint32_t srcWidth, uint32_t srcHeight, Texel* dst, uint32_t dstWidth, uint32_t dstHeight,
+    uint32_t channelsCount, eFilter filter)
+{
+    const AxisFilter horizontal = BuildAxisFilter(srcWidth, dstWidth, filter);
+    const AxisFilter vertical = BuildAxisFilter(srcHeight, dstHeight, filter);
+
+    std::vector<float> rows(static_cast<size_t>(dstWidth) * srcHeight * channelsCount);
+
+    for (uint32_t y = 0; y < srcHeight; ++y) {
+        const Texel* srcRow = src + static_cast<size_t>(y) * srcWidth * channelsCount;
+        float* row = rows.data() + static_cast<size_t>(y) * dstWidth * channelsCount;
+
+        for (uint32_t x = 0; x < dstWidth; ++x) {
+            const uint32_t* indices = horizontal.indices.data() + static_cast<size_t>(x) * horizontal.tapsCount;
+            const float* weights = horizontal.weights.data() + static_cast<size_t>(x) * horizontal.tapsCount;
+
+            for (uint32_t c = 0; c < channelsCount; ++c) {
+                float value = 0.0f;
+                for (uint32_t t = 0; t < horizontal.tapsCount; ++t) {
+                    value += weights[t] * LoadTexel(srcRow[static_cast<size_t>(indices[t]) * channelsCount + c]);
+                }
+                row[static_cast<size_t>(x) * channelsCount + c] = value;
+            }
+        }
+    }
+
+    const size_t rowSize = static_cast<size_t>(dstWidth) * channelsCount;
+
+    for (uint32_t y = 0; y < dstHeight; ++y) {
+        const uint32_t* indices = vertical.indices.data() + static_cast<size_t>(y) * vertical.tapsCount;
+        const float* weights = vertical.weights.data() + static_cast<size_t>(y) * vertical.tapsCount;
+        Texel* dstRow = dst + static_cast<size_t>(y) * rowSize;
+
+        for (size_t i = 0; i < rowSize; ++i) {
+            float value = 0.0f;
+            for (uint32_t t = 0; t < vertical.tapsCount; ++t) {
+                value += weights[t] * rows[static_cast<size_t>(indices[t]) * rowSize + i];
+            }
+            StoreTexel(value, dstRow[i]);
+        }
+    }
+}
+
+template <typename Texel>
+void GenerateMipChain(Texel* chain, uint32_t width, uint32_t height, uint32_t channelsCount, uint16_t levelsCount, eFilter filter)
+{
+    Texel* src = chain;
+    for (uint16_t level = 1; level < levelsCount; ++level) {
+        const uint32_t srcWidth = std::max(width >> (level - 1), 1u);
+        const uint32_t srcHeight = std::max(height >> (level - 1), 1u);
+        const uint32_t dstWidth = std::max(width >> level, 1u);
+        const uint32_t dstHeight = std::max(height >> level, 1u);
+
+        // Every level is filtered from the previous one, so the cost stays close to a single pass over level 0
+        Texel* dst = src + static_cast<size_t>(srcWidth) * srcHeight * channelsCount;
+        Downsample(src, srcWidth, srcHeight, dst, dstWidth, dstHeight, channelsCount, filter);
+        src = dst;
+    }
+}
+}
+
+uint16_t CG::Vk::MipGenerator::GetMipLevelsCount(uint32_t width, uint32_t height)
+{
+    uint16_t levelsCount = 1;
+    for (uint32_t size = std::max(width, height); size > 1; size >>= 1) {
+        ++levelsCount;
+    }
+    return levelsCount;
+}
+
+size_t CG::Vk::MipGenerator::GetMipChainSize(uint32_t width, uint32_t height, uint16_t levelsCount, size_t texelSize)
+{
+    size_t chainSize = 0;
+    for (uint16_t level = 0; level < levelsCount; ++level) {
+        chainSize += static_cast<size_t>(std::max(width >> level, 1u)) * std::max(height >> level, 1u) * texelSize;
+    }
+    return chainSize;
+}
+
+void CG::Vk::MipGenerator::GenerateMipChain(uint8_t* chain, uint32_t width, uint32_t height, uint16_t levelsCount, eFilter filter)
+{
+    SMipGenerator::GenerateMipChain(chain, width, height, 4, levelsCount, filter);
+}
+
+CG::Vk::MipGenerator::RowDownsampler::RowDownsampler(uint32_t srcWidth, uint32_t aSrcHeight, uint32_t aChannelsCount)
+    : srcHeight(aSrcHeight)
+    , dstWidth(std::max(srcWidth >> 1, 1u))
+    , dstHeight(std::max(aSrcHeight >> 1, 1u))
+    , channelsCount(aChannelsCount)
+{
+    SMipGenerator::AxisFilter horizontal = SMipGenerator::BuildAxisFilter(srcWidth, dstWidth, eFilter::kBox);
+    horizontalTapsCount = horizontal.tapsCount;
+    horizontalIndices = std::move(horizontal.indices);
+    horizontalWeights = std::move(horizontal.weights);
+
+    SMipGenerator::AxisFilter vertical = SMipGenerator::BuildAxisFilter(srcHeight, dstHeight, eFilter::kBox);
+    verticalTapsCount = vertical.tapsCount;
+    verticalIndices = std::move(vertical.indices);
+    verticalWeights = std::move(vertical.weights);
+
+    // Taps clamped to the edge repeat an index with zero weight, only rows which contribute are waited for
+    pendingRowsCounts.resize(dstHeight, 0);
+    for (uint32_t y = 0; y < dstHeight; ++y) {
+        const uint32_t* indices = verticalIndices.data() + static_cast<size_t>(y) * verticalTapsCount;
+        const float* weights = verticalWeights.data() + static_cast<size_t>(y) * verticalTapsCount;
+        for (uint32_t t = 0; t < verticalTapsCount; ++t) {
+            bool counted = false;
+            for (uint32_t previous = 0; previous < t; ++previous) {
+                counted = counted || (indices[previous] == indices[t] && weights[previous] > 0.0f);
+            }
+            if (weights[t] > 0.0f && !counted) {
+                ++pendingRowsCounts[y];
+            }
+        }
+    }
+
+    dstRows.resize(dstHeight);
+    filteredRow.resize(static_cast<size_t>(dstWidth) * channelsCount);
+}
+
+uint32_t CG::Vk::MipGenerator::RowDownsampler::GetDstWidth() const
+{
+    return dstWidth;
+}
+
+uint32_t CG::Vk::MipGenerator::RowDownsampler::GetDstHeight() const
+{
+    return dstHeight;
+}
+
+void CG::Vk::MipGenerator::RowDownsampler::AddRow(uint32_t srcY, const float* srcRow, const RowCallback& onRowReady)
+{
+    for (uint32_t x = 0; x < dstWidth; ++x) {
+        const uint32_t* indices = horizontalIndices.data() + static_cast<size_t>(x) * horizontalTapsCount;
+        const float* weights = horizontalWeights.data() + static_cast<size_t>(x) * horizontalTapsCount;
+
+        for (uint32_t c = 0; c < channelsCount; ++c) {
+            float value = 0.0f;
+            for (uint32_t t = 0; t < horizontalTapsCount; ++t) {
+                value += weights[t] * srcRow[static_cast<size_t>(indices[t]) * channelsCount + c];
+            }
+            filteredRow[static_cast<size_t>(x) * channelsCount + c] = value;
+        }
+    }
+
+    // Box footprint of a destination row is srcHeight / dstHeight rows wide, so only neighbours of srcY / scale can use the row
+    const uint32_t scale = srcHeight / dstHeight;
+    const uint32_t firstDstY = srcY / scale > 0 ? srcY / scale - 1 : 0;
+    const uint32_t lastDstY = std::min(srcY / scale + 1, dstHeight - 1);
+
+    for (uint32_t dstY = firstDstY; dstY <= lastDstY; ++dstY) {
+        const uint32_t* indices = verticalIndices.data() + static_cast<size_t>(dstY) * verticalTapsCount;
+        const float* weights = verticalWeights.data() + static_cast<size_t>(dstY) * verticalTapsCount;
+
+        float weight = 0.0f;
+        for (uint32_t t = 0; t < verticalTapsCount; ++t) {
+            if (indices[t] == srcY && weights[t] > 0.0f) {
+                weight += weights[t];
+            }
+        }
+        if (weight == 0.0f) {
+            continue;
+        }
+
+        std::vector<float>& dstRow = dstRows[dstY];
+        if (dstRow.empty()) {
+            dstRow.assign(filteredRow.size(), 0.0f);
+        }
+        for (size_t i = 0; i < filteredRow.size(); ++i) {
+            dstRow[i] += weight * filteredRow[i];
+        }
+
+        if (--pendingRowsCounts[dstY] == 0) {
+            onRowReady(dstY, dstRow.data());
+            std::vector<float>().swap(dstRow);
+        }
+    }
+}
@@ -7,15 +7,32 @@
 
 #pragma warning(push, 0)
 #include "glm/ext/matrix_transform.hpp"
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/quaternion.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #pragma warning(pop)
 
+#include "Core/MappedFile.hpp"
+#include "Core/ThreadPool.hpp"
+#include "Render/Vulkan/BlockCompressor.hpp"
 #include "Render/Vulkan/Debug.hpp"
 #include "Render/Vulkan/Device.hpp"
 #include "Render/Vulkan/Exceptions.hpp"
+#include "Render/Vulkan/KTX2.hpp"
+#include "Render/Vulkan/MipGenerator.hpp"
+#include "Render/Vulkan/SceneCache.hpp"
+#include "Render/Vulkan/UploadBatcher.hpp"
+#include "Render/Vulkan/VertexKernels.hpp"
 #include "glm/common.hpp"
 #include "tinygltf/tiny_gltf.h"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <chrono>
+#include <fstream>
 #include <mutex>
+#include <string_view>
+#include <unordered_map>
 
 namespace SGLTFModel {
 CG::Vk::GLTFModel::Node* FindNode(CG::Vk::GLTFModel::Node* parent, uint32_t index)
@@ -45,14 +62,408 @@ CG::Vk::GLTFModel::Node* NodeFromIndex(uint32_t index, const std::vector<std::un
     return nodeFound;
 }
 
-template <typename T>
-void FillVertexAttribute(const tinygltf::Primitive& primitive, const tinygltf::Model& input, const std::string& attrName, int compSize, const T** buffer, int& bufferStride)
+// Returns pointer to the first element of the attribute and distance between elements in bytes, nullptr if there is no such attribute
+// Start of the accessor data, buffers are either owned by tinygltf or memory mapped, see GLTFModel::ParseFile
+const uint8_t* GetAccessorData(const tinygltf::Model& input, const std::vector<const uint8_t*>& buffersData, const tinygltf::Accessor& accessor)
 {
-    if (primitive.attributes.find(attrName) != primitive.attributes.end()) {
-        const tinygltf::Accessor& accessor = input.accessors[primitive.attributes.find(attrName)->second];
-        const tinygltf::BufferView& view = input.bufferViews[accessor.bufferView];
-        *buffer = reinterpret_cast<const T*>(&(input.buffers[view.buffer].data[accessor.byteOffset + view.byteOffset]));
-        bufferStride = accessor.ByteStride(view) ? (accessor.ByteStride(view) / sizeof(T)) : tinygltf::GetNumComponentsInType(compSize);
+    const tinygltf::BufferView& view = input.bufferViews[accessor.bufferView];
+    return buffersData[view.buffer] + view.byteOffset + accessor.byteOffset;
+}
+
+const uint8_t* GetVertexAttribute(const tinygltf::Primitive& primitive, const tinygltf::Model& input, const std::vector<const uint8_t*>& buffersData,
+    const std::string& attrName, size_t& byteStride)
+{
+    const auto attribute = primitive.attributes.find(attrName);
+    if (attribute == primitive.attributes.end()) {
+        return nullptr;
+    }
+
+    const tinygltf::Accessor& accessor = input.accessors[attribute->second];
+    const tinygltf::BufferView& view = input.bufferViews[accessor.bufferView];
+    const int stride = accessor.ByteStride(view);
+    byteStride = stride > 0 ? static_cast<size_t>(stride)
+                            : tinygltf::GetComponentSizeInBytes(accessor.componentType) * tinygltf::GetNumComponentsInType(accessor.type);
+    return GetAccessorData(input, buffersData, accessor);
+}
+
+// Vertices and indices of big primitives are split into ranges of this size, so a single huge mesh still loads all workers
+constexpr uint32_t kDecodeRangeSize = 64 * 1024;
+
+bool IsIndexTypeSupported(int componentType)
+{
+    return componentType == TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT
+        || componentType == TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT
+        || componentType == TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE;
+}
+
+// Decodes [begin, end) range of the primitive vertices, dst points to the vertex for begin
+void DecodeVertices(const tinygltf::Primitive& primitive, const tinygltf::Model& input, const std::vector<const uint8_t*>& buffersData,
+    size_t begin, size_t end, CG::Vk::GLTFModel::Vertex* dst)
+{
+    using namespace CG::Vk;
+
+    size_t posByteStride = 0;
+    size_t normByteStride = 0;
+    size_t uv0ByteStride = 0;
+    size_t uv1ByteStride = 0;
+
+    const uint8_t* bufferPos = GetVertexAttribute(primitive, input, buffersData, "POSITION", posByteStride);
+    const uint8_t* bufferNormals = GetVertexAttribute(primitive, input, buffersData, "NORMAL", normByteStride);
+    const uint8_t* bufferTexCoordSet0 = GetVertexAttribute(primitive, input, buffersData, "TEXCOORD_0", uv0ByteStride);
+    const uint8_t* bufferTexCoordSet1 = GetVertexAttribute(primitive, input, buffersData, "TEXCOORD_1", uv1ByteStride);
+
+    const size_t count = end - begin;
+    GLTFModel::Vertex* vertices = dst;
+    constexpr size_t vertexStride = sizeof(GLTFModel::Vertex);
+
+    // Whole range is converted attribute by attribute, every kernel writes its own vec4 of the vertex
+    VertexKernels::ConvertPositions(bufferPos + begin * posByteStride, posByteStride, count, &vertices->pos, vertexStride);
+
+    if (bufferNormals) {
+        VertexKernels::ConvertNormals(bufferNormals + begin * normByteStride, normByteStride, count, &vertices->normal, vertexStride);
+    } else {
+        for (size_t v = 0; v < count; ++v) {
+            vertices[v].normal = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        }
+    }
+
+    VertexKernels::ConvertTexCoords(
+        bufferTexCoordSet0 ? bufferTexCoordSet0 + begin * uv0ByteStride : nullptr, uv0ByteStride,
+        bufferTexCoordSet1 ? bufferTexCoordSet1 + begin * uv1ByteStride : nullptr, uv1ByteStride,
+        count, &vertices->uv, vertexStride);
+}
+
+// Octahedral normal mapping, decoded by OctDecode in closest hit shaders
+glm::vec2 OctEncode(const glm::vec3& n)
+{
+    const float sum = glm::abs(n.x) + glm::abs(n.y) + glm::abs(n.z);
+    if (sum == 0.0f) {
+        return glm::vec2(0.0f);
+    }
+
+    glm::vec2 p = glm::vec2(n) / sum;
+    if (n.z < 0.0f) {
+        const glm::vec2 signNotZero = glm::vec2(p.x >= 0.0f ? 1.0f : -1.0f, p.y >= 0.0f ? 1.0f : -1.0f);
+        p = (1.0f - glm::abs(glm::vec2(p.y, p.x))) * signNotZero;
+    }
+    return p;
+}
+
+void PackCompactVertices(const CG::Vk::GLTFModel::Vertex* src, size_t count, CG::Vk::GLTFModel::CompactVertex* dst)
+{
+    for (size_t v = 0; v < count; ++v) {
+        dst[v].pos = glm::vec3(src[v].pos);
+        dst[v].normal = glm::packSnorm2x16(OctEncode(glm::vec3(src[v].normal)));
+        dst[v].uv0 = glm::packHalf2x16(glm::vec2(src[v].uv.x, src[v].uv.y));
+        dst[v].uv1 = glm::packHalf2x16(glm::vec2(src[v].uv.z, src[v].uv.w));
+    }
+}
+
+constexpr uint32_t kMaxIndex16VertexCount = 65536;
+
+// Upper bound of decoded, but not yet uploaded pixels, bounds loading memory of models with hundreds of 4K textures
+constexpr size_t kDecodedImagesBudget = 512 * 1024 * 1024;
+
+// Loading progress reported after every stage, textures take the most of the time
+constexpr float kProgressParsed = 0.1f;
+constexpr float kProgressTextures = 0.7f;
+constexpr float kProgressGeometry = 0.85f;
+constexpr float kProgressUploaded = 0.95f;
+
+float GetTexturesProgress(size_t loadedCount, size_t texturesCount)
+{
+    return kProgressParsed + (kProgressTextures - kProgressParsed) * static_cast<float>(loadedCount) / static_cast<float>(texturesCount);
+}
+
+// Ways materials sample an image, together they pick its block compression format
+constexpr uint32_t kColorImage = 1 << 0; // base color, emissive
+constexpr uint32_t kNormalImage = 1 << 1;
+constexpr uint32_t kDataImage = 1 << 2; // metallic roughness, occlusion
+
+std::vector<uint32_t> GetImageUsages(const tinygltf::Model& input, const std::vector<size_t>& textureSources)
+{
+    std::vector<uint32_t> imageUsages(input.images.size(), 0);
+    const auto addUsage = [&](const tinygltf::ParameterMap& parameters, const char* name, uint32_t usage) {
+        const auto parameter = parameters.find(name);
+        if (parameter != parameters.end()) {
+            const int textureIndex = parameter->second.TextureIndex();
+            if (textureIndex >= 0 && static_cast<size_t>(textureIndex) < textureSources.size()) {
+                imageUsages[textureSources[textureIndex]] |= usage;
+            }
+        }
+    };
+
+    for (const tinygltf::Material& material : input.materials) {
+        addUsage(material.values, "baseColorTexture", kColorImage);
+        addUsage(material.values, "metallicRoughnessTexture", kDataImage);
+        addUsage(material.additionalValues, "normalTexture", kNormalImage);
+        addUsage(material.additionalValues, "occlusionTexture", kDataImage);
+        addUsage(material.additionalValues, "emissiveTexture", kColorImage);
+    }
+    return imageUsages;
+}
+
+// Normal maps only need x and y, opaque colors fit BC1, BC7 keeps the rest: alpha and independent channels of packed maps
+VkFormat GetCompressedFormat(uint32_t imageUsage, bool opaque)
+{
+    if (imageUsage == kNormalImage) {
+        return VK_FORMAT_BC5_UNORM_BLOCK;
+    }
+    if (imageUsage == kColorImage && opaque) {
+        return VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+    }
+    return VK_FORMAT_BC7_UNORM_BLOCK;
+}
+
+uint32_t GetIndexSize(VkIndexType indexType)
+{
+    return indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+size_t AlignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+template <typename SrcType, typename DstType>
+void ConvertIndices(const void* src, size_t begin, size_t end, DstType* dst)
+{
+    const SrcType* buf = static_cast<const SrcType*>(src);
+    for (size_t index = begin; index < end; ++index) {
+        dst[index] = static_cast<DstType>(buf[index]);
+    }
+}
+
+// Decodes [begin, end) range of the primitive indices, dst points to the first index of the primitive
+void DecodeIndices(const tinygltf::Primitive& primitive, const tinygltf::Model& input, const std::vector<const uint8_t*>& buffersData,
+    size_t begin, size_t end, VkIndexType indexType, void* dst)
+{
+    uint16_t* dst16 = static_cast<uint16_t*>(dst);
+    uint32_t* dst32 = static_cast<uint32_t*>(dst);
+
+    if (primitive.indices < 0) {
+        for (size_t index = begin; index < end; ++index) {
+            if (indexType == VK_INDEX_TYPE_UINT16) {
+                dst16[index] = static_cast<uint16_t>(index);
+            } else {
+                dst32[index] = static_cast<uint32_t>(index);
+            }
+        }
+        return;
+    }
+
+    const tinygltf::Accessor& accessor = input.accessors[primitive.indices];
+    const void* dataPtr = GetAccessorData(input, buffersData, accessor);
+
+    if (indexType == VK_INDEX_TYPE_UINT16) {
+        // Primitive has less than 65536 vertices, so even uint32 source indices fit
+        switch (accessor.componentType) {
+        case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT:
+            ConvertIndices<uint32_t>(dataPtr, begin, end, dst16);
+            break;
+        case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT:
+            memcpy(dst16 + begin, static_cast<const uint16_t*>(dataPtr) + begin, (end - begin) * sizeof(uint16_t));
+            break;
+        case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE:
+            ConvertIndices<uint8_t>(dataPtr, begin, end, dst16);
+            break;
+        default:
+            // Filtered out by LoadNode
+            assert(false);
+            break;
+        }
+        return;
+    }
+
+    switch (accessor.componentType) {
+    case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT:
+        memcpy(dst32 + begin, static_cast<const uint32_t*>(dataPtr) + begin, (end - begin) * sizeof(uint32_t));
+        break;
+    case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT:
+        CG::Vk::VertexKernels::WidenIndices(static_cast<const uint16_t*>(dataPtr) + begin, end - begin, dst32 + begin);
+        break;
+    case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE:
+        CG::Vk::VertexKernels::WidenIndices(static_cast<const uint8_t*>(dataPtr) + begin, end - begin, dst32 + begin);
+        break;
+    default:
+        // Filtered out by LoadNode
+        assert(false);
+        break;
+    }
+}
+
+// Bytes of the accessor from its first element to the end of the last one, interleaved attributes of the view are included
+std::string_view GetAccessorBytes(const tinygltf::Model& input, const std::vector<const uint8_t*>& buffersData, int accessorIndex)
+{
+    if (accessorIndex < 0) {
+        return std::string_view();
+    }
+
+    const tinygltf::Accessor& accessor = input.accessors[accessorIndex];
+    const tinygltf::BufferView& view = input.bufferViews[accessor.bufferView];
+    const size_t elementSize = tinygltf::GetComponentSizeInBytes(accessor.componentType) * tinygltf::GetNumComponentsInType(accessor.type);
+    const int stride = accessor.ByteStride(view);
+    const size_t byteStride = stride > 0 ? static_cast<size_t>(stride) : elementSize;
+    const size_t size = accessor.count > 0 ? (accessor.count - 1) * byteStride + elementSize : 0;
+
+    return std::string_view(reinterpret_cast<const char*>(GetAccessorData(input, buffersData, accessor)), size);
+}
+
+// Accessors decoded into the geometry buffers: POSITION, NORMAL, TEXCOORD_0, TEXCOORD_1 and indices, -1 if absent
+std::array<int, 5> GetGeometryAccessors(const tinygltf::Primitive& primitive)
+{
+    std::array<int, 5> accessors = { -1, -1, -1, -1, primitive.indices };
+    const char* const names[] = { "POSITION", "NORMAL", "TEXCOORD_0", "TEXCOORD_1" };
+
+    for (size_t i = 0; i < std::size(names); ++i) {
+        const auto attribute = primitive.attributes.find(names[i]);
+        if (attribute != primitive.attributes.end()) {
+            accessors[i] = attribute->second;
+        }
+    }
+    return accessors;
+}
+
+// Hash of everything the decoded geometry depends on, exporters often duplicate mesh data instead of referencing it
+size_t GetGeometryHash(const tinygltf::Model& input, const std::vector<const uint8_t*>& buffersData, const tinygltf::Primitive& primitive)
+{
+    size_t hash = 0;
+    for (const int accessorIndex : GetGeometryAccessors(primitive)) {
+        size_t accessorHash = std::hash<int>()(accessorIndex < 0 ? -1 : input.accessors[accessorIndex].componentType);
+        accessorHash ^= std::hash<std::string_view>()(GetAccessorBytes(input, buffersData, accessorIndex));
+        hash = hash * 31 + accessorHash;
+    }
+    return hash;
+}
+
+// Hash collisions are resolved by comparing accessor formats and bytes
+bool IsSameGeometry(const tinygltf::Model& input, const std::vector<const uint8_t*>& buffersData,
+    const tinygltf::Primitive& first, const tinygltf::Primitive& second)
+{
+    const std::array<int, 5> firstAccessors = GetGeometryAccessors(first);
+    const std::array<int, 5> secondAccessors = GetGeometryAccessors(second);
+
+    for (size_t i = 0; i < firstAccessors.size(); ++i) {
+        const int a = firstAccessors[i];
+        const int b = secondAccessors[i];
+        if (a == b) {
+            continue;
+        }
+        if (a < 0 || b < 0) {
+            return false;
+        }
+
+        const tinygltf::Accessor& accessorA = input.accessors[a];
+        const tinygltf::Accessor& accessorB = input.accessors[b];
+        if (accessorA.componentType != accessorB.componentType || accessorA.type != accessorB.type
+            || accessorA.count != accessorB.count || accessorA.normalized != accessorB.normalized) {
+            return false;
+        }
+        if (GetAccessorBytes(input, buffersData, a) != GetAccessorBytes(input, buffersData, b)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+constexpr uint32_t kGLBMagic = 0x46546C67; // "glTF"
+constexpr uint32_t kGLBChunkTypeJSON = 0x4E4F534A; // "JSON"
+constexpr uint32_t kGLBChunkTypeBIN = 0x004E4942; // "BIN\0"
+constexpr size_t kGLBHeaderSize = 12;
+constexpr size_t kGLBChunkHeaderSize = 8;
+
+// tinygltf requires data for every buffer and image, real bytes are read from memory mapped files instead
+const char* kPlaceholderDataURI = "data:application/octet-stream;base64,AA==";
+
+struct GLBChunks {
+    const char* json = nullptr;
+    size_t jsonSize = 0;
+    const uint8_t* binary = nullptr;
+    size_t binarySize = 0;
+};
+
+uint32_t ReadUint32(const uint8_t* data)
+{
+    uint32_t value = 0;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+bool ParseGLBChunks(const uint8_t* data, size_t size, GLBChunks& chunks)
+{
+    if (size < kGLBHeaderSize + kGLBChunkHeaderSize || ReadUint32(data) != kGLBMagic || ReadUint32(data + 4) != 2) {
+        return false;
+    }
+
+    const size_t totalSize = std::min(static_cast<size_t>(ReadUint32(data + 8)), size);
+    size_t offset = kGLBHeaderSize;
+
+    while (offset + kGLBChunkHeaderSize <= totalSize) {
+        const size_t chunkSize = ReadUint32(data + offset);
+        const uint32_t chunkType = ReadUint32(data + offset + 4);
+        offset += kGLBChunkHeaderSize;
+
+        if (offset + chunkSize > totalSize) {
+            return false;
+        }
+
+        if (chunkType == kGLBChunkTypeJSON && !chunks.json) {
+            chunks.json = reinterpret_cast<const char*>(data + offset);
+            chunks.jsonSize = chunkSize;
+        } else if (chunkType == kGLBChunkTypeBIN && !chunks.binary) {
+            chunks.binary = data + offset;
+            chunks.binarySize = chunkSize;
+        }
+
+        // Chunks are 4 bytes aligned
+        offset += (chunkSize + 3) & ~size_t(3);
+    }
+
+    return chunks.json != nullptr;
+}
+
+bool HasExtension(const std::string& filename, const std::string& extension)
+{
+    if (filename.size() < extension.size()) {
+        return false;
+    }
+    return std::equal(extension.rbegin(), extension.rend(), filename.rbegin(),
+        [](char lhs, char rhs) { return std::tolower(static_cast<unsigned char>(lhs)) == std::tolower(static_cast<unsigned char>(rhs)); });
+}
+
+std::string GetBaseDir(const std::string& filename)
+{
+    const size_t separator = filename.find_last_of("/\\");
+    return separator != std::string::npos ? filename.substr(0, separator + 1) : std::string();
+}
+
+// glTF stores rotations as x, y, z, w
+glm::quat ToQuat(const glm::vec4& value)
+{
+    return glm::quat(value.w, value.x, value.y, value.z);
+}
+
+// Value of the sampler at keyframe + u, outputs of cubic spline samplers are in-tangent, value, out-tangent triplets
+glm::vec4 SampleKeyframes(const CG::Vk::GLTFModel::AnimationSampler& sampler, size_t keyframe, float u)
+{
+    using eInterpolationType = CG::Vk::GLTFModel::AnimationSampler::eInterpolationType;
+
+    switch (sampler.interpolation) {
+    case eInterpolationType::kStep:
+        return sampler.outputsVec4[keyframe];
+    case eInterpolationType::kCubicSpline: {
+        const float delta = sampler.inputs[keyframe + 1] - sampler.inputs[keyframe];
+        const glm::vec4& p0 = sampler.outputsVec4[keyframe * 3 + 1];
+        const glm::vec4 m0 = delta * sampler.outputsVec4[keyframe * 3 + 2];
+        const glm::vec4& p1 = sampler.outputsVec4[(keyframe + 1) * 3 + 1];
+        const glm::vec4 m1 = delta * sampler.outputsVec4[(keyframe + 1) * 3];
+
+        const float u2 = u * u;
+        const float u3 = u2 * u;
+        return (2.0f * u3 - 3.0f * u2 + 1.0f) * p0 + (u3 - 2.0f * u2 + u) * m0 + (-2.0f * u3 + 3.0f * u2) * p1 + (u3 - u2) * m1;
+    }
+    default:
+        return glm::mix(sampler.outputsVec4[keyframe], sampler.outputsVec4[keyframe + 1], u);
     }
 }
 }
@@ -66,38 +477,47 @@ CG::Vk::GLTFModel::~GLTFModel()
     loaded = false;
 
     for (auto& texture : textures) {
-        texture.texture.Destroy();
+        // Loading may fail before every texture is created
+        if (texture.texture.vkDevice) {
+            texture.texture.Destroy();
+        }
     }
 
     for (auto& material : materials) {
         material->materialParams.Destroy();
     }
 
-    for (auto& node : allNodes) {
-        if (node->mesh) {
-            for (auto& primitive : node->mesh->primitives) {
-                primitive->vertices.Destroy();
-                primitive->indices.Destroy();
-            }
-        }
+    for (auto& geometryBuffer : geometryBuffers) {
+        geometryBuffer.vertices.Destroy();
+        geometryBuffer.indices.Destroy();
     }
 }
 
 void CG::Vk::GLTFModel::LoadFromFile(const std::string& filename, float scale /*= 1.0f*/)
 {
+    if (loadingParams.useSceneCache && LoadFromCache(filename, scale)) {
+        return;
+    }
+
     tinygltf::Model glTFInput;
-    tinygltf::TinyGLTF gltfContext;
     std::string error, warning;
 
-    bool fileLoaded = gltfContext.LoadASCIIFromFile(&glTFInput, &error, &warning, filename);
-
-    std::vector<uint32_t> indexBuffer;
-    std::vector<Vertex> vertexBuffer;
+    bool fileLoaded = ParseFile(filename, glTFInput, error, warning);
 
     if (fileLoaded) {
+        ReportProgress(SGLTFModel::kProgressParsed);
+
+        // All textures, geometry and material buffers are gathered into one submit
+        UploadBatcher uploadBatcher(vkDevice, queue);
+
+        if (loadingParams.useSceneCache) {
+            OpenCache(filename, glTFInput);
+        }
+
         LoadTextureSamplers(glTFInput);
-        LoadTextures(glTFInput);
-        LoadMaterials(glTFInput);
+        LoadTextures(glTFInput, uploadBatcher);
+        LoadMaterials(glTFInput, uploadBatcher);
+        ReportProgress(SGLTFModel::kProgressTextures);
 
         if (glTFInput.scenes.empty()) {
             throw AssetLoadingException("Could not the load file!");
@@ -109,6 +529,17 @@ void CG::Vk::GLTFModel::LoadFromFile(const std::string& filename, float scale /*
             LoadNode(nullptr, node, scene.nodes[i], glTFInput, scale);
         }
 
+        DecodePrimitives(glTFInput);
+        ReportProgress(SGLTFModel::kProgressGeometry);
+
+        if (cacheWriter) {
+            WriteCache(filename, glTFInput, scale);
+        }
+
+        CreateGeometryBuffers(uploadBatcher);
+        uploadBatcher.Flush();
+        ReportProgress(SGLTFModel::kProgressUploaded);
+
         LoadAnimations(glTFInput);
         LoadSkins(glTFInput);
 
@@ -124,12 +555,597 @@ void CG::Vk::GLTFModel::LoadFromFile(const std::string& filename, float scale /*
         }
 
         CalculateSize();
+
+        // Everything is uploaded, so the source data is not needed anymore
+        buffersData.clear();
+        mappedFiles.clear();
+        sourceFiles.clear();
     } else {
+        std::cerr << error << std::endl;
         throw AssetLoadingException("Could not open the glTF file. Check, if it is correct");
         return;
     }
 
     extensions = glTFInput.extensionsUsed;
+    ReportProgress(1.0f);
+}
+
+bool CG::Vk::GLTFModel::ParseFile(const std::string& filename, tinygltf::Model& input, std::string& error, std::string& warning)
+{
+    const std::string baseDir = SGLTFModel::GetBaseDir(filename);
+    std::string jsonText;
+    SGLTFModel::GLBChunks glbChunks = {};
+
+    sourceFiles.push_back(filename.substr(baseDir.size()));
+
+    if (SGLTFModel::HasExtension(filename, ".glb")) {
+        auto glbFile = std::make_unique<MappedFile>();
+        if (!glbFile->Open(filename)) {
+            error = "Could not open " + filename;
+            return false;
+        }
+        if (!SGLTFModel::ParseGLBChunks(glbFile->GetData(), glbFile->GetSize(), glbChunks)) {
+            error = "Invalid glb container " + filename;
+            return false;
+        }
+        jsonText.assign(glbChunks.json, glbChunks.jsonSize);
+        mappedFiles.push_back(std::move(glbFile));
+    } else {
+        std::ifstream file(filename, std::ios::binary);
+        if (!file.is_open()) {
+            error = "Could not open " + filename;
+            return false;
+        }
+        jsonText.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    nlohmann::json root = nlohmann::json::parse(jsonText, nullptr, false);
+    if (root.is_discarded()) {
+        error = "Invalid glTF JSON in " + filename;
+        return false;
+    }
+
+    // Binary buffers are not copied into tinygltf::Buffer::data, accessors read them straight from the mappings
+    if (root.contains("buffers") && root["buffers"].is_array()) {
+        nlohmann::json& buffers = root["buffers"];
+        buffersData.assign(buffers.size(), nullptr);
+
+        for (size_t i = 0; i < buffers.size(); ++i) {
+            nlohmann::json& buffer = buffers[i];
+            const uint8_t* data = nullptr;
+            size_t dataSize = 0;
+
+            if (!buffer.contains("uri")) {
+                // Only the first buffer may refer to the glb binary chunk
+                if (i == 0 && glbChunks.binary) {
+                    data = glbChunks.binary;
+                    dataSize = glbChunks.binarySize;
+                }
+            } else if (buffer["uri"].is_string() && buffer["uri"].get<std::string>().rfind("data:", 0) != 0) {
+                sourceFiles.push_back(buffer["uri"].get<std::string>());
+
+                // External .bin file, falls back to tinygltf loading if it can't be mapped
+                auto binFile = std::make_unique<MappedFile>();
+                if (binFile->Open(baseDir + buffer["uri"].get<std::string>())) {
+                    data = binFile->GetData();
+                    dataSize = binFile->GetSize();
+                    mappedFiles.push_back(std::move(binFile));
+                }
+            }
+
+            if (data) {
+                if (buffer.value("byteLength", size_t(0)) > dataSize) {
+                    error = "Buffer " + std::to_string(i) + " is shorter than its byteLength";
+                    return false;
+                }
+                buffer["uri"] = SGLTFModel::kPlaceholderDataURI;
+                buffer["byteLength"] = 1;
+                buffersData[i] = data;
+            }
+        }
+    }
+
+    // Images stored in buffer views are decoded straight from the mappings too
+    if (root.contains("images") && root["images"].is_array()) {
+        encodedImages.resize(root["images"].size());
+    }
+    if (root.contains("images") && root["images"].is_array() && root.contains("bufferViews")) {
+        nlohmann::json& images = root["images"];
+        const nlohmann::json& bufferViews = root["bufferViews"];
+
+        for (size_t i = 0; i < images.size(); ++i) {
+            nlohmann::json& image = images[i];
+            if (!image.contains("bufferView")) {
+                continue;
+            }
+
+            const nlohmann::json& bufferView = bufferViews.at(image["bufferView"].get<size_t>());
+            const size_t bufferIndex = bufferView.at("buffer").get<size_t>();
+            if (bufferIndex >= buffersData.size() || !buffersData[bufferIndex]) {
+                continue;
+            }
+
+            encodedImages[i].data = buffersData[bufferIndex] + bufferView.value("byteOffset", size_t(0));
+            encodedImages[i].size = bufferView.at("byteLength").get<size_t>();
+            image.erase("bufferView");
+            image["uri"] = SGLTFModel::kPlaceholderDataURI;
+        }
+    }
+
+    tinygltf::TinyGLTF gltfContext;
+    gltfContext.SetImageLoader(LoadEncodedImage, this);
+
+    const std::string patchedJson = root.dump();
+    if (!gltfContext.LoadASCIIFromString(&input, &error, &warning, patchedJson.c_str(), static_cast<unsigned int>(patchedJson.size()), baseDir)) {
+        return false;
+    }
+
+    // Buffers, which were not mapped (data URIs), are owned by tinygltf
+    buffersData.resize(input.buffers.size(), nullptr);
+    for (size_t i = 0; i < input.buffers.size(); ++i) {
+        if (!buffersData[i]) {
+            buffersData[i] = input.buffers[i].data.data();
+        }
+    }
+
+    return true;
+}
+
+bool CG::Vk::GLTFModel::LoadEncodedImage(tinygltf::Image* image, const int imageIndex, std::string* error, std::string* warning,
+    int /*reqWidth*/, int /*reqHeight*/, const unsigned char* bytes, int size, void* userData)
+{
+    GLTFModel* model = static_cast<GLTFModel*>(userData);
+
+    if (imageIndex < 0 || static_cast<size_t>(imageIndex) >= model->encodedImages.size()) {
+        if (error) {
+            *error += "Unexpected image index " + std::to_string(imageIndex) + "\n";
+        }
+        return false;
+    }
+
+    // Embedded images already point into the mappings, the rest is only valid during this call
+    EncodedImage& encodedImage = model->encodedImages[imageIndex];
+    if (!encodedImage.data) {
+        encodedImage.ownedData.assign(bytes, bytes + size);
+        encodedImage.data = encodedImage.ownedData.data();
+        encodedImage.size = encodedImage.ownedData.size();
+    }
+
+    if (KTX2::IsKTX2(encodedImage.data, encodedImage.size)) {
+        encodedImage.isKTX2 = true;
+
+        KTX2::Image ktxImage;
+        std::string ktxError;
+        encodedImage.isLoadable = KTX2::Parse(encodedImage.data, encodedImage.size, ktxImage, ktxError);
+        if (!encodedImage.isLoadable && warning) {
+            *warning += "Image " + std::to_string(imageIndex) + " can't be used: " + ktxError + "\n";
+        }
+
+        // Size is only used to plan decoding batches, blocks take less than RGBA8 anyway
+        image->width = static_cast<int>(ktxImage.width);
+        image->height = static_cast<int>(ktxImage.height);
+        image->component = 4;
+        image->bits = 8;
+        image->pixel_type = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+        return true;
+    }
+
+    // Header is enough to plan decoding, pixels are decoded later by LoadTextures
+    int width = 0, height = 0, components = 0;
+    if (!stbi_info_from_memory(encodedImage.data, static_cast<int>(encodedImage.size), &width, &height, &components)) {
+        if (error) {
+            *error += "Unknown format of image " + std::to_string(imageIndex) + "\n";
+        }
+        return false;
+    }
+
+    // Images are always decoded into 8 bit RGBA
+    image->width = width;
+    image->height = height;
+    image->component = 4;
+    image->bits = 8;
+    image->pixel_type = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+    return true;
+}
+
+bool CG::Vk::GLTFModel::LoadFromCache(const std::string& filename, float scale)
+{
+    using namespace SceneCache;
+
+    const std::string cachePath = GetCachePath(filename);
+    Reader reader;
+    if (!reader.Open(cachePath)) {
+        return false;
+    }
+
+    const Header& header = reader.GetHeader();
+    if (header.geometryLayout != static_cast<uint32_t>(loadingParams.geometryLayout)
+        || header.vertexFormat != static_cast<uint32_t>(loadingParams.vertexFormat)
+        || header.mipGeneration != static_cast<uint32_t>(loadingParams.mipGeneration)
+        || header.textureCompression != static_cast<uint32_t>(IsTextureCompressionEnabled())
+        || header.vertexStride != GetVertexStride() || header.scale != scale) {
+        std::cout << "Scene cache " << cachePath << " was written with other loading params, rebuilding it" << std::endl;
+        return false;
+    }
+
+    size_t dependenciesCount = 0, texturesCount = 0, materialsCount = 0, geometriesCount = 0, nodesCount = 0, primitivesCount = 0,
+           extensionsCount = 0;
+    const DependencyRecord* dependencyRecords = reader.GetRecords<DependencyRecord>(header.dependencies, dependenciesCount);
+    const TextureRecord* textureRecords = reader.GetRecords<TextureRecord>(header.textures, texturesCount);
+    const MaterialRecord* materialRecords = reader.GetRecords<MaterialRecord>(header.materials, materialsCount);
+    size_t materialParamsCount = 0;
+    const Material::MaterialParams* materialParams = reader.GetRecords<Material::MaterialParams>(header.materialParams, materialParamsCount);
+    const GeometryRecord* geometryRecords = reader.GetRecords<GeometryRecord>(header.geometries, geometriesCount);
+    const NodeRecord* nodeRecords = reader.GetRecords<NodeRecord>(header.nodes, nodesCount);
+    const PrimitiveRecord* primitiveRecords = reader.GetRecords<PrimitiveRecord>(header.primitives, primitivesCount);
+    const StringRef* extensionRecords = reader.GetRecords<StringRef>(header.extensions, extensionsCount);
+
+    if (!dependencyRecords || !textureRecords || !materialRecords || !geometryRecords || !nodeRecords || !primitiveRecords
+        || !extensionRecords || !materialParams || materialsCount == 0 || materialParamsCount != materialsCount) {
+        std::cout << "Scene cache " << cachePath << " is damaged, rebuilding it" << std::endl;
+        return false;
+    }
+
+    const std::string baseDir = SGLTFModel::GetBaseDir(filename);
+    for (size_t i = 0; i < dependenciesCount; ++i) {
+        uint64_t fileSize = 0;
+        int64_t modifiedTime = 0;
+        const std::string path = baseDir + reader.GetString(dependencyRecords[i].path);
+        if (!GetFileStamp(path, fileSize, modifiedTime) || fileSize != dependencyRecords[i].size
+            || modifiedTime != dependencyRecords[i].modifiedTime) {
+            std::cout << "Scene cache " << cachePath << " is outdated, " << path << " has changed" << std::endl;
+            return false;
+        }
+    }
+
+    // Everything is validated before the first GPU resource is created, so a rejected cache leaves the model untouched
+    bool valid = true;
+    for (size_t i = 0; i < texturesCount; ++i) {
+        const TextureRecord& record = textureRecords[i];
+        const bool validLevels = record.mipLevels > 0 && record.mipLevels <= MipGenerator::GetMipLevelsCount(record.width, record.height);
+        valid = valid && validLevels && reader.GetBlob(record.data)
+            && record.data.size >= Texture2D::GetMipChainSize(static_cast<VkFormat>(record.format), record.width, record.height,
+                static_cast<uint16_t>(record.mipLevels));
+    }
+    for (size_t i = 0; i < materialsCount; ++i) {
+        const int32_t materialTextures[] = { materialRecords[i].baseColorTexture, materialRecords[i].metallicRoughnessTexture,
+            materialRecords[i].normalTexture, materialRecords[i].occlusionTexture, materialRecords[i].emissiveTexture };
+        for (int32_t textureIndex : materialTextures) {
+            valid = valid && textureIndex >= -1 && textureIndex < static_cast<int32_t>(texturesCount);
+        }
+    }
+    for (size_t i = 0; i < geometriesCount; ++i) {
+        valid = valid && reader.GetBlob(geometryRecords[i].vertices) && reader.GetBlob(geometryRecords[i].indices);
+    }
+    for (size_t i = 0; i < nodesCount; ++i) {
+        const NodeRecord& node = nodeRecords[i];
+        valid = valid && (node.parent == -1 || (node.parent > static_cast<int32_t>(i) && node.parent < static_cast<int32_t>(nodesCount)));
+        valid = valid && (node.firstPrimitive == -1 || static_cast<size_t>(node.firstPrimitive) + node.primitivesCount <= primitivesCount);
+    }
+    for (size_t i = 0; i < primitivesCount && valid; ++i) {
+        const PrimitiveRecord& record = primitiveRecords[i];
+        valid = record.material < materialsCount && record.geometryBufferIndex < geometriesCount
+            && (record.indexType == VK_INDEX_TYPE_UINT16 || record.indexType == VK_INDEX_TYPE_UINT32);
+        if (!valid) {
+            break;
+        }
+
+        // Ranges are read by BLAS builds and hit shaders, so they have to stay inside their geometry blobs
+        const GeometryRecord& geometry = geometryRecords[record.geometryBufferIndex];
+        const uint64_t indexSize = record.indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+        valid = (static_cast<uint64_t>(record.firstIndex) + record.indexCount) * indexSize <= geometry.indices.size
+            && (static_cast<uint64_t>(record.firstVertex) + record.vertexCount) * header.vertexStride <= geometry.vertices.size;
+    }
+    if (!valid) {
+        std::cout << "Scene cache " << cachePath << " is damaged, rebuilding it" << std::endl;
+        return false;
+    }
+
+    ReportProgress(SGLTFModel::kProgressParsed);
+
+    // Every blob is copied straight from the mapping into the staging ring and goes to the GPU with one flush
+    UploadBatcher uploadBatcher(vkDevice, queue);
+
+    textures.resize(texturesCount);
+    for (size_t i = 0; i < texturesCount; ++i) {
+        const TextureRecord& record = textureRecords[i];
+        ReportProgress(SGLTFModel::GetTexturesProgress(i, texturesCount));
+
+        TextureSampler textureSampler;
+        textureSampler.magFilter = static_cast<VkFilter>(record.magFilter);
+        textureSampler.minFilter = static_cast<VkFilter>(record.minFilter);
+        textureSampler.addressModeU = static_cast<VkSamplerAddressMode>(record.addressModeU);
+        textureSampler.addressModeV = static_cast<VkSamplerAddressMode>(record.addressModeV);
+        textureSampler.addressModeW = static_cast<VkSamplerAddressMode>(record.addressModeW);
+
+        textures[i].texture.FromBuffer(reader.GetBlob(record.data), record.data.size, static_cast<VkFormat>(record.format), record.width,
+            record.height, static_cast<uint16_t>(record.mipLevels), vkDevice, uploadBatcher, textureSampler, record.generateMips != 0);
+        KeepTextureData(textures[i], reader.GetBlob(record.data), static_cast<VkFormat>(record.format), record.width, record.height,
+            textureSampler);
+    }
+
+    const auto getTexture = [this](int32_t textureIndex) { return textureIndex > -1 ? &textures[textureIndex] : nullptr; };
+
+    for (size_t i = 0; i < materialsCount; ++i) {
+        const MaterialRecord& record = materialRecords[i];
+
+        std::unique_ptr<Material> material = std::make_unique<Material>();
+        material->baseColorFactor = record.baseColorFactor;
+        material->emissiveFactor = record.emissiveFactor;
+        material->metallicFactor = record.metallicFactor;
+        material->roughnessFactor = record.roughnessFactor;
+        material->alphaCutoff = record.alphaCutoff;
+        material->alphaMode = static_cast<Material::eAlphaMode>(record.alphaMode);
+        material->baseColorTexture = getTexture(record.baseColorTexture);
+        material->metallicRoughnessTexture = getTexture(record.metallicRoughnessTexture);
+        material->normalTexture = getTexture(record.normalTexture);
+        material->occlusionTexture = getTexture(record.occlusionTexture);
+        material->emissiveTexture = getTexture(record.emissiveTexture);
+        material->texCoordSets.baseColor = record.baseColorTexCoordSet;
+        material->texCoordSets.metallicRoughness = record.metallicRoughnessTexCoordSet;
+        material->texCoordSets.specularGlossiness = record.specularGlossinessTexCoordSet;
+        material->texCoordSets.normal = record.normalTexCoordSet;
+        material->texCoordSets.occlusion = record.occlusionTexCoordSet;
+        material->texCoordSets.emissive = record.emissiveTexCoordSet;
+        material->materialParamsData = materialParams[i];
+
+        material->BuildBuffers(vkDevice, uploadBatcher);
+        materials.push_back(std::move(material));
+    }
+
+    geometryBuffers.resize(geometriesCount);
+    for (size_t i = 0; i < geometriesCount; ++i) {
+        const GeometryRecord& record = geometryRecords[i];
+        CreateGeometryBuffer(geometryBuffers[i], reader.GetBlob(record.vertices), record.vertices.size, reader.GetBlob(record.indices),
+            record.indices.size, uploadBatcher);
+    }
+
+    if (loadingParams.keepGeometryData) {
+        geometryData.resize(geometriesCount);
+        for (size_t i = 0; i < geometriesCount; ++i) {
+            const GeometryRecord& record = geometryRecords[i];
+            const uint8_t* vertices = reader.GetBlob(record.vertices);
+            const uint8_t* indices = reader.GetBlob(record.indices);
+
+            GeometryData& geometry = geometryData[i];
+            geometry.vertices.assign(vertices, vertices + record.vertices.size);
+            geometry.indices.assign(indices, indices + record.indices.size);
+            geometry.vertexCount = record.vertexCount;
+            geometry.indicesSize = record.indices.size;
+        }
+    }
+
+    uploadBatcher.Flush();
+    ReportProgress(SGLTFModel::kProgressUploaded);
+
+    std::vector<std::unique_ptr<Node>> loadedNodes(nodesCount);
+    for (size_t i = 0; i < nodesCount; ++i) {
+        const NodeRecord& record = nodeRecords[i];
+
+        loadedNodes[i] = std::make_unique<Node>();
+        Node* node = loadedNodes[i].get();
+        node->index = record.index;
+        node->name = reader.GetString(record.name);
+        node->matrix = record.matrix;
+        node->translation = record.translation;
+        node->rotation = record.rotation;
+        node->scale = record.scale;
+
+        if (record.firstPrimitive > -1) {
+            std::unique_ptr<Mesh> mesh = std::make_unique<Mesh>(vkDevice, node->matrix);
+            for (uint32_t p = 0; p < record.primitivesCount; ++p) {
+                const PrimitiveRecord& primitiveRecord = primitiveRecords[record.firstPrimitive + p];
+
+                std::unique_ptr<Primitive> primitive = std::make_unique<Primitive>(primitiveRecord.firstIndex, primitiveRecord.firstVertex,
+                    primitiveRecord.indexCount, primitiveRecord.vertexCount, *materials[primitiveRecord.material]);
+                primitive->bbox = AABBox(primitiveRecord.bboxMin, primitiveRecord.bboxMax);
+                primitive->bbox.valid = primitiveRecord.bboxValid != 0;
+                primitive->geometryBufferIndex = primitiveRecord.geometryBufferIndex;
+                primitive->indexType = static_cast<VkIndexType>(primitiveRecord.indexType);
+                mesh->primitives.push_back(std::move(primitive));
+            }
+            mesh->bbox = AABBox(record.meshBBoxMin, record.meshBBoxMax);
+            mesh->bbox.valid = record.meshBBoxValid != 0;
+            node->mesh = std::move(mesh);
+        }
+
+    }
+
+    // Children are stored before their parents, so a parent is still owned by loadedNodes when its children are attached
+    for (size_t i = 0; i < nodesCount; ++i) {
+        allNodes.push_back(loadedNodes[i].get());
+
+        const int32_t parent = nodeRecords[i].parent;
+        if (parent == -1) {
+            nodes.push_back(std::move(loadedNodes[i]));
+        } else {
+            loadedNodes[i]->parent = loadedNodes[parent].get();
+            loadedNodes[parent]->children.push_back(std::move(loadedNodes[i]));
+        }
+    }
+
+    for (auto node : allNodes) {
+        // Initial pose
+        if (node->mesh) {
+            node->UpdateRecursive();
+        }
+    }
+
+    CalculateSize();
+
+    for (size_t i = 0; i < extensionsCount; ++i) {
+        extensions.push_back(reader.GetString(extensionRecords[i]));
+    }
+
+    std::cout << "Loaded scene cache " << cachePath << std::endl;
+    ReportProgress(1.0f);
+    return true;
+}
+
+void CG::Vk::GLTFModel::OpenCache(const std::string& filename, const tinygltf::Model& input)
+{
+    if (!input.animations.empty() || !input.skins.empty()) {
+        return;
+    }
+
+    auto writer = std::make_unique<SceneCache::Writer>();
+    if (!writer->Open(SceneCache::GetCachePath(filename))) {
+        std::cerr << "Could not write scene cache " << SceneCache::GetCachePath(filename) << std::endl;
+        return;
+    }
+
+    cacheWriter = std::move(writer);
+    cacheTextureRecords.assign(input.textures.size(), {});
+}
+
+void CG::Vk::GLTFModel::WriteCache(const std::string& filename, const tinygltf::Model& input, float scale)
+{
+    using namespace SceneCache;
+
+    const std::string cachePath = GetCachePath(filename);
+    const std::string baseDir = SGLTFModel::GetBaseDir(filename);
+
+    // Unfinished cache file is removed by the writer
+    std::unique_ptr<Writer> writerOwner = std::move(cacheWriter);
+    Writer& writer = *writerOwner;
+
+    Header header = {};
+    header.geometryLayout = static_cast<uint32_t>(loadingParams.geometryLayout);
+    header.vertexFormat = static_cast<uint32_t>(loadingParams.vertexFormat);
+    header.mipGeneration = static_cast<uint32_t>(loadingParams.mipGeneration);
+    header.textureCompression = static_cast<uint32_t>(IsTextureCompressionEnabled());
+    header.vertexStride = GetVertexStride();
+    header.scale = scale;
+
+    // External images are read by tinygltf, so they are dependencies too
+    std::vector<std::string> dependencies = sourceFiles;
+    for (const tinygltf::Image& image : input.images) {
+        if (!image.uri.empty() && image.uri.rfind("data:", 0) != 0) {
+            dependencies.push_back(image.uri);
+        }
+    }
+
+    std::vector<DependencyRecord> dependencyRecords;
+    for (const std::string& dependency : dependencies) {
+        DependencyRecord record = {};
+        if (!GetFileStamp(baseDir + dependency, record.size, record.modifiedTime)) {
+            std::cerr << "Scene cache is not written, could not stat " << baseDir + dependency << std::endl;
+            return;
+        }
+        record.path = writer.AddString(dependency);
+        dependencyRecords.push_back(record);
+    }
+    header.dependencies = writer.WriteRecords(dependencyRecords);
+
+    // Pixels are already in the file, LoadTextures writes them right after decoding
+    header.textures = writer.WriteRecords(cacheTextureRecords);
+    cacheTextureRecords.clear();
+
+    const auto getTextureIndex = [this](const Texture* texture) {
+        return texture ? static_cast<int32_t>(texture - textures.data()) : -1;
+    };
+
+    std::vector<MaterialRecord> materialRecords;
+    for (const auto& material : materials) {
+        MaterialRecord record = {};
+        record.baseColorFactor = material->baseColorFactor;
+        record.emissiveFactor = material->emissiveFactor;
+        record.metallicFactor = material->metallicFactor;
+        record.roughnessFactor = material->roughnessFactor;
+        record.alphaCutoff = material->alphaCutoff;
+        record.alphaMode = static_cast<uint32_t>(material->alphaMode);
+        record.baseColorTexture = getTextureIndex(material->baseColorTexture);
+        record.metallicRoughnessTexture = getTextureIndex(material->metallicRoughnessTexture);
+        record.normalTexture = getTextureIndex(material->normalTexture);
+        record.occlusionTexture = getTextureIndex(material->occlusionTexture);
+        record.emissiveTexture = getTextureIndex(material->emissiveTexture);
+        record.baseColorTexCoordSet = material->texCoordSets.baseColor;
+        record.metallicRoughnessTexCoordSet = material->texCoordSets.metallicRoughness;
+        record.specularGlossinessTexCoordSet = material->texCoordSets.specularGlossiness;
+        record.normalTexCoordSet = material->texCoordSets.normal;
+        record.occlusionTexCoordSet = material->texCoordSets.occlusion;
+        record.emissiveTexCoordSet = material->texCoordSets.emissive;
+        materialRecords.push_back(record);
+    }
+    header.materials = writer.WriteRecords(materialRecords);
+
+    std::vector<Material::MaterialParams> materialParams;
+    for (const auto& material : materials) {
+        materialParams.push_back(material->materialParamsData);
+    }
+    header.materialParams = writer.WriteRecords(materialParams);
+
+    std::vector<GeometryRecord> geometryRecords;
+    for (const GeometryData& geometry : geometryData) {
+        GeometryRecord record = {};
+        record.vertexCount = geometry.vertexCount;
+        record.vertices = writer.WriteBlob(geometry.vertices.data(), geometry.vertices.size());
+        record.indices = writer.WriteBlob(geometry.indices.data(), geometry.indices.size());
+        geometryRecords.push_back(record);
+    }
+    header.geometries = writer.WriteRecords(geometryRecords);
+
+    std::unordered_map<const Node*, int32_t> nodeRecordIndices;
+    std::unordered_map<const Material*, uint32_t> materialIndices;
+    for (size_t i = 0; i < materials.size(); ++i) {
+        materialIndices[materials[i].get()] = static_cast<uint32_t>(i);
+    }
+    for (size_t i = 0; i < allNodes.size(); ++i) {
+        nodeRecordIndices[allNodes[i]] = static_cast<int32_t>(i);
+    }
+
+    std::vector<NodeRecord> nodeRecords;
+    std::vector<PrimitiveRecord> primitiveRecords;
+    for (const Node* node : allNodes) {
+        NodeRecord record = {};
+        record.matrix = node->matrix;
+        record.rotation = node->rotation;
+        record.translation = node->translation;
+        record.scale = node->scale;
+        record.parent = node->parent ? nodeRecordIndices[node->parent] : -1;
+        record.index = node->index;
+        record.name = writer.AddString(node->name);
+
+        if (node->mesh) {
+            record.meshBBoxMin = node->mesh->bbox.min;
+            record.meshBBoxMax = node->mesh->bbox.max;
+            record.meshBBoxValid = node->mesh->bbox.valid ? 1 : 0;
+            record.firstPrimitive = static_cast<int32_t>(primitiveRecords.size());
+            record.primitivesCount = static_cast<uint32_t>(node->mesh->primitives.size());
+
+            for (const auto& primitive : node->mesh->primitives) {
+                PrimitiveRecord primitiveRecord = {};
+                primitiveRecord.firstIndex = primitive->firstIndex;
+                primitiveRecord.firstVertex = primitive->firstVertex;
+                primitiveRecord.indexCount = primitive->indexCount;
+                primitiveRecord.vertexCount = primitive->vertexCount;
+                primitiveRecord.geometryBufferIndex = primitive->geometryBufferIndex;
+                primitiveRecord.indexType = primitive->indexType;
+                primitiveRecord.material = materialIndices[&primitive->material];
+                primitiveRecord.bboxValid = primitive->bbox.valid ? 1 : 0;
+                primitiveRecord.bboxMin = primitive->bbox.min;
+                primitiveRecord.bboxMax = primitive->bbox.max;
+                primitiveRecords.push_back(primitiveRecord);
+            }
+        }
+
+        nodeRecords.push_back(record);
+    }
+    header.nodes = writer.WriteRecords(nodeRecords);
+    header.primitives = writer.WriteRecords(primitiveRecords);
+
+    std::vector<StringRef> extensionRecords;
+    for (const std::string& extension : input.extensionsUsed) {
+        extensionRecords.push_back(writer.AddString(extension));
+    }
+    header.extensions = writer.WriteRecords(extensionRecords);
+
+    if (!writer.Finish(header)) {
+        std::cerr << "Could not write scene cache " << cachePath << std::endl;
+        return;
+    }
+
+    std::cout << "Written scene cache " << cachePath << std::endl;
 }
 
 std::vector<std::unique_ptr<CG::Vk::GLTFModel::Material>>& CG::Vk::GLTFModel::GetMaterials()
@@ -137,6 +1153,11 @@ std::vector<std::unique_ptr<CG::Vk::GLTFModel::Material>>& CG::Vk::GLTFModel::Ge
     return materials;
 }
 
+const std::vector<std::unique_ptr<CG::Vk::GLTFModel::Material>>& CG::Vk::GLTFModel::GetMaterials() const
+{
+    return materials;
+}
+
 const std::vector<CG::Vk::GLTFModel::Texture>& CG::Vk::GLTFModel::GetTextures() const
 {
     return textures;
@@ -152,6 +1173,21 @@ const std::vector<CG::Vk::GLTFModel::Node*>& CG::Vk::GLTFModel::GetFlatNodes() c
     return allNodes;
 }
 
+const std::vector<CG::Vk::GLTFModel::GeometryBuffer>& CG::Vk::GLTFModel::GetGeometryBuffers() const
+{
+    return geometryBuffers;
+}
+
+const std::vector<CG::Vk::GLTFModel::GeometryData>& CG::Vk::GLTFModel::GetGeometryData() const
+{
+    return geometryData;
+}
+
+uint32_t CG::Vk::GLTFModel::GetVertexStride() const
+{
+    return static_cast<uint32_t>(loadingParams.vertexFormat == eVertexFormat::kCompact ? sizeof(CompactVertex) : sizeof(Vertex));
+}
+
 bool CG::Vk::GLTFModel::IsLoaded() const
 {
     return loaded;
@@ -179,6 +1215,55 @@ const uint32_t CG::Vk::GLTFModel::GetPrimitivesCount()
     return primCount;
 }
 
+const std::vector<CG::Vk::GLTFModel::Animation>& CG::Vk::GLTFModel::GetAnimations() const
+{
+    return animations;
+}
+
+bool CG::Vk::GLTFModel::UpdateAnimation(uint32_t index, float time)
+{
+    if (index >= animations.size()) {
+        return false;
+    }
+
+    bool updated = false;
+    for (const AnimationChannel& channel : animations[index].channels) {
+        const AnimationSampler& sampler = animations[index].samplers[channel.samplerIndex];
+        const size_t outputsPerKeyframe = sampler.interpolation == AnimationSampler::eInterpolationType::kCubicSpline ? 3 : 1;
+        if (sampler.inputs.size() < 2 || sampler.outputsVec4.size() < sampler.inputs.size() * outputsPerKeyframe) {
+            continue;
+        }
+
+        // Channels keep their first and last values outside of their keyframes
+        const float clampedTime = glm::clamp(time, sampler.inputs.front(), sampler.inputs.back());
+        const auto next = std::upper_bound(sampler.inputs.begin(), sampler.inputs.end() - 1, clampedTime);
+        const size_t keyframe = static_cast<size_t>(std::max(next - sampler.inputs.begin(), std::ptrdiff_t(1))) - 1;
+        const float delta = sampler.inputs[keyframe + 1] - sampler.inputs[keyframe];
+        const float u = delta > 0.0f ? glm::clamp((clampedTime - sampler.inputs[keyframe]) / delta, 0.0f, 1.0f) : 0.0f;
+
+        switch (channel.path) {
+        case AnimationChannel::ePathType::kTranslation:
+            channel.node->translation = glm::vec3(SGLTFModel::SampleKeyframes(sampler, keyframe, u));
+            break;
+        case AnimationChannel::ePathType::kScale:
+            channel.node->scale = glm::vec3(SGLTFModel::SampleKeyframes(sampler, keyframe, u));
+            break;
+        case AnimationChannel::ePathType::kRotation:
+            if (sampler.interpolation == AnimationSampler::eInterpolationType::kLinear) {
+                const glm::quat q0 = SGLTFModel::ToQuat(sampler.outputsVec4[keyframe]);
+                const glm::quat q1 = SGLTFModel::ToQuat(sampler.outputsVec4[keyframe + 1]);
+                channel.node->rotation = glm::normalize(glm::slerp(q0, q1, u));
+            } else {
+                channel.node->rotation = glm::normalize(SGLTFModel::ToQuat(SGLTFModel::SampleKeyframes(sampler, keyframe, u)));
+            }
+            break;
+        }
+        updated = true;
+    }
+
+    return updated;
+}
+
 // from GLTF2 specs
 VkSamplerAddressMode CG::Vk::GLTFModel::GetVkWrapMode(int32_t wrapMode)
 {
@@ -228,29 +1313,245 @@ void CG::Vk::GLTFModel::LoadTextureSamplers(const tinygltf::Model& input)
     }
 }
 
-void CG::Vk::GLTFModel::LoadTextures(const tinygltf::Model& input)
+CG::Vk::TextureSampler CG::Vk::GLTFModel::GetTextureSampler(int32_t samplerIndex) const
 {
-    textures.reserve(input.textures.size());
+    if (samplerIndex != -1) {
+        return textureSamplers[samplerIndex];
+    }
 
-    for (const tinygltf::Texture& tex : input.textures) {
-        const tinygltf::Image& image = input.images[tex.source];
-        TextureSampler textureSampler;
-        if (tex.sampler == -1) {
-            textureSampler.magFilter = VK_FILTER_LINEAR;
-            textureSampler.minFilter = VK_FILTER_LINEAR;
-            textureSampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-            textureSampler.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-            textureSampler.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    TextureSampler textureSampler;
+    textureSampler.magFilter = VK_FILTER_LINEAR;
+    textureSampler.minFilter = VK_FILTER_LINEAR;
+    textureSampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    textureSampler.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    textureSampler.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    return textureSampler;
+}
+
+void CG::Vk::GLTFModel::KeepTextureData(
+    Texture& texture, const void* pixels, VkFormat format, uint32_t width, uint32_t height, const TextureSampler& sampler) const
+{
+    if (!loadingParams.keepTextureData) {
+        return;
+    }
+
+    if (format != VK_FORMAT_R8G8B8A8_UNORM) {
+        std::cout << "Texture in format " << format << " has no CPU copy, only R8G8B8A8 images are kept" << std::endl;
+        return;
+    }
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(pixels);
+    texture.data.width = width;
+    texture.data.height = height;
+    texture.data.pixels.assign(bytes, bytes + static_cast<size_t>(width) * height * 4);
+    texture.data.sampler = sampler;
+}
+
+bool CG::Vk::GLTFModel::IsTextureCompressionEnabled() const
+{
+    return loadingParams.compressTextures && vkDevice->enabledFeatures.textureCompressionBC;
+}
+
+size_t CG::Vk::GLTFModel::GetTextureSource(const tinygltf::Texture& texture) const
+{
+    const auto basisu = texture.extensions.find("KHR_texture_basisu");
+    if (basisu != texture.extensions.end() && basisu->second.Has("source") && basisu->second.Get("source").IsInt()) {
+        const int source = basisu->second.Get("source").Get<int>();
+        if (source >= 0 && static_cast<size_t>(source) < encodedImages.size() && encodedImages[source].isLoadable) {
+            return static_cast<size_t>(source);
+        }
+    }
+
+    if (texture.source < 0 || static_cast<size_t>(texture.source) >= encodedImages.size() || !encodedImages[texture.source].isLoadable) {
+        throw AssetLoadingException("Texture has no image the engine can load!");
+    }
+    return static_cast<size_t>(texture.source);
+}
+
+void CG::Vk::GLTFModel::LoadTextures(const tinygltf::Model& input, UploadBatcher& uploadBatcher)
+{
+    const auto decodingStart = std::chrono::high_resolution_clock::now();
+
+    textures.resize(input.textures.size());
+
+    // Every image is decoded once, even if several textures refer to it
+    std::vector<std::vector<size_t>> imageTextures(input.images.size());
+    std::vector<size_t> sourceImages;
+    std::vector<size_t> textureSources(input.textures.size());
+    for (size_t i = 0; i < input.textures.size(); ++i) {
+        const size_t source = GetTextureSource(input.textures[i]);
+        if (imageTextures[source].empty()) {
+            sourceImages.push_back(source);
+        }
+        imageTextures[source].push_back(i);
+        textureSources[i] = source;
+    }
+
+    const bool compress = IsTextureCompressionEnabled();
+    if (loadingParams.compressTextures && !compress) {
+        std::cout << "Device doesn't support BC textures, they are loaded uncompressed" << std::endl;
+    }
+
+    // Block compressed levels can't be blitted, so the chain is filtered on the CPU before the encoding
+    const bool cpuMips = loadingParams.mipGeneration == eMipGeneration::kBox || loadingParams.mipGeneration == eMipGeneration::kKaiser
+        || (compress && loadingParams.mipGeneration == eMipGeneration::kGPU);
+    const MipGenerator::eFilter mipFilter = loadingParams.mipGeneration == eMipGeneration::kKaiser ? MipGenerator::eFilter::kKaiser
+                                                                                                   : MipGenerator::eFilter::kBox;
+
+    std::vector<uint32_t> imageUsages;
+    if (compress) {
+        imageUsages = SGLTFModel::GetImageUsages(input, textureSources);
+    }
+
+    struct DecodedImage {
+        std::unique_ptr<stbi_uc, void (*)(void*)> pixels { nullptr, stbi_image_free };
+        int width = 0;
+        int height = 0;
+        VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+        // Whole chain if it is generated, compressed or read from KTX2 on the CPU, pixels are released then
+        std::vector<uint8_t> mipChain;
+        uint16_t levelsCount = 1;
+        bool generateMips = false;
+    };
+
+    size_t batchBegin = 0;
+    while (batchBegin < sourceImages.size()) {
+        // Decoded pixels of a batch fit into the budget, big models never keep all of their images in memory
+        size_t batchEnd = batchBegin;
+        size_t batchSize = 0;
+        while (batchEnd < sourceImages.size()) {
+            const tinygltf::Image& image = input.images[sourceImages[batchEnd]];
+            const uint32_t imageWidth = static_cast<uint32_t>(image.width);
+            const uint32_t imageHeight = static_cast<uint32_t>(image.height);
+            const uint16_t levelsCount = cpuMips ? MipGenerator::GetMipLevelsCount(imageWidth, imageHeight) : 1;
+            const size_t decodedSize = MipGenerator::GetMipChainSize(imageWidth, imageHeight, levelsCount, 4);
+            if (batchEnd > batchBegin && batchSize + decodedSize > SGLTFModel::kDecodedImagesBudget) {
+                break;
+            }
+            batchSize += decodedSize;
+            ++batchEnd;
+        }
+
+        std::vector<DecodedImage> decodedImages(batchEnd - batchBegin);
+
+        const auto decodeImage = [this, batchBegin, compress, cpuMips, mipFilter, &imageUsages, &sourceImages, &decodedImages](size_t i) {
+            const size_t source = sourceImages[batchBegin + i];
+            const EncodedImage& encodedImage = encodedImages[source];
+            DecodedImage& decodedImage = decodedImages[i];
+
+            // KTX2 levels are already in their final format
+            if (encodedImage.isKTX2) {
+                KTX2::Image ktxImage;
+                std::string error;
+                if (!KTX2::Parse(encodedImage.data, encodedImage.size, ktxImage, error)) {
+                    throw AssetLoadingException("Failed to parse KTX2 texture image!");
+                }
+                // There is no source to decode instead, so the file can't be used without BC support
+                if (Texture2D::IsBlockCompressed(ktxImage.format) && !vkDevice->enabledFeatures.textureCompressionBC) {
+                    throw AssetLoadingException("KTX2 texture image is BC compressed, but the device doesn't support BC textures!");
+                }
+                decodedImage.width = static_cast<int>(ktxImage.width);
+                decodedImage.height = static_cast<int>(ktxImage.height);
+                decodedImage.format = ktxImage.format;
+                decodedImage.mipChain = KTX2::GetMipChain(ktxImage);
+                decodedImage.levelsCount = static_cast<uint16_t>(ktxImage.levels.size());
+                decodedImage.generateMips = ktxImage.generateMips && loadingParams.mipGeneration != eMipGeneration::kNone;
+                return;
+            }
+
+            int components = 0;
+            decodedImage.pixels.reset(stbi_load_from_memory(encodedImage.data, static_cast<int>(encodedImage.size),
+                &decodedImage.width, &decodedImage.height, &components, STBI_rgb_alpha));
+            if (!decodedImage.pixels) {
+                throw AssetLoadingException("Failed to decode texture image!");
+            }
+
+            const uint32_t width = static_cast<uint32_t>(decodedImage.width);
+            const uint32_t height = static_cast<uint32_t>(decodedImage.height);
+
+            if (cpuMips || compress) {
+                decodedImage.levelsCount = cpuMips ? MipGenerator::GetMipLevelsCount(width, height) : 1;
+                decodedImage.mipChain.resize(MipGenerator::GetMipChainSize(width, height, decodedImage.levelsCount, 4));
+
+                memcpy(decodedImage.mipChain.data(), decodedImage.pixels.get(), static_cast<size_t>(width) * height * 4);
+                decodedImage.pixels.reset();
+
+                MipGenerator::GenerateMipChain(decodedImage.mipChain.data(), width, height, decodedImage.levelsCount, mipFilter);
+            } else {
+                decodedImage.generateMips = loadingParams.mipGeneration == eMipGeneration::kGPU;
+            }
+
+            if (compress) {
+                decodedImage.format = SGLTFModel::GetCompressedFormat(imageUsages[source],
+                    BlockCompressor::IsOpaque(decodedImage.mipChain.data(), width, height));
+
+                std::vector<uint8_t> blocks(static_cast<size_t>(
+                    Texture2D::GetMipChainSize(decodedImage.format, width, height, decodedImage.levelsCount)));
+                BlockCompressor::CompressMipChain(
+                    decodedImage.mipChain.data(), width, height, decodedImage.levelsCount, decodedImage.format, blocks.data());
+                decodedImage.mipChain.swap(blocks);
+            }
+        };
+
+        if (threadPool) {
+            threadPool->ParallelFor(decodedImages.size(), decodeImage);
         } else {
-            textureSampler = textureSamplers[tex.sampler];
+            for (size_t i = 0; i < decodedImages.size(); ++i) {
+                decodeImage(i);
+            }
         }
-        Texture texture;
-        texture.FromGLTFImage(image, textureSampler, vkDevice, queue);
-        textures.push_back(texture);
+
+        // Batcher copies pixels into the staging ring, so the batch is released before the next one is decoded
+        for (size_t i = 0; i < decodedImages.size(); ++i) {
+            const DecodedImage& decodedImage = decodedImages[i];
+            const uint32_t width = static_cast<uint32_t>(decodedImage.width);
+            const uint32_t height = static_cast<uint32_t>(decodedImage.height);
+            const uint8_t* pixels = decodedImage.mipChain.empty() ? decodedImage.pixels.get() : decodedImage.mipChain.data();
+            const VkDeviceSize pixelsSize = Texture2D::GetMipChainSize(decodedImage.format, width, height, decodedImage.levelsCount);
+
+            SceneCache::Range cacheRange = {};
+            if (cacheWriter) {
+                cacheRange = cacheWriter->WriteBlob(pixels, static_cast<size_t>(pixelsSize));
+            }
+
+            for (size_t textureIndex : imageTextures[sourceImages[batchBegin + i]]) {
+                const TextureSampler textureSampler = GetTextureSampler(input.textures[textureIndex].sampler);
+                textures[textureIndex].texture.FromBuffer(pixels, pixelsSize, decodedImage.format, width, height, decodedImage.levelsCount,
+                    vkDevice, uploadBatcher, textureSampler, decodedImage.generateMips);
+                KeepTextureData(textures[textureIndex], pixels, decodedImage.format, width, height, textureSampler);
+
+                if (cacheWriter) {
+                    SceneCache::TextureRecord& record = cacheTextureRecords[textureIndex];
+                    record.width = width;
+                    record.height = height;
+                    record.mipLevels = decodedImage.levelsCount;
+                    record.generateMips = decodedImage.generateMips ? 1 : 0;
+                    record.format = decodedImage.format;
+                    record.magFilter = textureSampler.magFilter;
+                    record.minFilter = textureSampler.minFilter;
+                    record.addressModeU = textureSampler.addressModeU;
+                    record.addressModeV = textureSampler.addressModeV;
+                    record.addressModeW = textureSampler.addressModeW;
+                    record.data = cacheRange;
+                }
+            }
+        }
+
+        batchBegin = batchEnd;
+        ReportProgress(SGLTFModel::GetTexturesProgress(batchEnd, sourceImages.size()));
+    }
+
+    // Encoded bytes are not needed anymore, embedded ones are only pointers into the mappings
+    encodedImages.clear();
+
+    if (!sourceImages.empty()) {
+        const float milliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - decodingStart).count();
+        std::cout << (compress ? "Decoded and compressed " : "Decoded ") << sourceImages.size() << " image(s) in " << milliseconds
+                  << " ms on " << (threadPool ? threadPool->GetThreadsCount() : 1) << " thread(s)" << std::endl;
     }
 }
 
-void CG::Vk::GLTFModel::LoadMaterials(const tinygltf::Model& input)
+void CG::Vk::GLTFModel::LoadMaterials(const tinygltf::Model& input, UploadBatcher& uploadBatcher)
 {
     for (const tinygltf::Material& mat : input.materials) {
         std::unique_ptr<Material> material = std::make_unique<Material>();
@@ -323,13 +1624,13 @@ void CG::Vk::GLTFModel::LoadMaterials(const tinygltf::Model& input)
         materialParams.alphaMaskCutoff = material->alphaCutoff;
         material->materialParamsData = materialParams;
 
-        material->BuildBuffers(vkDevice, queue);
+        material->BuildBuffers(vkDevice, uploadBatcher);
 
         materials.push_back(std::move(material));
     }
     // Push a default material at the end of the list for meshes with no material assigned
     auto defaultMaterial = std::make_unique<Material>();
-    defaultMaterial->BuildBuffers(vkDevice, queue);
+    defaultMaterial->BuildBuffers(vkDevice, uploadBatcher);
     materials.push_back(std::move(defaultMaterial));
 }
 
@@ -356,12 +1657,10 @@ void CG::Vk::GLTFModel::LoadAnimations(const tinygltf::Model& input)
             // Read sampler input time values
             {
                 const tinygltf::Accessor& accessor = input.accessors[samp.input];
-                const tinygltf::BufferView& bufferView = input.bufferViews[accessor.bufferView];
-                const tinygltf::Buffer& buffer = input.buffers[bufferView.buffer];
 
                 assert(accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT);
 
-                const void* dataPtr = &buffer.data[accessor.byteOffset + bufferView.byteOffset];
+                const void* dataPtr = SGLTFModel::GetAccessorData(input, buffersData, accessor);
                 const float* buf = static_cast<const float*>(dataPtr);
                 for (size_t index = 0; index < accessor.count; index++) {
                     sampler.inputs.push_back(buf[index]);
@@ -380,12 +1679,10 @@ void CG::Vk::GLTFModel::LoadAnimations(const tinygltf::Model& input)
             // Read sampler output T/R/S values
             {
                 const tinygltf::Accessor& accessor = input.accessors[samp.output];
-                const tinygltf::BufferView& bufferView = input.bufferViews[accessor.bufferView];
-                const tinygltf::Buffer& buffer = input.buffers[bufferView.buffer];
 
                 assert(accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT);
 
-                const void* dataPtr = &buffer.data[accessor.byteOffset + bufferView.byteOffset];
+                const void* dataPtr = SGLTFModel::GetAccessorData(input, buffersData, accessor);
 
                 switch (accessor.type) {
                 case TINYGLTF_TYPE_VEC3: {
@@ -464,10 +1761,8 @@ void CG::Vk::GLTFModel::LoadSkins(const tinygltf::Model& input)
         // Get inverse bind matrices from buffer
         if (source.inverseBindMatrices > -1) {
             const tinygltf::Accessor& accessor = input.accessors[source.inverseBindMatrices];
-            const tinygltf::BufferView& bufferView = input.bufferViews[accessor.bufferView];
-            const tinygltf::Buffer& buffer = input.buffers[bufferView.buffer];
             newSkin->inverseBindMatrices.resize(accessor.count);
-            memcpy(newSkin->inverseBindMatrices.data(), &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(glm::mat4));
+            memcpy(newSkin->inverseBindMatrices.data(), SGLTFModel::GetAccessorData(input, buffersData, accessor), accessor.count * sizeof(glm::mat4));
         }
 
         skins.push_back(std::move(newSkin));
@@ -492,65 +1787,173 @@ void CG::Vk::GLTFModel::CalculateSize()
     size = glm::vec3(dimension.max[0] - dimension.min[0], dimension.max[1] - dimension.min[1], dimension.max[2] - dimension.min[2]);
 }
 
-void CG::Vk::GLTFModel::CreatePrimitiveBuffers(Primitive* newPrimitive, std::vector<Vertex>& vertexBuffer,
-    std::vector<uint32_t>& indexBuffer)
+void CG::Vk::GLTFModel::ReportProgress(float progress) const
 {
-    size_t vertexBufferSize = vertexBuffer.size() * sizeof(Vertex);
-    size_t indexBufferSize = indexBuffer.size() * sizeof(uint32_t);
-    newPrimitive->indexCount = static_cast<uint32_t>(indexBuffer.size());
-    newPrimitive->vertexCount = static_cast<uint32_t>(vertexBuffer.size());
+    if (progressCallback) {
+        progressCallback(progress);
+    }
+}
 
-    // We are creating this buffers to copy them on local memory for better performance
-    Buffer vertexStaging, indexStaging;
+void CG::Vk::GLTFModel::DecodePrimitives(const tinygltf::Model& input)
+{
+    for (GeometryData& geometry : geometryData) {
+        geometry.vertices.resize(static_cast<size_t>(geometry.vertexCount) * GetVertexStride());
+        // Shaders fetch indices as 32 bit words, so the tail of the last 16 bit range has to be inside of the buffer
+        geometry.indices.resize(SGLTFModel::AlignUp(geometry.indicesSize, sizeof(uint32_t)));
+    }
 
-    VK_CHECK_RESULT(vkDevice->CreateBuffer(
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        &vertexStaging,
-        vertexBufferSize,
-        vertexBuffer.data()));
+    // Every task decodes a range of vertices or indices of one primitive into its own part of the geometry
+    struct DecodeTask {
+        const PrimitiveDecodeJob* job = nullptr;
+        uint32_t begin = 0;
+        uint32_t end = 0;
+        bool indices = false;
+    };
 
-    VK_CHECK_RESULT(vkDevice->CreateBuffer(
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        &indexStaging,
-        indexBufferSize,
-        indexBuffer.data()));
+    std::vector<DecodeTask> decodeTasks;
+    for (const PrimitiveDecodeJob& job : primitiveDecodeJobs) {
+        for (uint32_t begin = 0; begin < job.vertexCount; begin += SGLTFModel::kDecodeRangeSize) {
+            decodeTasks.push_back({ &job, begin, std::min(begin + SGLTFModel::kDecodeRangeSize, job.vertexCount), false });
+        }
+        for (uint32_t begin = 0; begin < job.indexCount; begin += SGLTFModel::kDecodeRangeSize) {
+            decodeTasks.push_back({ &job, begin, std::min(begin + SGLTFModel::kDecodeRangeSize, job.indexCount), true });
+        }
+    }
+
+    const auto decodeTask = [this, &input, &decodeTasks](size_t taskIndex) {
+        const DecodeTask& task = decodeTasks[taskIndex];
+        GeometryData& geometry = geometryData[task.job->geometryBufferIndex];
+
+        if (task.indices) {
+            uint8_t* firstIndex = geometry.indices.data() + static_cast<size_t>(task.job->firstIndex) * SGLTFModel::GetIndexSize(task.job->indexType);
+            SGLTFModel::DecodeIndices(*task.job->primitive, input, buffersData, task.begin, task.end, task.job->indexType, firstIndex);
+            return;
+        }
+
+        const size_t firstVertex = static_cast<size_t>(task.job->firstVertex) + task.begin;
+
+        if (loadingParams.vertexFormat == eVertexFormat::kCompact) {
+            // Full vertices are only an intermediate step, range is small enough to keep them in a per thread scratch
+            thread_local std::vector<Vertex> scratchVertices;
+            scratchVertices.resize(task.end - task.begin);
+
+            SGLTFModel::DecodeVertices(*task.job->primitive, input, buffersData, task.begin, task.end, scratchVertices.data());
+            SGLTFModel::PackCompactVertices(scratchVertices.data(), scratchVertices.size(),
+                reinterpret_cast<CompactVertex*>(geometry.vertices.data()) + firstVertex);
+        } else {
+            SGLTFModel::DecodeVertices(*task.job->primitive, input, buffersData, task.begin, task.end,
+                reinterpret_cast<Vertex*>(geometry.vertices.data()) + firstVertex);
+        }
+    };
+
+    if (threadPool) {
+        threadPool->ParallelFor(decodeTasks.size(), decodeTask);
+    } else {
+        for (size_t i = 0; i < decodeTasks.size(); ++i) {
+            decodeTask(i);
+        }
+    }
+
+    primitiveDecodeJobs.clear();
+    primitiveDecodeJobs.shrink_to_fit();
+    meshPrimitiveDecodeJobs.clear();
+    geometryHashDecodeJobs.clear();
+}
+
+void CG::Vk::GLTFModel::CreateGeometryBuffers(UploadBatcher& uploadBatcher)
+{
+    geometryBuffers.resize(geometryData.size());
+
+    for (size_t i = 0; i < geometryData.size(); ++i) {
+        const GeometryData& data = geometryData[i];
+        GeometryBuffer& geometryBuffer = geometryBuffers[i];
+
+        CreateGeometryBuffer(geometryBuffer, data.vertices.data(), data.vertices.size(), data.indices.data(), data.indices.size(), uploadBatcher);
+    }
+
+    // Staging ring already holds a copy, so CPU geometry is not needed anymore
+    if (!loadingParams.keepGeometryData) {
+        geometryData.clear();
+        geometryData.shrink_to_fit();
+    }
+}
+
+void CG::Vk::GLTFModel::CreateGeometryBuffer(GeometryBuffer& geometryBuffer, const void* vertices, VkDeviceSize verticesSize,
+    const void* indices, VkDeviceSize indicesSize, UploadBatcher& uploadBatcher)
+{
+    if (verticesSize == 0 || indicesSize == 0) {
+        return;
+    }
 
     VK_CHECK_RESULT(vkDevice->CreateBuffer(
-        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+            | loadingParams.geometryBufferUsage,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        &newPrimitive->vertices,
-        vertexBufferSize));
+        &geometryBuffer.vertices,
+        verticesSize));
     VK_CHECK_RESULT(vkDevice->CreateBuffer(
-        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+            | loadingParams.geometryBufferUsage,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        &newPrimitive->indices,
-        indexBufferSize));
+        &geometryBuffer.indices,
+        indicesSize));
 
-    VkCommandBuffer copyCmd = vkDevice->CreateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-    VkBufferCopy copyRegion = {};
+    // Copies are only recorded here, the batcher submits them once the whole model is processed
+    uploadBatcher.Upload(geometryBuffer.vertices, vertices, verticesSize);
+    uploadBatcher.Upload(geometryBuffer.indices, indices, indicesSize);
+}
 
-    copyRegion.size = vertexBufferSize;
-    vkCmdCopyBuffer(
-        copyCmd,
-        vertexStaging.buffer,
-        newPrimitive->vertices.buffer,
-        1,
-        &copyRegion);
+size_t CG::Vk::GLTFModel::ReserveGeometry(const tinygltf::Primitive& primitive, uint64_t meshPrimitiveKey, const tinygltf::Model& input,
+    uint32_t vertexCount, uint32_t indexCount)
+{
+    // Nodes instancing the same glTF mesh
+    const auto meshPrimitiveJob = meshPrimitiveDecodeJobs.find(meshPrimitiveKey);
+    if (meshPrimitiveJob != meshPrimitiveDecodeJobs.end()) {
+        return meshPrimitiveJob->second;
+    }
 
-    copyRegion.size = indexBufferSize;
-    vkCmdCopyBuffer(
-        copyCmd,
-        indexStaging.buffer,
-        newPrimitive->indices.buffer,
-        1,
-        &copyRegion);
+    // Meshes with duplicated data, only checked once per glTF mesh primitive
+    const size_t geometryHash = SGLTFModel::GetGeometryHash(input, buffersData, primitive);
+    const auto sameHashJobs = geometryHashDecodeJobs.equal_range(geometryHash);
+    for (auto hashJob = sameHashJobs.first; hashJob != sameHashJobs.second; ++hashJob) {
+        if (SGLTFModel::IsSameGeometry(input, buffersData, primitive, *primitiveDecodeJobs[hashJob->second].primitive)) {
+            meshPrimitiveDecodeJobs.emplace(meshPrimitiveKey, hashJob->second);
+            return hashJob->second;
+        }
+    }
 
-    vkDevice->FlushCommandBuffer(copyCmd, queue, true);
+    if (geometryData.empty() || loadingParams.geometryLayout == eGeometryLayout::kPerPrimitive) {
+        geometryData.emplace_back();
+    }
+
+    const uint32_t geometryBufferIndex = static_cast<uint32_t>(geometryData.size() - 1);
+    GeometryData& geometry = geometryData.back();
+
+    // Indices are relative to the primitive first vertex, so the vertex count alone decides the index size
+    const VkIndexType indexType = vertexCount < SGLTFModel::kMaxIndex16VertexCount ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    const uint32_t indexSize = SGLTFModel::GetIndexSize(indexType);
+
+    // BLAS index offset has to be a multiple of the index size and uint32 ranges may follow uint16 ones
+    geometry.indicesSize = SGLTFModel::AlignUp(geometry.indicesSize, sizeof(uint32_t));
 
-    vertexStaging.Destroy();
-    indexStaging.Destroy();
+    PrimitiveDecodeJob decodeJob = {};
+    decodeJob.primitive = &primitive;
+    decodeJob.geometryBufferIndex = geometryBufferIndex;
+    decodeJob.firstVertex = geometry.vertexCount;
+    decodeJob.firstIndex = static_cast<uint32_t>(geometry.indicesSize / indexSize);
+    decodeJob.vertexCount = vertexCount;
+    decodeJob.indexCount = indexCount;
+    decodeJob.indexType = indexType;
+
+    geometry.vertexCount += vertexCount;
+    geometry.indicesSize += static_cast<size_t>(indexCount) * indexSize;
+
+    const size_t decodeJobIndex = primitiveDecodeJobs.size();
+    primitiveDecodeJobs.push_back(decodeJob);
+    meshPrimitiveDecodeJobs.emplace(meshPrimitiveKey, decodeJobIndex);
+    geometryHashDecodeJobs.emplace(geometryHash, decodeJobIndex);
+
+    return decodeJobIndex;
 }
 
 void CG::Vk::GLTFModel::LoadNode(Node* parent, const tinygltf::Node& node, uint32_t nodeIndex,
@@ -592,122 +1995,40 @@ void CG::Vk::GLTFModel::LoadNode(Node* parent, const tinygltf::Node& node, uint3
 
     // Node contains mesh data
     if (node.mesh > -1) {
-        const tinygltf::Mesh mesh = input.meshes[node.mesh];
+        const tinygltf::Mesh& mesh = input.meshes[node.mesh];
         std::unique_ptr<Mesh> newMesh = std::make_unique<Mesh>(vkDevice, newNode->matrix);
         for (size_t j = 0; j < mesh.primitives.size(); j++) {
             const tinygltf::Primitive& primitive = mesh.primitives[j];
 
-            std::vector<uint32_t> indexBuffer;
-            indexBuffer.reserve(4096);
-            std::vector<Vertex> vertexBuffer;
-            vertexBuffer.reserve(4096);
-
-            uint32_t indexStart = 0;
-            uint32_t vertexStart = 0;
-            uint32_t indexCount = 0;
-            uint32_t vertexCount = 0;
-            bool hasSkin = false;
-            bool hasIndices = primitive.indices > -1;
+            // Position attribute is required
+            assert(primitive.attributes.find("POSITION") != primitive.attributes.end());
 
-            glm::vec3 posMin {};
-            glm::vec3 posMax {};
+            const tinygltf::Accessor& posAccessor = input.accessors[primitive.attributes.find("POSITION")->second];
+            const uint32_t vertexCount = static_cast<uint32_t>(posAccessor.count);
+            // Shaders always fetch vertices through indices, so non indexed primitives get a trivial index list
+            uint32_t indexCount = vertexCount;
 
-            // Vertices
-            {
-                const float* bufferPos = nullptr;
-                const float* bufferNormals = nullptr;
-                const float* bufferTexCoordSet0 = nullptr;
-                const float* bufferTexCoordSet1 = nullptr;
-                const uint16_t* bufferJoints = nullptr;
-                const float* bufferWeights = nullptr;
-
-                int posByteStride = 0;
-                int normByteStride = 0;
-                int uv0ByteStride = 0;
-                int uv1ByteStride = 0;
-                int jointByteStride = 0;
-                int weightByteStride = 0;
-
-                // Position attribute is required
-                assert(primitive.attributes.find("POSITION") != primitive.attributes.end());
-
-                const tinygltf::Accessor& posAccessor = input.accessors[primitive.attributes.find("POSITION")->second];
-                vertexCount = static_cast<uint32_t>(posAccessor.count);
-
-                SGLTFModel::FillVertexAttribute(primitive, input, "POSITION", TINYGLTF_TYPE_VEC3, &bufferPos, posByteStride);
-                SGLTFModel::FillVertexAttribute(primitive, input, "NORMAL", TINYGLTF_TYPE_VEC3, &bufferNormals, normByteStride);
-                SGLTFModel::FillVertexAttribute(primitive, input, "TEXCOORD_0", TINYGLTF_TYPE_VEC2, &bufferTexCoordSet0, uv0ByteStride);
-                SGLTFModel::FillVertexAttribute(primitive, input, "TEXCOORD_1", TINYGLTF_TYPE_VEC2, &bufferTexCoordSet1, uv1ByteStride);
-                SGLTFModel::FillVertexAttribute(primitive, input, "JOINTS_0", TINYGLTF_TYPE_VEC4, &bufferJoints, jointByteStride);
-                SGLTFModel::FillVertexAttribute(primitive, input, "JOINTS_0", TINYGLTF_TYPE_VEC4, &bufferWeights, weightByteStride);
-
-                posMin = glm::vec3(posAccessor.minValues[0], posAccessor.minValues[1], posAccessor.minValues[2]);
-                posMax = glm::vec3(posAccessor.maxValues[0], posAccessor.maxValues[1], posAccessor.maxValues[2]);
-
-                hasSkin = (bufferJoints && bufferWeights);
-
-                for (size_t v = 0; v < posAccessor.count; ++v) {
-                    Vertex vert = {};
-                    vert.pos = glm::vec4(glm::make_vec3(&bufferPos[v * posByteStride]), 1.0f);
-                    vert.normal = glm::vec4(glm::normalize(glm::vec3(bufferNormals ? glm::make_vec3(&bufferNormals[v * normByteStride]) : glm::vec3(0.0f))), 1.0f);
-                    glm::vec2 uv0 = bufferTexCoordSet0 ? glm::make_vec2(&bufferTexCoordSet0[v * uv0ByteStride]) : glm::vec2(0.0f);
-                    glm::vec2 uv1 = bufferTexCoordSet1 ? glm::make_vec2(&bufferTexCoordSet1[v * uv1ByteStride]) : glm::vec2(0.0f);
-                    vert.uv = glm::vec4(uv0.x, uv0.y, uv1.x, uv1.y);
-
-                    /*
-                    vert.joint0 = hasSkin ? glm::vec4(glm::make_vec4(&bufferJoints[v * jointByteStride])) : glm::vec4(0.0f);
-                    vert.weight0 = hasSkin ? glm::make_vec4(&bufferWeights[v * weightByteStride]) : glm::vec4(0.0f);
-                    // Fix for all zero weights
-                    if (glm::length(vert.weight0) == 0.0f) {
-                        vert.weight0 = glm::vec4(1.0f, 0.0f, 0.0f, 0.0f);
-                    }
-                    */
-                    vertexBuffer.push_back(vert);
+            if (primitive.indices > -1) {
+                const tinygltf::Accessor& accessor = input.accessors[primitive.indices];
+                if (!SGLTFModel::IsIndexTypeSupported(accessor.componentType)) {
+                    std::cerr << "Index component type " << accessor.componentType << " not supported!" << std::endl;
+                    continue;
                 }
+                indexCount = static_cast<uint32_t>(accessor.count);
             }
-            // Indices
-            if (hasIndices) {
-                const tinygltf::Accessor& accessor = input.accessors[primitive.indices > -1 ? primitive.indices : 0];
-                const tinygltf::BufferView& bufferView = input.bufferViews[accessor.bufferView];
-                const tinygltf::Buffer& buffer = input.buffers[bufferView.buffer];
 
-                indexCount = static_cast<uint32_t>(accessor.count);
-                const void* dataPtr = &(buffer.data[accessor.byteOffset + bufferView.byteOffset]);
+            const uint64_t meshPrimitiveKey = (static_cast<uint64_t>(node.mesh) << 32) | static_cast<uint64_t>(j);
+            const PrimitiveDecodeJob& decodeJob = primitiveDecodeJobs[ReserveGeometry(primitive, meshPrimitiveKey, input, vertexCount, indexCount)];
 
-                switch (accessor.componentType) {
-                case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT: {
-                    const uint32_t* buf = static_cast<const uint32_t*>(dataPtr);
-                    for (size_t index = 0; index < accessor.count; index++) {
-                        indexBuffer.push_back(buf[index] + vertexStart);
-                    }
-                    break;
-                }
-                case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT: {
-                    const uint16_t* buf = static_cast<const uint16_t*>(dataPtr);
-                    for (size_t index = 0; index < accessor.count; index++) {
-                        indexBuffer.push_back(buf[index] + vertexStart);
-                    }
-                    break;
-                }
-                case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE: {
-                    const uint8_t* buf = static_cast<const uint8_t*>(dataPtr);
-                    for (size_t index = 0; index < accessor.count; index++) {
-                        indexBuffer.push_back(buf[index] + vertexStart);
-                    }
-                    break;
-                }
-                default:
-                    std::cerr << "Index component type " << accessor.componentType << " not supported!" << std::endl;
-                    return;
-                }
-            }
+            const glm::vec3 posMin = glm::vec3(posAccessor.minValues[0], posAccessor.minValues[1], posAccessor.minValues[2]);
+            const glm::vec3 posMax = glm::vec3(posAccessor.maxValues[0], posAccessor.maxValues[1], posAccessor.maxValues[2]);
 
             // loading last material as default one
-            std::unique_ptr<Primitive> newPrimitive = std::make_unique<Primitive>(indexStart, vertexStart, indexCount, vertexCount,
+            std::unique_ptr<Primitive> newPrimitive = std::make_unique<Primitive>(decodeJob.firstIndex, decodeJob.firstVertex, indexCount, vertexCount,
                 primitive.material > -1 ? *materials[primitive.material] : *materials.back());
             newPrimitive->bbox = AABBox(posMin, posMax);
-
-            CreatePrimitiveBuffers(newPrimitive.get(), vertexBuffer, indexBuffer);
+            newPrimitive->geometryBufferIndex = decodeJob.geometryBufferIndex;
+            newPrimitive->indexType = decodeJob.indexType;
 
             newMesh->primitives.push_back(std::move(newPrimitive));
         }
@@ -795,40 +2116,6 @@ void CG::Vk::GLTFModel::Node::UpdateRecursive()
     }
 }
 
-void CG::Vk::GLTFModel::Texture::FromGLTFImage(const tinygltf::Image& glTFImage, TextureSampler textureSampler, Device* device, VkQueue copyQueue)
-{
-    VkDeviceSize bufferSize = 0;
-
-    // We convert RGB-only images to RGBA, as most devices don't support RGB-formats in Vulkan
-    if (glTFImage.component == 3) {
-        uint64_t pixelsCount = static_cast<uint64_t>(glTFImage.width) * static_cast<uint64_t>(glTFImage.height);
-        bufferSize = pixelsCount * 4;
-        unsigned char* buffer = new unsigned char[bufferSize];
-        unsigned char* rgba = buffer;
-        const unsigned char* rgb = &glTFImage.image[0];
-        for (size_t pixel = 0; pixel < pixelsCount; ++pixel) {
-            for (int32_t j = 0; j < 3; ++j) {
-                rgba[j] = rgb[j];
-            }
-            rgba[3] = 0;
-
-            rgba += 4;
-            rgb += 3;
-        }
-
-        texture.FromBuffer(buffer, bufferSize, VK_FORMAT_R8G8B8A8_UNORM, glTFImage.width, glTFImage.height,
-            device, copyQueue, VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-            VK_IMAGE_TILING_OPTIMAL, textureSampler);
-    } else {
-        const unsigned char* buffer = &glTFImage.image[0];
-        bufferSize = glTFImage.image.size();
-
-        texture.FromBuffer(buffer, bufferSize, VK_FORMAT_R8G8B8A8_UNORM, glTFImage.width, glTFImage.height,
-            device, copyQueue, VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-            VK_IMAGE_TILING_OPTIMAL, textureSampler);
-    }
-}
-
 CG::Vk::GLTFModel::AABBox CG::Vk::GLTFModel::AABBox::GetAABB(const glm::mat4& m)
 {
     glm::vec3 locMin = glm::vec3(m[3]);
@@ -856,37 +2143,15 @@ CG::Vk::GLTFModel::AABBox CG::Vk::GLTFModel::AABBox::GetAABB(const glm::mat4& m)
     return AABBox(locMin, locaMax);
 }
 
-void CG::Vk::GLTFModel::Material::BuildBuffers(CG::Vk::Device* vkDevice, VkQueue queue)
+void CG::Vk::GLTFModel::Material::BuildBuffers(CG::Vk::Device* vkDevice, UploadBatcher& uploadBatcher)
 {
     size_t materialBufferSize = sizeof(Material::MaterialParams);
 
-    // We are creating this buffers to copy them on local memory for better performance
-    Buffer materialStaging;
-
-    VK_CHECK_RESULT(vkDevice->CreateBuffer(
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        &materialStaging,
-        materialBufferSize,
-        &materialParamsData));
-
     VK_CHECK_RESULT(vkDevice->CreateBuffer(
         VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
         &materialParams,
         materialBufferSize));
 
-    VkCommandBuffer copyCmd = vkDevice->CreateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-    VkBufferCopy copyRegion = {};
-
-    copyRegion.size = materialBufferSize;
-    vkCmdCopyBuffer(
-        copyCmd,
-        materialStaging.buffer,
-        materialParams.buffer,
-        1,
-        &copyRegion);
-
-    vkDevice->FlushCommandBuffer(copyCmd, queue, true);
-    materialStaging.Destroy();
+    uploadBatcher.Upload(materialParams, &materialParamsData, materialBufferSize);
 }
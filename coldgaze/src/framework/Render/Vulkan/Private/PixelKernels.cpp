@@ -0,0 +1,191 @@
+#include "Render/Vulkan/PixelKernels.hpp"
+#include "Render/Vulkan/VertexKernels.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define CG_PIXEL_KERNELS_SSE2 1
+#include <immintrin.h>
+#endif
+
+// Every CPU with AVX2 has F16C as well, so the AVX2 level also enables hardware half conversions
+#if defined(CG_PIXEL_KERNELS_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#define CG_TARGET_AVX2_F16C __attribute__((target("avx2,f16c")))
+#else
+#define CG_TARGET_AVX2_F16C
+#endif
+
+using eInstructionSet = CG::Vk::VertexKernels::eInstructionSet;
+
+namespace SPixelKernels {
+constexpr uint16_t kHalfOne = 0x3C00;
+
+// Float bit patterns used by the half conversion
+constexpr uint32_t kHalfOverflow = 0x47800000; // 65536.0f, first value which rounds to half infinity
+constexpr uint32_t kHalfMinNormal = 0x38800000; // 2^-14
+constexpr uint32_t kDenormMagic = 0x3F000000; // 0.5f, adding it aligns half subnormal mantissa to the float one
+constexpr uint32_t kRebiasExponent = 0xC8000FFF; // (15 - 127) << 23 plus the rounding bias
+
+// E5B9G9R9 constants from the Vulkan specification
+constexpr int32_t kSharedExponentBias = 15;
+constexpr int32_t kSharedMantissaBits = 9;
+constexpr float kSharedExponentMax = 65408.0f; // (2^9 - 1) / 2^9 * 2^16
+
+void ConvertRGBToHalfRGBAScalar(const float* src, size_t texelsCount, uint16_t* dst)
+{
+    for (size_t i = 0; i < texelsCount; ++i) {
+        dst[i * 4 + 0] = CG::Vk::PixelKernels::FloatToHalf(src[i * 3 + 0]);
+        dst[i * 4 + 1] = CG::Vk::PixelKernels::FloatToHalf(src[i * 3 + 1]);
+        dst[i * 4 + 2] = CG::Vk::PixelKernels::FloatToHalf(src[i * 3 + 2]);
+        dst[i * 4 + 3] = kHalfOne;
+    }
+}
+
+#if defined(CG_PIXEL_KERNELS_SSE2)
+// Same steps as the scalar FloatToHalf with selects instead of branches, halves end up in the low 16 bits of the lanes
+__m128i FloatToHalfSSE2(__m128 value)
+{
+    const __m128i bits = _mm_castps_si128(value);
+    const __m128i sign = _mm_and_si128(_mm_srli_epi32(bits, 16), _mm_set1_epi32(0x8000));
+    const __m128i magnitude = _mm_and_si128(bits, _mm_set1_epi32(0x7FFFFFFF));
+
+    const __m128i mantissaOdd = _mm_and_si128(_mm_srli_epi32(magnitude, 13), _mm_set1_epi32(1));
+    const __m128i normal = _mm_srli_epi32(
+        _mm_add_epi32(_mm_add_epi32(magnitude, _mm_set1_epi32(static_cast<int32_t>(kRebiasExponent))), mantissaOdd), 13);
+
+    const __m128 denormMagic = _mm_castsi128_ps(_mm_set1_epi32(kDenormMagic));
+    const __m128i denormal
+        = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(magnitude), denormMagic)), _mm_set1_epi32(kDenormMagic));
+
+    const __m128i isNaN = _mm_cmpgt_epi32(magnitude, _mm_set1_epi32(0x7F800000));
+    const __m128i infinityOrNaN = _mm_or_si128(_mm_set1_epi32(0x7C00), _mm_and_si128(isNaN, _mm_set1_epi32(0x0200)));
+
+    const __m128i isOverflow = _mm_cmpgt_epi32(magnitude, _mm_set1_epi32(kHalfOverflow - 1));
+    const __m128i isDenormal = _mm_cmplt_epi32(magnitude, _mm_set1_epi32(kHalfMinNormal));
+
+    __m128i result = _mm_or_si128(_mm_and_si128(isDenormal, denormal), _mm_andnot_si128(isDenormal, normal));
+    result = _mm_or_si128(_mm_and_si128(isOverflow, infinityOrNaN), _mm_andnot_si128(isOverflow, result));
+    return _mm_or_si128(result, sign);
+}
+
+// Two texels per iteration, the unaligned load of a texel reads the red channel of the next one, which is replaced by alpha
+void ConvertRGBToHalfRGBASSE2(const float* src, size_t texelsCount, uint16_t* dst)
+{
+    const __m128 rgbMask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+    const __m128 alpha = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+
+    size_t i = 0;
+    for (; i + 3 <= texelsCount; i += 2) {
+        const __m128 texel0 = _mm_or_ps(_mm_and_ps(_mm_loadu_ps(src + i * 3), rgbMask), alpha);
+        const __m128 texel1 = _mm_or_ps(_mm_and_ps(_mm_loadu_ps(src + i * 3 + 3), rgbMask), alpha);
+
+        // Halves are sign extended first, so the saturating pack keeps their bits
+        const __m128i half0 = _mm_srai_epi32(_mm_slli_epi32(FloatToHalfSSE2(texel0), 16), 16);
+        const __m128i half1 = _mm_srai_epi32(_mm_slli_epi32(FloatToHalfSSE2(texel1), 16), 16);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), _mm_packs_epi32(half0, half1));
+    }
+
+    ConvertRGBToHalfRGBAScalar(src + i * 3, texelsCount - i, dst + i * 4);
+}
+
+CG_TARGET_AVX2_F16C void ConvertRGBToHalfRGBAF16C(const float* src, size_t texelsCount, uint16_t* dst)
+{
+    const __m256 alpha = _mm256_set1_ps(1.0f);
+
+    size_t i = 0;
+    for (; i + 3 <= texelsCount; i += 2) {
+        const __m256 texels = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(src + i * 3)), _mm_loadu_ps(src + i * 3 + 3), 1);
+        const __m256 rgba = _mm256_blend_ps(texels, alpha, 0x88);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), _mm256_cvtps_ph(rgba, _MM_FROUND_TO_NEAREST_INT));
+    }
+
+    ConvertRGBToHalfRGBAScalar(src + i * 3, texelsCount - i, dst + i * 4);
+}
+#endif
+
+float ClampShared(float value)
+{
+    // NaN fails the comparison and becomes zero too
+    return value > 0.0f ? std::min(value, kSharedExponentMax) : 0.0f;
+}
+}
+
+uint16_t CG::Vk::PixelKernels::FloatToHalf(float value)
+{
+    uint32_t bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+
+    const uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t magnitude = bits & 0x7FFFFFFF;
+
+    uint32_t half = 0;
+    if (magnitude >= SPixelKernels::kHalfOverflow) {
+        // Infinity, NaN stays quiet NaN
+        half = magnitude > 0x7F800000 ? 0x7E00 : 0x7C00;
+    } else if (magnitude < SPixelKernels::kHalfMinNormal) {
+        // Subnormal half or zero, the float addition does the rounding
+        float magnitudeFloat = 0.0f;
+        memcpy(&magnitudeFloat, &magnitude, sizeof(magnitude));
+        float denormMagic = 0.0f;
+        memcpy(&denormMagic, &SPixelKernels::kDenormMagic, sizeof(denormMagic));
+
+        magnitudeFloat += denormMagic;
+        memcpy(&magnitude, &magnitudeFloat, sizeof(magnitude));
+        half = magnitude - SPixelKernels::kDenormMagic;
+    } else {
+        const uint32_t mantissaOdd = (magnitude >> 13) & 1;
+        magnitude += SPixelKernels::kRebiasExponent;
+        magnitude += mantissaOdd;
+        half = magnitude >> 13;
+    }
+
+    return static_cast<uint16_t>(half | sign);
+}
+
+void CG::Vk::PixelKernels::ConvertRGBToHalfRGBA(const float* src, size_t texelsCount, uint16_t* dst)
+{
+#if defined(CG_PIXEL_KERNELS_SSE2)
+    switch (VertexKernels::GetInstructionSet()) {
+    case eInstructionSet::kAVX2:
+        SPixelKernels::ConvertRGBToHalfRGBAF16C(src, texelsCount, dst);
+        return;
+    case eInstructionSet::kSSE2:
+        SPixelKernels::ConvertRGBToHalfRGBASSE2(src, texelsCount, dst);
+        return;
+    default:
+        break;
+    }
+#endif
+    SPixelKernels::ConvertRGBToHalfRGBAScalar(src, texelsCount, dst);
+}
+
+void CG::Vk::PixelKernels::ConvertRGBToE5B9G9R9(const float* src, size_t texelsCount, uint32_t* dst)
+{
+    using namespace SPixelKernels;
+
+    for (size_t i = 0; i < texelsCount; ++i) {
+        const float red = ClampShared(src[i * 3 + 0]);
+        const float green = ClampShared(src[i * 3 + 1]);
+        const float blue = ClampShared(src[i * 3 + 2]);
+        const float maxChannel = std::max(red, std::max(green, blue));
+
+        // floor(log2(maxChannel)) is exact with frexp, which returns the exponent of a [0.5, 1) mantissa
+        int exponent = 0;
+        std::frexp(maxChannel, &exponent);
+        const int32_t floorLog2 = maxChannel > 0.0f ? exponent - 1 : -kSharedExponentBias - 1;
+        int32_t sharedExponent = std::max(-kSharedExponentBias - 1, floorLog2) + 1 + kSharedExponentBias;
+
+        // Rounding of the biggest channel may overflow its 9 bits, the exponent is raised then
+        float scale = std::ldexp(1.0f, sharedExponent - kSharedExponentBias - kSharedMantissaBits);
+        if (static_cast<int32_t>(std::floor(maxChannel / scale + 0.5f)) == (1 << kSharedMantissaBits)) {
+            ++sharedExponent;
+            scale *= 2.0f;
+        }
+
+        const uint32_t redBits = static_cast<uint32_t>(std::floor(red / scale + 0.5f));
+        const uint32_t greenBits = static_cast<uint32_t>(std::floor(green / scale + 0.5f));
+        const uint32_t blueBits = static_cast<uint32_t>(std::floor(blue / scale + 0.5f));
+        dst[i] = redBits | (greenBits << 9) | (blueBits << 18) | (static_cast<uint32_t>(sharedExponent) << 27);
+    }
+}
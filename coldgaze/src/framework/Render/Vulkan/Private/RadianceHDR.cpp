@@ -0,0 +1,222 @@
+#include "Render/Vulkan/RadianceHDR.hpp"
+#include <cmath>
+#include <cstring>
+
+namespace SRadianceHDR {
+constexpr char kRadianceIdentifier[] = "#?RADIANCE\n";
+constexpr char kRGBEIdentifier[] = "#?RGBE\n";
+constexpr char kFormatLine[] = "FORMAT=32-bit_rle_rgbe";
+
+// Same limits as stb_image, adaptive RLE can only describe scanlines in [8, 32767]
+constexpr uint32_t kMaxDimension = 1 << 24;
+constexpr uint32_t kMinRLEWidth = 8;
+constexpr uint32_t kMaxRLEWidth = 32767;
+
+bool StartsWith(const uint8_t* data, size_t size, const char* prefix)
+{
+    const size_t prefixSize = strlen(prefix);
+    return size >= prefixSize && memcmp(data, prefix, prefixSize) == 0;
+}
+
+// Returns the line without the line break and moves offset past it, false at the end of data
+bool ReadLine(const uint8_t* data, size_t size, size_t& offset, std::string& line)
+{
+    if (offset >= size) {
+        return false;
+    }
+
+    const uint8_t* lineStart = data + offset;
+    const void* lineEnd = memchr(lineStart, '\n', size - offset);
+    const size_t lineSize = lineEnd ? static_cast<const uint8_t*>(lineEnd) - lineStart : size - offset;
+
+    line.assign(reinterpret_cast<const char*>(lineStart), lineSize);
+    offset += lineSize + (lineEnd ? 1 : 0);
+    return true;
+}
+
+// Parses "<sign><axis> <value>" at position, returns false if the token doesn't match
+bool ParseAxis(const std::string& line, size_t& position, const char* axis, uint32_t& value)
+{
+    const size_t axisSize = strlen(axis);
+    if (line.compare(position, axisSize, axis) != 0) {
+        return false;
+    }
+    position += axisSize;
+
+    while (position < line.size() && line[position] == ' ') {
+        ++position;
+    }
+
+    uint64_t parsed = 0;
+    const size_t digitsStart = position;
+    while (position < line.size() && line[position] >= '0' && line[position] <= '9' && parsed <= kMaxDimension) {
+        parsed = parsed * 10 + static_cast<uint64_t>(line[position] - '0');
+        ++position;
+    }
+
+    while (position < line.size() && line[position] == ' ') {
+        ++position;
+    }
+
+    value = static_cast<uint32_t>(parsed);
+    return position > digitsStart && parsed > 0 && parsed <= kMaxDimension;
+}
+
+void ConvertRGBE(const uint8_t* rgbe, float* rgb)
+{
+    if (rgbe[3] != 0) {
+        const float scale = std::ldexp(1.0f, static_cast<int>(rgbe[3]) - (128 + 8));
+        rgb[0] = rgbe[0] * scale;
+        rgb[1] = rgbe[1] * scale;
+        rgb[2] = rgbe[2] * scale;
+    } else {
+        rgb[0] = 0.0f;
+        rgb[1] = 0.0f;
+        rgb[2] = 0.0f;
+    }
+}
+}
+
+bool CG::Vk::RadianceHDR::IsRadianceHDR(const uint8_t* data, size_t size)
+{
+    return SRadianceHDR::StartsWith(data, size, SRadianceHDR::kRadianceIdentifier)
+        || SRadianceHDR::StartsWith(data, size, SRadianceHDR::kRGBEIdentifier);
+}
+
+bool CG::Vk::RadianceHDR::ParseHeader(const uint8_t* data, size_t size, Header& header, std::string& error)
+{
+    if (!IsRadianceHDR(data, size)) {
+        error = "not a Radiance HDR file";
+        return false;
+    }
+
+    size_t offset = 0;
+    std::string line;
+    SRadianceHDR::ReadLine(data, size, offset, line);
+
+    // Variables end with an empty line, only the pixel format matters
+    bool validFormat = false;
+    for (;;) {
+        if (!SRadianceHDR::ReadLine(data, size, offset, line)) {
+            error = "truncated HDR header";
+            return false;
+        }
+        if (line.empty()) {
+            break;
+        }
+        if (line == SRadianceHDR::kFormatLine) {
+            validFormat = true;
+        }
+    }
+
+    if (!validFormat) {
+        error = "unsupported HDR pixel format, only 32-bit_rle_rgbe is supported";
+        return false;
+    }
+
+    if (!SRadianceHDR::ReadLine(data, size, offset, line)) {
+        error = "missing HDR resolution";
+        return false;
+    }
+
+    size_t position = 0;
+    if (!SRadianceHDR::ParseAxis(line, position, "-Y", header.height) || !SRadianceHDR::ParseAxis(line, position, "+X", header.width)
+        || position != line.size()) {
+        error = "unsupported HDR resolution line \"" + line + "\", only -Y height +X width is supported";
+        return false;
+    }
+
+    header.pixelsOffset = offset;
+    return true;
+}
+
+CG::Vk::RadianceHDR::ScanlineDecoder::ScanlineDecoder(const uint8_t* aData, size_t aSize, const Header& header)
+    : data(aData)
+    , size(aSize)
+    , offset(header.pixelsOffset)
+    , width(header.width)
+    , flat(header.width < SRadianceHDR::kMinRLEWidth || header.width > SRadianceHDR::kMaxRLEWidth)
+    , scanline(static_cast<size_t>(header.width) * 4)
+{
+}
+
+bool CG::Vk::RadianceHDR::ScanlineDecoder::DecodeScanline(float* rgb, std::string& error)
+{
+    if (!(flat ? ReadFlatScanline(error) : ReadRLEScanline(error))) {
+        return false;
+    }
+
+    for (uint32_t x = 0; x < width; ++x) {
+        SRadianceHDR::ConvertRGBE(scanline.data() + x * 4, rgb + x * 3);
+    }
+    return true;
+}
+
+bool CG::Vk::RadianceHDR::ScanlineDecoder::ReadRLEScanline(std::string& error)
+{
+    if (size - offset < 4) {
+        error = "truncated HDR scanline";
+        return false;
+    }
+
+    // Adaptive RLE scanlines start with 2, 2 and a 15 bit width, anything else is a flat RGBE texel
+    const uint8_t* start = data + offset;
+    if (start[0] != 2 || start[1] != 2 || (start[2] & 0x80) != 0) {
+        flat = true;
+        return ReadFlatScanline(error);
+    }
+
+    if ((static_cast<uint32_t>(start[2]) << 8 | start[3]) != width) {
+        error = "invalid HDR scanline length";
+        return false;
+    }
+    offset += 4;
+
+    // Every channel of the scanline is stored separately as runs and literal spans
+    for (uint32_t channel = 0; channel < 4; ++channel) {
+        uint32_t x = 0;
+        while (x < width) {
+            if (offset >= size) {
+                error = "truncated HDR scanline";
+                return false;
+            }
+
+            uint32_t count = data[offset++];
+            const uint32_t left = width - x;
+
+            if (count > 128) {
+                count -= 128;
+                if (count > left || offset >= size) {
+                    error = "bad RLE data in HDR scanline";
+                    return false;
+                }
+                const uint8_t value = data[offset++];
+                for (uint32_t i = 0; i < count; ++i, ++x) {
+                    scanline[x * 4 + channel] = value;
+                }
+            } else {
+                if (count == 0 || count > left || size - offset < count) {
+                    error = "bad RLE data in HDR scanline";
+                    return false;
+                }
+                for (uint32_t i = 0; i < count; ++i, ++x) {
+                    scanline[x * 4 + channel] = data[offset++];
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+bool CG::Vk::RadianceHDR::ScanlineDecoder::ReadFlatScanline(std::string& error)
+{
+    if (size - offset < scanline.size()) {
+        error = "truncated HDR scanline";
+        return false;
+    }
+
+    memcpy(scanline.data(), data + offset, scanline.size());
+    offset += scanline.size();
+    return true;
+}
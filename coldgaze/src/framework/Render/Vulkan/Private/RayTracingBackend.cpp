@@ -0,0 +1,84 @@
+#include "Render/Vulkan/RayTracingBackend.hpp"
+#include "Render/Vulkan/Debug.hpp"
+#include "Render/Vulkan/Device.hpp"
+#include "Render/Vulkan/RayTracingBackendKHR.hpp"
+#include "Render/Vulkan/RayTracingBackendNV.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+CG::Vk::eRayTracingApi CG::Vk::RayTracingBackend::SelectApi(Device& device, bool preferNV)
+{
+    bool khrSupported = true;
+    for (const char* extension : GetRequiredExtensions(eRayTracingApi::kKHR)) {
+        khrSupported = khrSupported && device.ExtensionSupported(extension);
+    }
+
+    const bool nvSupported = device.ExtensionSupported(VK_NV_RAY_TRACING_EXTENSION_NAME);
+
+    const eRayTracingApi api = khrSupported && !(preferNV && nvSupported) ? eRayTracingApi::kKHR : eRayTracingApi::kNV;
+    std::cout << "Ray tracing backend: " << (api == eRayTracingApi::kKHR ? "KHR" : "NV") << std::endl;
+
+    return api;
+}
+
+std::vector<const char*> CG::Vk::RayTracingBackend::GetRequiredExtensions(eRayTracingApi api)
+{
+    if (api == eRayTracingApi::kNV) {
+        return { VK_NV_RAY_TRACING_EXTENSION_NAME };
+    }
+
+    return {
+        VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME,
+        VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME,
+        VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME,
+        VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME,
+        VK_KHR_SPIRV_1_4_EXTENSION_NAME,
+        VK_KHR_SHADER_FLOAT_CONTROLS_EXTENSION_NAME,
+    };
+}
+
+std::unique_ptr<CG::Vk::RayTracingBackend> CG::Vk::RayTracingBackend::Create(eRayTracingApi api, Device* vkDevice, ThreadPool* threadPool)
+{
+    if (api == eRayTracingApi::kNV) {
+        return std::make_unique<RayTracingBackendNV>(vkDevice);
+    }
+
+    return std::make_unique<RayTracingBackendKHR>(vkDevice, threadPool);
+}
+
+CG::Vk::RayTracingBackend::RayTracingBackend(Device* aVkDevice)
+    : vkDevice(aVkDevice)
+{
+}
+
+void CG::Vk::RayTracingBackend::CreateShaderBindingTable(VkPipeline pipeline, Buffer& shaderBindingTable) const
+{
+    const VkDeviceSize stride = GetShaderBindingTableStride();
+
+    std::vector<uint8_t> shaderHandles(static_cast<size_t>(shaderGroupHandleSize) * kShaderGroupsCount);
+    GetShaderGroupHandles(pipeline, kShaderGroupsCount, shaderHandles.size(), shaderHandles.data());
+
+    VK_CHECK_RESULT(vkDevice->CreateBuffer(GetShaderBindingTableUsage(),
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        &shaderBindingTable, stride * kShaderGroupsCount));
+    VK_CHECK_RESULT(shaderBindingTable.Map());
+
+    uint8_t* data = static_cast<uint8_t*>(shaderBindingTable.mapped);
+    for (uint32_t i = 0; i < kShaderGroupsCount; ++i) {
+        memcpy(data + stride * i, shaderHandles.data() + static_cast<size_t>(shaderGroupHandleSize) * i, shaderGroupHandleSize);
+    }
+
+    shaderBindingTable.Unmap();
+}
+
+uint32_t CG::Vk::RayTracingBackend::GetMaxRecursionDepth() const
+{
+    return maxRecursionDepth;
+}
+
+VkDeviceSize CG::Vk::RayTracingBackend::GetShaderBindingTableStride() const
+{
+    const VkDeviceSize alignment = std::max(shaderGroupBaseAlignment, 1u);
+    return (shaderGroupHandleSize + alignment - 1) / alignment * alignment;
+}
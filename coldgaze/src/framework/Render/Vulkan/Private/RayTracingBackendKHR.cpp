@@ -0,0 +1,413 @@
+#include "Render/Vulkan/RayTracingBackendKHR.hpp"
+#include "Core/ThreadPool.hpp"
+#include "Render/Vulkan/Debug.hpp"
+#include "Render/Vulkan/Device.hpp"
+#include "Render/Vulkan/Initializers.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+namespace SRayTracingBackendKHR {
+// Build geometry info together with the arrays it points to, so it's filled in place and never copied
+struct BuildGeometry {
+    BuildGeometry(const CG::Vk::RayTracingBackendKHR& backend, const CG::Vk::AccelerationStructureInputs& inputs)
+    {
+        if (inputs.level == CG::Vk::eAccelerationStructureLevel::kTop) {
+            VkAccelerationStructureGeometryKHR geometry = {};
+            geometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
+            geometry.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR;
+            geometry.geometry.instances.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR;
+            geometry.geometry.instances.arrayOfPointers = VK_FALSE;
+            geometry.geometry.instances.data.deviceAddress = backend.GetDeviceAddress(inputs.instanceBuffer);
+            geometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
+
+            AddGeometry(geometry, inputs.instanceCount);
+        } else {
+            for (uint32_t i = 0; i < inputs.geometryCount; ++i) {
+                const CG::Vk::RayTracingGeometry& source = inputs.geometries[i];
+
+                VkAccelerationStructureGeometryKHR geometry = {};
+                geometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
+                geometry.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
+                geometry.geometry.triangles.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
+                geometry.geometry.triangles.vertexFormat = source.vertexFormat;
+                geometry.geometry.triangles.vertexData.deviceAddress = backend.GetDeviceAddress(source.vertexBuffer) + source.vertexOffset;
+                geometry.geometry.triangles.vertexStride = source.vertexStride;
+                geometry.geometry.triangles.maxVertex = source.vertexCount > 0 ? source.vertexCount - 1 : 0;
+                geometry.geometry.triangles.indexType = source.indexType;
+                geometry.geometry.triangles.indexData.deviceAddress = backend.GetDeviceAddress(source.indexBuffer) + source.indexOffset;
+                geometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
+
+                AddGeometry(geometry, source.indexCount / 3);
+            }
+        }
+
+        info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
+        info.type = inputs.level == CG::Vk::eAccelerationStructureLevel::kTop
+            ? VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR
+            : VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+        info.flags = inputs.flags;
+        info.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+        info.geometryCount = static_cast<uint32_t>(geometries.size());
+        info.pGeometries = geometries.data();
+    }
+
+    BuildGeometry(const BuildGeometry&) = delete;
+    BuildGeometry& operator=(const BuildGeometry&) = delete;
+
+    void AddGeometry(const VkAccelerationStructureGeometryKHR& geometry, uint32_t primitiveCount)
+    {
+        geometries.push_back(geometry);
+        primitiveCounts.push_back(primitiveCount);
+
+        VkAccelerationStructureBuildRangeInfoKHR range = {};
+        range.primitiveCount = primitiveCount;
+        ranges.push_back(range);
+    }
+
+    std::vector<VkAccelerationStructureGeometryKHR> geometries;
+    std::vector<VkAccelerationStructureBuildRangeInfoKHR> ranges;
+    std::vector<uint32_t> primitiveCounts;
+    VkAccelerationStructureBuildGeometryInfoKHR info = {};
+};
+
+VkRayTracingShaderGroupCreateInfoKHR GetShaderGroup(VkShaderStageFlagBits stage, uint32_t stageIndex)
+{
+    VkRayTracingShaderGroupCreateInfoKHR group = {};
+    group.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR;
+    group.generalShader = VK_SHADER_UNUSED_KHR;
+    group.closestHitShader = VK_SHADER_UNUSED_KHR;
+    group.anyHitShader = VK_SHADER_UNUSED_KHR;
+    group.intersectionShader = VK_SHADER_UNUSED_KHR;
+
+    if (stage == VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR) {
+        group.type = VK_RAY_TRACING_SHADER_GROUP_TYPE_TRIANGLES_HIT_GROUP_KHR;
+        group.closestHitShader = stageIndex;
+    } else {
+        group.type = VK_RAY_TRACING_SHADER_GROUP_TYPE_GENERAL_KHR;
+        group.generalShader = stageIndex;
+    }
+
+    return group;
+}
+}
+
+CG::Vk::RayTracingBackendKHR::RayTracingBackendKHR(Device* aVkDevice, ThreadPool* aThreadPool)
+    : RayTracingBackend(aVkDevice)
+    , threadPool(aThreadPool)
+{
+    LoadProcs();
+
+    VkPhysicalDeviceAccelerationStructurePropertiesKHR accelerationStructureProperties = {};
+    accelerationStructureProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_PROPERTIES_KHR;
+
+    VkPhysicalDeviceRayTracingPipelinePropertiesKHR rayTracingPipelineProperties = {};
+    rayTracingPipelineProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_PROPERTIES_KHR;
+    rayTracingPipelineProperties.pNext = &accelerationStructureProperties;
+
+    VkPhysicalDeviceProperties2 physicalDeviceProperties = {};
+    physicalDeviceProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    physicalDeviceProperties.pNext = &rayTracingPipelineProperties;
+    vkGetPhysicalDeviceProperties2(vkDevice->physicalDevice, &physicalDeviceProperties);
+
+    shaderGroupHandleSize = rayTracingPipelineProperties.shaderGroupHandleSize;
+    shaderGroupBaseAlignment = rayTracingPipelineProperties.shaderGroupBaseAlignment;
+    maxRecursionDepth = rayTracingPipelineProperties.maxRayRecursionDepth;
+    scratchAlignment = accelerationStructureProperties.minAccelerationStructureScratchOffsetAlignment;
+}
+
+CG::Vk::eRayTracingApi CG::Vk::RayTracingBackendKHR::GetApi() const
+{
+    return eRayTracingApi::kKHR;
+}
+
+void CG::Vk::RayTracingBackendKHR::CreateAccelerationStructure(
+    const AccelerationStructureInputs& inputs, AccelerationStructure& accelerationStructure)
+{
+    const SRayTracingBackendKHR::BuildGeometry buildGeometry(*this, inputs);
+
+    VkAccelerationStructureBuildSizesInfoKHR buildSizes = {};
+    buildSizes.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
+    vkGetAccelerationStructureBuildSizesKHR(vkDevice->logicalDevice, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
+        &buildGeometry.info, buildGeometry.primitiveCounts.data(), &buildSizes);
+
+    CreateStorage(buildGeometry.info.type, buildSizes.accelerationStructureSize, accelerationStructure);
+    accelerationStructure.buildScratchSize = buildSizes.buildScratchSize;
+    accelerationStructure.updateScratchSize = buildSizes.updateScratchSize;
+}
+
+void CG::Vk::RayTracingBackendKHR::CreateCompactedBottomLevel(
+    [[maybe_unused]] VkBuildAccelerationStructureFlagsKHR flags, VkDeviceSize compactedSize, AccelerationStructure& accelerationStructure)
+{
+    // Only the size is needed, flags come with the copy
+    CreateStorage(VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, compactedSize, accelerationStructure);
+}
+
+void CG::Vk::RayTracingBackendKHR::DestroyAccelerationStructure(AccelerationStructure& accelerationStructure)
+{
+    vkDestroyAccelerationStructureKHR(vkDevice->logicalDevice, accelerationStructure.accelerationStructureKHR, nullptr);
+    vkDestroyBuffer(vkDevice->logicalDevice, accelerationStructure.buffer, nullptr);
+    vkFreeMemory(vkDevice->logicalDevice, accelerationStructure.memory, nullptr);
+    accelerationStructure = {};
+}
+
+void CG::Vk::RayTracingBackendKHR::RecordBuild(VkCommandBuffer cmdBuffer, const AccelerationStructureInputs& inputs,
+    const AccelerationStructure& accelerationStructure, bool update, VkBuffer scratchBuffer, VkDeviceSize scratchOffset) const
+{
+    SRayTracingBackendKHR::BuildGeometry buildGeometry(*this, inputs);
+    buildGeometry.info.mode = update ? VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR : VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+    buildGeometry.info.srcAccelerationStructure = update ? accelerationStructure.accelerationStructureKHR : VK_NULL_HANDLE;
+    buildGeometry.info.dstAccelerationStructure = accelerationStructure.accelerationStructureKHR;
+    buildGeometry.info.scratchData.deviceAddress = GetDeviceAddress(scratchBuffer) + scratchOffset;
+
+    const VkAccelerationStructureBuildRangeInfoKHR* ranges = buildGeometry.ranges.data();
+    vkCmdBuildAccelerationStructuresKHR(cmdBuffer, 1, &buildGeometry.info, &ranges);
+}
+
+void CG::Vk::RayTracingBackendKHR::RecordCompactingCopy(
+    VkCommandBuffer cmdBuffer, const AccelerationStructure& source, const AccelerationStructure& destination) const
+{
+    VkCopyAccelerationStructureInfoKHR copyInfo = {};
+    copyInfo.sType = VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_INFO_KHR;
+    copyInfo.src = source.accelerationStructureKHR;
+    copyInfo.dst = destination.accelerationStructureKHR;
+    copyInfo.mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_COMPACT_KHR;
+    vkCmdCopyAccelerationStructureKHR(cmdBuffer, &copyInfo);
+}
+
+void CG::Vk::RayTracingBackendKHR::RecordCompactedSizesQuery(VkCommandBuffer cmdBuffer, const std::vector<AccelerationStructure>& structures,
+    VkQueryPool queryPool, uint32_t firstQuery) const
+{
+    std::vector<VkAccelerationStructureKHR> handles(structures.size());
+    for (size_t i = 0; i < structures.size(); ++i) {
+        handles[i] = structures[i].accelerationStructureKHR;
+    }
+
+    vkCmdWriteAccelerationStructuresPropertiesKHR(cmdBuffer, static_cast<uint32_t>(handles.size()), handles.data(),
+        VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR, queryPool, firstQuery);
+}
+
+VkQueryType CG::Vk::RayTracingBackendKHR::GetCompactedSizeQueryType() const
+{
+    return VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR;
+}
+
+VkBufferUsageFlags CG::Vk::RayTracingBackendKHR::GetScratchBufferUsage() const
+{
+    return VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT_KHR;
+}
+
+VkBufferUsageFlags CG::Vk::RayTracingBackendKHR::GetBuildInputBufferUsage() const
+{
+    return VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT_KHR;
+}
+
+VkDeviceSize CG::Vk::RayTracingBackendKHR::GetScratchAlignment() const
+{
+    return scratchAlignment;
+}
+
+VkDescriptorType CG::Vk::RayTracingBackendKHR::GetAccelerationStructureDescriptorType() const
+{
+    return VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+}
+
+void CG::Vk::RayTracingBackendKHR::WriteAccelerationStructureDescriptor(
+    VkDescriptorSet descriptorSet, uint32_t binding, const AccelerationStructure& accelerationStructure) const
+{
+    VkWriteDescriptorSetAccelerationStructureKHR descriptorAccelerationStructureInfo = {};
+    descriptorAccelerationStructureInfo.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR;
+    descriptorAccelerationStructureInfo.accelerationStructureCount = 1;
+    descriptorAccelerationStructureInfo.pAccelerationStructures = &accelerationStructure.accelerationStructureKHR;
+
+    VkWriteDescriptorSet accelerationStructureWrite = {};
+    accelerationStructureWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    accelerationStructureWrite.pNext = &descriptorAccelerationStructureInfo;
+    accelerationStructureWrite.dstSet = descriptorSet;
+    accelerationStructureWrite.dstBinding = binding;
+    accelerationStructureWrite.descriptorCount = 1;
+    accelerationStructureWrite.descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+
+    vkUpdateDescriptorSets(vkDevice->logicalDevice, 1, &accelerationStructureWrite, 0, nullptr);
+}
+
+std::string CG::Vk::RayTracingBackendKHR::GetShaderPath(const std::string& shaderPath) const
+{
+    return shaderPath + ".khr.spv";
+}
+
+void CG::Vk::RayTracingBackendKHR::CreatePipelines(const RayTracingPipelineInfo* pipelineInfos, uint32_t pipelinesCount, VkPipeline* pipelines)
+{
+    const auto compileStart = std::chrono::high_resolution_clock::now();
+
+    std::vector<std::vector<VkRayTracingShaderGroupCreateInfoKHR>> groups(pipelinesCount);
+    std::vector<VkRayTracingPipelineCreateInfoKHR> pipelineCIs(pipelinesCount);
+
+    for (uint32_t i = 0; i < pipelinesCount; ++i) {
+        const RayTracingPipelineInfo& pipelineInfo = pipelineInfos[i];
+
+        for (uint32_t stage = 0; stage < pipelineInfo.stageCount; ++stage) {
+            groups[i].push_back(SRayTracingBackendKHR::GetShaderGroup(pipelineInfo.stages[stage].stage, stage));
+        }
+
+        VkRayTracingPipelineCreateInfoKHR& pipelineCI = pipelineCIs[i];
+        pipelineCI.sType = VK_STRUCTURE_TYPE_RAY_TRACING_PIPELINE_CREATE_INFO_KHR;
+        pipelineCI.stageCount = pipelineInfo.stageCount;
+        pipelineCI.pStages = pipelineInfo.stages;
+        pipelineCI.groupCount = static_cast<uint32_t>(groups[i].size());
+        pipelineCI.pGroups = groups[i].data();
+        pipelineCI.maxPipelineRayRecursionDepth = pipelineInfo.maxRecursionDepth;
+        pipelineCI.layout = pipelineInfo.layout;
+    }
+
+    VkDeferredOperationKHR deferredOperation = VK_NULL_HANDLE;
+    VK_CHECK_RESULT(vkCreateDeferredOperationKHR(vkDevice->logicalDevice, nullptr, &deferredOperation));
+
+    VkResult result = vkCreateRayTracingPipelinesKHR(vkDevice->logicalDevice, deferredOperation, VK_NULL_HANDLE,
+        pipelinesCount, pipelineCIs.data(), nullptr, pipelines);
+
+    if (result == VK_OPERATION_DEFERRED_KHR) {
+        result = JoinDeferredOperation(deferredOperation);
+    } else if (result == VK_OPERATION_NOT_DEFERRED_KHR) {
+        // The implementation compiled everything right in the call
+        result = VK_SUCCESS;
+    }
+
+    vkDestroyDeferredOperationKHR(vkDevice->logicalDevice, deferredOperation, nullptr);
+    VK_CHECK_RESULT(result);
+
+    const auto compileEnd = std::chrono::high_resolution_clock::now();
+    std::cout << "Compiled " << pipelinesCount << " ray tracing pipeline(s) in "
+              << std::chrono::duration<float, std::milli>(compileEnd - compileStart).count() << " ms" << std::endl;
+}
+
+void CG::Vk::RayTracingBackendKHR::RecordTraceRays(
+    VkCommandBuffer cmdBuffer, const Buffer& shaderBindingTable, uint32_t width, uint32_t height) const
+{
+    const VkDeviceAddress address = GetDeviceAddress(shaderBindingTable.buffer);
+    const VkDeviceSize stride = GetShaderBindingTableStride();
+
+    const VkStridedDeviceAddressRegionKHR raygenRegion = { address, stride, stride };
+    const VkStridedDeviceAddressRegionKHR missRegion = { address + stride, stride, stride };
+    const VkStridedDeviceAddressRegionKHR hitRegion = { address + stride * 2, stride, stride };
+    const VkStridedDeviceAddressRegionKHR callableRegion = {};
+
+    vkCmdTraceRaysKHR(cmdBuffer, &raygenRegion, &missRegion, &hitRegion, &callableRegion, width, height, 1);
+}
+
+VkDeviceAddress CG::Vk::RayTracingBackendKHR::GetDeviceAddress(VkBuffer buffer) const
+{
+    VkBufferDeviceAddressInfoKHR addressInfo = {};
+    addressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO_KHR;
+    addressInfo.buffer = buffer;
+    return vkGetBufferDeviceAddressKHR(vkDevice->logicalDevice, &addressInfo);
+}
+
+VkBufferUsageFlags CG::Vk::RayTracingBackendKHR::GetShaderBindingTableUsage() const
+{
+    return VK_BUFFER_USAGE_SHADER_BINDING_TABLE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT_KHR;
+}
+
+void CG::Vk::RayTracingBackendKHR::GetShaderGroupHandles(VkPipeline pipeline, uint32_t groupsCount, size_t dataSize, void* data) const
+{
+    VK_CHECK_RESULT(vkGetRayTracingShaderGroupHandlesKHR(vkDevice->logicalDevice, pipeline, 0, groupsCount, dataSize, data));
+}
+
+void CG::Vk::RayTracingBackendKHR::LoadProcs()
+{
+    VkDevice device = vkDevice->logicalDevice;
+
+    vkGetBufferDeviceAddressKHR = reinterpret_cast<PFN_vkGetBufferDeviceAddressKHR>(
+        vkGetDeviceProcAddr(device, "vkGetBufferDeviceAddressKHR"));
+    vkCreateAccelerationStructureKHR = reinterpret_cast<PFN_vkCreateAccelerationStructureKHR>(
+        vkGetDeviceProcAddr(device, "vkCreateAccelerationStructureKHR"));
+    vkDestroyAccelerationStructureKHR = reinterpret_cast<PFN_vkDestroyAccelerationStructureKHR>(
+        vkGetDeviceProcAddr(device, "vkDestroyAccelerationStructureKHR"));
+    vkGetAccelerationStructureBuildSizesKHR = reinterpret_cast<PFN_vkGetAccelerationStructureBuildSizesKHR>(
+        vkGetDeviceProcAddr(device, "vkGetAccelerationStructureBuildSizesKHR"));
+    vkGetAccelerationStructureDeviceAddressKHR = reinterpret_cast<PFN_vkGetAccelerationStructureDeviceAddressKHR>(
+        vkGetDeviceProcAddr(device, "vkGetAccelerationStructureDeviceAddressKHR"));
+    vkCmdBuildAccelerationStructuresKHR = reinterpret_cast<PFN_vkCmdBuildAccelerationStructuresKHR>(
+        vkGetDeviceProcAddr(device, "vkCmdBuildAccelerationStructuresKHR"));
+    vkCmdCopyAccelerationStructureKHR = reinterpret_cast<PFN_vkCmdCopyAccelerationStructureKHR>(
+        vkGetDeviceProcAddr(device, "vkCmdCopyAccelerationStructureKHR"));
+    vkCmdWriteAccelerationStructuresPropertiesKHR = reinterpret_cast<PFN_vkCmdWriteAccelerationStructuresPropertiesKHR>(
+        vkGetDeviceProcAddr(device, "vkCmdWriteAccelerationStructuresPropertiesKHR"));
+    vkCreateRayTracingPipelinesKHR = reinterpret_cast<PFN_vkCreateRayTracingPipelinesKHR>(
+        vkGetDeviceProcAddr(device, "vkCreateRayTracingPipelinesKHR"));
+    vkGetRayTracingShaderGroupHandlesKHR = reinterpret_cast<PFN_vkGetRayTracingShaderGroupHandlesKHR>(
+        vkGetDeviceProcAddr(device, "vkGetRayTracingShaderGroupHandlesKHR"));
+    vkCmdTraceRaysKHR = reinterpret_cast<PFN_vkCmdTraceRaysKHR>(
+        vkGetDeviceProcAddr(device, "vkCmdTraceRaysKHR"));
+    vkCreateDeferredOperationKHR = reinterpret_cast<PFN_vkCreateDeferredOperationKHR>(
+        vkGetDeviceProcAddr(device, "vkCreateDeferredOperationKHR"));
+    vkDestroyDeferredOperationKHR = reinterpret_cast<PFN_vkDestroyDeferredOperationKHR>(
+        vkGetDeviceProcAddr(device, "vkDestroyDeferredOperationKHR"));
+    vkGetDeferredOperationMaxConcurrencyKHR = reinterpret_cast<PFN_vkGetDeferredOperationMaxConcurrencyKHR>(
+        vkGetDeviceProcAddr(device, "vkGetDeferredOperationMaxConcurrencyKHR"));
+    vkGetDeferredOperationResultKHR = reinterpret_cast<PFN_vkGetDeferredOperationResultKHR>(
+        vkGetDeviceProcAddr(device, "vkGetDeferredOperationResultKHR"));
+    vkDeferredOperationJoinKHR = reinterpret_cast<PFN_vkDeferredOperationJoinKHR>(
+        vkGetDeviceProcAddr(device, "vkDeferredOperationJoinKHR"));
+}
+
+void CG::Vk::RayTracingBackendKHR::CreateStorage(
+    VkAccelerationStructureTypeKHR type, VkDeviceSize size, AccelerationStructure& accelerationStructure) const
+{
+    const VkBufferCreateInfo bufferCI = Initializers::BufferCreateInfo(
+        VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT_KHR, size);
+    VK_CHECK_RESULT(vkCreateBuffer(vkDevice->logicalDevice, &bufferCI, nullptr, &accelerationStructure.buffer));
+
+    VkMemoryRequirements memoryRequirements;
+    vkGetBufferMemoryRequirements(vkDevice->logicalDevice, accelerationStructure.buffer, &memoryRequirements);
+
+    VkMemoryAllocateFlagsInfo memoryAllocateFlags = {};
+    memoryAllocateFlags.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO;
+    memoryAllocateFlags.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR;
+
+    VkMemoryAllocateInfo memoryAllocateInfo = Initializers::MemoryAllocateInfo();
+    memoryAllocateInfo.pNext = &memoryAllocateFlags;
+    memoryAllocateInfo.allocationSize = memoryRequirements.size;
+    memoryAllocateInfo.memoryTypeIndex = vkDevice->GetMemoryTypeIndex(
+        memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    VK_CHECK_RESULT(vkAllocateMemory(vkDevice->logicalDevice, &memoryAllocateInfo, nullptr, &accelerationStructure.memory));
+    VK_CHECK_RESULT(vkBindBufferMemory(vkDevice->logicalDevice, accelerationStructure.buffer, accelerationStructure.memory, 0));
+    accelerationStructure.memorySize = memoryAllocateInfo.allocationSize;
+
+    VkAccelerationStructureCreateInfoKHR accelerationStructureCI = {};
+    accelerationStructureCI.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
+    accelerationStructureCI.buffer = accelerationStructure.buffer;
+    accelerationStructureCI.size = size;
+    accelerationStructureCI.type = type;
+    VK_CHECK_RESULT(vkCreateAccelerationStructureKHR(
+        vkDevice->logicalDevice, &accelerationStructureCI, nullptr, &accelerationStructure.accelerationStructureKHR));
+
+    VkAccelerationStructureDeviceAddressInfoKHR addressInfo = {};
+    addressInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR;
+    addressInfo.accelerationStructure = accelerationStructure.accelerationStructureKHR;
+    accelerationStructure.handle = vkGetAccelerationStructureDeviceAddressKHR(vkDevice->logicalDevice, &addressInfo);
+}
+
+VkResult CG::Vk::RayTracingBackendKHR::JoinDeferredOperation(VkDeferredOperationKHR deferredOperation) const
+{
+    VkDevice device = vkDevice->logicalDevice;
+
+    const auto join = [this, device, deferredOperation](size_t) {
+        // VK_THREAD_DONE_KHR means the rest of the work is taken by other threads, VK_SUCCESS that the operation is complete
+        while (vkDeferredOperationJoinKHR(device, deferredOperation) == VK_THREAD_IDLE_KHR) {
+            std::this_thread::yield();
+        }
+    };
+
+    const uint32_t maxConcurrency = vkGetDeferredOperationMaxConcurrencyKHR(device, deferredOperation);
+    const uint32_t joinersCount = threadPool ? std::max(1u, std::min(maxConcurrency, threadPool->GetThreadsCount())) : 1;
+
+    if (threadPool) {
+        threadPool->ParallelFor(joinersCount, join);
+    } else {
+        join(0);
+    }
+
+    return vkGetDeferredOperationResultKHR(device, deferredOperation);
+}
@@ -0,0 +1,345 @@
+#include "Render/Vulkan/RayTracingBackendNV.hpp"
+#include "Render/Vulkan/Debug.hpp"
+#include "Render/Vulkan/Device.hpp"
+#include "Render/Vulkan/Initializers.hpp"
+
+namespace SRayTracingBackendNV {
+std::vector<VkGeometryNV> GetGeometries(const CG::Vk::AccelerationStructureInputs& inputs)
+{
+    std::vector<VkGeometryNV> geometries(inputs.geometryCount);
+
+    for (uint32_t i = 0; i < inputs.geometryCount; ++i) {
+        const CG::Vk::RayTracingGeometry& source = inputs.geometries[i];
+
+        VkGeometryNV& geometry = geometries[i];
+        geometry.sType = VK_STRUCTURE_TYPE_GEOMETRY_NV;
+        geometry.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_NV;
+        geometry.geometry.triangles.sType = VK_STRUCTURE_TYPE_GEOMETRY_TRIANGLES_NV;
+        geometry.geometry.triangles.vertexData = source.vertexBuffer;
+        geometry.geometry.triangles.vertexOffset = source.vertexOffset;
+        geometry.geometry.triangles.vertexCount = source.vertexCount;
+        geometry.geometry.triangles.vertexStride = source.vertexStride;
+        geometry.geometry.triangles.vertexFormat = source.vertexFormat;
+        geometry.geometry.triangles.indexData = source.indexBuffer;
+        geometry.geometry.triangles.indexOffset = source.indexOffset;
+        geometry.geometry.triangles.indexCount = source.indexCount;
+        geometry.geometry.triangles.indexType = source.indexType;
+        geometry.geometry.triangles.transformData = VK_NULL_HANDLE;
+        geometry.geometry.triangles.transformOffset = 0;
+        geometry.geometry.aabbs.sType = VK_STRUCTURE_TYPE_GEOMETRY_AABB_NV;
+        geometry.flags = VK_GEOMETRY_OPAQUE_BIT_NV;
+    }
+
+    return geometries;
+}
+
+VkAccelerationStructureInfoNV GetInfo(const CG::Vk::AccelerationStructureInputs& inputs, const std::vector<VkGeometryNV>& geometries)
+{
+    const bool topLevel = inputs.level == CG::Vk::eAccelerationStructureLevel::kTop;
+
+    VkAccelerationStructureInfoNV accelerationStructureInfo = {};
+    accelerationStructureInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_INFO_NV;
+    accelerationStructureInfo.type = topLevel ? VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_NV : VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_NV;
+    accelerationStructureInfo.flags = inputs.flags;
+    accelerationStructureInfo.instanceCount = topLevel ? inputs.instanceCount : 0;
+    accelerationStructureInfo.geometryCount = static_cast<uint32_t>(geometries.size());
+    accelerationStructureInfo.pGeometries = geometries.data();
+    return accelerationStructureInfo;
+}
+
+VkRayTracingShaderGroupCreateInfoNV GetShaderGroup(VkShaderStageFlagBits stage, uint32_t stageIndex)
+{
+    VkRayTracingShaderGroupCreateInfoNV group = {};
+    group.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_NV;
+    group.generalShader = VK_SHADER_UNUSED_NV;
+    group.closestHitShader = VK_SHADER_UNUSED_NV;
+    group.anyHitShader = VK_SHADER_UNUSED_NV;
+    group.intersectionShader = VK_SHADER_UNUSED_NV;
+
+    if (stage == VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV) {
+        group.type = VK_RAY_TRACING_SHADER_GROUP_TYPE_TRIANGLES_HIT_GROUP_NV;
+        group.closestHitShader = stageIndex;
+    } else {
+        group.type = VK_RAY_TRACING_SHADER_GROUP_TYPE_GENERAL_NV;
+        group.generalShader = stageIndex;
+    }
+
+    return group;
+}
+}
+
+CG::Vk::RayTracingBackendNV::RayTracingBackendNV(Device* aVkDevice)
+    : RayTracingBackend(aVkDevice)
+{
+    LoadProcs();
+
+    VkPhysicalDeviceRayTracingPropertiesNV rayTracingProperties = Initializers::PhysicalDeviceRayTracingPropertiesNV();
+
+    VkPhysicalDeviceProperties2 physicalDeviceProperties = {};
+    physicalDeviceProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    physicalDeviceProperties.pNext = &rayTracingProperties;
+    vkGetPhysicalDeviceProperties2(vkDevice->physicalDevice, &physicalDeviceProperties);
+
+    shaderGroupHandleSize = rayTracingProperties.shaderGroupHandleSize;
+    shaderGroupBaseAlignment = rayTracingProperties.shaderGroupBaseAlignment;
+    maxRecursionDepth = rayTracingProperties.maxRecursionDepth;
+}
+
+CG::Vk::eRayTracingApi CG::Vk::RayTracingBackendNV::GetApi() const
+{
+    return eRayTracingApi::kNV;
+}
+
+void CG::Vk::RayTracingBackendNV::CreateAccelerationStructure(
+    const AccelerationStructureInputs& inputs, AccelerationStructure& accelerationStructure)
+{
+    const std::vector<VkGeometryNV> geometries = SRayTracingBackendNV::GetGeometries(inputs);
+
+    VkAccelerationStructureCreateInfoNV accelerationStructureCI = {};
+    accelerationStructureCI.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_NV;
+    accelerationStructureCI.info = SRayTracingBackendNV::GetInfo(inputs, geometries);
+    VK_CHECK_RESULT(vkCreateAccelerationStructureNV(
+        vkDevice->logicalDevice, &accelerationStructureCI, nullptr,
+        &accelerationStructure.accelerationStructureNV));
+
+    BindMemory(accelerationStructure);
+}
+
+void CG::Vk::RayTracingBackendNV::CreateCompactedBottomLevel(
+    VkBuildAccelerationStructureFlagsKHR flags, VkDeviceSize compactedSize, AccelerationStructure& accelerationStructure)
+{
+    // Compacted structures are created without geometries, their content comes with the copy
+    VkAccelerationStructureCreateInfoNV accelerationStructureCI = {};
+    accelerationStructureCI.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_NV;
+    accelerationStructureCI.compactedSize = compactedSize;
+    accelerationStructureCI.info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_INFO_NV;
+    accelerationStructureCI.info.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_NV;
+    accelerationStructureCI.info.flags = flags;
+    VK_CHECK_RESULT(vkCreateAccelerationStructureNV(
+        vkDevice->logicalDevice, &accelerationStructureCI, nullptr,
+        &accelerationStructure.accelerationStructureNV));
+
+    BindMemory(accelerationStructure);
+}
+
+void CG::Vk::RayTracingBackendNV::DestroyAccelerationStructure(AccelerationStructure& accelerationStructure)
+{
+    vkDestroyAccelerationStructureNV(vkDevice->logicalDevice, accelerationStructure.accelerationStructureNV, nullptr);
+    vkFreeMemory(vkDevice->logicalDevice, accelerationStructure.memory, nullptr);
+    accelerationStructure = {};
+}
+
+void CG::Vk::RayTracingBackendNV::RecordBuild(VkCommandBuffer cmdBuffer, const AccelerationStructureInputs& inputs,
+    const AccelerationStructure& accelerationStructure, bool update, VkBuffer scratchBuffer, VkDeviceSize scratchOffset) const
+{
+    const std::vector<VkGeometryNV> geometries = SRayTracingBackendNV::GetGeometries(inputs);
+    const VkAccelerationStructureInfoNV buildInfo = SRayTracingBackendNV::GetInfo(inputs, geometries);
+
+    vkCmdBuildAccelerationStructureNV(cmdBuffer, &buildInfo,
+        inputs.instanceBuffer, 0, update ? VK_TRUE : VK_FALSE,
+        accelerationStructure.accelerationStructureNV,
+        update ? accelerationStructure.accelerationStructureNV : VK_NULL_HANDLE,
+        scratchBuffer, scratchOffset);
+}
+
+void CG::Vk::RayTracingBackendNV::RecordCompactingCopy(
+    VkCommandBuffer cmdBuffer, const AccelerationStructure& source, const AccelerationStructure& destination) const
+{
+    vkCmdCopyAccelerationStructureNV(cmdBuffer, destination.accelerationStructureNV,
+        source.accelerationStructureNV, VK_COPY_ACCELERATION_STRUCTURE_MODE_COMPACT_NV);
+}
+
+void CG::Vk::RayTracingBackendNV::RecordCompactedSizesQuery(VkCommandBuffer cmdBuffer, const std::vector<AccelerationStructure>& structures,
+    VkQueryPool queryPool, uint32_t firstQuery) const
+{
+    std::vector<VkAccelerationStructureNV> handles(structures.size());
+    for (size_t i = 0; i < structures.size(); ++i) {
+        handles[i] = structures[i].accelerationStructureNV;
+    }
+
+    vkCmdWriteAccelerationStructuresPropertiesNV(cmdBuffer, static_cast<uint32_t>(handles.size()), handles.data(),
+        VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_NV, queryPool, firstQuery);
+}
+
+VkQueryType CG::Vk::RayTracingBackendNV::GetCompactedSizeQueryType() const
+{
+    return VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_NV;
+}
+
+VkBufferUsageFlags CG::Vk::RayTracingBackendNV::GetScratchBufferUsage() const
+{
+    return VK_BUFFER_USAGE_RAY_TRACING_BIT_NV;
+}
+
+VkBufferUsageFlags CG::Vk::RayTracingBackendNV::GetBuildInputBufferUsage() const
+{
+    return VK_BUFFER_USAGE_RAY_TRACING_BIT_NV;
+}
+
+VkDeviceSize CG::Vk::RayTracingBackendNV::GetScratchAlignment() const
+{
+    // Scratch offsets have no alignment requirement of their own
+    return 1;
+}
+
+VkDescriptorType CG::Vk::RayTracingBackendNV::GetAccelerationStructureDescriptorType() const
+{
+    return VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_NV;
+}
+
+void CG::Vk::RayTracingBackendNV::WriteAccelerationStructureDescriptor(
+    VkDescriptorSet descriptorSet, uint32_t binding, const AccelerationStructure& accelerationStructure) const
+{
+    VkWriteDescriptorSetAccelerationStructureNV descriptorAccelerationStructureInfo = {};
+    descriptorAccelerationStructureInfo.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_NV;
+    descriptorAccelerationStructureInfo.accelerationStructureCount = 1;
+    descriptorAccelerationStructureInfo.pAccelerationStructures = &accelerationStructure.accelerationStructureNV;
+
+    VkWriteDescriptorSet accelerationStructureWrite = {};
+    accelerationStructureWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    // The specialized acceleration structure descriptor has to be chained
+    accelerationStructureWrite.pNext = &descriptorAccelerationStructureInfo;
+    accelerationStructureWrite.dstSet = descriptorSet;
+    accelerationStructureWrite.dstBinding = binding;
+    accelerationStructureWrite.descriptorCount = 1;
+    accelerationStructureWrite.descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_NV;
+
+    vkUpdateDescriptorSets(vkDevice->logicalDevice, 1, &accelerationStructureWrite, 0, nullptr);
+}
+
+std::string CG::Vk::RayTracingBackendNV::GetShaderPath(const std::string& shaderPath) const
+{
+    return shaderPath + ".spv";
+}
+
+void CG::Vk::RayTracingBackendNV::CreatePipelines(const RayTracingPipelineInfo* pipelineInfos, uint32_t pipelinesCount, VkPipeline* pipelines)
+{
+    std::vector<std::vector<VkRayTracingShaderGroupCreateInfoNV>> groups(pipelinesCount);
+    std::vector<VkRayTracingPipelineCreateInfoNV> pipelineCIs(pipelinesCount);
+
+    for (uint32_t i = 0; i < pipelinesCount; ++i) {
+        const RayTracingPipelineInfo& pipelineInfo = pipelineInfos[i];
+
+        for (uint32_t stage = 0; stage < pipelineInfo.stageCount; ++stage) {
+            groups[i].push_back(SRayTracingBackendNV::GetShaderGroup(pipelineInfo.stages[stage].stage, stage));
+        }
+
+        VkRayTracingPipelineCreateInfoNV& pipelineCI = pipelineCIs[i];
+        pipelineCI.sType = VK_STRUCTURE_TYPE_RAY_TRACING_PIPELINE_CREATE_INFO_NV;
+        pipelineCI.stageCount = pipelineInfo.stageCount;
+        pipelineCI.pStages = pipelineInfo.stages;
+        pipelineCI.groupCount = static_cast<uint32_t>(groups[i].size());
+        pipelineCI.pGroups = groups[i].data();
+        pipelineCI.maxRecursionDepth = pipelineInfo.maxRecursionDepth;
+        pipelineCI.layout = pipelineInfo.layout;
+    }
+
+    VK_CHECK_RESULT(vkCreateRayTracingPipelinesNV(vkDevice->logicalDevice, VK_NULL_HANDLE,
+        pipelinesCount, pipelineCIs.data(), nullptr, pipelines));
+}
+
+void CG::Vk::RayTracingBackendNV::RecordTraceRays(
+    VkCommandBuffer cmdBuffer, const Buffer& shaderBindingTable, uint32_t width, uint32_t height) const
+{
+    const VkDeviceSize stride = GetShaderBindingTableStride();
+
+    vkCmdTraceRaysNV(cmdBuffer,
+        shaderBindingTable.buffer, 0,
+        shaderBindingTable.buffer, stride, stride,
+        shaderBindingTable.buffer, stride * 2, stride,
+        VK_NULL_HANDLE, 0, 0,
+        width, height, 1);
+}
+
+VkBufferUsageFlags CG::Vk::RayTracingBackendNV::GetShaderBindingTableUsage() const
+{
+    return VK_BUFFER_USAGE_RAY_TRACING_BIT_NV;
+}
+
+void CG::Vk::RayTracingBackendNV::GetShaderGroupHandles(VkPipeline pipeline, uint32_t groupsCount, size_t dataSize, void* data) const
+{
+    VK_CHECK_RESULT(vkGetRayTracingShaderGroupHandlesNV(vkDevice->logicalDevice, pipeline, 0, groupsCount, dataSize, data));
+}
+
+void CG::Vk::RayTracingBackendNV::LoadProcs()
+{
+    VkDevice device = vkDevice->logicalDevice;
+
+    vkCreateAccelerationStructureNV = reinterpret_cast<PFN_vkCreateAccelerationStructureNV>(
+        vkGetDeviceProcAddr(device, "vkCreateAccelerationStructureNV"));
+    vkDestroyAccelerationStructureNV = reinterpret_cast<PFN_vkDestroyAccelerationStructureNV>(
+        vkGetDeviceProcAddr(device, "vkDestroyAccelerationStructureNV"));
+    vkBindAccelerationStructureMemoryNV = reinterpret_cast<PFN_vkBindAccelerationStructureMemoryNV>(
+        vkGetDeviceProcAddr(device, "vkBindAccelerationStructureMemoryNV"));
+    vkGetAccelerationStructureHandleNV = reinterpret_cast<PFN_vkGetAccelerationStructureHandleNV>(
+        vkGetDeviceProcAddr(device, "vkGetAccelerationStructureHandleNV"));
+    vkGetAccelerationStructureMemoryRequirementsNV = reinterpret_cast<PFN_vkGetAccelerationStructureMemoryRequirementsNV>(
+        vkGetDeviceProcAddr(device, "vkGetAccelerationStructureMemoryRequirementsNV"));
+    vkCmdBuildAccelerationStructureNV = reinterpret_cast<PFN_vkCmdBuildAccelerationStructureNV>(
+        vkGetDeviceProcAddr(device, "vkCmdBuildAccelerationStructureNV"));
+    vkCmdCopyAccelerationStructureNV = reinterpret_cast<PFN_vkCmdCopyAccelerationStructureNV>(
+        vkGetDeviceProcAddr(device, "vkCmdCopyAccelerationStructureNV"));
+    vkCmdWriteAccelerationStructuresPropertiesNV = reinterpret_cast<PFN_vkCmdWriteAccelerationStructuresPropertiesNV>(
+        vkGetDeviceProcAddr(device, "vkCmdWriteAccelerationStructuresPropertiesNV"));
+    vkCreateRayTracingPipelinesNV = reinterpret_cast<PFN_vkCreateRayTracingPipelinesNV>(
+        vkGetDeviceProcAddr(device, "vkCreateRayTracingPipelinesNV"));
+    vkGetRayTracingShaderGroupHandlesNV = reinterpret_cast<PFN_vkGetRayTracingShaderGroupHandlesNV>(
+        vkGetDeviceProcAddr(device, "vkGetRayTracingShaderGroupHandlesNV"));
+    vkCmdTraceRaysNV = reinterpret_cast<PFN_vkCmdTraceRaysNV>(
+        vkGetDeviceProcAddr(device, "vkCmdTraceRaysNV"));
+}
+
+void CG::Vk::RayTracingBackendNV::BindMemory(AccelerationStructure& accelerationStructure) const
+{
+    VkAccelerationStructureMemoryRequirementsInfoNV memoryRequirementsInfo {};
+    memoryRequirementsInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_MEMORY_REQUIREMENTS_INFO_NV;
+    memoryRequirementsInfo.type = VK_ACCELERATION_STRUCTURE_MEMORY_REQUIREMENTS_TYPE_OBJECT_NV;
+    memoryRequirementsInfo.accelerationStructure = accelerationStructure.accelerationStructureNV;
+
+    VkMemoryRequirements2 memoryRequirements2 = {};
+    memoryRequirements2.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+    vkGetAccelerationStructureMemoryRequirementsNV(
+        vkDevice->logicalDevice, &memoryRequirementsInfo, &memoryRequirements2);
+
+    VkMemoryAllocateInfo memoryAllocateInfo = Initializers::MemoryAllocateInfo();
+    memoryAllocateInfo.allocationSize = memoryRequirements2.memoryRequirements.size;
+    memoryAllocateInfo.memoryTypeIndex = vkDevice->GetMemoryTypeIndex(
+        memoryRequirements2.memoryRequirements.memoryTypeBits,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    VK_CHECK_RESULT(vkAllocateMemory(vkDevice->logicalDevice,
+        &memoryAllocateInfo, nullptr,
+        &accelerationStructure.memory));
+    accelerationStructure.memorySize = memoryAllocateInfo.allocationSize;
+
+    VkBindAccelerationStructureMemoryInfoNV accelerationStructureMemoryInfo = {};
+    accelerationStructureMemoryInfo.sType = VK_STRUCTURE_TYPE_BIND_ACCELERATION_STRUCTURE_MEMORY_INFO_NV;
+    accelerationStructureMemoryInfo.accelerationStructure = accelerationStructure.accelerationStructureNV;
+    accelerationStructureMemoryInfo.memory = accelerationStructure.memory;
+    VK_CHECK_RESULT(vkBindAccelerationStructureMemoryNV(
+        vkDevice->logicalDevice, 1, &accelerationStructureMemoryInfo));
+
+    VK_CHECK_RESULT(vkGetAccelerationStructureHandleNV(
+        vkDevice->logicalDevice, accelerationStructure.accelerationStructureNV,
+        sizeof(uint64_t), &accelerationStructure.handle));
+
+    accelerationStructure.buildScratchSize = GetMemorySize(
+        accelerationStructure.accelerationStructureNV, VK_ACCELERATION_STRUCTURE_MEMORY_REQUIREMENTS_TYPE_BUILD_SCRATCH_NV);
+    accelerationStructure.updateScratchSize = GetMemorySize(
+        accelerationStructure.accelerationStructureNV, VK_ACCELERATION_STRUCTURE_MEMORY_REQUIREMENTS_TYPE_UPDATE_SCRATCH_NV);
+}
+
+VkDeviceSize CG::Vk::RayTracingBackendNV::GetMemorySize(
+    VkAccelerationStructureNV accelerationStructure, VkAccelerationStructureMemoryRequirementsTypeNV type) const
+{
+    VkAccelerationStructureMemoryRequirementsInfoNV memoryRequirementsInfo {};
+    memoryRequirementsInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_MEMORY_REQUIREMENTS_INFO_NV;
+    memoryRequirementsInfo.type = type;
+    memoryRequirementsInfo.accelerationStructure = accelerationStructure;
+
+    VkMemoryRequirements2 memoryRequirements2 = {};
+    memoryRequirements2.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+    vkGetAccelerationStructureMemoryRequirementsNV(
+        vkDevice->logicalDevice, &memoryRequirementsInfo, &memoryRequirements2);
+
+    return memoryRequirements2.memoryRequirements.size;
+}
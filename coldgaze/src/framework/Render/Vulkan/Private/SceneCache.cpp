@@ -0,0 +1,140 @@
+#include "Render/Vulkan/SceneCache.hpp"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+namespace SSceneCache {
+const char kPadding[CG::Vk::SceneCache::kBlobAlignment] = {};
+}
+
+std::string CG::Vk::SceneCache::GetCachePath(const std::string& modelPath)
+{
+    return modelPath + kFileExtension;
+}
+
+bool CG::Vk::SceneCache::GetFileStamp(const std::string& filePath, uint64_t& size, int64_t& modifiedTime)
+{
+    std::error_code error;
+    const std::filesystem::path path(filePath);
+
+    size = static_cast<uint64_t>(std::filesystem::file_size(path, error));
+    if (error) {
+        return false;
+    }
+
+    modifiedTime = static_cast<int64_t>(std::filesystem::last_write_time(path, error).time_since_epoch().count());
+    return !error;
+}
+
+CG::Vk::SceneCache::Writer::~Writer()
+{
+    // Unfinished cache is never left behind
+    if (file.is_open()) {
+        file.close();
+    }
+    if (!tempPath.empty() && !finished) {
+        std::remove(tempPath.c_str());
+    }
+}
+
+bool CG::Vk::SceneCache::Writer::Open(const std::string& cachePath)
+{
+    path = cachePath;
+    tempPath = cachePath + ".tmp";
+
+    file.open(tempPath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    // Header is written by Finish, once all ranges are known
+    const Header header = {};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    return file.good();
+}
+
+CG::Vk::SceneCache::Range CG::Vk::SceneCache::Writer::WriteBlob(const void* data, size_t size)
+{
+    const uint64_t position = static_cast<uint64_t>(file.tellp());
+    const uint64_t paddingSize = (kBlobAlignment - position % kBlobAlignment) % kBlobAlignment;
+    file.write(SSceneCache::kPadding, static_cast<std::streamsize>(paddingSize));
+
+    Range range = {};
+    range.offset = position + paddingSize;
+    range.size = size;
+
+    if (size > 0) {
+        file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+    }
+    return range;
+}
+
+CG::Vk::SceneCache::StringRef CG::Vk::SceneCache::Writer::AddString(const std::string& string)
+{
+    StringRef stringRef = {};
+    stringRef.offset = static_cast<uint32_t>(strings.size());
+    stringRef.length = static_cast<uint32_t>(string.size());
+    strings += string;
+    return stringRef;
+}
+
+bool CG::Vk::SceneCache::Writer::Finish(Header& header)
+{
+    header.magic = kMagic;
+    header.version = kVersion;
+    header.strings = WriteBlob(strings.data(), strings.size());
+
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.close();
+
+    if (file.fail()) {
+        return false;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempPath, path, error);
+    finished = !error;
+    return finished;
+}
+
+bool CG::Vk::SceneCache::Reader::Open(const std::string& cachePath)
+{
+    if (!file.Open(cachePath)) {
+        return false;
+    }
+
+    if (file.GetSize() < sizeof(Header)) {
+        file.Close();
+        return false;
+    }
+
+    memcpy(&header, file.GetData(), sizeof(Header));
+    if (header.magic != kMagic || header.version != kVersion || !GetBlob(header.strings)) {
+        file.Close();
+        return false;
+    }
+
+    return true;
+}
+
+const CG::Vk::SceneCache::Header& CG::Vk::SceneCache::Reader::GetHeader() const
+{
+    return header;
+}
+
+const uint8_t* CG::Vk::SceneCache::Reader::GetBlob(const Range& range) const
+{
+    if (range.offset > file.GetSize() || range.size > file.GetSize() - range.offset) {
+        return nullptr;
+    }
+    return file.GetData() + range.offset;
+}
+
+std::string CG::Vk::SceneCache::Reader::GetString(const StringRef& string) const
+{
+    if (static_cast<uint64_t>(string.offset) + string.length > header.strings.size) {
+        return std::string();
+    }
+    return std::string(reinterpret_cast<const char*>(file.GetData() + header.strings.offset + string.offset), string.length);
+}
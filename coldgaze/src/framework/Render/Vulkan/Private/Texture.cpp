@@ -12,10 +12,21 @@ void CG::Vk::Texture::UpdateDescriptor()
 
 void CG::Vk::Texture::Destroy()
 {
+    // Never loaded
+    if (!vkDevice) {
+        return;
+    }
+
     vkDestroyImageView(vkDevice->logicalDevice, view, nullptr);
     vkDestroyImage(vkDevice->logicalDevice, image, nullptr);
     if (sampler) {
         vkDestroySampler(vkDevice->logicalDevice, sampler, nullptr);
     }
     vkFreeMemory(vkDevice->logicalDevice, deviceMemory, nullptr);
+
+    // Textures can be loaded again, destroying twice has to be harmless
+    view = VK_NULL_HANDLE;
+    image = VK_NULL_HANDLE;
+    sampler = VK_NULL_HANDLE;
+    deviceMemory = VK_NULL_HANDLE;
 }
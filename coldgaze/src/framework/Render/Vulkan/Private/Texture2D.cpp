@@ -1,46 +1,206 @@
 #include "Render/Vulkan/Texture2D.hpp"
+#include "Core/MappedFile.hpp"
 #include "Render/Vulkan/Debug.hpp"
 #include "Render/Vulkan/Device.hpp"
 #include "Render/Vulkan/Exceptions.hpp"
 #include "Render/Vulkan/Initializers.hpp"
+#include "Render/Vulkan/KTX2.hpp"
+#include "Render/Vulkan/MipGenerator.hpp"
+#include "Render/Vulkan/PixelKernels.hpp"
+#include "Render/Vulkan/RadianceHDR.hpp"
+#include "Render/Vulkan/UploadBatcher.hpp"
 #include "Render/Vulkan/Utils.hpp"
 #include "stb_image.h"
+#include <algorithm>
+#include <iostream>
+#include <vector>
 
-void CG::Vk::Texture2D::LoadFromFile(const std::string& fileName, Device* device, VkQueue copyQueue, bool loadHDR /*= false*/)
+namespace STexture2D {
+VkDeviceSize GetBlocksCount(uint32_t width, uint32_t height)
+{
+    return static_cast<VkDeviceSize>((width + 3) / 4) * ((height + 3) / 4);
+}
+
+bool HasExtension(const std::string& fileName, const std::string& extension)
+{
+    return fileName.size() >= extension.size() && fileName.compare(fileName.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+// Staging ring of HDR uploads, levels bigger than it are streamed through in bands of rows
+constexpr VkDeviceSize kHDRStagingSize = 16 * 1024 * 1024;
+
+// Packs rows of every level of an HDR mip chain as soon as they are known. Level 0 rows go straight into reserved staging memory,
+// smaller levels come out of the downsamplers in the middle of a level 0 band, so they wait in bands of their own until it's complete
+class HDRChainWriter {
+public:
+    HDRChainWriter(VkImage aImage, VkFormat aFormat, uint32_t width, uint32_t height, uint16_t levelsCount, CG::Vk::UploadBatcher& aUploadBatcher)
+        : image(aImage)
+        , format(aFormat)
+        , uploadBatcher(aUploadBatcher)
+    {
+        // A quarter of the ring per band, so a few bands are copied with every submit
+        const VkDeviceSize bandSize = uploadBatcher.GetStagingSize() / 4;
+
+        levels.resize(levelsCount);
+        for (uint32_t level = 0; level < levelsCount; ++level) {
+            Level& levelData = levels[level];
+            levelData.width = std::max(width >> level, 1u);
+            levelData.height = std::max(height >> level, 1u);
+            levelData.rowSize = CG::Vk::Texture2D::GetLevelSize(format, levelData.width, 1);
+            levelData.bandRowsCount = static_cast<uint32_t>(std::clamp<VkDeviceSize>(bandSize / levelData.rowSize, 1, levelData.height));
+
+            if (level + 1 < levelsCount) {
+                downsamplers.emplace_back(levelData.width, levelData.height, 3);
+            }
+        }
+    }
+
+    // Rows of level 0 have to come from the top of the image down, from height - 1 to 0
+    void AddRow(uint32_t level, uint32_t y, const float* row)
+    {
+        Level& levelData = levels[level];
+
+        if (y < levelData.band.firstRow || y >= levelData.band.firstRow + levelData.band.rowsCount) {
+            StartBand(level, y);
+        }
+        PackRow(row, levelData.width, levelData.band.rows + static_cast<size_t>(y - levelData.band.firstRow) * levelData.rowSize);
+
+        // Rows come with decreasing y, so the band is complete once its first row is written
+        if (y == levelData.band.firstRow && level > 0) {
+            pendingBands.push_back(std::move(levelData.band));
+            levelData.band = Band();
+        }
+
+        if (level < downsamplers.size()) {
+            downsamplers[level].AddRow(y, row, [this, level](uint32_t dstY, const float* dstRow) { AddRow(level + 1, dstY, dstRow); });
+        }
+    }
+
+    void Finish()
+    {
+        FlushPendingBands();
+    }
+
+private:
+    struct Band {
+        uint32_t firstRow = 0;
+        uint32_t rowsCount = 0;
+        // Staging memory for level 0, storage for the rest
+        uint8_t* rows = nullptr;
+        std::vector<uint8_t> storage;
+        uint32_t level = 0;
+    };
+
+    struct Level {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        VkDeviceSize rowSize = 0;
+        uint32_t bandRowsCount = 0;
+        Band band;
+    };
+
+    void StartBand(uint32_t level, uint32_t lastRow)
+    {
+        Level& levelData = levels[level];
+
+        Band band;
+        band.level = level;
+        band.firstRow = lastRow + 1 > levelData.bandRowsCount ? lastRow + 1 - levelData.bandRowsCount : 0;
+        band.rowsCount = lastRow + 1 - band.firstRow;
+
+        if (level == 0) {
+            // Previous level 0 band is complete, so reserving staging can't submit half written rows
+            FlushPendingBands();
+            band.rows = static_cast<uint8_t*>(
+                uploadBatcher.ReserveImageRows(image, 0, levelData.width, band.firstRow, band.rowsCount, levelData.rowSize));
+        } else {
+            band.storage.resize(static_cast<size_t>(band.rowsCount * levelData.rowSize));
+            band.rows = band.storage.data();
+        }
+
+        levelData.band = std::move(band);
+    }
+
+    void FlushPendingBands()
+    {
+        for (const Band& band : pendingBands) {
+            const Level& levelData = levels[band.level];
+            void* rows = uploadBatcher.ReserveImageRows(image, band.level, levelData.width, band.firstRow, band.rowsCount, levelData.rowSize);
+            memcpy(rows, band.storage.data(), band.storage.size());
+        }
+        pendingBands.clear();
+    }
+
+    void PackRow(const float* row, uint32_t width, uint8_t* dst) const
+    {
+        if (format == VK_FORMAT_R16G16B16A16_SFLOAT) {
+            CG::Vk::PixelKernels::ConvertRGBToHalfRGBA(row, width, reinterpret_cast<uint16_t*>(dst));
+        } else {
+            CG::Vk::PixelKernels::ConvertRGBToE5B9G9R9(row, width, reinterpret_cast<uint32_t*>(dst));
+        }
+    }
+
+    VkImage image = VK_NULL_HANDLE;
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    CG::Vk::UploadBatcher& uploadBatcher;
+
+    std::vector<Level> levels;
+    // downsamplers[i] produces rows of level i + 1
+    std::vector<CG::Vk::MipGenerator::RowDownsampler> downsamplers;
+    std::vector<Band> pendingBands;
+};
+}
+
+void CG::Vk::Texture2D::LoadFromFile(const std::string& fileName, Device* device, VkQueue copyQueue, bool loadHDR /*= false*/,
+    eHDRFormat hdrFormat /*= eHDRFormat::kSharedExponent*/, const HDRRowVisitor& hdrRowVisitor /*= nullptr*/)
 {
     vkDevice = device;
 
+    if (STexture2D::HasExtension(fileName, ".ktx2")) {
+        LoadFromKTX2(fileName, device, copyQueue);
+        return;
+    }
+
+    TextureSampler loadingSampler;
+    loadingSampler.magFilter = VK_FILTER_LINEAR;
+    loadingSampler.minFilter = VK_FILTER_LINEAR;
+    loadingSampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    loadingSampler.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    loadingSampler.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+
+    if (loadHDR) {
+        // Mapped pages are read once by the decoder, the file never turns into a float image in memory
+        MappedFile file;
+        if (file.Open(fileName) && RadianceHDR::IsRadianceHDR(file.GetData(), file.GetSize())) {
+            LoadFromRadianceHDR(file.GetData(), file.GetSize(), device, copyQueue, hdrFormat, loadingSampler, hdrRowVisitor);
+            return;
+        }
+    }
+
     int imageWidth, imageHeight, nrComponents;
     void* data;
     if (loadHDR) {
         stbi_set_flip_vertically_on_load(true);
-        data = stbi_loadf(fileName.c_str(), &imageWidth, &imageHeight, &nrComponents, 0);
+        data = stbi_loadf(fileName.c_str(), &imageWidth, &imageHeight, &nrComponents, STBI_rgb);
         stbi_set_flip_vertically_on_load(false);
     } else {
-        data = stbi_load(fileName.c_str(), &imageWidth, &imageHeight, &nrComponents, 0);
+        // Images are always uploaded as RGBA8, whatever the number of channels in the file
+        data = stbi_load(fileName.c_str(), &imageWidth, &imageHeight, &nrComponents, STBI_rgb_alpha);
     }
 
     if (data) {
         width = static_cast<uint32_t>(imageWidth);
         height = static_cast<uint32_t>(imageHeight);
-        uint32_t imageSize = 0;
 
         if (loadHDR) {
-            imageSize = width * height * 3 * sizeof(float);
-
-            TextureSampler loadingSampler;
-            loadingSampler.magFilter = VK_FILTER_LINEAR;
-            loadingSampler.minFilter = VK_FILTER_LINEAR;
-            loadingSampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-            loadingSampler.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-            loadingSampler.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-
-            FromBuffer(data, imageSize, VK_FORMAT_R32G32B32_SFLOAT, width, height, device,
-                copyQueue, VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-                VK_IMAGE_TILING_LINEAR, loadingSampler);
+            FromHDRPixels(static_cast<const float*>(data), width, height, device, copyQueue, hdrFormat, loadingSampler, hdrRowVisitor);
         } else {
-            imageSize = width * height * 4 * sizeof(unsigned char);
-            FromBuffer(data, imageSize, VK_FORMAT_R8G8B8A8_UNORM, width, height, device, copyQueue);
+            const uint32_t imageSize = width * height * 4 * sizeof(unsigned char);
+
+            // Mip chain is blitted on the GPU right after the upload
+            UploadBatcher uploadBatcher(device, copyQueue, imageSize);
+            FromBuffer(data, imageSize, VK_FORMAT_R8G8B8A8_UNORM, width, height, 1, device, uploadBatcher, loadingSampler, true);
+            uploadBatcher.Flush();
         }
 
         stbi_image_free(data);
@@ -49,6 +209,115 @@ void CG::Vk::Texture2D::LoadFromFile(const std::string& fileName, Device* device
     }
 }
 
+void CG::Vk::Texture2D::LoadFromKTX2(const std::string& fileName, Device* device, VkQueue copyQueue)
+{
+    MappedFile file;
+    if (!file.Open(fileName)) {
+        throw AssetLoadingException("Failed to open KTX2 texture!");
+    }
+
+    KTX2::Image ktxImage;
+    std::string error;
+    if (!KTX2::Parse(file.GetData(), file.GetSize(), ktxImage, error)) {
+        std::cout << "Failed to load " << fileName << ": " << error << std::endl;
+        throw AssetLoadingException("Failed to load KTX2 texture!");
+    }
+
+    TextureSampler loadingSampler;
+    loadingSampler.magFilter = VK_FILTER_LINEAR;
+    loadingSampler.minFilter = VK_FILTER_LINEAR;
+    loadingSampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    loadingSampler.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    loadingSampler.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+
+    const std::vector<uint8_t> mipChain = KTX2::GetMipChain(ktxImage);
+
+    UploadBatcher uploadBatcher(device, copyQueue, mipChain.size());
+    FromBuffer(mipChain.data(), mipChain.size(), ktxImage.format, ktxImage.width, ktxImage.height,
+        static_cast<uint16_t>(ktxImage.levels.size()), device, uploadBatcher, loadingSampler, ktxImage.generateMips);
+    uploadBatcher.Flush();
+}
+
+void CG::Vk::Texture2D::LoadFromRadianceHDR(const uint8_t* data, size_t size, Device* device, VkQueue copyQueue, eHDRFormat hdrFormat,
+    const TextureSampler& textureSampler, const HDRRowVisitor& hdrRowVisitor)
+{
+    RadianceHDR::Header header;
+    std::string error;
+    if (!RadianceHDR::ParseHeader(data, size, header, error)) {
+        std::cout << "Failed to load HDR image: " << error << std::endl;
+        throw AssetLoadingException("Failed to load image! Make sure that it has RGBE or RGB format!");
+    }
+
+    RadianceHDR::ScanlineDecoder decoder(data, size, header);
+    const auto readRow = [&decoder, &error](float* row) {
+        if (!decoder.DecodeScanline(row, error)) {
+            std::cout << "Failed to load HDR image: " << error << std::endl;
+            throw AssetLoadingException("Failed to decode HDR image!");
+        }
+    };
+
+    UploadHDRRows(header.width, header.height, device, copyQueue, hdrFormat, textureSampler, readRow, hdrRowVisitor);
+}
+
+void CG::Vk::Texture2D::FromHDRPixels(const float* pixels, uint32_t texWidth, uint32_t texHeight, Device* device, VkQueue copyQueue,
+    eHDRFormat hdrFormat, const TextureSampler& textureSampler, const HDRRowVisitor& hdrRowVisitor /*= nullptr*/)
+{
+    // Pixels are stored bottom up, rows are read from the top as a decoder would produce them
+    const size_t rowSize = static_cast<size_t>(texWidth) * 3;
+    const float* src = pixels + rowSize * texHeight;
+    const auto readRow = [&src, rowSize](float* row) {
+        src -= rowSize;
+        memcpy(row, src, rowSize * sizeof(float));
+    };
+
+    UploadHDRRows(texWidth, texHeight, device, copyQueue, hdrFormat, textureSampler, readRow, hdrRowVisitor);
+}
+
+void CG::Vk::Texture2D::UploadHDRRows(uint32_t texWidth, uint32_t texHeight, Device* device, VkQueue copyQueue, eHDRFormat hdrFormat,
+    const TextureSampler& textureSampler, const std::function<void(float* row)>& readRow, const HDRRowVisitor& hdrRowVisitor)
+{
+    vkDevice = device;
+    width = texWidth;
+    height = texHeight;
+    mipLevels = MipGenerator::GetMipLevelsCount(width, height);
+    imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    const VkFormat format = hdrFormat == eHDRFormat::kHalf ? VK_FORMAT_R16G16B16A16_SFLOAT : VK_FORMAT_E5B9G9R9_UFLOAT_PACK32;
+    const VkDeviceSize chainSize = GetMipChainSize(format, width, height, mipLevels);
+
+    CreateImage(format, VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_TILING_OPTIMAL);
+
+    VkImageSubresourceRange subresourceRange = {};
+    subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    subresourceRange.baseMipLevel = 0;
+    subresourceRange.levelCount = mipLevels;
+    subresourceRange.layerCount = 1;
+
+    UploadBatcher uploadBatcher(device, copyQueue, std::min(chainSize, STexture2D::kHDRStagingSize));
+    uploadBatcher.TransitionImage(image, subresourceRange, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+    // Every row is packed into level 0 and box filtered into the smaller levels right away, only one float row of level 0
+    // and a few rows of every other level are alive at once
+    STexture2D::HDRChainWriter chainWriter(image, format, width, height, mipLevels, uploadBatcher);
+    std::vector<float> row(static_cast<size_t>(width) * 3);
+
+    for (uint32_t y = height; y-- > 0;) {
+        readRow(row.data());
+        if (hdrRowVisitor) {
+            hdrRowVisitor(width, height, y, row.data());
+        }
+        chainWriter.AddRow(0, y, row.data());
+    }
+    chainWriter.Finish();
+
+    uploadBatcher.TransitionImage(image, subresourceRange, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, imageLayout);
+    uploadBatcher.Flush();
+
+    CreateSamplerAndView(format, textureSampler);
+
+    UpdateDescriptor();
+}
+
 void CG::Vk::Texture2D::FromBuffer(
     const void* buffer,
     VkDeviceSize bufferSize,
@@ -104,29 +373,7 @@ void CG::Vk::Texture2D::FromBuffer(
     bufferCopyRegion.imageExtent.depth = 1;
     bufferCopyRegion.bufferOffset = 0;
 
-    VkImageCreateInfo imageCreateInfo = Initializers::ImageCreateInfo();
-    imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-    imageCreateInfo.format = format;
-    imageCreateInfo.mipLevels = mipLevels;
-    imageCreateInfo.arrayLayers = 1;
-    imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-    imageCreateInfo.tiling = imageTiling;
-    imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    imageCreateInfo.extent = { width, height, 1 };
-    imageCreateInfo.usage = imageUsageFlags;
-    if (!(imageCreateInfo.usage & VK_IMAGE_USAGE_TRANSFER_DST_BIT)) {
-        imageCreateInfo.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-    }
-    VK_CHECK_RESULT(vkCreateImage(vkDevice->logicalDevice, &imageCreateInfo, nullptr, &image));
-
-    vkGetImageMemoryRequirements(vkDevice->logicalDevice, image, &memReqs);
-
-    memAllocInfo.allocationSize = memReqs.size;
-
-    memAllocInfo.memoryTypeIndex = vkDevice->GetMemoryTypeIndex(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    VK_CHECK_RESULT(vkAllocateMemory(vkDevice->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-    VK_CHECK_RESULT(vkBindImageMemory(vkDevice->logicalDevice, image, deviceMemory, 0));
+    CreateImage(format, imageUsageFlags, imageTiling);
 
     VkImageSubresourceRange subresourceRange = {};
     subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -160,6 +407,160 @@ void CG::Vk::Texture2D::FromBuffer(
     vkFreeMemory(vkDevice->logicalDevice, stagingMemory, nullptr);
     vkDestroyBuffer(vkDevice->logicalDevice, stagingBuffer, nullptr);
 
+    CreateSamplerAndView(format, textureSampler);
+
+    UpdateDescriptor();
+}
+
+void CG::Vk::Texture2D::FromBuffer(
+    const void* buffer,
+    VkDeviceSize bufferSize,
+    VkFormat format,
+    uint32_t texWidth,
+    uint32_t texHeight,
+    uint16_t levelsCount,
+    Device* device,
+    UploadBatcher& uploadBatcher,
+    TextureSampler textureSampler,
+    bool generateMips /*= false*/)
+{
+    vkDevice = device;
+    width = texWidth;
+    height = texHeight;
+    mipLevels = levelsCount;
+    imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkImageUsageFlags imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT;
+
+    const uint16_t fullLevelsCount = MipGenerator::GetMipLevelsCount(width, height);
+    generateMips = generateMips && levelsCount < fullLevelsCount && SupportsMipBlits(device, format);
+    if (generateMips) {
+        mipLevels = fullLevelsCount;
+        imageUsageFlags |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
+
+    CreateImage(format, imageUsageFlags, VK_IMAGE_TILING_OPTIMAL);
+
+    VkImageSubresourceRange subresourceRange = {};
+    subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    subresourceRange.baseMipLevel = 0;
+    subresourceRange.levelCount = mipLevels;
+    subresourceRange.layerCount = 1;
+
+    uploadBatcher.TransitionImage(image, subresourceRange, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+    const uint8_t* levelData = static_cast<const uint8_t*>(buffer);
+    const uint8_t* bufferEnd = levelData + bufferSize;
+    for (uint32_t level = 0; level < levelsCount; ++level) {
+        const uint32_t levelWidth = std::max(width >> level, 1u);
+        const uint32_t levelHeight = std::max(height >> level, 1u);
+        const VkDeviceSize levelSize = GetLevelSize(format, levelWidth, levelHeight);
+
+        if (levelData + levelSize > bufferEnd) {
+            throw AssetLoadingException("Texture buffer is smaller than its mip chain!");
+        }
+
+        uploadBatcher.UploadImage(image, level, levelWidth, levelHeight, levelData, levelSize, IsBlockCompressed(format) ? 4 : 1);
+        levelData += levelSize;
+    }
+
+    if (generateMips) {
+        uploadBatcher.GenerateMipChain(image, width, height, levelsCount - 1, mipLevels, imageLayout);
+    } else {
+        uploadBatcher.TransitionImage(image, subresourceRange, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, imageLayout);
+    }
+
+    CreateSamplerAndView(format, textureSampler);
+
+    UpdateDescriptor();
+}
+
+VkDeviceSize CG::Vk::Texture2D::GetLevelSize(VkFormat format, uint32_t levelWidth, uint32_t levelHeight)
+{
+    const VkDeviceSize pixelsCount = static_cast<VkDeviceSize>(levelWidth) * levelHeight;
+
+    switch (format) {
+    case VK_FORMAT_R32G32B32A32_SFLOAT:
+        return pixelsCount * 16;
+    case VK_FORMAT_R32G32B32_SFLOAT:
+        return pixelsCount * 12;
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+        return pixelsCount * 8;
+    case VK_FORMAT_E5B9G9R9_UFLOAT_PACK32:
+        return pixelsCount * 4;
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        return STexture2D::GetBlocksCount(levelWidth, levelHeight) * 8;
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+        return STexture2D::GetBlocksCount(levelWidth, levelHeight) * 16;
+    default:
+        return pixelsCount * 4;
+    }
+}
+
+VkDeviceSize CG::Vk::Texture2D::GetMipChainSize(VkFormat format, uint32_t texWidth, uint32_t texHeight, uint16_t levelsCount)
+{
+    VkDeviceSize chainSize = 0;
+    for (uint32_t level = 0; level < levelsCount; ++level) {
+        chainSize += GetLevelSize(format, std::max(texWidth >> level, 1u), std::max(texHeight >> level, 1u));
+    }
+    return chainSize;
+}
+
+bool CG::Vk::Texture2D::IsBlockCompressed(VkFormat format)
+{
+    switch (format) {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool CG::Vk::Texture2D::SupportsMipBlits(const Device* device, VkFormat format)
+{
+    VkFormatProperties formatProperties = {};
+    vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
+
+    const VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT
+        | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    return (formatProperties.optimalTilingFeatures & requiredFeatures) == requiredFeatures;
+}
+
+void CG::Vk::Texture2D::CreateImage(VkFormat format, VkImageUsageFlags imageUsageFlags, VkImageTiling imageTiling)
+{
+    VkImageCreateInfo imageCreateInfo = Initializers::ImageCreateInfo();
+    imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageCreateInfo.format = format;
+    imageCreateInfo.mipLevels = mipLevels;
+    imageCreateInfo.arrayLayers = 1;
+    imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageCreateInfo.tiling = imageTiling;
+    imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageCreateInfo.extent = { width, height, 1 };
+    imageCreateInfo.usage = imageUsageFlags;
+    if (!(imageCreateInfo.usage & VK_IMAGE_USAGE_TRANSFER_DST_BIT)) {
+        imageCreateInfo.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    }
+    VK_CHECK_RESULT(vkCreateImage(vkDevice->logicalDevice, &imageCreateInfo, nullptr, &image));
+
+    VkMemoryRequirements memReqs;
+    vkGetImageMemoryRequirements(vkDevice->logicalDevice, image, &memReqs);
+
+    VkMemoryAllocateInfo memAllocInfo = Initializers::MemoryAllocateInfo();
+    memAllocInfo.allocationSize = memReqs.size;
+    memAllocInfo.memoryTypeIndex = vkDevice->GetMemoryTypeIndex(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    VK_CHECK_RESULT(vkAllocateMemory(vkDevice->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
+    VK_CHECK_RESULT(vkBindImageMemory(vkDevice->logicalDevice, image, deviceMemory, 0));
+}
+
+void CG::Vk::Texture2D::CreateSamplerAndView(VkFormat format, const TextureSampler& textureSampler)
+{
     VkSamplerCreateInfo samplerCreateInfo = {};
     samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
     samplerCreateInfo.magFilter = textureSampler.magFilter;
@@ -171,7 +572,7 @@ void CG::Vk::Texture2D::FromBuffer(
     samplerCreateInfo.mipLodBias = 0.0f;
     samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
     samplerCreateInfo.minLod = 0.0f;
-    samplerCreateInfo.maxLod = 0.0f;
+    samplerCreateInfo.maxLod = static_cast<float>(mipLevels - 1);
     samplerCreateInfo.maxAnisotropy = 1.0f;
     VK_CHECK_RESULT(vkCreateSampler(vkDevice->logicalDevice, &samplerCreateInfo, nullptr, &sampler));
 
@@ -182,9 +583,7 @@ void CG::Vk::Texture2D::FromBuffer(
     viewCreateInfo.format = format;
     viewCreateInfo.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
     viewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-    viewCreateInfo.subresourceRange.levelCount = 1;
+    viewCreateInfo.subresourceRange.levelCount = mipLevels;
     viewCreateInfo.image = image;
     VK_CHECK_RESULT(vkCreateImageView(vkDevice->logicalDevice, &viewCreateInfo, nullptr, &view));
-
-    UpdateDescriptor();
 }
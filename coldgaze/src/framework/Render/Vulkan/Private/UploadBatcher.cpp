@@ -0,0 +1,281 @@
+#include "Render/Vulkan/UploadBatcher.hpp"
+#include "Render/Vulkan/Debug.hpp"
+#include "Render/Vulkan/Device.hpp"
+#include "Render/Vulkan/Initializers.hpp"
+#include "Render/Vulkan/Utils.hpp"
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+
+namespace SUploadBatcher {
+// Keeps every staging range aligned, so copies never straddle odd offsets.
+// Also satisfies buffer to image copies of every 1, 2, 4, 8 and 16 bytes texel or block format
+constexpr VkDeviceSize kStagingAlignment = 16;
+
+VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+}
+
+CG::Vk::UploadBatcher::UploadBatcher(Device* aVkDevice, VkQueue aQueue, VkDeviceSize stagingSize /*= kDefaultStagingSize*/)
+    : vkDevice(aVkDevice)
+    , queue(aQueue)
+{
+    VK_CHECK_RESULT(vkDevice->CreateBuffer(
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        &staging,
+        stagingSize));
+
+    // Staging ring stays mapped for the whole batcher lifetime
+    VK_CHECK_RESULT(staging.Map());
+
+    VkFenceCreateInfo fenceInfo = Initializers::FenceCreateInfo(VK_FLAGS_NONE);
+    VK_CHECK_RESULT(vkCreateFence(vkDevice->logicalDevice, &fenceInfo, nullptr, &fence));
+
+    cmdBuffer = vkDevice->CreateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, false);
+}
+
+CG::Vk::UploadBatcher::~UploadBatcher()
+{
+    Flush();
+
+    vkFreeCommandBuffers(vkDevice->logicalDevice, vkDevice->GetCommandPool(), 1, &cmdBuffer);
+    vkDestroyFence(vkDevice->logicalDevice, fence, nullptr);
+
+    staging.Unmap();
+    staging.Destroy();
+}
+
+void CG::Vk::UploadBatcher::Upload(const Buffer& dstBuffer, const void* data, VkDeviceSize dataSize, VkDeviceSize dstOffset /*= 0*/)
+{
+    if (dataSize == 0) {
+        return;
+    }
+
+    if (pendingBytes == 0 && !recording) {
+        uploadStart = std::chrono::high_resolution_clock::now();
+    }
+
+    const uint8_t* src = static_cast<const uint8_t*>(data);
+
+    // Buffers bigger than the ring are streamed through it in several chunks
+    while (dataSize > 0) {
+        const VkDeviceSize chunkSize = std::min(dataSize, staging.size);
+        const VkDeviceSize srcOffset = AllocateStaging(chunkSize);
+
+        memcpy(static_cast<uint8_t*>(staging.mapped) + srcOffset, src, chunkSize);
+
+        VkBufferCopy copyRegion = {};
+        copyRegion.srcOffset = srcOffset;
+        copyRegion.dstOffset = dstOffset;
+        copyRegion.size = chunkSize;
+        vkCmdCopyBuffer(cmdBuffer, staging.buffer, dstBuffer.buffer, 1, &copyRegion);
+
+        pendingBytes += chunkSize;
+        src += chunkSize;
+        dstOffset += chunkSize;
+        dataSize -= chunkSize;
+    }
+}
+
+void CG::Vk::UploadBatcher::TransitionImage(
+    VkImage image, const VkImageSubresourceRange& subresourceRange, VkImageLayout oldLayout, VkImageLayout newLayout)
+{
+    BeginRecording();
+
+    Utils::SetImageLayout(cmdBuffer, image, oldLayout, newLayout, subresourceRange);
+}
+
+void CG::Vk::UploadBatcher::UploadImage(VkImage image, uint32_t mipLevel, uint32_t width, uint32_t height, const void* data,
+    VkDeviceSize dataSize, uint32_t blockHeight /*= 1*/)
+{
+    if (dataSize == 0) {
+        return;
+    }
+
+    if (pendingBytes == 0 && !recording) {
+        uploadStart = std::chrono::high_resolution_clock::now();
+    }
+
+    const uint8_t* src = static_cast<const uint8_t*>(data);
+
+    // Level is split by rows of blocks, as many of them as the ring can hold at once
+    const uint32_t blockRowsCount = (height + blockHeight - 1) / blockHeight;
+    const VkDeviceSize blockRowSize = dataSize / blockRowsCount;
+    const uint32_t blockRowsPerChunk = static_cast<uint32_t>(std::max(staging.size / blockRowSize, VkDeviceSize(1)));
+
+    for (uint32_t blockRow = 0; blockRow < blockRowsCount; blockRow += blockRowsPerChunk) {
+        const uint32_t chunkBlockRows = std::min(blockRowsPerChunk, blockRowsCount - blockRow);
+        const VkDeviceSize chunkSize = chunkBlockRows * blockRowSize;
+        const VkDeviceSize srcOffset = AllocateStaging(chunkSize);
+
+        memcpy(static_cast<uint8_t*>(staging.mapped) + srcOffset, src + blockRow * blockRowSize, chunkSize);
+
+        const uint32_t firstRow = blockRow * blockHeight;
+        RecordImageCopy(image, mipLevel, srcOffset, width, firstRow, std::min(chunkBlockRows * blockHeight, height - firstRow));
+
+        pendingBytes += chunkSize;
+    }
+}
+
+void* CG::Vk::UploadBatcher::ReserveImageRows(
+    VkImage image, uint32_t mipLevel, uint32_t width, uint32_t firstRow, uint32_t rowsCount, VkDeviceSize rowSize)
+{
+    if (pendingBytes == 0 && !recording) {
+        uploadStart = std::chrono::high_resolution_clock::now();
+    }
+
+    const VkDeviceSize dataSize = rowSize * rowsCount;
+    assert(dataSize <= staging.size);
+
+    const VkDeviceSize srcOffset = AllocateStaging(dataSize);
+    RecordImageCopy(image, mipLevel, srcOffset, width, firstRow, rowsCount);
+
+    pendingBytes += dataSize;
+    return static_cast<uint8_t*>(staging.mapped) + srcOffset;
+}
+
+void CG::Vk::UploadBatcher::GenerateMipChain(VkImage image, uint32_t width, uint32_t height, uint32_t baseLevel, uint32_t levelsCount,
+    VkImageLayout finalLayout)
+{
+    BeginRecording();
+
+    VkImageSubresourceRange subresourceRange = {};
+    subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    subresourceRange.baseMipLevel = 0;
+    subresourceRange.levelCount = baseLevel;
+    subresourceRange.layerCount = 1;
+
+    // Uploaded levels before the base one don't take part in blits
+    if (baseLevel > 0) {
+        Utils::SetImageLayout(cmdBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, finalLayout, subresourceRange);
+    }
+
+    subresourceRange.levelCount = 1;
+
+    for (uint32_t level = baseLevel + 1; level < levelsCount; ++level) {
+        subresourceRange.baseMipLevel = level - 1;
+        Utils::SetImageLayout(cmdBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, subresourceRange,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+        VkImageBlit blit = {};
+        blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1 };
+        blit.srcOffsets[1] = { static_cast<int32_t>(std::max(width >> (level - 1), 1u)), static_cast<int32_t>(std::max(height >> (level - 1), 1u)), 1 };
+        blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+        blit.dstOffsets[1] = { static_cast<int32_t>(std::max(width >> level, 1u)), static_cast<int32_t>(std::max(height >> level, 1u)), 1 };
+        vkCmdBlitImage(cmdBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+        // Source level is complete once its blit is done
+        Utils::SetImageLayout(cmdBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, finalLayout, subresourceRange);
+    }
+
+    subresourceRange.baseMipLevel = levelsCount - 1;
+    Utils::SetImageLayout(cmdBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, finalLayout, subresourceRange);
+}
+
+void CG::Vk::UploadBatcher::Flush()
+{
+    if (!recording) {
+        return;
+    }
+
+    SubmitAndWait();
+
+    const float seconds = std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - uploadStart).count();
+    const float megabytes = static_cast<float>(pendingBytes) / (1024.0f * 1024.0f);
+
+    std::cout << "Uploaded " << megabytes << " MB in " << submitsCount << " submit(s), "
+              << (seconds > 0.0f ? megabytes / seconds : 0.0f) << " MB/s" << std::endl;
+
+    uploadedBytes += pendingBytes;
+    pendingBytes = 0;
+    submitsCount = 0;
+}
+
+VkDeviceSize CG::Vk::UploadBatcher::GetUploadedBytes() const
+{
+    return uploadedBytes + pendingBytes;
+}
+
+VkDeviceSize CG::Vk::UploadBatcher::GetStagingSize() const
+{
+    return staging.size;
+}
+
+void CG::Vk::UploadBatcher::RecordImageCopy(
+    VkImage image, uint32_t mipLevel, VkDeviceSize srcOffset, uint32_t width, uint32_t firstRow, uint32_t rowsCount)
+{
+    VkBufferImageCopy copyRegion = {};
+    copyRegion.bufferOffset = srcOffset;
+    copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    copyRegion.imageSubresource.mipLevel = mipLevel;
+    copyRegion.imageSubresource.baseArrayLayer = 0;
+    copyRegion.imageSubresource.layerCount = 1;
+    copyRegion.imageOffset = { 0, static_cast<int32_t>(firstRow), 0 };
+    copyRegion.imageExtent = { width, rowsCount, 1 };
+    vkCmdCopyBufferToImage(cmdBuffer, staging.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+}
+
+VkDeviceSize CG::Vk::UploadBatcher::AllocateStaging(VkDeviceSize allocationSize)
+{
+    VkDeviceSize offset = SUploadBatcher::AlignUp(stagingOffset, SUploadBatcher::kStagingAlignment);
+
+    // Ring is exhausted, so the GPU has to consume recorded copies before we can overwrite staging memory
+    if (offset + allocationSize > staging.size) {
+        SubmitAndWait();
+        offset = 0;
+    }
+
+    if (!recording) {
+        BeginCommandBuffer();
+    }
+
+    stagingOffset = offset + allocationSize;
+    return offset;
+}
+
+void CG::Vk::UploadBatcher::BeginRecording()
+{
+    if (!recording) {
+        if (pendingBytes == 0) {
+            uploadStart = std::chrono::high_resolution_clock::now();
+        }
+        BeginCommandBuffer();
+    }
+}
+
+void CG::Vk::UploadBatcher::BeginCommandBuffer()
+{
+    VkCommandBufferBeginInfo cmdBufInfo = Initializers::CommandBufferBeginInfo();
+    cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &cmdBufInfo));
+
+    recording = true;
+}
+
+void CG::Vk::UploadBatcher::SubmitAndWait()
+{
+    if (!recording) {
+        return;
+    }
+
+    VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
+
+    VkSubmitInfo submitInfo = Initializers::SubmitInfo();
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &cmdBuffer;
+
+    {
+        std::lock_guard<std::mutex> lock(vkDevice->deviceQueueMutex);
+        VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, fence));
+    }
+    VK_CHECK_RESULT(vkWaitForFences(vkDevice->logicalDevice, 1, &fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
+    VK_CHECK_RESULT(vkResetFences(vkDevice->logicalDevice, 1, &fence));
+    VK_CHECK_RESULT(vkResetCommandBuffer(cmdBuffer, 0));
+
+    recording = false;
+    stagingOffset = 0;
+    ++submitsCount;
+}
@@ -0,0 +1,394 @@
+#include "Render/Vulkan/VertexKernels.hpp"
+#include <atomic>
+#include <cmath>
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define CG_VERTEX_KERNELS_SSE2 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang only emit AVX2 instructions inside of functions marked for it, MSVC accepts intrinsics everywhere
+#if defined(CG_VERTEX_KERNELS_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#define CG_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CG_TARGET_AVX2
+#endif
+
+using eInstructionSet = CG::Vk::VertexKernels::eInstructionSet;
+
+namespace SVertexKernels {
+std::atomic<eInstructionSet> currentInstructionSet { CG::Vk::VertexKernels::GetSupportedInstructionSet() };
+
+const uint8_t* Advance(const void* ptr, size_t offset)
+{
+    return static_cast<const uint8_t*>(ptr) + offset;
+}
+
+uint8_t* Advance(void* ptr, size_t offset)
+{
+    return static_cast<uint8_t*>(ptr) + offset;
+}
+
+eInstructionSet DetectInstructionSet()
+{
+#if defined(CG_VERTEX_KERNELS_SSE2)
+#if defined(_MSC_VER)
+    int info[4] = {};
+    __cpuid(info, 0);
+    const int maxLeaf = info[0];
+
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+
+    bool avx2 = false;
+    if (maxLeaf >= 7) {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+    }
+
+    // OS has to save YMM registers on context switch too
+    if (osxsave && avx && avx2 && (_xgetbv(0) & 0x6) == 0x6) {
+        return eInstructionSet::kAVX2;
+    }
+#else
+    if (__builtin_cpu_supports("avx2")) {
+        return eInstructionSet::kAVX2;
+    }
+#endif
+    return eInstructionSet::kSSE2;
+#else
+    return eInstructionSet::kScalar;
+#endif
+}
+
+// Scalar versions, also used for tails of vectorized loops
+
+void ConvertPositionsScalar(const void* src, size_t srcStride, size_t count, void* dst, size_t dstStride)
+{
+    for (size_t i = 0; i < count; ++i) {
+        const float* s = reinterpret_cast<const float*>(Advance(src, i * srcStride));
+        float* d = reinterpret_cast<float*>(Advance(dst, i * dstStride));
+        d[0] = s[0];
+        d[1] = s[1];
+        d[2] = s[2];
+        d[3] = 1.0f;
+    }
+}
+
+void ConvertNormalsScalar(const void* src, size_t srcStride, size_t count, void* dst, size_t dstStride)
+{
+    for (size_t i = 0; i < count; ++i) {
+        const float* s = reinterpret_cast<const float*>(Advance(src, i * srcStride));
+        float* d = reinterpret_cast<float*>(Advance(dst, i * dstStride));
+
+        const float lengthSq = s[0] * s[0] + s[1] * s[1] + s[2] * s[2];
+        const float invLength = lengthSq > 0.0f ? 1.0f / std::sqrt(lengthSq) : 0.0f;
+        d[0] = s[0] * invLength;
+        d[1] = s[1] * invLength;
+        d[2] = s[2] * invLength;
+        d[3] = 1.0f;
+    }
+}
+
+void ConvertTexCoordsScalar(const void* uv0Src, size_t uv0Stride, const void* uv1Src, size_t uv1Stride,
+    size_t count, void* dst, size_t dstStride)
+{
+    for (size_t i = 0; i < count; ++i) {
+        float* d = reinterpret_cast<float*>(Advance(dst, i * dstStride));
+        const float* uv0 = uv0Src ? reinterpret_cast<const float*>(Advance(uv0Src, i * uv0Stride)) : nullptr;
+        const float* uv1 = uv1Src ? reinterpret_cast<const float*>(Advance(uv1Src, i * uv1Stride)) : nullptr;
+        d[0] = uv0 ? uv0[0] : 0.0f;
+        d[1] = uv0 ? uv0[1] : 0.0f;
+        d[2] = uv1 ? uv1[0] : 0.0f;
+        d[3] = uv1 ? uv1[1] : 0.0f;
+    }
+}
+
+template <typename T>
+void WidenIndicesScalar(const T* src, size_t count, uint32_t* dst)
+{
+    for (size_t i = 0; i < count; ++i) {
+        dst[i] = src[i];
+    }
+}
+
+#if defined(CG_VERTEX_KERNELS_SSE2)
+
+// Every 16 byte load of a float3 reads 4 bytes of the next element, so the last element is always converted by the scalar code
+
+void ConvertPositionsSSE2(const void* src, size_t srcStride, size_t count, void* dst, size_t dstStride)
+{
+    if (count == 0) {
+        return;
+    }
+
+    const __m128 xyzMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+    const __m128 wOne = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+
+    const size_t vectorCount = count - 1;
+    for (size_t i = 0; i < vectorCount; ++i) {
+        const __m128 v = _mm_loadu_ps(reinterpret_cast<const float*>(Advance(src, i * srcStride)));
+        _mm_storeu_ps(reinterpret_cast<float*>(Advance(dst, i * dstStride)), _mm_or_ps(_mm_and_ps(v, xyzMask), wOne));
+    }
+
+    ConvertPositionsScalar(Advance(src, vectorCount * srcStride), srcStride, 1, Advance(dst, vectorCount * dstStride), dstStride);
+}
+
+// Four normals are transposed into SoA, normalized and transposed back
+void ConvertNormalsSSE2(const void* src, size_t srcStride, size_t count, void* dst, size_t dstStride)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    size_t i = 0;
+    for (; i + 4 < count; i += 4) {
+        __m128 x = _mm_loadu_ps(reinterpret_cast<const float*>(Advance(src, (i + 0) * srcStride)));
+        __m128 y = _mm_loadu_ps(reinterpret_cast<const float*>(Advance(src, (i + 1) * srcStride)));
+        __m128 z = _mm_loadu_ps(reinterpret_cast<const float*>(Advance(src, (i + 2) * srcStride)));
+        __m128 w = _mm_loadu_ps(reinterpret_cast<const float*>(Advance(src, (i + 3) * srcStride)));
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+
+        const __m128 lengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+        const __m128 invLength = _mm_and_ps(_mm_div_ps(one, _mm_sqrt_ps(lengthSq)), _mm_cmpgt_ps(lengthSq, zero));
+
+        x = _mm_mul_ps(x, invLength);
+        y = _mm_mul_ps(y, invLength);
+        z = _mm_mul_ps(z, invLength);
+        w = one;
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+
+        _mm_storeu_ps(reinterpret_cast<float*>(Advance(dst, (i + 0) * dstStride)), x);
+        _mm_storeu_ps(reinterpret_cast<float*>(Advance(dst, (i + 1) * dstStride)), y);
+        _mm_storeu_ps(reinterpret_cast<float*>(Advance(dst, (i + 2) * dstStride)), z);
+        _mm_storeu_ps(reinterpret_cast<float*>(Advance(dst, (i + 3) * dstStride)), w);
+    }
+
+    ConvertNormalsScalar(Advance(src, i * srcStride), srcStride, count - i, Advance(dst, i * dstStride), dstStride);
+}
+
+void ConvertTexCoordsSSE2(const void* uv0Src, size_t uv0Stride, const void* uv1Src, size_t uv1Stride,
+    size_t count, void* dst, size_t dstStride)
+{
+    const __m128 zero = _mm_setzero_ps();
+
+    for (size_t i = 0; i < count; ++i) {
+        const __m128 uv0 = uv0Src ? _mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(Advance(uv0Src, i * uv0Stride)))) : zero;
+        const __m128 uv1 = uv1Src ? _mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(Advance(uv1Src, i * uv1Stride)))) : zero;
+        _mm_storeu_ps(reinterpret_cast<float*>(Advance(dst, i * dstStride)), _mm_movelh_ps(uv0, uv1));
+    }
+}
+
+void WidenIndicesSSE2(const uint8_t* src, size_t count, uint32_t* dst)
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        const __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+        const __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 0), _mm_unpacklo_epi16(lo, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), _mm_unpackhi_epi16(lo, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8), _mm_unpacklo_epi16(hi, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 12), _mm_unpackhi_epi16(hi, zero));
+    }
+
+    WidenIndicesScalar(src + i, count - i, dst + i);
+}
+
+void WidenIndicesSSE2(const uint16_t* src, size_t count, uint32_t* dst)
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i shorts = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 0), _mm_unpacklo_epi16(shorts, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), _mm_unpackhi_epi16(shorts, zero));
+    }
+
+    WidenIndicesScalar(src + i, count - i, dst + i);
+}
+
+// Eight normals are gathered straight into SoA registers, so no transpose is needed on the way in
+CG_TARGET_AVX2 void ConvertNormalsAVX2(const void* src, size_t srcStride, size_t count, void* dst, size_t dstStride)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const int stride = static_cast<int>(srcStride);
+    const __m256i offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(stride));
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const float* base = reinterpret_cast<const float*>(Advance(src, i * srcStride));
+        __m256 x = _mm256_i32gather_ps(base + 0, offsets, 1);
+        __m256 y = _mm256_i32gather_ps(base + 1, offsets, 1);
+        __m256 z = _mm256_i32gather_ps(base + 2, offsets, 1);
+
+        const __m256 lengthSq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z));
+        const __m256 invLength = _mm256_and_ps(_mm256_div_ps(one, _mm256_sqrt_ps(lengthSq)), _mm256_cmp_ps(lengthSq, zero, _CMP_GT_OQ));
+        x = _mm256_mul_ps(x, invLength);
+        y = _mm256_mul_ps(y, invLength);
+        z = _mm256_mul_ps(z, invLength);
+
+        // SoA -> AoS, every 256 bit register ends up with vertices n and n + 4
+        const __m256 xy0 = _mm256_unpacklo_ps(x, y);
+        const __m256 xy1 = _mm256_unpackhi_ps(x, y);
+        const __m256 zw0 = _mm256_unpacklo_ps(z, one);
+        const __m256 zw1 = _mm256_unpackhi_ps(z, one);
+        const __m256 v04 = _mm256_shuffle_ps(xy0, zw0, _MM_SHUFFLE(1, 0, 1, 0));
+        const __m256 v15 = _mm256_shuffle_ps(xy0, zw0, _MM_SHUFFLE(3, 2, 3, 2));
+        const __m256 v26 = _mm256_shuffle_ps(xy1, zw1, _MM_SHUFFLE(1, 0, 1, 0));
+        const __m256 v37 = _mm256_shuffle_ps(xy1, zw1, _MM_SHUFFLE(3, 2, 3, 2));
+
+        _mm_storeu_ps(reinterpret_cast<float*>(Advance(dst, (i + 0) * dstStride)), _mm256_castps256_ps128(v04));
+        _mm_storeu_ps(reinterpret_cast<float*>(Advance(dst, (i + 1) * dstStride)), _mm256_castps256_ps128(v15));
+        _mm_storeu_ps(reinterpret_cast<float*>(Advance(dst, (i + 2) * dstStride)), _mm256_castps256_ps128(v26));
+        _mm_storeu_ps(reinterpret_cast<float*>(Advance(dst, (i + 3) * dstStride)), _mm256_castps256_ps128(v37));
+        _mm_storeu_ps(reinterpret_cast<float*>(Advance(dst, (i + 4) * dstStride)), _mm256_extractf128_ps(v04, 1));
+        _mm_storeu_ps(reinterpret_cast<float*>(Advance(dst, (i + 5) * dstStride)), _mm256_extractf128_ps(v15, 1));
+        _mm_storeu_ps(reinterpret_cast<float*>(Advance(dst, (i + 6) * dstStride)), _mm256_extractf128_ps(v26, 1));
+        _mm_storeu_ps(reinterpret_cast<float*>(Advance(dst, (i + 7) * dstStride)), _mm256_extractf128_ps(v37, 1));
+    }
+
+    ConvertNormalsSSE2(Advance(src, i * srcStride), srcStride, count - i, Advance(dst, i * dstStride), dstStride);
+}
+
+CG_TARGET_AVX2 void WidenIndicesAVX2(const uint8_t* src, size_t count, uint32_t* dst)
+{
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 0), _mm256_cvtepu8_epi32(bytes));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 8), _mm256_cvtepu8_epi32(_mm_srli_si128(bytes, 8)));
+    }
+
+    WidenIndicesScalar(src + i, count - i, dst + i);
+}
+
+CG_TARGET_AVX2 void WidenIndicesAVX2(const uint16_t* src, size_t count, uint32_t* dst)
+{
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 0));
+        const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 8));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 0), _mm256_cvtepu16_epi32(lo));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 8), _mm256_cvtepu16_epi32(hi));
+    }
+
+    WidenIndicesScalar(src + i, count - i, dst + i);
+}
+
+#endif
+}
+
+eInstructionSet CG::Vk::VertexKernels::GetSupportedInstructionSet()
+{
+    static const eInstructionSet supportedInstructionSet = SVertexKernels::DetectInstructionSet();
+    return supportedInstructionSet;
+}
+
+eInstructionSet CG::Vk::VertexKernels::GetInstructionSet()
+{
+    return SVertexKernels::currentInstructionSet;
+}
+
+void CG::Vk::VertexKernels::SetInstructionSet(eInstructionSet instructionSet)
+{
+    // Never go above what CPU can execute
+    if (instructionSet > GetSupportedInstructionSet()) {
+        instructionSet = GetSupportedInstructionSet();
+    }
+    SVertexKernels::currentInstructionSet = instructionSet;
+}
+
+const char* CG::Vk::VertexKernels::GetInstructionSetName(eInstructionSet instructionSet)
+{
+    switch (instructionSet) {
+    case eInstructionSet::kSSE2:
+        return "SSE2";
+    case eInstructionSet::kAVX2:
+        return "AVX2";
+    default:
+        return "Scalar";
+    }
+}
+
+void CG::Vk::VertexKernels::ConvertPositions(const void* src, size_t srcStride, size_t count, void* dst, size_t dstStride)
+{
+#if defined(CG_VERTEX_KERNELS_SSE2)
+    // Positions are a plain copy, 128 bit lanes already match the vertex layout, so AVX2 has nothing to add
+    if (GetInstructionSet() != eInstructionSet::kScalar) {
+        SVertexKernels::ConvertPositionsSSE2(src, srcStride, count, dst, dstStride);
+        return;
+    }
+#endif
+    SVertexKernels::ConvertPositionsScalar(src, srcStride, count, dst, dstStride);
+}
+
+void CG::Vk::VertexKernels::ConvertNormals(const void* src, size_t srcStride, size_t count, void* dst, size_t dstStride)
+{
+#if defined(CG_VERTEX_KERNELS_SSE2)
+    switch (GetInstructionSet()) {
+    case eInstructionSet::kAVX2:
+        SVertexKernels::ConvertNormalsAVX2(src, srcStride, count, dst, dstStride);
+        return;
+    case eInstructionSet::kSSE2:
+        SVertexKernels::ConvertNormalsSSE2(src, srcStride, count, dst, dstStride);
+        return;
+    default:
+        break;
+    }
+#endif
+    SVertexKernels::ConvertNormalsScalar(src, srcStride, count, dst, dstStride);
+}
+
+void CG::Vk::VertexKernels::ConvertTexCoords(const void* uv0Src, size_t uv0Stride, const void* uv1Src, size_t uv1Stride,
+    size_t count, void* dst, size_t dstStride)
+{
+#if defined(CG_VERTEX_KERNELS_SSE2)
+    if (GetInstructionSet() != eInstructionSet::kScalar) {
+        SVertexKernels::ConvertTexCoordsSSE2(uv0Src, uv0Stride, uv1Src, uv1Stride, count, dst, dstStride);
+        return;
+    }
+#endif
+    SVertexKernels::ConvertTexCoordsScalar(uv0Src, uv0Stride, uv1Src, uv1Stride, count, dst, dstStride);
+}
+
+void CG::Vk::VertexKernels::WidenIndices(const uint8_t* src, size_t count, uint32_t* dst)
+{
+#if defined(CG_VERTEX_KERNELS_SSE2)
+    switch (GetInstructionSet()) {
+    case eInstructionSet::kAVX2:
+        SVertexKernels::WidenIndicesAVX2(src, count, dst);
+        return;
+    case eInstructionSet::kSSE2:
+        SVertexKernels::WidenIndicesSSE2(src, count, dst);
+        return;
+    default:
+        break;
+    }
+#endif
+    SVertexKernels::WidenIndicesScalar(src, count, dst);
+}
+
+void CG::Vk::VertexKernels::WidenIndices(const uint16_t* src, size_t count, uint32_t* dst)
+{
+#if defined(CG_VERTEX_KERNELS_SSE2)
+    switch (GetInstructionSet()) {
+    case eInstructionSet::kAVX2:
+        SVertexKernels::WidenIndicesAVX2(src, count, dst);
+        return;
+    case eInstructionSet::kSSE2:
+        SVertexKernels::WidenIndicesSSE2(src, count, dst);
+        return;
+    default:
+        break;
+    }
+#endif
+    SVertexKernels::WidenIndicesScalar(src, count, dst);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace CG {
+namespace Vk {
+    // Streaming reader of Radiance .hdr files (RGBE, flat or adaptive RLE scanlines), an alternative to stbi_loadf,
+    // which would return the whole float image at once. Only the "-Y height +X width" layout is supported, as in stb_image.
+    namespace RadianceHDR {
+
+        struct Header {
+            uint32_t width = 0;
+            uint32_t height = 0;
+            // Offset of the first scanline in the file
+            size_t pixelsOffset = 0;
+        };
+
+        bool IsRadianceHDR(const uint8_t* data, size_t size);
+
+        // Returns false and describes the reason in error if the file can't be decoded
+        bool ParseHeader(const uint8_t* data, size_t size, Header& header, std::string& error);
+
+        // Decodes scanlines one by one from the top of the image, data has to outlive the decoder
+        class ScanlineDecoder {
+        public:
+            ScanlineDecoder(const uint8_t* data, size_t size, const Header& header);
+
+            // Next scanline as width float RGB texels, values match stbi_loadf.
+            // Returns false and describes the reason in error if the data is truncated or corrupted
+            bool DecodeScanline(float* rgb, std::string& error);
+
+        private:
+            bool ReadRLEScanline(std::string& error);
+            bool ReadFlatScanline(std::string& error);
+
+            const uint8_t* data = nullptr;
+            size_t size = 0;
+            size_t offset = 0;
+            uint32_t width = 0;
+
+            // Old files and narrow images store raw RGBE texels, once such a scanline is met the rest of the file is flat
+            bool flat = false;
+
+            // RGBE texels of the current scanline
+            std::vector<uint8_t> scanline;
+        };
+    }
+}
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include "Render/Vulkan/Buffer.hpp"
+#include "vulkan/vulkan_core.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace CG {
+class ThreadPool;
+
+namespace Vk {
+    class Device;
+
+    enum class eRayTracingApi {
+        // VK_NV_ray_tracing
+        kNV,
+        // VK_KHR_acceleration_structure with VK_KHR_ray_tracing_pipeline
+        kKHR,
+    };
+
+    enum class eAccelerationStructureLevel {
+        kBottom,
+        kTop,
+    };
+
+    struct AccelerationStructure {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        // KHR structures are placed in a buffer, NV ones are bound to memory directly
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkAccelerationStructureNV accelerationStructureNV = VK_NULL_HANDLE;
+        VkAccelerationStructureKHR accelerationStructureKHR = VK_NULL_HANDLE;
+        // Referenced by top level instances, NV handle or KHR device address
+        uint64_t handle = 0;
+        VkDeviceSize memorySize = 0;
+        VkDeviceSize buildScratchSize = 0;
+        VkDeviceSize updateScratchSize = 0;
+    };
+
+    // Indexed opaque triangles of a bottom level
+    struct RayTracingGeometry {
+        VkBuffer vertexBuffer = VK_NULL_HANDLE;
+        VkDeviceSize vertexOffset = 0;
+        uint32_t vertexCount = 0;
+        VkDeviceSize vertexStride = 0;
+        VkFormat vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;
+        VkBuffer indexBuffer = VK_NULL_HANDLE;
+        VkDeviceSize indexOffset = 0;
+        uint32_t indexCount = 0;
+        VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+    };
+
+    // Everything a build reads: geometries of a bottom level or instanceCount records of instanceBuffer for a top level
+    struct AccelerationStructureInputs {
+        eAccelerationStructureLevel level = eAccelerationStructureLevel::kBottom;
+        // NV build flags are aliases of the KHR ones
+        VkBuildAccelerationStructureFlagsKHR flags = 0;
+        const RayTracingGeometry* geometries = nullptr;
+        uint32_t geometryCount = 0;
+        VkBuffer instanceBuffer = VK_NULL_HANDLE;
+        uint32_t instanceCount = 0;
+    };
+
+    // Every stage gets its own shader group in the order of stages, raygen and miss stages a general one
+    // and closest hit stages a triangles hit group
+    struct RayTracingPipelineInfo {
+        const VkPipelineShaderStageCreateInfo* stages = nullptr;
+        uint32_t stageCount = 0;
+        VkPipelineLayout layout = VK_NULL_HANDLE;
+        uint32_t maxRecursionDepth = 1;
+    };
+
+    // Acceleration structures, pipelines and trace dispatch of one ray tracing extension,
+    // so the renderer runs on VK_NV_ray_tracing as well as on KHR ray tracing of any vendor
+    class RayTracingBackend {
+    public:
+        // Shader binding tables hold a raygen, a miss and a hit group record in this order
+        static constexpr uint32_t kShaderGroupsCount = 3;
+
+        // KHR ray tracing is picked if the device supports it, NV one if it's preferred or the only option
+        static eRayTracingApi SelectApi(Device& device, bool preferNV);
+        // Device extensions to enable on top of descriptor indexing
+        static std::vector<const char*> GetRequiredExtensions(eRayTracingApi api);
+        // The device has to be created with extensions and features of the api
+        static std::unique_ptr<RayTracingBackend> Create(eRayTracingApi api, Device* vkDevice, ThreadPool* threadPool);
+
+        RayTracingBackend(Device* vkDevice);
+        virtual ~RayTracingBackend() = default;
+
+        RayTracingBackend(const RayTracingBackend&) = delete;
+        RayTracingBackend& operator=(const RayTracingBackend&) = delete;
+
+        virtual eRayTracingApi GetApi() const = 0;
+
+        // Allocates the structure for inputs and fills its scratch sizes
+        virtual void CreateAccelerationStructure(const AccelerationStructureInputs& inputs, AccelerationStructure& accelerationStructure) = 0;
+        // Destination of a compacting copy of a bottom level built with flags
+        virtual void CreateCompactedBottomLevel(
+            VkBuildAccelerationStructureFlagsKHR flags, VkDeviceSize compactedSize, AccelerationStructure& accelerationStructure) = 0;
+        virtual void DestroyAccelerationStructure(AccelerationStructure& accelerationStructure) = 0;
+
+        // An update refits the structure in place, inputs may differ from the build ones only in vertex positions or instance transforms
+        virtual void RecordBuild(VkCommandBuffer cmdBuffer, const AccelerationStructureInputs& inputs, const AccelerationStructure& accelerationStructure,
+            bool update, VkBuffer scratchBuffer, VkDeviceSize scratchOffset) const = 0;
+        virtual void RecordCompactingCopy(VkCommandBuffer cmdBuffer, const AccelerationStructure& source, const AccelerationStructure& destination) const = 0;
+        // Writes compacted sizes of structures into consecutive queries of a pool of GetCompactedSizeQueryType
+        virtual void RecordCompactedSizesQuery(VkCommandBuffer cmdBuffer, const std::vector<AccelerationStructure>& structures,
+            VkQueryPool queryPool, uint32_t firstQuery) const = 0;
+        virtual VkQueryType GetCompactedSizeQueryType() const = 0;
+
+        virtual VkBufferUsageFlags GetScratchBufferUsage() const = 0;
+        // Usage of vertex, index and instance buffers read by builds
+        virtual VkBufferUsageFlags GetBuildInputBufferUsage() const = 0;
+        virtual VkDeviceSize GetScratchAlignment() const = 0;
+
+        virtual VkDescriptorType GetAccelerationStructureDescriptorType() const = 0;
+        virtual void WriteAccelerationStructureDescriptor(
+            VkDescriptorSet descriptorSet, uint32_t binding, const AccelerationStructure& accelerationStructure) const = 0;
+
+        // SPIR-V of a ray tracing shader for this backend, e.g. "shaders/compiled/raygen.rgen" + ".spv" or ".khr.spv"
+        virtual std::string GetShaderPath(const std::string& shaderPath) const = 0;
+        // All pipelines are created at once, the KHR backend compiles them on the thread pool
+        virtual void CreatePipelines(const RayTracingPipelineInfo* pipelineInfos, uint32_t pipelinesCount, VkPipeline* pipelines) = 0;
+
+        void CreateShaderBindingTable(VkPipeline pipeline, Buffer& shaderBindingTable) const;
+        virtual void RecordTraceRays(VkCommandBuffer cmdBuffer, const Buffer& shaderBindingTable, uint32_t width, uint32_t height) const = 0;
+
+        uint32_t GetMaxRecursionDepth() const;
+
+    protected:
+        virtual VkBufferUsageFlags GetShaderBindingTableUsage() const = 0;
+        virtual void GetShaderGroupHandles(VkPipeline pipeline, uint32_t groupsCount, size_t dataSize, void* data) const = 0;
+
+        // Records are aligned to shaderGroupBaseAlignment, so any of them can start a region of the table
+        VkDeviceSize GetShaderBindingTableStride() const;
+
+        Device* vkDevice = nullptr;
+
+        uint32_t shaderGroupHandleSize = 0;
+        uint32_t shaderGroupBaseAlignment = 0;
+        uint32_t maxRecursionDepth = 0;
+    };
+}
+}
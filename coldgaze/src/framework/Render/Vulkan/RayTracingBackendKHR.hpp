@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Render/Vulkan/RayTracingBackend.hpp"
+
+namespace CG {
+namespace Vk {
+    // VK_KHR_acceleration_structure with VK_KHR_ray_tracing_pipeline, builds and traces read buffers through device addresses.
+    // Pipelines are compiled as a deferred operation joined by the thread pool
+    class RayTracingBackendKHR : public RayTracingBackend {
+    public:
+        RayTracingBackendKHR(Device* vkDevice, ThreadPool* threadPool);
+
+        eRayTracingApi GetApi() const override;
+
+        void CreateAccelerationStructure(const AccelerationStructureInputs& inputs, AccelerationStructure& accelerationStructure) override;
+        void CreateCompactedBottomLevel(
+            VkBuildAccelerationStructureFlagsKHR flags, VkDeviceSize compactedSize, AccelerationStructure& accelerationStructure) override;
+        void DestroyAccelerationStructure(AccelerationStructure& accelerationStructure) override;
+
+        void RecordBuild(VkCommandBuffer cmdBuffer, const AccelerationStructureInputs& inputs, const AccelerationStructure& accelerationStructure,
+            bool update, VkBuffer scratchBuffer, VkDeviceSize scratchOffset) const override;
+        void RecordCompactingCopy(VkCommandBuffer cmdBuffer, const AccelerationStructure& source, const AccelerationStructure& destination) const override;
+        void RecordCompactedSizesQuery(VkCommandBuffer cmdBuffer, const std::vector<AccelerationStructure>& structures,
+            VkQueryPool queryPool, uint32_t firstQuery) const override;
+        VkQueryType GetCompactedSizeQueryType() const override;
+
+        VkBufferUsageFlags GetScratchBufferUsage() const override;
+        VkBufferUsageFlags GetBuildInputBufferUsage() const override;
+        VkDeviceSize GetScratchAlignment() const override;
+
+        VkDescriptorType GetAccelerationStructureDescriptorType() const override;
+        void WriteAccelerationStructureDescriptor(
+            VkDescriptorSet descriptorSet, uint32_t binding, const AccelerationStructure& accelerationStructure) const override;
+
+        std::string GetShaderPath(const std::string& shaderPath) const override;
+        void CreatePipelines(const RayTracingPipelineInfo* pipelineInfos, uint32_t pipelinesCount, VkPipeline* pipelines) override;
+
+        void RecordTraceRays(VkCommandBuffer cmdBuffer, const Buffer& shaderBindingTable, uint32_t width, uint32_t height) const override;
+
+        // The buffer has to be created with VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
+        VkDeviceAddress GetDeviceAddress(VkBuffer buffer) const;
+
+    protected:
+        VkBufferUsageFlags GetShaderBindingTableUsage() const override;
+        void GetShaderGroupHandles(VkPipeline pipeline, uint32_t groupsCount, size_t dataSize, void* data) const override;
+
+    private:
+        void LoadProcs();
+
+        // Creates the backing buffer of the structure and the structure itself
+        void CreateStorage(VkAccelerationStructureTypeKHR type, VkDeviceSize size, AccelerationStructure& accelerationStructure) const;
+
+        // Keeps calling vkDeferredOperationJoinKHR on the thread pool until the operation is complete
+        VkResult JoinDeferredOperation(VkDeferredOperationKHR deferredOperation) const;
+
+        ThreadPool* threadPool = nullptr;
+
+        VkDeviceSize scratchAlignment = 0;
+
+        PFN_vkGetBufferDeviceAddressKHR vkGetBufferDeviceAddressKHR = nullptr;
+        PFN_vkCreateAccelerationStructureKHR vkCreateAccelerationStructureKHR = nullptr;
+        PFN_vkDestroyAccelerationStructureKHR vkDestroyAccelerationStructureKHR = nullptr;
+        PFN_vkGetAccelerationStructureBuildSizesKHR vkGetAccelerationStructureBuildSizesKHR = nullptr;
+        PFN_vkGetAccelerationStructureDeviceAddressKHR vkGetAccelerationStructureDeviceAddressKHR = nullptr;
+        PFN_vkCmdBuildAccelerationStructuresKHR vkCmdBuildAccelerationStructuresKHR = nullptr;
+        PFN_vkCmdCopyAccelerationStructureKHR vkCmdCopyAccelerationStructureKHR = nullptr;
+        PFN_vkCmdWriteAccelerationStructuresPropertiesKHR vkCmdWriteAccelerationStructuresPropertiesKHR = nullptr;
+        PFN_vkCreateRayTracingPipelinesKHR vkCreateRayTracingPipelinesKHR = nullptr;
+        PFN_vkGetRayTracingShaderGroupHandlesKHR vkGetRayTracingShaderGroupHandlesKHR = nullptr;
+        PFN_vkCmdTraceRaysKHR vkCmdTraceRaysKHR = nullptr;
+        PFN_vkCreateDeferredOperationKHR vkCreateDeferredOperationKHR = nullptr;
+        PFN_vkDestroyDeferredOperationKHR vkDestroyDeferredOperationKHR = nullptr;
+        PFN_vkGetDeferredOperationMaxConcurrencyKHR vkGetDeferredOperationMaxConcurrencyKHR = nullptr;
+        PFN_vkGetDeferredOperationResultKHR vkGetDeferredOperationResultKHR = nullptr;
+        PFN_vkDeferredOperationJoinKHR vkDeferredOperationJoinKHR = nullptr;
+    };
+}
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "Render/Vulkan/RayTracingBackend.hpp"
+
+namespace CG {
+namespace Vk {
+    // VK_NV_ray_tracing, acceleration structures are referenced by opaque handles
+    class RayTracingBackendNV : public RayTracingBackend {
+    public:
+        RayTracingBackendNV(Device* vkDevice);
+
+        eRayTracingApi GetApi() const override;
+
+        void CreateAccelerationStructure(const AccelerationStructureInputs& inputs, AccelerationStructure& accelerationStructure) override;
+        void CreateCompactedBottomLevel(
+            VkBuildAccelerationStructureFlagsKHR flags, VkDeviceSize compactedSize, AccelerationStructure& accelerationStructure) override;
+        void DestroyAccelerationStructure(AccelerationStructure& accelerationStructure) override;
+
+        void RecordBuild(VkCommandBuffer cmdBuffer, const AccelerationStructureInputs& inputs, const AccelerationStructure& accelerationStructure,
+            bool update, VkBuffer scratchBuffer, VkDeviceSize scratchOffset) const override;
+        void RecordCompactingCopy(VkCommandBuffer cmdBuffer, const AccelerationStructure& source, const AccelerationStructure& destination) const override;
+        void RecordCompactedSizesQuery(VkCommandBuffer cmdBuffer, const std::vector<AccelerationStructure>& structures,
+            VkQueryPool queryPool, uint32_t firstQuery) const override;
+        VkQueryType GetCompactedSizeQueryType() const override;
+
+        VkBufferUsageFlags GetScratchBufferUsage() const override;
+        VkBufferUsageFlags GetBuildInputBufferUsage() const override;
+        VkDeviceSize GetScratchAlignment() const override;
+
+        VkDescriptorType GetAccelerationStructureDescriptorType() const override;
+        void WriteAccelerationStructureDescriptor(
+            VkDescriptorSet descriptorSet, uint32_t binding, const AccelerationStructure& accelerationStructure) const override;
+
+        std::string GetShaderPath(const std::string& shaderPath) const override;
+        void CreatePipelines(const RayTracingPipelineInfo* pipelineInfos, uint32_t pipelinesCount, VkPipeline* pipelines) override;
+
+        void RecordTraceRays(VkCommandBuffer cmdBuffer, const Buffer& shaderBindingTable, uint32_t width, uint32_t height) const override;
+
+    protected:
+        VkBufferUsageFlags GetShaderBindingTableUsage() const override;
+        void GetShaderGroupHandles(VkPipeline pipeline, uint32_t groupsCount, size_t dataSize, void* data) const override;
+
+    private:
+        void LoadProcs();
+
+        // Allocates and binds memory of a created structure, scratch sizes are queried as well
+        void BindMemory(AccelerationStructure& accelerationStructure) const;
+        VkDeviceSize GetMemorySize(VkAccelerationStructureNV accelerationStructure, VkAccelerationStructureMemoryRequirementsTypeNV type) const;
+
+        PFN_vkCreateAccelerationStructureNV vkCreateAccelerationStructureNV = nullptr;
+        PFN_vkDestroyAccelerationStructureNV vkDestroyAccelerationStructureNV = nullptr;
+        PFN_vkBindAccelerationStructureMemoryNV vkBindAccelerationStructureMemoryNV = nullptr;
+        PFN_vkGetAccelerationStructureHandleNV vkGetAccelerationStructureHandleNV = nullptr;
+        PFN_vkGetAccelerationStructureMemoryRequirementsNV vkGetAccelerationStructureMemoryRequirementsNV = nullptr;
+        PFN_vkCmdBuildAccelerationStructureNV vkCmdBuildAccelerationStructureNV = nullptr;
+        PFN_vkCmdCopyAccelerationStructureNV vkCmdCopyAccelerationStructureNV = nullptr;
+        PFN_vkCmdWriteAccelerationStructuresPropertiesNV vkCmdWriteAccelerationStructuresPropertiesNV = nullptr;
+        PFN_vkCreateRayTracingPipelinesNV vkCreateRayTracingPipelinesNV = nullptr;
+        PFN_vkGetRayTracingShaderGroupHandlesNV vkGetRayTracingShaderGroupHandlesNV = nullptr;
+        PFN_vkCmdTraceRaysNV vkCmdTraceRaysNV = nullptr;
+    };
+}
+}
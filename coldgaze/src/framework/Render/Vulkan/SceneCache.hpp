@@ -0,0 +1,214 @@
+#pragma once
+
+#include "Core/MappedFile.hpp"
+#include "glm/mat4x4.hpp"
+#include "glm/vec3.hpp"
+#include "glm/vec4.hpp"
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#pragma warning(push, 0)
+#include "glm/ext/quaternion_float.hpp"
+#pragma warning(pop)
+
+namespace CG {
+namespace Vk {
+    // Binary .cgscene file written next to a glTF model after its first load.
+    // Geometry and textures are stored exactly as they are uploaded, so the next load only maps the file
+    // and copies blobs into the staging ring. Records are plain structs of this engine build, the cache is not portable.
+    namespace SceneCache {
+
+        constexpr uint32_t kMagic = 0x53434743; // "CGCS"
+        // Bump on any change of records, vertex formats or texture payloads
+        constexpr uint32_t kVersion = 3;
+
+        constexpr const char* kFileExtension = ".cgscene";
+
+        // Blobs start at this alignment inside of the file, enough for any vertex, index or texel block
+        constexpr uint64_t kBlobAlignment = 16;
+
+        // Range of the file, either a blob or an array of records
+        struct Range {
+            uint64_t offset = 0;
+            uint64_t size = 0;
+        };
+
+        // Range of the strings blob
+        struct StringRef {
+            uint32_t offset = 0;
+            uint32_t length = 0;
+        };
+
+        struct Header {
+            uint32_t magic = kMagic;
+            uint32_t version = kVersion;
+
+            // GLTFModel::LoadingParams the cache was written with
+            uint32_t geometryLayout = 0;
+            uint32_t vertexFormat = 0;
+            uint32_t mipGeneration = 0;
+            uint32_t textureCompression = 0;
+            float scale = 1.0f;
+            uint32_t vertexStride = 0;
+
+            // Arrays of the records below
+            Range dependencies = {};
+            Range textures = {};
+            Range materials = {};
+            // GLTFModel::Material::MaterialParams of every material record, ready for the uniform buffers
+            Range materialParams = {};
+            Range geometries = {};
+            Range nodes = {};
+            Range primitives = {};
+            Range extensions = {};
+
+            Range strings = {};
+        };
+
+        // Source file the cache was built from: the model itself, its external buffers and images.
+        // Any change of size or modification time invalidates the cache
+        struct DependencyRecord {
+            StringRef path = {}; // relative to the model directory
+            uint64_t size = 0;
+            int64_t modifiedTime = 0;
+        };
+
+        struct TextureRecord {
+            uint32_t width = 0;
+            uint32_t height = 0;
+            // Levels stored in data
+            uint32_t mipLevels = 1;
+            uint32_t format = 0; // VkFormat, levels of BC formats are stored as blocks
+            uint32_t magFilter = 0;
+            uint32_t minFilter = 0;
+            uint32_t addressModeU = 0;
+            uint32_t addressModeV = 0;
+            uint32_t addressModeW = 0;
+            // Rest of the chain is blitted on the GPU after the stored levels are uploaded
+            uint32_t generateMips = 0;
+            // Stored mip levels, tightly packed
+            Range data = {};
+        };
+
+        struct MaterialRecord {
+            glm::vec4 baseColorFactor = {};
+            glm::vec4 emissiveFactor = {};
+            float metallicFactor = 1.0f;
+            float roughnessFactor = 1.0f;
+            float alphaCutoff = 1.0f;
+            uint32_t alphaMode = 0;
+
+            // Texture indices, -1 if there is no texture
+            int32_t baseColorTexture = -1;
+            int32_t metallicRoughnessTexture = -1;
+            int32_t normalTexture = -1;
+            int32_t occlusionTexture = -1;
+            int32_t emissiveTexture = -1;
+
+            int32_t baseColorTexCoordSet = 0;
+            int32_t metallicRoughnessTexCoordSet = 0;
+            int32_t specularGlossinessTexCoordSet = 0;
+            int32_t normalTexCoordSet = 0;
+            int32_t occlusionTexCoordSet = 0;
+            int32_t emissiveTexCoordSet = 0;
+        };
+
+        struct GeometryRecord {
+            uint32_t vertexCount = 0;
+            uint32_t padding = 0;
+            Range vertices = {};
+            Range indices = {};
+        };
+
+        // Nodes are stored in GLTFModel::GetFlatNodes() order, children always go before their parent
+        struct NodeRecord {
+            glm::mat4 matrix = glm::mat4(1.0f);
+            glm::quat rotation = {};
+            glm::vec3 translation = {};
+            glm::vec3 scale = glm::vec3(1.0f);
+            glm::vec3 meshBBoxMin = {};
+            glm::vec3 meshBBoxMax = {};
+            uint32_t meshBBoxValid = 0;
+
+            int32_t parent = -1; // record index
+            uint32_t index = 0; // glTF node index
+            StringRef name = {};
+
+            // Primitive records of the mesh, -1 if the node has no mesh
+            int32_t firstPrimitive = -1;
+            uint32_t primitivesCount = 0;
+        };
+
+        struct PrimitiveRecord {
+            uint32_t firstIndex = 0;
+            uint32_t firstVertex = 0;
+            uint32_t indexCount = 0;
+            uint32_t vertexCount = 0;
+            uint32_t geometryBufferIndex = 0;
+            uint32_t indexType = 0; // VkIndexType
+            uint32_t material = 0; // material record index
+            uint32_t bboxValid = 0;
+            glm::vec3 bboxMin = {};
+            glm::vec3 bboxMax = {};
+        };
+
+        std::string GetCachePath(const std::string& modelPath);
+
+        // Returns false if the file doesn't exist
+        bool GetFileStamp(const std::string& filePath, uint64_t& size, int64_t& modifiedTime);
+
+        // Streams the cache into a temporary file, which replaces the old cache only once it is complete
+        class Writer {
+        public:
+            ~Writer();
+
+            bool Open(const std::string& cachePath);
+
+            // Both return the range of the written data inside of the file
+            Range WriteBlob(const void* data, size_t size);
+            template <typename Record>
+            Range WriteRecords(const std::vector<Record>& records)
+            {
+                return WriteBlob(records.data(), records.size() * sizeof(Record));
+            }
+
+            // Strings are collected in memory and written by Finish
+            StringRef AddString(const std::string& string);
+
+            bool Finish(Header& header);
+
+        private:
+            std::ofstream file;
+            std::string path;
+            std::string tempPath;
+            std::string strings;
+            bool finished = false;
+        };
+
+        class Reader {
+        public:
+            // Fails if the file doesn't exist or was written by another engine version
+            bool Open(const std::string& cachePath);
+
+            const Header& GetHeader() const;
+
+            // nullptr if the range is outside of the file
+            const uint8_t* GetBlob(const Range& range) const;
+            template <typename Record>
+            const Record* GetRecords(const Range& range, size_t& count) const
+            {
+                count = static_cast<size_t>(range.size / sizeof(Record));
+                return reinterpret_cast<const Record*>(GetBlob(range));
+            }
+
+            std::string GetString(const StringRef& string) const;
+
+        private:
+            MappedFile file;
+            Header header = {};
+        };
+    }
+}
+}
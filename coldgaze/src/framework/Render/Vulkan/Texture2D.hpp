@@ -2,11 +2,13 @@
 
 #include "Texture.hpp"
 #include "vulkan/vulkan_core.h"
+#include <functional>
 #include <string>
 
 namespace CG {
 namespace Vk {
     class Device;
+    class UploadBatcher;
 
     struct TextureSampler {
         VkFilter magFilter;
@@ -18,7 +20,21 @@ namespace Vk {
 
     class Texture2D : public Texture {
     public:
-        void LoadFromFile(const std::string& fileName, Device* device, VkQueue copyQueue, bool loadHDR = false);
+        // Packed format of HDR images, both are optimally tiled and have a full mip chain
+        enum class eHDRFormat {
+            // VK_FORMAT_E5B9G9R9_UFLOAT_PACK32, 4 bytes per texel
+            kSharedExponent,
+            // VK_FORMAT_R16G16B16A16_SFLOAT, 8 bytes per texel, keeps precision of saturated colors
+            kHalf,
+        };
+
+        // Sees every float RGB row of level 0 while an HDR image is uploaded, y = 0 is the bottom row
+        using HDRRowVisitor = std::function<void(uint32_t imageWidth, uint32_t imageHeight, uint32_t y, const float* row)>;
+
+        // .ktx2 files are uploaded with their own format and levels, Radiance .hdr files are decoded scanline by scanline
+        // into staging memory when loadHDR is set, anything else goes through stb_image
+        void LoadFromFile(const std::string& fileName, Device* device, VkQueue copyQueue, bool loadHDR = false,
+            eHDRFormat hdrFormat = eHDRFormat::kSharedExponent, const HDRRowVisitor& hdrRowVisitor = nullptr);
 
         void FromBuffer(
             const void* buffer,
@@ -32,6 +48,47 @@ namespace Vk {
             VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
             VkImageTiling imageTiling = VK_IMAGE_TILING_LINEAR,
             TextureSampler textureSampler = {});
+
+        // Image, view and sampler are created right away, pixels reach the GPU with the next uploadBatcher flush.
+        // Buffer holds levelsCount tightly packed mip levels, starting from the biggest one.
+        // With generateMips the rest of the chain down to 1x1 is blitted from the last given level, if the format allows it
+        void FromBuffer(
+            const void* buffer,
+            VkDeviceSize bufferSize,
+            VkFormat format,
+            uint32_t texWidth,
+            uint32_t texHeight,
+            uint16_t levelsCount,
+            Device* device,
+            UploadBatcher& uploadBatcher,
+            TextureSampler textureSampler,
+            bool generateMips = false);
+
+        // Pixels are float RGB of texWidth x texHeight, the mip chain is filtered on the CPU and packed into hdrFormat
+        void FromHDRPixels(const float* pixels, uint32_t texWidth, uint32_t texHeight, Device* device, VkQueue copyQueue,
+            eHDRFormat hdrFormat, const TextureSampler& textureSampler, const HDRRowVisitor& hdrRowVisitor = nullptr);
+
+        // Size of a tightly packed mip level
+        static VkDeviceSize GetLevelSize(VkFormat format, uint32_t levelWidth, uint32_t levelHeight);
+        static VkDeviceSize GetMipChainSize(VkFormat format, uint32_t texWidth, uint32_t texHeight, uint16_t levelsCount);
+
+        // BC formats, levels are stored and copied by 4x4 blocks
+        static bool IsBlockCompressed(VkFormat format);
+
+        // Optimal tiling images of the format can be blitted with linear filtering
+        static bool SupportsMipBlits(const Device* device, VkFormat format);
+
+    private:
+        void LoadFromKTX2(const std::string& fileName, Device* device, VkQueue copyQueue);
+        void LoadFromRadianceHDR(const uint8_t* data, size_t size, Device* device, VkQueue copyQueue, eHDRFormat hdrFormat,
+            const TextureSampler& textureSampler, const HDRRowVisitor& hdrRowVisitor);
+
+        // readRow fills float RGB rows from the top of the image down, all levels are filtered and packed while they arrive
+        void UploadHDRRows(uint32_t texWidth, uint32_t texHeight, Device* device, VkQueue copyQueue, eHDRFormat hdrFormat,
+            const TextureSampler& textureSampler, const std::function<void(float* row)>& readRow, const HDRRowVisitor& hdrRowVisitor);
+
+        void CreateImage(VkFormat format, VkImageUsageFlags imageUsageFlags, VkImageTiling imageTiling);
+        void CreateSamplerAndView(VkFormat format, const TextureSampler& textureSampler);
     };
 }
 }
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "Render/Vulkan/Buffer.hpp"
+#include "vulkan/vulkan_core.h"
+#include <chrono>
+
+namespace CG {
+namespace Vk {
+    class Device;
+
+    // Packs host to device copies into one ring staging buffer and records them into a single command buffer,
+    // so a whole model goes to the GPU with one submit and one fence wait instead of a flush per resource.
+    class UploadBatcher {
+    public:
+        static constexpr VkDeviceSize kDefaultStagingSize = 64 * 1024 * 1024;
+
+        UploadBatcher(Device* vkDevice, VkQueue queue, VkDeviceSize stagingSize = kDefaultStagingSize);
+        ~UploadBatcher();
+
+        UploadBatcher(const UploadBatcher&) = delete;
+        UploadBatcher& operator=(const UploadBatcher&) = delete;
+
+        // Data is copied into the staging ring immediately, so the source can be released right after the call
+        void Upload(const Buffer& dstBuffer, const void* data, VkDeviceSize dataSize, VkDeviceSize dstOffset = 0);
+
+        // Records a layout transition in order with the copies
+        void TransitionImage(VkImage image, const VkImageSubresourceRange& subresourceRange, VkImageLayout oldLayout, VkImageLayout newLayout);
+
+        // Copies a tightly packed mip level into the image, which has to be in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL.
+        // Levels bigger than the ring are streamed in bands of rows, blockHeight is 4 for block compressed formats
+        void UploadImage(VkImage image, uint32_t mipLevel, uint32_t width, uint32_t height, const void* data, VkDeviceSize dataSize,
+            uint32_t blockHeight = 1);
+
+        // Reserves staging memory for rowsCount tightly packed rows of a mip level, starting from firstRow, and records their copy.
+        // Rows have to be written through the returned pointer before the next call to the batcher, which may submit the copy.
+        // Lets decoders write texels straight into staging, rowsCount * rowSize can't exceed the ring
+        void* ReserveImageRows(VkImage image, uint32_t mipLevel, uint32_t width, uint32_t firstRow, uint32_t rowsCount, VkDeviceSize rowSize);
+
+        // Fills levels baseLevel + 1 .. levelsCount - 1 with linear blits, every level from the previous one.
+        // All levels have to be in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, all of them end up in finalLayout
+        void GenerateMipChain(VkImage image, uint32_t width, uint32_t height, uint32_t baseLevel, uint32_t levelsCount,
+            VkImageLayout finalLayout);
+
+        // Submits all recorded copies and waits for them, prints upload statistics
+        void Flush();
+
+        VkDeviceSize GetUploadedBytes() const;
+        VkDeviceSize GetStagingSize() const;
+
+    private:
+        // Returns offset of the free staging range, submits pending copies if the ring is full
+        VkDeviceSize AllocateStaging(VkDeviceSize allocationSize);
+
+        void RecordImageCopy(VkImage image, uint32_t mipLevel, VkDeviceSize srcOffset, uint32_t width, uint32_t firstRow, uint32_t rowsCount);
+
+        // Commands which don't go through the staging ring still have to be recorded into an open command buffer
+        void BeginRecording();
+        void BeginCommandBuffer();
+        void SubmitAndWait();
+
+        Device* vkDevice = nullptr;
+        VkQueue queue = VK_NULL_HANDLE;
+
+        Buffer staging = {};
+        VkDeviceSize stagingOffset = 0;
+
+        VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+        bool recording = false;
+
+        uint32_t submitsCount = 0;
+        VkDeviceSize pendingBytes = 0;
+        VkDeviceSize uploadedBytes = 0;
+        std::chrono::high_resolution_clock::time_point uploadStart = {};
+    };
+}
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace CG {
+namespace Vk {
+    // Conversion of whole glTF accessors into the interleaved GLTFModel::Vertex layout.
+    // Source elements are srcStride bytes apart, destination vec4s are dstStride bytes apart.
+    namespace VertexKernels {
+
+        enum class eInstructionSet {
+            kScalar,
+            kSSE2,
+            kAVX2,
+        };
+
+        // Best instruction set supported by the CPU, detected once
+        eInstructionSet GetSupportedInstructionSet();
+
+        // Kernels use the supported instruction set by default, lower one can be forced for comparison
+        eInstructionSet GetInstructionSet();
+        void SetInstructionSet(eInstructionSet instructionSet);
+
+        const char* GetInstructionSetName(eInstructionSet instructionSet);
+
+        // float3 -> float4(xyz, 1.0)
+        void ConvertPositions(const void* src, size_t srcStride, size_t count, void* dst, size_t dstStride);
+
+        // float3 -> float4(normalize(xyz), 1.0), zero length normals stay zero
+        void ConvertNormals(const void* src, size_t srcStride, size_t count, void* dst, size_t dstStride);
+
+        // Two float2 sets -> float4(uv0, uv1), missing set (nullptr) is written as zeros
+        void ConvertTexCoords(const void* uv0Src, size_t uv0Stride, const void* uv1Src, size_t uv1Stride,
+            size_t count, void* dst, size_t dstStride);
+
+        void WidenIndices(const uint8_t* src, size_t count, uint32_t* dst);
+        void WidenIndices(const uint16_t* src, size_t count, uint32_t* dst);
+    }
+}
+}
@@ -2,6 +2,7 @@
 #include <iostream>
 #include <memory>
 
+#include "Benchmarks/VertexKernelsBenchmark.hpp"
 #include "Core/EngineConfig.hpp"
 #include "Core/EngineImpl.hpp"
 #include "SDL2/SDL.h"
@@ -20,6 +21,12 @@ int main(int argc, char* argv[])
         engineConfig.args.push_back(argv[i]);
     };
 
+    for (const char* arg : engineConfig.args) {
+        if (arg == std::string("-benchmark-vertex-kernels")) {
+            return CG::Benchmarks::RunVertexKernelsBenchmark();
+        }
+    }
+
     CG::EngineImpl engine = { engineConfig };
 
     int execResult;